@@ -113,6 +113,7 @@ HEADERS += \
     baseoperations/math/unarymathtable.h \
     baseoperations/util/stringoperations.h \
     baseoperations/util/testoperation.h \
+    baseoperations/util/iterationbenchmark.h \
     baseoperations/util/text2output.h \
     baseoperations/util/workingcatalog.h \
     baseoperations/baseoperations_global.h \
@@ -191,6 +192,7 @@ SOURCES += \
     baseoperations/math/unarymathtable.cpp \
     baseoperations/util/stringoperations.cpp \
     baseoperations/util/testoperation.cpp \
+    baseoperations/util/iterationbenchmark.cpp \
     baseoperations/util/text2output.cpp \
     baseoperations/util/workingcatalog.cpp \
     baseoperations/baseoperationsmodule.cpp
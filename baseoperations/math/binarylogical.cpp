@@ -54,7 +54,7 @@ bool BinaryLogical::executeCoverageNumber(ExecutionContext *ctx, SymbolTable& sy
 
     auto BinaryLogical = [&](const BoundingBox box, int threadIdx ) -> bool {
         PixelIterator iterIn(_inputGC1, box);
-        PixelIterator iterOut(_outputGC, BoundingBox(box.size()));
+        PixelIterator iterOut(_outputGC, box);
 
         std::for_each(iterOut, iterOut.end(), [&](double& v){
             double v_in1 = *iterIn;
@@ -64,7 +64,6 @@ bool BinaryLogical::executeCoverageNumber(ExecutionContext *ctx, SymbolTable& sy
         return true;
     };
 
-    ctx->_threaded = false;
 	if (!OperationHelperRaster::execute(ctx, BinaryLogical, { _inputGC1,_outputGC }))
         return false;
     return setOutput(ctx, symTable);
@@ -74,7 +73,7 @@ bool BinaryLogical::executeCoverageCoverage(ExecutionContext *ctx, SymbolTable&
     std::function<bool(const BoundingBox&, int threadIdx)> binaryLogical = [&](const BoundingBox& box, int threadIdx) -> bool {
         PixelIterator iterIn1(_inputGC1, box);
         PixelIterator iterIn2(_inputGC2, box);
-        PixelIterator iterOut(_outputGC, BoundingBox(box.size()));
+        PixelIterator iterOut(_outputGC, box);
 
         double v_in1 = 0;
         double v_in2 = 0;
@@ -94,7 +93,6 @@ bool BinaryLogical::executeCoverageCoverage(ExecutionContext *ctx, SymbolTable&
         }
     }
 
-    ctx->_threaded = false;
 	bool resource = OperationHelperRaster::execute(ctx, binaryLogical, { _inputGC1, _inputGC2, _outputGC });
 
     if (resource && ctx)
@@ -23,6 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #include "symboltable.h"
 #include "ilwisoperation.h"
 #include "numericoperation.h"
+#include "calculatoroperation.h"
 #include "binarymathraster.h"
 
 using namespace Ilwis;
@@ -53,23 +54,77 @@ bool BinaryMathRaster::setOutput(ExecutionContext *ctx, SymbolTable& symTable) {
     return _outputGC.isValid();
 }
 
+/*!
+ * \brief BinaryMathRaster::executeDeferred makes the output a deferred raster (see CalculatorExpression) instead of computing it; an input that is itself deferred
+ * is fused into the expression of the output
+ * \return false if the operation must be computed directly
+ */
+bool BinaryMathRaster::executeDeferred(ExecutionContext *ctx, SymbolTable& symTable) {
+    if ( !CalculatorOperation::deferExpressions())
+        return false;
+
+    CalculatorOperation::Program::Instruction instruction;
+    switch(_operator) {
+    case otPLUS:
+        instruction._action = CalculatorOperation::maADD; break;
+    case otMINUS:
+        instruction._action = CalculatorOperation::maMINUS; break;
+    case otMULT:
+        instruction._action = CalculatorOperation::maMULT; break;
+    case otDIV:
+        instruction._action = CalculatorOperation::maDIVIDE; break;
+    case otPOW:
+        instruction._action = CalculatorOperation::maPOW; break;
+    case otMIN:
+        instruction._action = CalculatorOperation::maMIN; break;
+    case otMAX:
+        instruction._action = CalculatorOperation::maMAX; break;
+    default:
+        return false;
+    }
+    instruction._anyUndef = false; // calc() only treats rUNDEF as undefined
+
+    CalculatorOperation::Program program;
+    program._sources.push_back(_inputGC1);
+    if ( _coveragecoverage) {
+        if ( !_inputGC1->georeference()->isCompatible(_inputGC2->georeference()) || _inputGC1->size() != _inputGC2->size())
+            return false;
+        if ( _inputGC2->id() != _inputGC1->id())
+            program._sources.push_back(_inputGC2);
+        instruction._operands = { 0, (int)program._sources.size() - 1};
+    } else {
+        program._constants.push_back(_number1);
+        instruction._operands = _firstorder ? std::vector<int>{1, 0} : std::vector<int>{0, 1};
+    }
+    for(const IRasterCoverage& source : program._sources) {
+        if ( source->id() == _outputGC->id())
+            return false;
+    }
+    program._instructions.push_back(instruction);
+    CalculatorOperation::fuse(program);
+    CalculatorOperation::defer(program, _outputGC);
+
+    return setOutput(ctx, symTable);
+}
+
 bool BinaryMathRaster::executeCoverageNumber(ExecutionContext *ctx, SymbolTable& symTable) {
 
-    quint64 currentCount = 0;
-    auto binaryMath = [&](const BoundingBox box, int threadIdx) -> bool {
+    std::atomic<quint64> currentCount(0);
+    auto binaryMath = [&](const BoundingBox box, int threadIdx, OutputStatistics::Written& written) -> bool {
         PixelIterator iterIn(_inputGC1, box);
-        PixelIterator iterOut(_outputGC, BoundingBox(box.size()));
-
-        std::for_each(iterOut, iterOut.end(), [&](double& v){
+        PixelIterator iterOut(_outputGC, box);
 
-            v = _firstorder ? calc(_number1, *iterIn) : calc(*iterIn, _number1);
+        PixelIterator iterEnd = end(iterOut);
+        while(iterOut != iterEnd) {
+            *iterOut = _firstorder ? calc(_number1, *iterIn) : calc(*iterIn, _number1);
+            written.add(iterOut.z(), *iterOut);
             ++iterIn;
+            ++iterOut;
             updateTranquilizer(currentCount++, 1000);
-        });
+        }
         return true;
     };
 
-    ctx->_threaded = false;
 	if (!OperationHelperRaster::execute(ctx, binaryMath, { _inputGC1, _outputGC }))
             return false;
 
@@ -79,8 +134,8 @@ bool BinaryMathRaster::executeCoverageNumber(ExecutionContext *ctx, SymbolTable&
 }
 
 bool BinaryMathRaster::executeCoverageCoverage(ExecutionContext *ctx, SymbolTable& symTable) {
-    quint64 currentCount = 0;
-    std::function<bool(const BoundingBox, int )> binaryMath = [&](const BoundingBox box, int threadIdx) -> bool {
+    std::atomic<quint64> currentCount(0);
+    auto binaryMath = [&](const BoundingBox box, int threadIdx, OutputStatistics::Written& written) -> bool {
         PixelIterator iterIn1(_inputGC1, box);
         PixelIterator iterIn2(_inputGC2, box);
         PixelIterator iterOut(_outputGC, box);
@@ -89,6 +144,7 @@ bool BinaryMathRaster::executeCoverageCoverage(ExecutionContext *ctx, SymbolTabl
         PixelIterator iterEnd = end(iterOut);
         while(iterOut != iterEnd) {
             *iterOut = calc(*iterIn1, *iterIn2);
+            written.add(iterOut.z(), *iterOut);
             ++iterIn1;
             ++iterIn2;
             ++iterOut;
@@ -102,12 +158,7 @@ bool BinaryMathRaster::executeCoverageCoverage(ExecutionContext *ctx, SymbolTabl
             return ERROR2(ERR_COULD_NOT_CONVERT_2, TR("georeferences"), TR("common base"));
         }
     }
-    // TODO:, research this exception
-    // because of the swapping mechanism it is probably detrimental to use multithread here as blocks may continously be swapping
-    //if ( _inputGC1 == _inputGC2)
-        ctx->_threaded = false;
-
-		if (OperationHelperRaster::execute(ctx, binaryMath, { _inputGC1, _inputGC2,_outputGC }))
+	if (OperationHelperRaster::execute(ctx, binaryMath, { _inputGC1, _inputGC2,_outputGC }))
         return setOutput(ctx, symTable);
 
     return false;
@@ -123,6 +174,8 @@ bool BinaryMathRaster::execute(ExecutionContext *ctx, SymbolTable& symTable)
         double result = calc(_leftValue, _rightValue);
         QVariant v = result;
         ctx->setOutput(symTable,v,sUNDEF, itDOUBLE, Resource() );
+    }else if ( executeDeferred(ctx, symTable)) {
+        return true;
     }else if ( _coveragecoverage) {
         return executeCoverageCoverage(ctx, symTable);
 
@@ -36,6 +36,7 @@ private:
     bool prepareCoverageCoverage();
     bool prepareCoverageNumber(IlwisTypes ptype1, IlwisTypes ptype2);
     bool setOutput(ExecutionContext *ctx, SymbolTable& symTable);
+    bool executeDeferred(ExecutionContext *ctx, SymbolTable& symTable);
 
     bool _coveragecoverage;
     IRasterCoverage _inputGC1;
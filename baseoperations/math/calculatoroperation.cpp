@@ -30,12 +30,188 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #include "itemdomain.h"
 #include "symboltable.h"
 #include "commandhandler.h"
+#include "ilwiscontext.h"
 #include "numericoperation.h"
 #include "calculatoroperation.h"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CALCULATOR_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CALCULATOR_SSE2
+#endif
+
 using namespace Ilwis;
 using namespace BaseOperations;
 
+const quint32 CalculatorOperation::PROGRAMCHUNK;
+
+namespace {
+// kernels of the compiled programs. The arithmetic and comparisons have a vector variant; the undefined check is the same as isNumericalUndef()
+#if defined(CALCULATOR_AVX)
+typedef __m256d VectorType;
+const quint32 VECTORSIZE = 4;
+
+inline VectorType undefMask(VectorType v) {
+    VectorType mask = _mm256_cmp_pd(v, _mm256_set1_pd(rUNDEF), _CMP_EQ_OQ);
+    mask = _mm256_or_pd(mask, _mm256_cmp_pd(v, _mm256_set1_pd((double)iUNDEF), _CMP_EQ_OQ));
+    mask = _mm256_or_pd(mask, _mm256_cmp_pd(v, _mm256_set1_pd((double)shUNDEF), _CMP_EQ_OQ));
+    mask = _mm256_or_pd(mask, _mm256_cmp_pd(v, _mm256_set1_pd((double)flUNDEF), _CMP_EQ_OQ));
+    return _mm256_or_pd(mask, _mm256_cmp_pd(v, _mm256_set1_pd((double)i64UNDEF), _CMP_EQ_OQ));
+}
+inline VectorType rUndefMask(VectorType v) { return _mm256_cmp_pd(v, _mm256_set1_pd(rUNDEF), _CMP_EQ_OQ); }
+inline VectorType load(const PIXVALUETYPE *v) { return _mm256_loadu_pd(v); }
+inline void storeMasked(PIXVALUETYPE *result, VectorType v, VectorType mask) { _mm256_storeu_pd(result, _mm256_blendv_pd(v, _mm256_set1_pd(PIXVALUEUNDEF), mask)); }
+inline VectorType truth(VectorType mask) { return _mm256_and_pd(mask, _mm256_set1_pd(1.0)); }
+#elif defined(CALCULATOR_SSE2)
+typedef __m128d VectorType;
+const quint32 VECTORSIZE = 2;
+
+inline VectorType undefMask(VectorType v) {
+    VectorType mask = _mm_cmpeq_pd(v, _mm_set1_pd(rUNDEF));
+    mask = _mm_or_pd(mask, _mm_cmpeq_pd(v, _mm_set1_pd((double)iUNDEF)));
+    mask = _mm_or_pd(mask, _mm_cmpeq_pd(v, _mm_set1_pd((double)shUNDEF)));
+    mask = _mm_or_pd(mask, _mm_cmpeq_pd(v, _mm_set1_pd((double)flUNDEF)));
+    return _mm_or_pd(mask, _mm_cmpeq_pd(v, _mm_set1_pd((double)i64UNDEF)));
+}
+inline VectorType rUndefMask(VectorType v) { return _mm_cmpeq_pd(v, _mm_set1_pd(rUNDEF)); }
+inline VectorType load(const PIXVALUETYPE *v) { return _mm_loadu_pd(v); }
+inline void storeMasked(PIXVALUETYPE *result, VectorType v, VectorType mask) {
+    _mm_storeu_pd(result, _mm_or_pd(_mm_and_pd(mask, _mm_set1_pd(PIXVALUEUNDEF)), _mm_andnot_pd(mask, v)));
+}
+inline VectorType truth(VectorType mask) { return _mm_and_pd(mask, _mm_set1_pd(1.0)); }
+#endif
+
+#if defined(CALCULATOR_AVX)
+#define VECTOR_OP(avx, sse) avx
+#elif defined(CALCULATOR_SSE2)
+#define VECTOR_OP(avx, sse) sse
+#endif
+
+// every operation has a scalar variant; vector() may add lanes to the undefined mask (e.g. division by zero)
+struct AddOp {
+    static PIXVALUETYPE scalar(PIXVALUETYPE v1, PIXVALUETYPE v2) { return v1 + v2; }
+#ifdef VECTOR_OP
+    static VectorType vector(VectorType v1, VectorType v2, VectorType&) { return VECTOR_OP(_mm256_add_pd, _mm_add_pd)(v1, v2); }
+#endif
+};
+struct MinusOp {
+    static PIXVALUETYPE scalar(PIXVALUETYPE v1, PIXVALUETYPE v2) { return v1 - v2; }
+#ifdef VECTOR_OP
+    static VectorType vector(VectorType v1, VectorType v2, VectorType&) { return VECTOR_OP(_mm256_sub_pd, _mm_sub_pd)(v1, v2); }
+#endif
+};
+struct MultOp {
+    static PIXVALUETYPE scalar(PIXVALUETYPE v1, PIXVALUETYPE v2) { return v1 * v2; }
+#ifdef VECTOR_OP
+    static VectorType vector(VectorType v1, VectorType v2, VectorType&) { return VECTOR_OP(_mm256_mul_pd, _mm_mul_pd)(v1, v2); }
+#endif
+};
+struct DivideOp {
+    static PIXVALUETYPE scalar(PIXVALUETYPE v1, PIXVALUETYPE v2) { return v2 == 0 ? PIXVALUEUNDEF : v1 / v2; }
+#if defined(CALCULATOR_AVX)
+    static VectorType vector(VectorType v1, VectorType v2, VectorType& mask) {
+        mask = _mm256_or_pd(mask, _mm256_cmp_pd(v2, _mm256_setzero_pd(), _CMP_EQ_OQ));
+        return _mm256_div_pd(v1, v2);
+    }
+#elif defined(CALCULATOR_SSE2)
+    static VectorType vector(VectorType v1, VectorType v2, VectorType& mask) {
+        mask = _mm_or_pd(mask, _mm_cmpeq_pd(v2, _mm_setzero_pd()));
+        return _mm_div_pd(v1, v2);
+    }
+#endif
+};
+struct LessOp {
+    static PIXVALUETYPE scalar(PIXVALUETYPE v1, PIXVALUETYPE v2) { return v1 < v2; }
+#ifdef VECTOR_OP
+    static VectorType vector(VectorType v1, VectorType v2, VectorType&) { return truth(VECTOR_OP(_mm256_cmp_pd(v1, v2, _CMP_LT_OQ), _mm_cmplt_pd(v1, v2))); }
+#endif
+};
+struct LessEqOp {
+    static PIXVALUETYPE scalar(PIXVALUETYPE v1, PIXVALUETYPE v2) { return v1 <= v2; }
+#ifdef VECTOR_OP
+    static VectorType vector(VectorType v1, VectorType v2, VectorType&) { return truth(VECTOR_OP(_mm256_cmp_pd(v1, v2, _CMP_LE_OQ), _mm_cmple_pd(v1, v2))); }
+#endif
+};
+struct GreaterOp {
+    static PIXVALUETYPE scalar(PIXVALUETYPE v1, PIXVALUETYPE v2) { return v1 > v2; }
+#ifdef VECTOR_OP
+    static VectorType vector(VectorType v1, VectorType v2, VectorType&) { return truth(VECTOR_OP(_mm256_cmp_pd(v1, v2, _CMP_GT_OQ), _mm_cmpgt_pd(v1, v2))); }
+#endif
+};
+struct GreaterEqOp {
+    static PIXVALUETYPE scalar(PIXVALUETYPE v1, PIXVALUETYPE v2) { return v1 >= v2; }
+#ifdef VECTOR_OP
+    static VectorType vector(VectorType v1, VectorType v2, VectorType&) { return truth(VECTOR_OP(_mm256_cmp_pd(v1, v2, _CMP_GE_OQ), _mm_cmpge_pd(v1, v2))); }
+#endif
+};
+struct EqOp {
+    static PIXVALUETYPE scalar(PIXVALUETYPE v1, PIXVALUETYPE v2) { return v1 == v2; }
+#ifdef VECTOR_OP
+    static VectorType vector(VectorType v1, VectorType v2, VectorType&) { return truth(VECTOR_OP(_mm256_cmp_pd(v1, v2, _CMP_EQ_OQ), _mm_cmpeq_pd(v1, v2))); }
+#endif
+};
+struct NeqOp {
+    static PIXVALUETYPE scalar(PIXVALUETYPE v1, PIXVALUETYPE v2) { return v1 != v2; }
+#ifdef VECTOR_OP
+    static VectorType vector(VectorType v1, VectorType v2, VectorType&) { return truth(VECTOR_OP(_mm256_cmp_pd(v1, v2, _CMP_NEQ_UQ), _mm_cmpneq_pd(v1, v2))); }
+#endif
+};
+
+// a pointer to n contiguous values of a span, starting at start; values with a stride are copied to the buffer
+const PIXVALUETYPE *contiguous(PixelSpan& span, qint32 start, quint32 n, std::vector<PIXVALUETYPE>& buffer) {
+    if ( span._stride == 1)
+        return span._values + start;
+    buffer.resize(n);
+    for(quint32 i = 0; i < n; ++i)
+        buffer[i] = span[start + i];
+    return buffer.data();
+}
+
+template<bool AnyUndef> inline bool isUndef(PIXVALUETYPE v) {
+    return AnyUndef ? isNumericalUndef(v) : v == rUNDEF;
+}
+
+// a binary operation whose result is undefined if one of the operands is
+template<class Op, bool AnyUndef> void binaryKernel(const PIXVALUETYPE *v1, const PIXVALUETYPE *v2, PIXVALUETYPE *result, quint32 n) {
+    quint32 i = 0;
+#ifdef VECTOR_OP
+    for(; i + VECTORSIZE <= n; i += VECTORSIZE) {
+        VectorType a = load(v1 + i);
+        VectorType b = load(v2 + i);
+        VectorType mask = VECTOR_OP(_mm256_or_pd, _mm_or_pd)(AnyUndef ? undefMask(a) : rUndefMask(a), AnyUndef ? undefMask(b) : rUndefMask(b));
+        VectorType r = Op::vector(a, b, mask);
+        storeMasked(result + i, r, mask);
+    }
+#endif
+    for(; i < n; ++i)
+        result[i] = (isUndef<AnyUndef>(v1[i]) || isUndef<AnyUndef>(v2[i])) ? PIXVALUEUNDEF : Op::scalar(v1[i], v2[i]);
+}
+
+template<class Op> void binaryKernel(const PIXVALUETYPE *v1, const PIXVALUETYPE *v2, PIXVALUETYPE *result, quint32 n, bool anyUndef = true) {
+    if ( anyUndef)
+        binaryKernel<Op, true>(v1, v2, result, n);
+    else
+        binaryKernel<Op, false>(v1, v2, result, n);
+}
+
+template<typename Func> void binaryLoop(const PIXVALUETYPE *v1, const PIXVALUETYPE *v2, PIXVALUETYPE *result, quint32 n, bool anyUndef, Func func) {
+    if ( anyUndef) {
+        for(quint32 i = 0; i < n; ++i)
+            result[i] = (isNumericalUndef(v1[i]) || isNumericalUndef(v2[i])) ? PIXVALUEUNDEF : func(v1[i], v2[i]);
+    } else {
+        for(quint32 i = 0; i < n; ++i)
+            result[i] = (v1[i] == rUNDEF || v2[i] == rUNDEF) ? PIXVALUEUNDEF : func(v1[i], v2[i]);
+    }
+}
+
+template<typename Func> void unaryLoop(const PIXVALUETYPE *v, PIXVALUETYPE *result, quint32 n, Func func) {
+    for(quint32 i = 0; i < n; ++i)
+        result[i] = isNumericalUndef(v[i]) ? PIXVALUEUNDEF : func(v[i]);
+}
+}
+
 CalculatorOperation::CalculatorOperation()
 {}
 
@@ -656,7 +832,7 @@ PIXVALUETYPE CalculatorOperation::calc(const std::vector<Action>& localActions)
             case maATAN:
             {
                 PIXVALUETYPE v = GetValue(action._values[0],result);
-                calcResult =  ( v < -M_PI/2 || v > M_PI/2 || isNumericalUndef(v)) ? PIXVALUEUNDEF : std::acos(v);
+                calcResult =  isNumericalUndef(v) ? PIXVALUEUNDEF : std::atan(v); // defined for every number
                 break;
             }
             case maLOG10:
@@ -830,3 +1006,358 @@ PIXVALUETYPE CalculatorOperation::calc(const std::vector<Action>& localActions)
     }
     return result.back();
 }
+
+bool CalculatorOperation::compile(const std::vector<Action>& actions, Program& program)
+{
+    program = Program();
+    std::map<quint64, int> sources; // raster id to source slot
+    for(const Action& action : actions) {
+        if ( action._action == maATTRIBUTE || (action._action == maUNKNOWN && action._values.size() != 1))
+            return false;
+        for(const ParmValue& parm : action._values) {
+            if ( parm._type == ITERATOR) {
+                if ( parm._source == 0)
+                    return false;
+                IRasterCoverage raster = parm._source->raster();
+                if ( sources.find(raster->id()) == sources.end()) {
+                    sources[raster->id()] = (int)program._sources.size();
+                    program._sources.push_back(raster);
+                }
+            } else if ( parm._type == NUMERIC || parm._type == DOMAINITEM)
+                program._constants.push_back(parm._value);
+            else if ( parm._type != LINK)
+                return false;
+        }
+    }
+    // slots: sources, constants, one register per instruction
+    int constantSlot = (int)program._sources.size();
+    int firstRegister = constantSlot + (int)program._constants.size();
+    for(int i = 0; i < actions.size(); ++i) {
+        const Action& action = actions[i];
+        Program::Instruction instruction;
+        instruction._action = action._action;
+        for(const ParmValue& parm : action._values) {
+            if ( parm._type == ITERATOR)
+                instruction._operands.push_back(sources[parm._source->raster()->id()]);
+            else if ( parm._type == LINK) {
+                if ( parm._link < 0 || parm._link >= i) {
+                    program = Program();
+                    return false;
+                }
+                instruction._operands.push_back(firstRegister + parm._link);
+            } else {
+                instruction._numericOperand |= parm._type == NUMERIC;
+                instruction._operands.push_back(constantSlot++);
+            }
+        }
+        program._instructions.push_back(instruction);
+    }
+    return program.isValid();
+}
+
+void CalculatorOperation::calc(const Program& program, const std::vector<const PIXVALUETYPE *>& sources, PIXVALUETYPE *result, quint32 n, Workspace& workspace)
+{
+    quint32 nConstants = (quint32)program._constants.size();
+    quint32 nInstructions = (quint32)program._instructions.size();
+    if ( workspace._registers.size() != (nConstants + nInstructions) * PROGRAMCHUNK) { // first use; the constants are filled once
+        workspace._registers.resize((nConstants + nInstructions) * PROGRAMCHUNK);
+        for(quint32 c = 0; c < nConstants; ++c)
+            std::fill_n(workspace._registers.begin() + c * PROGRAMCHUNK, PROGRAMCHUNK, program._constants[c]);
+        workspace._slots.resize(sources.size() + nConstants + nInstructions);
+        for(quint32 r = 0; r < nConstants + nInstructions; ++r)
+            workspace._slots[sources.size() + r] = &workspace._registers[r * PROGRAMCHUNK];
+    }
+    std::copy(sources.begin(), sources.end(), workspace._slots.begin());
+
+    for(quint32 i = 0; i < nInstructions; ++i) {
+        const Program::Instruction& instruction = program._instructions[i];
+        // the last instruction writes the result directly; registers are only read by later instructions
+        PIXVALUETYPE *out = i + 1 == nInstructions ? result : &workspace._registers[(nConstants + i) * PROGRAMCHUNK];
+        const PIXVALUETYPE *v1 = workspace._slots[instruction._operands[0]];
+        const PIXVALUETYPE *v2 = instruction._operands.size() > 1 ? workspace._slots[instruction._operands[1]] : 0;
+        const PIXVALUETYPE *v3 = instruction._operands.size() > 2 ? workspace._slots[instruction._operands[2]] : 0;
+        switch(instruction._action){
+        case maADD:
+            binaryKernel<AddOp>(v1, v2, out, n, instruction._anyUndef); break;
+        case maMINUS:
+            binaryKernel<MinusOp>(v1, v2, out, n, instruction._anyUndef); break;
+        case maMULT:
+            binaryKernel<MultOp>(v1, v2, out, n, instruction._anyUndef); break;
+        case maDIVIDE:
+            binaryKernel<DivideOp>(v1, v2, out, n, instruction._anyUndef); break;
+        case maPOW:
+            binaryLoop(v1, v2, out, n, instruction._anyUndef, [](PIXVALUETYPE a, PIXVALUETYPE b) { return std::pow(a, b); }); break;
+        case maMAX:
+            binaryLoop(v1, v2, out, n, instruction._anyUndef, [](PIXVALUETYPE a, PIXVALUETYPE b) { return std::max(a, b); }); break;
+        case maMIN:
+            binaryLoop(v1, v2, out, n, instruction._anyUndef, [](PIXVALUETYPE a, PIXVALUETYPE b) { return std::min(a, b); }); break;
+        case maSIN:
+            unaryLoop(v1, out, n, [](PIXVALUETYPE v) { return std::sin(v); }); break;
+        case maCOS:
+            unaryLoop(v1, out, n, [](PIXVALUETYPE v) { return std::cos(v); }); break;
+        case maTAN:
+            unaryLoop(v1, out, n, [](PIXVALUETYPE v) { return std::abs(v) == M_PI / 2 ? PIXVALUEUNDEF : std::tan(v); }); break;
+        case maACOS:
+            unaryLoop(v1, out, n, [](PIXVALUETYPE v) { return (v < -1 || v > 1) ? PIXVALUEUNDEF : std::acos(v); }); break;
+        case maASIN:
+            unaryLoop(v1, out, n, [](PIXVALUETYPE v) { return (v < -1 || v > 1) ? PIXVALUEUNDEF : std::asin(v); }); break;
+        case maATAN:
+            unaryLoop(v1, out, n, [](PIXVALUETYPE v) { return std::atan(v); }); break;
+        case maLOG10:
+            unaryLoop(v1, out, n, [](PIXVALUETYPE v) { return v <= 0 ? PIXVALUEUNDEF : std::log10(v); }); break;
+        case maLN:
+            unaryLoop(v1, out, n, [](PIXVALUETYPE v) { return v <= 0 ? PIXVALUEUNDEF : std::log(v); }); break;
+        case maEXP:
+            unaryLoop(v1, out, n, [](PIXVALUETYPE v) { return std::exp(v); }); break;
+        case maABS:
+            unaryLoop(v1, out, n, [](PIXVALUETYPE v) { return std::abs(v); }); break;
+        case maSQ:
+            unaryLoop(v1, out, n, [](PIXVALUETYPE v) { return v * v; }); break;
+        case maSQRT:
+            unaryLoop(v1, out, n, [](PIXVALUETYPE v) { return v < 0 ? PIXVALUEUNDEF : std::sqrt(v); }); break;
+        case maFLOOR:
+            unaryLoop(v1, out, n, [](PIXVALUETYPE v) { return std::floor(v); }); break;
+        case maCEIL:
+            unaryLoop(v1, out, n, [](PIXVALUETYPE v) { return std::ceil(v); }); break;
+        case maNOT:
+            unaryLoop(v1, out, n, [](PIXVALUETYPE v) { return (PIXVALUETYPE)~(qint64)v; }); break;
+        case maXOR:
+            binaryLoop(v1, v2, out, n, true, [](PIXVALUETYPE a, PIXVALUETYPE b) { return (PIXVALUETYPE)(((qint64)a) ^ ((qint64)b)); }); break;
+        case maEQ:
+            if ( instruction._numericOperand) {
+                for(quint32 j = 0; j < n; ++j)
+                    out[j] = v1[j] == v2[j];
+            } else
+                binaryKernel<EqOp>(v1, v2, out, n);
+            break;
+        case maNEQ:
+            if ( instruction._numericOperand) {
+                for(quint32 j = 0; j < n; ++j)
+                    out[j] = v1[j] != v2[j];
+            } else
+                binaryKernel<NeqOp>(v1, v2, out, n);
+            break;
+        case maLESSEQ:
+            binaryKernel<LessEqOp>(v1, v2, out, n); break;
+        case maLESS:
+            binaryKernel<LessOp>(v1, v2, out, n); break;
+        case maGREATEREQ:
+            binaryKernel<GreaterEqOp>(v1, v2, out, n); break;
+        case maGREATER:
+            binaryKernel<GreaterOp>(v1, v2, out, n); break;
+        case maAND:
+            for(quint32 j = 0; j < n; ++j) {
+                if (!(bool)v1[j] || !(bool)v2[j])
+                    out[j] = false;
+                else
+                    out[j] = (isNumericalUndef(v1[j]) || isNumericalUndef(v2[j])) ? PIXVALUEUNDEF : true;
+            }
+            break;
+        case maOR:
+            for(quint32 j = 0; j < n; ++j) {
+                if (isNumericalUndef(v1[j]))
+                    out[j] = (!isNumericalUndef(v2[j]) && (bool)v2[j]) ? true : PIXVALUEUNDEF;
+                else if (isNumericalUndef(v2[j]))
+                    out[j] = (bool)v1[j] ? true : PIXVALUEUNDEF;
+                else
+                    out[j] = (bool)v1[j] || (bool)v2[j];
+            }
+            break;
+        case maIFF:
+            for(quint32 j = 0; j < n; ++j)
+                out[j] = v1[j] == PIXVALUEUNDEF ? PIXVALUEUNDEF : ((bool)v1[j] ? v2[j] : v3[j]);
+            break;
+        case maIFUNDEF:
+            for(quint32 j = 0; j < n; ++j)
+                out[j] = isNumericalUndef(v1[j]) ? v2[j] : v3[j];
+            break;
+        case maIFNOTUNDEF:
+            for(quint32 j = 0; j < n; ++j)
+                out[j] = !isNumericalUndef(v1[j]) ? v2[j] : v3[j];
+            break;
+        default: // a single value
+            std::copy(v1, v1 + n, out);
+        }
+    }
+}
+
+void CalculatorOperation::calc(const Program& program, const BoundingBox& box, int threadIndex, const IRasterCoverage& output, std::vector<PIXVALUETYPE>& values, Workspace& workspace, OutputStatistics::Written *written)
+{
+    quint32 nSources = (quint32)program._sources.size();
+    workspace._buffers.resize(nSources + 1); // for spans with a stride (band interleaved grids); the last one is for the output
+    std::vector<const PIXVALUETYPE *> inputs(nSources);
+    std::vector<PixelSpan> spans;
+    const Pixel& pmin = box.min_corner();
+    const Pixel& pmax = box.max_corner();
+    // band by band; a source with a single band is used for every band of the box
+    for(qint32 z = pmin.z; z <= pmax.z; ++z) {
+        std::vector<PixelIterator> iters;
+        iters.reserve(nSources + 1);
+        for(const IRasterCoverage& raster : program._sources) {
+            qint32 band = raster->size().zsize() == 1 ? 0 : z;
+            iters.push_back(PixelIterator(raster, threadIndex, BoundingBox(Pixel(pmin.x, pmin.y, band), Pixel(pmax.x, pmax.y, band))));
+        }
+        if ( output.isValid())
+            iters.push_back(PixelIterator(output, threadIndex, BoundingBox(Pixel(pmin.x, pmin.y, z), Pixel(pmax.x, pmax.y, z))));
+        std::vector<PixelIterator *> pointers;
+        for(PixelIterator& iter : iters)
+            pointers.push_back(&iter);
+
+        qint32 length;
+        while((length = PixelIterator::spans(pointers, spans)) > 0) {
+            for(qint32 start = 0; start < length; start += PROGRAMCHUNK) {
+                quint32 n = std::min((quint32)(length - start), PROGRAMCHUNK);
+                for(quint32 s = 0; s < nSources; ++s)
+                    inputs[s] = contiguous(spans[s], start, n, workspace._buffers[s]);
+                if ( !output.isValid()) {
+                    values.resize(values.size() + n);
+                    calc(program, inputs, values.data() + values.size() - n, n, workspace);
+                } else if ( spans.back()._stride == 1) {
+                    calc(program, inputs, spans.back()._values + start, n, workspace);
+                } else {
+                    std::vector<PIXVALUETYPE>& buffer = workspace._buffers.back();
+                    buffer.resize(n);
+                    calc(program, inputs, buffer.data(), n, workspace);
+                    for(quint32 i = 0; i < n; ++i)
+                        spans.back()[start + i] = buffer[i];
+                }
+                if ( output.isValid() && written) {
+                    for(quint32 i = 0; i < n; ++i)
+                        written->add(z, spans.back()[start + i]);
+                }
+            }
+            for(PixelIterator *iter : pointers)
+                *iter += length;
+        }
+    }
+}
+
+void CalculatorOperation::fuse(Program& program)
+{
+    // every round replaces one deferred source; the bound only guards against a malformed chain
+    for(int round = 0; round < 64; ++round) {
+        int fused = -1;
+        std::shared_ptr<CalculatorExpression> producer;
+        for(int s = 0; s < program._sources.size() && fused == -1; ++s) {
+            producer = std::dynamic_pointer_cast<CalculatorExpression>(program._sources[s]->expression());
+            if ( producer && !producer->isUsed())
+                fused = s;
+        }
+        if ( fused == -1)
+            return;
+
+        const Program& inner = producer->program();
+        Program result;
+        std::map<quint64, int> sources; // raster id to source slot
+        auto addSource = [&](const IRasterCoverage& raster)->int{
+            auto iter = sources.find(raster->id());
+            if ( iter != sources.end())
+                return iter->second;
+            sources[raster->id()] = (int)result._sources.size();
+            result._sources.push_back(raster);
+            return (int)result._sources.size() - 1;
+        };
+        std::vector<int> outerSources(program._sources.size(), -1), innerSources(inner._sources.size());
+        for(int s = 0; s < program._sources.size(); ++s) {
+            if ( s != fused)
+                outerSources[s] = addSource(program._sources[s]);
+        }
+        for(int s = 0; s < inner._sources.size(); ++s)
+            innerSources[s] = addSource(inner._sources[s]);
+        result._constants = program._constants;
+        result._constants.insert(result._constants.end(), inner._constants.begin(), inner._constants.end());
+
+        // slots: sources, the constants of the outer and then of the inner program, the registers of the inner and then of the outer program
+        int nSources = (int)result._sources.size();
+        int firstRegister = result.firstRegister();
+        int innerResult = firstRegister + (int)inner._instructions.size() - 1;
+        for(Program::Instruction instruction : inner._instructions) {
+            for(int& operand : instruction._operands) {
+                if ( operand < inner._sources.size())
+                    operand = innerSources[operand];
+                else if ( operand < inner.firstRegister())
+                    operand = nSources + (int)program._constants.size() + operand - (int)inner._sources.size();
+                else
+                    operand = firstRegister + operand - inner.firstRegister();
+            }
+            result._instructions.push_back(instruction);
+        }
+        for(Program::Instruction instruction : program._instructions) {
+            for(int& operand : instruction._operands) {
+                if ( operand < program._sources.size())
+                    operand = operand == fused ? innerResult : outerSources[operand];
+                else if ( operand < program.firstRegister())
+                    operand = nSources + operand - (int)program._sources.size();
+                else
+                    operand = firstRegister + (int)inner._instructions.size() + operand - program.firstRegister();
+            }
+            result._instructions.push_back(instruction);
+        }
+        program = result;
+    }
+}
+
+void CalculatorOperation::defer(const Program& program, const IRasterCoverage& output)
+{
+    // the inputs may change before the output is read; the expression reads copies of them that share their blocks until one of the two is written.
+    // deferred inputs that are not used yet were fused into the program; their own sources are copies already
+    Program snapshot = program;
+    for(IRasterCoverage& source : snapshot._sources) {
+        auto producer = std::dynamic_pointer_cast<CalculatorExpression>(source->expression());
+        if ( !producer || producer->isUsed())
+            source.set(source->clone());
+    }
+    output->expression(SPRasterExpression(new CalculatorExpression(snapshot)));
+}
+
+bool CalculatorOperation::deferExpressions()
+{
+    return ilwisconfig("system-settings/deferred-expressions", true);
+}
+
+//---------------------------------------------------------------------------------
+CalculatorExpression::CalculatorExpression(const CalculatorOperation::Program &program) : _program(program), _used(false)
+{
+}
+
+bool CalculatorExpression::computeBlock(RasterCoverage *raster, quint32 block)
+{
+    _used = true;
+    const UPGrid& grid = raster->gridRef();
+    BoundingBox box = grid->blockBox(block);
+    std::vector<PIXVALUETYPE> values;
+    values.reserve(box.size().linearSize());
+    CalculatorOperation::Workspace workspace;
+    // a worker reading the raster reads the inputs through its own cache entry, without taking the lock of the shared entry
+    CalculatorOperation::calc(_program, box, TaskScheduler::currentThreadIndex(), IRasterCoverage(), values, workspace);
+    grid->setBlockData(block, values);
+
+    OutputStatistics::Values counted;
+    for(PIXVALUETYPE v : values)
+        counted.add(v);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if ( _computed.empty()) {
+        _computed.resize(grid->blocksPerBand() * raster->size().zsize(), false);
+        _remaining = (quint32)_computed.size();
+        _statistics.prepare(1, raster->size().zsize());
+    }
+    if ( block >= _computed.size() || _computed[block])
+        return true;
+    _computed[block] = true;
+    _statistics.add(0, block / grid->blocksPerBand(), counted);
+    if ( --_remaining == 0) { // the raster is complete; its ranges are those of its values instead of those of its domain
+        IRasterCoverage rc(raster);
+        _statistics.setRanges(rc, _statistics.total()._integer ? 1 : 0);
+    }
+    return true;
+}
+
+const CalculatorOperation::Program &CalculatorExpression::program() const
+{
+    return _program;
+}
+
+bool CalculatorExpression::isUsed() const
+{
+    return _used;
+}
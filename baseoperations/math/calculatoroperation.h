@@ -17,6 +17,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #ifndef CALCULATOROPERATION_H
 #define CALCULATOROPERATION_H
 
+#include <atomic>
+#include <mutex>
+
 namespace Ilwis {
 namespace BaseOperations{
 
@@ -32,8 +35,57 @@ public:
     const int LEFT_ASSOC = 0;
     const int RIGHT_ASSOC = 1;
 
-
-
+    /*!
+     * \brief The Program struct the actions translated to instructions that each work on an array of (at most PROGRAMCHUNK) pixels at a time.
+     * The operands of an instruction are slots: first the sources (the distinct input rasters of the actions), then the constants and then
+     * one register per instruction holding its result. The result of the last instruction is the result of the expression.
+     */
+    struct Program{
+        struct Instruction{
+            MathAction _action = maUNKNOWN; // maUNKNOWN copies its single operand
+            std::vector<int> _operands;
+            bool _numericOperand = false; // a (in)equality with a number also compares undefined values
+            bool _anyUndef = true; // false if only rUNDEF counts as undefined, the rule of the binary math operations
+        };
+        std::vector<IRasterCoverage> _sources;
+        std::vector<PIXVALUETYPE> _constants;
+        std::vector<Instruction> _instructions;
+
+        bool isValid() const { return _instructions.size() > 0; }
+        int firstRegister() const { return (int)(_sources.size() + _constants.size()); }
+    };
+    /*!
+     * \brief The Workspace struct the registers of a program; every thread that evaluates the program needs its own
+     */
+    struct Workspace{
+        std::vector<PIXVALUETYPE> _registers;
+        std::vector<const PIXVALUETYPE *> _slots;
+        std::vector<std::vector<PIXVALUETYPE>> _buffers; // values of spans with a stride, made contiguous
+    };
+    static const quint32 PROGRAMCHUNK = 2048;
+
+    /*!
+     * \brief calc evaluates a program for n pixels
+     * \param sources per source of the program a pointer to n contiguous input values
+     * \param result receives the n results
+     */
+    static void calc(const Program& program, const std::vector<const PIXVALUETYPE *>& sources, PIXVALUETYPE *result, quint32 n, Workspace& workspace);
+    /*!
+     * \brief calc evaluates a program for the pixels of a box, band by band; a source with a single band is used for every band
+     * \param output the results are written into this raster if it is valid, otherwise they are appended to values in the order of the box
+     * \param written optional; counts the results that are written into the output
+     */
+    static void calc(const Program& program, const BoundingBox& box, int threadIndex, const IRasterCoverage& output, std::vector<PIXVALUETYPE>& values, Workspace& workspace, OutputStatistics::Written *written = 0);
+    /*!
+     * \brief fuse replaces the sources of a program that are deferred rasters (see CalculatorExpression) by the instructions of their expressions,
+     * so the intermediate rasters are never computed
+     */
+    static void fuse(Program& program);
+    /*!
+     * \brief defer makes the output a deferred raster whose blocks are computed by the program when they are read
+     */
+    static void defer(const Program& program, const IRasterCoverage& output);
+    static bool deferExpressions();
 
 protected:
     struct ParmValue{
@@ -49,7 +101,7 @@ protected:
     };
     struct Action{
         std::vector<ParmValue> _values;
-        MathAction _action;
+        MathAction _action = maUNKNOWN; // an expression of a single value has no action
     };
 
     std::map<QString, int> _functions;
@@ -76,6 +128,11 @@ protected:
     IDomain collectDomainInfo(std::vector<std::vector<QString>>& rpn);
     IDomain linearize(const QStringList &tokens);
     PIXVALUETYPE  calc(const std::vector<Action>& localActions);
+    /*!
+     * \brief compile translates the actions to a program that evaluates the expression for many pixels at a time with the same results as calc()
+     * \return false if the actions use something only calc() can evaluate (strings, columns or attributes); the program is then invalid
+     */
+    static bool compile(const std::vector<Action>& actions, Program& program);
     int checkItem(int domainCount, QString &item, QString &copy_item, std::set<QString> &domainItems);
     int checkIndexItem(int domainCount, std::vector<std::vector<QString> > &rpn, std::vector<std::vector<QString> > &copy_rpn, int index, std::set<QString> &domainItems);
     void check(bool ok, const QString& error) const;
@@ -83,6 +140,33 @@ protected:
 private:
     IDomain findOutDomain(const std::vector<std::vector<QString> > &rpn, const std::vector<QString> &node);
 };
+
+/*!
+ * \brief The CalculatorExpression class the deferred result of a pixel wise operation; computes the blocks of its raster with a compiled program
+ */
+class CalculatorExpression : public RasterExpression
+{
+public:
+    CalculatorExpression(const CalculatorOperation::Program& program);
+
+    /*!
+     * \brief computeBlock computes a block with the block cache of the calling thread; when the last block is computed the ranges of the raster are set
+     */
+    bool computeBlock(RasterCoverage *raster, quint32 block);
+    const CalculatorOperation::Program& program() const;
+    /*!
+     * \brief isUsed true once a block was computed; from then on the raster has data of its own, which may have been changed, so it is no longer fused
+     */
+    bool isUsed() const;
+
+private:
+    CalculatorOperation::Program _program;
+    std::atomic<bool> _used;
+    std::mutex _mutex;
+    OutputStatistics _statistics; // values of the blocks computed so far
+    std::vector<bool> _computed;
+    quint32 _remaining = 0;
+};
 }
 }
 
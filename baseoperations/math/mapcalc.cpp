@@ -70,7 +70,10 @@ bool MapCalc::execute(ExecutionContext *ctx, SymbolTable& symTable)
         if((_prepState = prepare(ctx, symTable)) != sPREPARED)
             return false;
 
-	 BoxedAsyncFunc calcFun = [&](const BoundingBox& box, int threadIndex) -> bool {
+	 auto calcFun = [&](const BoundingBox& box, int threadIndex, OutputStatistics::Written& written) -> bool {
+         if ( _program.isValid())
+             return calcBlocks(box, threadIndex, written);
+
 		 PixelIterator iterOut(_outputRaster, threadIndex, box);
 
 		 std::vector<Action> localActions = _actions;
@@ -84,6 +87,7 @@ bool MapCalc::execute(ExecutionContext *ctx, SymbolTable& symTable)
 		 while (iterOut != iterEnd) {
 			 PIXVALUETYPE v = calc(localActions);
 			 *iterOut = v;
+			 written.add(iterOut.z(), v);
 			 ++iterOut;
 			 for (auto& item : inputRasters) {
 				 ++(item.second);
@@ -95,6 +99,18 @@ bool MapCalc::execute(ExecutionContext *ctx, SymbolTable& symTable)
 		 }
 		 return true;
 	 };
+	 // a numeric result is only computed when it is read, fused with the operations that use it
+	 bool deferred = _program.isValid() && deferExpressions() && _outputRaster->datadef().domain()->ilwisType() == itNUMERICDOMAIN;
+	 for(const IRasterCoverage& source : _program._sources)
+		 deferred &= source->id() != _outputRaster->id(); // a raster can't be computed from itself
+	 if ( deferred) {
+		 defer(_program, _outputRaster);
+		 QVariant value;
+		 value.setValue<IRasterCoverage>(_outputRaster);
+		 logOperation(_outputRaster, _expression, rasters());
+		 ctx->setOutput(symTable, value, _outputRaster->name(), itRASTER, _outputRaster->resource());
+		 return true;
+	 }
 	 std::vector<IRasterCoverage> allRasters;
 	 
 	 for (auto iter_raster : _inputRasters) {
@@ -103,20 +119,11 @@ bool MapCalc::execute(ExecutionContext *ctx, SymbolTable& symTable)
 	 }
 	 allRasters.push_back(_outputRaster);
 
-	 OperationHelperRaster::execute(ctx, calcFun, allRasters);
+	 OutputStatistics collected; // range and integer-ness of the output, collected by the tasks while they write it
+	 OperationHelperRaster::execute(ctx, calcFun, allRasters, &collected);
 
 	if (_outputRaster->datadef().domain()->ilwisType() == itNUMERICDOMAIN) {
-		PIXVALUETYPE rmin = PIXVALUEUNDEF, rmax = PIXVALUEUNDEF;
-		bool isInt = true;
-		for (PIXVALUETYPE v : _outputRaster) {
-			rmin = Ilwis::min(rmin, v);
-			rmax = Ilwis::max(rmax, v);
-			if (v != PIXVALUEUNDEF) {
-				isInt &= std::abs((qint64)v - v) < EPS8;
-			}
-		}
-		NumericRange *range = new NumericRange(rmin, rmax, isInt ? 1 : 0);
-		_outputRaster->datadefRef().range(range);
+		collected.setRanges(_outputRaster, collected.total()._integer ? 1 : 0);
 	}
 	else {
 		IFlatTable tbl;
@@ -144,6 +151,15 @@ bool MapCalc::execute(ExecutionContext *ctx, SymbolTable& symTable)
     return true;
 }
 
+bool MapCalc::calcBlocks(const BoundingBox& box, int threadIndex, OutputStatistics::Written& written)
+{
+    Workspace workspace;
+    std::vector<PIXVALUETYPE> unused;
+    calc(_program, box, threadIndex, _outputRaster, unused, workspace, &written);
+    trq()->update(box.size().linearSize());
+    return true;
+}
+
 std::vector<IIlwisObject> MapCalc::rasters() const {
 	std::vector<IIlwisObject> result;
 	std::map<quint64, IRasterCoverage> maps;
@@ -265,6 +281,8 @@ OperationImplementation::State MapCalc::prepare(ExecutionContext *ctx,const Symb
         outputDomain = linearize(shuntingYard(expr));
         if( !outputDomain.isValid())
             return sPREPAREFAILED;
+        if ( compile(_actions, _program))
+            fuse(_program);
     } catch(ErrorObject& err){
         return sPREPAREFAILED;
     }
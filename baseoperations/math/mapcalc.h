@@ -32,6 +32,7 @@ public:
 
 private:
     std::map<int, PixelIterator> _inputRasters;
+    Program _program; // invalid if the expression can only be evaluated pixel by pixel
 
     IRasterCoverage _outputRaster;
 
@@ -41,6 +42,7 @@ private:
     bool check(int index) const;
 	std::vector<IIlwisObject> rasters() const;
 	void prepareActions(std::vector<Action>& localActions, std::map<int, PixelIterator>& inputRasters, const BoundingBox& box, int threadIndex) const;
+    bool calcBlocks(const BoundingBox& box, int threadIndex, OutputStatistics::Written& written);
 };
 
 class MapCalc1 : public MapCalc{
@@ -50,8 +50,8 @@ bool UnaryMathRasterAndNumber::execute(ExecutionContext *ctx, SymbolTable& symTa
 
     if ( _case == otSPATIAL) {
         BoxedAsyncFunc unaryFun = [&](const BoundingBox& box, int threadIdx) -> bool {
-            PixelIterator iterIn(_inputGC, _box);
-            PixelIterator iterOut(_outputGC, BoundingBox(_box.size()));
+            PixelIterator iterIn(_inputGC, box);
+            PixelIterator iterOut(_outputGC, box);
 
             double v_in = 0;
             std::for_each(iterOut, iterOut.end(), [&](double& v){
@@ -64,7 +64,7 @@ bool UnaryMathRasterAndNumber::execute(ExecutionContext *ctx, SymbolTable& symTa
         };
 
 
-        bool resource = OperationHelperRaster::execute(ctx, unaryFun, { _outputGC });
+        bool resource = OperationHelperRaster::execute(ctx, unaryFun, { _inputGC, _outputGC });
         if ( resource && ctx != 0) {
             QVariant value;
             value.setValue<IRasterCoverage>(_outputGC);
@@ -0,0 +1,143 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+
+#include <QString>
+#include <QElapsedTimer>
+#include <functional>
+#include <memory>
+#include "kernel.h"
+#include "ilwisdata.h"
+#include "ilwisobject.h"
+#include "domain.h"
+#include "datadefinition.h"
+#include "columndefinition.h"
+#include "raster.h"
+#include "pixeliterator.h"
+#include "symboltable.h"
+#include "operationExpression.h"
+#include "operationmetadata.h"
+#include "commandhandler.h"
+#include "operation.h"
+#include "iterationbenchmark.h"
+
+using namespace Ilwis;
+using namespace BaseOperations;
+
+REGISTER_OPERATION(IterationBenchmark)
+
+Ilwis::OperationImplementation *IterationBenchmark::create(quint64 metaid, const Ilwis::OperationExpression &expr)
+{
+    return new IterationBenchmark(metaid, expr);
+}
+
+IterationBenchmark::IterationBenchmark()
+{
+}
+
+IterationBenchmark::IterationBenchmark(quint64 metaid, const Ilwis::OperationExpression &expr) : OperationImplementation(metaid, expr)
+{
+
+}
+
+bool IterationBenchmark::execute(ExecutionContext *ctx, SymbolTable &symTable)
+{
+    if (_prepState == sNOTPREPARED)
+        if((_prepState = prepare(ctx, symTable)) != sPREPARED)
+            return false;
+
+    IRasterCoverage classic(_raster1->clone());
+    IRasterCoverage span(_raster1->clone());
+    auto calc = [](PIXVALUETYPE v1, PIXVALUETYPE v2) { return (v1 == rUNDEF || v2 == rUNDEF) ? rUNDEF : 2 * v1 + v2; };
+
+    double warmup = 0; // brings the blocks of the inputs in memory so the first variant has no advantage
+    for(auto iter1 = begin(_raster1), iter2 = begin(_raster2); iter1 != end(_raster1); ++iter1, ++iter2)
+        warmup += *iter1 + *iter2;
+
+    QElapsedTimer timer;
+    timer.start();
+    PixelIterator iterIn1(_raster1), iterIn2(_raster2), iterOut(classic);
+    PixelIterator iterEnd = iterOut.end();
+    while(iterOut != iterEnd) {
+        *iterOut = calc(*iterIn1, *iterIn2);
+        ++iterOut; ++iterIn1; ++iterIn2;
+    }
+    qint64 classicNanos = timer.nsecsElapsed();
+
+    timer.restart();
+    PixelIterator spanIn1(_raster1), spanIn2(_raster2), spanOut(span);
+    std::vector<PixelIterator *> iters = {&spanIn1, &spanIn2, &spanOut};
+    std::vector<PixelSpan> spans;
+    qint32 length;
+    while((length = PixelIterator::spans(iters, spans)) > 0) {
+        for(qint32 i = 0; i < length; ++i)
+            spans[2][i] = calc(spans[0][i], spans[1][i]);
+        for(PixelIterator *iter : iters)
+            *iter += length;
+    }
+    qint64 spanNanos = timer.nsecsElapsed();
+    kernel()->issues()->log(QString("classic iteration %1 ns, span loops %2 ns for %3 pixels").arg(classicNanos).arg(spanNanos).arg(_raster1->size().linearSize()),IssueObject::itMessage);
+
+    QVariant value1;
+    value1.setValue<IRasterCoverage>(classic);
+    ctx->setOutput(symTable, value1, classic->name(), itRASTER, classic->resource());
+
+    QVariant value2;
+    value2.setValue<IRasterCoverage>(span);
+    ctx->addOutput(symTable, value2, span->name(), itRASTER, span->resource());
+
+    return true;
+}
+
+Ilwis::OperationImplementation::State IterationBenchmark::prepare(ExecutionContext *ctx, const SymbolTable &)
+{
+    QString inname1 = _expression.input<QString>(0);
+    QString inname2 = _expression.input<QString>(1);
+
+    if (!_raster1.prepare(inname1)) {
+        ERROR2(ERR_COULD_NOT_LOAD_2,inname1,"");
+        return sPREPAREFAILED;
+    }
+    if (!_raster2.prepare(inname2)) {
+        ERROR2(ERR_COULD_NOT_LOAD_2,inname2,"");
+        return sPREPAREFAILED;
+    }
+    if ( _raster1->size() != _raster2->size()) {
+        ERROR2(ERR_NOT_COMPATIBLE2,inname1,inname2);
+        return sPREPAREFAILED;
+    }
+
+    return sPREPARED;
+}
+
+quint64 IterationBenchmark::createMetadata()
+{
+    OperationResource operation({"ilwis://operations/iterationbenchmark"});
+    operation.setSyntax("iterationbenchmark(raster1, raster2)");
+    operation.setDescription(TR("test operation that computes 2 * raster1 + raster2 with classic pixel iteration and with span loops; the outputs must be identical"));
+    operation.setInParameterCount({2});
+    operation.addInParameter(0,itRASTER , TR("input raster1"));
+    operation.addInParameter(1,itRASTER, TR("input raster2"), TR("raster of the same size as raster1"));
+    operation.setOutParameterCount({2});
+    operation.addOutParameter(0,itRASTER , TR("classic iteration"));
+    operation.addOutParameter(1,itRASTER , TR("span loops"));
+    operation.setKeywords("test");
+
+    operation.checkAlternateDefinition();
+    mastercatalog()->addItems({operation});
+    return operation.id();
+
+}
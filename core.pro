@@ -415,7 +415,12 @@ HEADERS += \
    ./core/geos/include/geos.h \
    ./core/geos/src/operation/valid/IndexedNestedRingTester.h \
    ./core/ilwisobjects/coverage/basegrid.h \
+   ./core/ilwisobjects/coverage/blockcache.h \
    ./core/ilwisobjects/coverage/blockiterator.h \
+   ./core/ilwisobjects/coverage/neighbourhoodwindow.h \
+   ./core/ilwisobjects/coverage/rasterpyramid.h \
+   ./core/ilwisobjects/coverage/blockprefetcher.h \
+   ./core/ilwisobjects/coverage/rasterexpression.h \
    ./core/ilwisobjects/coverage/coverage.h \
    ./core/ilwisobjects/coverage/feature.h \
    ./core/ilwisobjects/coverage/featurecoverage.h \
@@ -424,6 +429,7 @@ HEADERS += \
    ./core/ilwisobjects/coverage/geometryhelper.h \
    ./core/ilwisobjects/coverage/grid.h \
    ./core/ilwisobjects/coverage/indexslicer.h \
+   ./core/ilwisobjects/coverage/memorygovernor.h \
    ./core/ilwisobjects/coverage/pixeliterator.h \
    ./core/ilwisobjects/coverage/raster.h \
    ./core/ilwisobjects/coverage/rastercoverage.h \
@@ -500,6 +506,7 @@ HEADERS += \
    ./core/ilwisobjects/operation/operationhelper.h \
    ./core/ilwisobjects/operation/operationhelperfeatures.h \
    ./core/ilwisobjects/operation/operationhelpergrid.h \
+   ./core/ilwisobjects/operation/outputstatistics.h \
    ./core/ilwisobjects/operation/operationmetadata.h \
    ./core/ilwisobjects/operation/operationoverloads.h \
    ./core/ilwisobjects/operation/operationspec.h \
@@ -550,6 +557,8 @@ HEADERS += \
    ./core/util/supportlibraryloader.h \
    ./core/util/tranquilizer.h \
    ./core/util/tranquilizerfactory.h \
+   ./core/util/taskscheduler.h \
+   ./core/util/quantilesketch.h \
    ./core/util/valuerange.h \
    ./core/util/xmlstreamparser.h \
    ./core/util/xpathparser.h \
@@ -931,7 +940,11 @@ SOURCES += \
     ./core/geos/src/util/math.cpp \
     ./core/geos/src/util/Profiler.cpp \
     ./core/geos/src/inlines.cpp \
+    ./core/ilwisobjects/coverage/blockcache.cpp \
     ./core/ilwisobjects/coverage/blockiterator.cpp \
+    ./core/ilwisobjects/coverage/neighbourhoodwindow.cpp \
+    ./core/ilwisobjects/coverage/rasterpyramid.cpp \
+    ./core/ilwisobjects/coverage/blockprefetcher.cpp \
     ./core/ilwisobjects/coverage/coverage.cpp \
     ./core/ilwisobjects/coverage/feature.cpp \
     ./core/ilwisobjects/coverage/featurecoverage.cpp \
@@ -940,6 +953,7 @@ SOURCES += \
     ./core/ilwisobjects/coverage/geometryhelper.cpp \
     ./core/ilwisobjects/coverage/grid.cpp \
     ./core/ilwisobjects/coverage/indexslicer.cpp \
+    ./core/ilwisobjects/coverage/memorygovernor.cpp \
     ./core/ilwisobjects/coverage/pixeliterator.cpp \
     ./core/ilwisobjects/coverage/rastercoverage.cpp \
     ./core/ilwisobjects/coverage/rasterinterpolator.cpp \
@@ -1006,6 +1020,7 @@ SOURCES += \
     ./core/ilwisobjects/operation/operationhelper.cpp \
     ./core/ilwisobjects/operation/operationhelperfeatures.cpp \
     ./core/ilwisobjects/operation/operationhelpergrid.cpp \
+    ./core/ilwisobjects/operation/outputstatistics.cpp \
     ./core/ilwisobjects/operation/operationmetadata.cpp \
     ./core/ilwisobjects/operation/operationoverloads.cpp \
     ./core/ilwisobjects/operation/rasterfilter.cpp \
@@ -1042,6 +1057,8 @@ SOURCES += \
     ./core/util/supportlibraryloader.cpp \
     ./core/util/tranquilizer.cpp \
     ./core/util/tranquilizerfactory.cpp \
+    ./core/util/taskscheduler.cpp \
+    ./core/util/quantilesketch.cpp \
     ./core/util/xmlstreamparser.cpp \
     ./core/abstractfactory.cpp \
     ./core/connectorfactory.cpp \
@@ -52,6 +52,12 @@ public:
     virtual bool dataIsLoaded() const { return false; }
     virtual bool store(IlwisObject *, const IOOptions& options = IOOptions() ) { return false; }
 	virtual bool storeData(IlwisObject *, const IOOptions& options = IOOptions()) { return false; }
+    /*!
+     * \brief loadOverview fills overview with a decimated version of the data of the object, for formats that keep overviews (e.g. GeoTIFF)
+     * \param level the overview level; the overview has 1/2^level of the size of the object in x and y and has been prepared with that size
+     * \return false if the source has no overview of that size; the overview is then computed
+     */
+    virtual bool loadOverview(IlwisObject*, quint32 level, IlwisObject *overview) { return false; }
 
 
 
@@ -96,6 +102,14 @@ public:
      * \return
      */
     virtual bool isReadOnly() const { return true; }
+    /*!
+     * \brief isReentrant true if loadData() may be called by several threads at once for different blocks of a raster; otherwise the raster loads its blocks one at a time
+     */
+    virtual bool isReentrant() const { return false; }
+    /*!
+     * \brief statistics counters of the way the connector reaches its source, e.g. the handles of a pool it reads through; empty if it keeps none
+     */
+    virtual QVariantMap statistics() const { return QVariantMap(); }
     virtual void addProperty(const QString &, const QVariant &) {}
     virtual void removeProperty(const QString &) {}
     virtual bool hasProperty(const QString &) const { return false; }
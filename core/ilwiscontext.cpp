@@ -31,6 +31,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #include "ilwiscontext.h"
 #include "mastercatalog.h"
 #include "mastercatalogcache.h"
+#include "memorygovernor.h"
 
 Ilwis::IlwisContext *Ilwis::IlwisContext::_context = 0;
 
@@ -47,7 +48,7 @@ IlwisContext* Ilwis::context(const QString & ilwisDir, int runMode) {
 
 
 
-IlwisContext::IlwisContext(int runMode) :  _memoryLimit(9e8), _memoryLeft(_memoryLimit), _runMode(runMode)
+IlwisContext::IlwisContext(int runMode) :  _runMode(runMode)
 {
     // _workingCatalog = new Catalog(); // empty catalog>
 
@@ -224,17 +225,9 @@ QUrl IlwisContext::persistentInternalCatalog() const
 
 quint64 IlwisContext::memoryLeft() const
 {
-    return _memoryLeft;
-}
-quint64 IlwisContext::changeMemoryLeft(qint64 amount)
-{
-    if ( (_memoryLeft + amount) > 0) {
-        _memoryLeft += amount;
-    }
-    else
-        _memoryLeft = 0;
-
-    return _memoryLeft;
+    MemoryGovernor::Usage usage = memorygovernor()->usage();
+    quint64 used = usage._residentBytes + usage._packedBytes;
+    return usage._limit > used ? usage._limit - used : 0;
 }
 
 IlwisConfiguration &IlwisContext::configurationRef()
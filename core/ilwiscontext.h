@@ -50,7 +50,6 @@ public:
     QUrl persistentInternalCatalog() const;
     QString resourcesLocation(const QString&internalName="") const;
     quint64 memoryLeft() const;
-    quint64 changeMemoryLeft(qint64 amount);
     IlwisConfiguration& configurationRef();
     const IlwisConfiguration& configuration() const;
     QFileInfo resourceRoot() const;
@@ -69,8 +68,6 @@ private:
     ICatalog _systemCatalog;
     //last used local folder, often equals to working catalog but not necessary. The location is there to have a dependable location for (file)outputs if the working catalog is not a folder
     ICatalog _lastUsedLocalFolder;
-    quint64 _memoryLimit;
-    quint64 _memoryLeft;
     QFileInfo _ilwisDir;
     IlwisConfiguration _configuration;
     QUrl _cacheLocation;
@@ -0,0 +1,139 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#include "raster.h"
+#include "ilwiscontext.h"
+#include "grid.h"
+#include "blockcache.h"
+#include "memorygovernor.h"
+
+using namespace Ilwis;
+
+BlockCache *Ilwis::blockcache() {
+    static BlockCache *cache = new BlockCache();
+    return cache;
+}
+
+BlockCache::BlockCache()
+{
+    int megabytes = ilwisconfig("system-settings/block-cache-mb", 0); // by default the MemoryGovernor decides
+    _budget = megabytes > 0 ? (quint64)std::max(16, megabytes) * 1024 * 1024 : memorygovernor()->residentBudget();
+}
+
+void BlockCache::touch(GridBlockInternal *block, bool loaded)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if ( loaded)
+        ++_misses;
+    else
+        ++_hits;
+    if ( block->_cached) {
+        if ( _head == block)
+            return;
+        unlink(block);
+    }
+    link(block);
+    evict();
+}
+
+void BlockCache::admit(GridBlockInternal *block)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if ( block->_cached)
+        return;
+    link(block);
+    evict();
+}
+
+void BlockCache::link(GridBlockInternal *block)
+{
+    block->_lruPrev = 0;
+    block->_lruNext = _head;
+    if ( _head)
+        _head->_lruPrev = block;
+    _head = block;
+    if ( !_tail)
+        _tail = block;
+    block->_cached = true;
+    _bytesUsed += block->residentBytes();
+}
+
+void BlockCache::remove(GridBlockInternal *block)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if ( block->_cached)
+        unlink(block);
+}
+
+void BlockCache::unlink(GridBlockInternal *block)
+{
+    if ( block->_lruPrev)
+        block->_lruPrev->_lruNext = block->_lruNext;
+    else
+        _head = block->_lruNext;
+    if ( block->_lruNext)
+        block->_lruNext->_lruPrev = block->_lruPrev;
+    else
+        _tail = block->_lruPrev;
+    block->_lruPrev = block->_lruNext = 0;
+    block->_cached = false;
+    _bytesUsed -= block->residentBytes();
+}
+
+void BlockCache::evict()
+{
+    GridBlockInternal *candidate = _tail;
+    while(candidate && _bytesUsed > _budget) {
+        GridBlockInternal *previous = candidate->_lruPrev;
+        // blocks in use (pinned, or locked by another thread) stay; the block locks are only tried, as a thread may hold one while it waits for this cache
+        if ( candidate->trySwapOut()) {
+            unlink(candidate);
+            ++_evictions;
+        }
+        candidate = previous;
+    }
+}
+
+quint64 BlockCache::budget() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _budget;
+}
+
+void BlockCache::budget(quint64 bytes)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _budget = bytes;
+    evict();
+}
+
+BlockCache::Statistics BlockCache::statistics() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Statistics stats;
+    stats._hits = _hits;
+    stats._misses = _misses;
+    stats._evictions = _evictions;
+    stats._bytesUsed = _bytesUsed;
+    stats._budget = _budget;
+    return stats;
+}
+
+void BlockCache::resetStatistics()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _hits = _misses = _evictions = 0;
+}
@@ -0,0 +1,84 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include <mutex>
+#include "kernel_global.h"
+
+namespace Ilwis {
+
+class GridBlockInternal;
+
+/*!
+ * \brief The BlockCache class keeps the resident blocks of all grids in the process in one least recently used list
+ *
+ * The resident blocks (PIXVALUETYPE arrays) together may not exceed a budget in bytes, by default a part of the limit of the MemoryGovernor. When a block becomes resident and the budget is exceeded, the least
+ * recently used blocks are swapped out (packed), whatever grid they belong to. Blocks that are pinned by a grid, because a thread is using them, are skipped.
+ * The list is intrusive (the blocks hold the links), so using, adding and removing a block takes constant time.
+ */
+class KERNELSHARED_EXPORT BlockCache
+{
+public:
+    struct Statistics {
+        quint64 _hits = 0; // block was still resident
+        quint64 _misses = 0; // block had to be unpacked, loaded from the cache file or fetched from its source
+        quint64 _evictions = 0;
+        quint64 _bytesUsed = 0;
+        quint64 _budget = 0;
+    };
+
+    BlockCache();
+
+    /*!
+     * \brief touch marks a resident block as the most recently used one; a block that is not yet in the list is added
+     * \param loaded true if the block had to be made resident for this use
+     */
+    void touch(GridBlockInternal *block, bool loaded);
+    /*!
+     * \brief admit adds a block that was made resident ahead of its use; it doesn't count as a hit or a miss
+     */
+    void admit(GridBlockInternal *block);
+    /*!
+     * \brief remove takes a block from the list without swapping it out; needed before a block is unloaded or deleted by its grid
+     */
+    void remove(GridBlockInternal *block);
+
+    quint64 budget() const;
+    void budget(quint64 bytes);
+    Statistics statistics() const;
+    void resetStatistics();
+
+private:
+    void link(GridBlockInternal *block);
+    void unlink(GridBlockInternal *block);
+    void evict();
+
+    mutable std::mutex _mutex;
+    GridBlockInternal *_head = 0; // most recently used
+    GridBlockInternal *_tail = 0;
+    quint64 _budget = 0;
+    quint64 _bytesUsed = 0;
+    quint64 _hits = 0;
+    quint64 _misses = 0;
+    quint64 _evictions = 0;
+};
+
+KERNELSHARED_EXPORT BlockCache* blockcache();
+}
+
+#endif // BLOCKCACHE_H
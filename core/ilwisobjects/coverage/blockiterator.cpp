@@ -117,21 +117,30 @@ GridBlock::GridBlock(BlockIterator *iter) :
     // when calculating the linear postions only very basic operations are needed then
     if (! isValid())
         return ;
+    const UPGrid& grid = iter->_raster->_grid;
+    int xsize = grid->size().xsize();
     int ysize = iter->_raster->size().ysize();
-    _blockYSize = iter->_raster->_grid->maxLines();
-    _blockXSize = iter->_raster->_grid->size().xsize();
-    _XYSize = iter->_raster->_grid->size().xsize() * iter->_raster->_grid->size().ysize();
+    _blockYSize = grid->maxLines();
+    _blockXSize = grid->tileSize().xsize();
+    _XYSize = grid->size().xsize() * grid->size().ysize();
     _internalBlockNumber.resize(ysize);
     _offsets.resize(ysize);
-    qint32 base = 0;
     for(int i=0; i < ysize; ++i ) {
-        if ( i % _blockYSize == 0)
-            base = 0;
-        _internalBlockNumber[i] =   i / _blockYSize;
-        _offsets[i] = base;
-        base += _blockXSize;
+        _internalBlockNumber[i] = (i / _blockYSize) * grid->blocksPerRow();
+        _offsets[i] = i % _blockYSize;
     }
-    _bandOffset = iter->_raster->_grid->blocksPerBand();
+    // with full width strips there is one block per row; tiles split a row over several blocks
+    _columnBlocks.resize(xsize);
+    _columnOffsets.resize(xsize);
+    _columnWidths.resize(xsize);
+    for(int i=0; i < xsize; ++i) {
+        _columnBlocks[i] = i / _blockXSize;
+        _columnOffsets[i] = i % _blockXSize;
+        _columnWidths[i] = std::min(_blockXSize, xsize - _columnBlocks[i] * _blockXSize);
+    }
+    _bandOffset = grid->bandBlocks();
+    _pixelStride = grid->pixelStride();
+    _bandStep = grid->bandStep();
 }
 
 double& GridBlock::operator ()(qint32 x, qint32 y, qint32 z)
@@ -144,7 +153,7 @@ double& GridBlock::operator ()(qint32 x, qint32 y, qint32 z)
 	}
 		
 
-    double &v =_iterator->_raster->_grid->value(_internalBlockNumber[y ] + _bandOffset * z, _offsets[y] + x);
+    double &v =_iterator->_raster->_grid->value(_internalBlockNumber[y] + _columnBlocks[x] + _bandOffset * z, (_offsets[y] * _columnWidths[x] + _columnOffsets[x]) * _pixelStride + _bandStep * z, _iterator->_threadIndex);
     return v;
 
 }
@@ -156,7 +165,7 @@ double GridBlock::value(int x, int y, int z) const {
 	if (!actualPosition(x, y, z))
 		return PIXVALUEUNDEF;
 
-	double v = _iterator->_raster->_grid->value(_internalBlockNumber[y] + _bandOffset * z, _offsets[y] + x);
+	double v = _iterator->_raster->_grid->value(_internalBlockNumber[y] + _columnBlocks[x] + _bandOffset * z, (_offsets[y] * _columnWidths[x] + _columnOffsets[x]) * _pixelStride + _bandStep * z, _iterator->_threadIndex);
 	return v;
 }
 double GridBlock::operator ()(qint32 x, qint32 y, qint32 z) const
@@ -170,13 +179,16 @@ bool GridBlock::actualPosition(qint32& x, qint32& y, qint32& z) const
 	int px = _iterator->_x + x;
 	int py = _iterator->_y + y;
 	int pz = _iterator->_z + z;
+	// x and y are limited by the raster, not by the box of the iterator; a box that is part of a larger raster (e.g. the box of one thread) still sees the real neighbours
+	int maxx = _iterator->_raster->size().xsize() - 1;
+	int maxy = _iterator->_raster->size().ysize() - 1;
 	if (_iterator->_acceptOutside) {
 		if (px < 0 || py < 0 || pz < 0 ||
-			px > _iterator->_endx || py > _iterator->_endy || pz > _iterator->_endz)
+			px > maxx || py > maxy || pz > _iterator->_endz)
 			return false;
 	}
-    x = std::max(0, std::min(px,_iterator->_endx));
-    y = std::max(0, std::min(py,_iterator->_endy));
+    x = std::max(0, std::min(px,maxx));
+    y = std::max(0, std::min(py,maxy));
     z = std::max(0, std::min(pz,_iterator->_endz));
 
 	return true;
@@ -92,11 +92,16 @@ public:
 
 private:
     BlockIterator* _iterator;
-    std::vector<quint32> _internalBlockNumber;
-    std::vector<quint32> _offsets;
+    std::vector<quint32> _internalBlockNumber; // per row, the first block of its row of blocks
+    std::vector<quint32> _offsets; // per row, the row within its block
+    std::vector<quint32> _columnBlocks; // per column, the block within a row of blocks
+    std::vector<quint32> _columnOffsets; // per column, the column within its block
+    std::vector<quint32> _columnWidths; // per column, the width of its block
     quint32 _blockYSize;
     quint32 _blockXSize;
-    quint32 _bandOffset;
+    quint32 _bandOffset; // distance between the blocks of successive bands; 0 if a block holds all bands
+    quint32 _pixelStride = 1; // distance between the values of neighbouring pixels within a block
+    quint32 _bandStep = 0; // distance between the values of successive bands of a pixel within a block
     quint64 _XYSize;
     bool actualPosition(qint32 &x, qint32 &y, qint32 &z) const;
 };
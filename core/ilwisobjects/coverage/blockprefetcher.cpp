@@ -0,0 +1,172 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#include <algorithm>
+#include "raster.h"
+#include "ilwiscontext.h"
+#include "grid.h"
+#include "blockprefetcher.h"
+
+using namespace Ilwis;
+
+namespace {
+thread_local std::vector<IIlwisObject> *_heldObjects = 0; // references kept by the I/O thread that reads a block; 0 on other threads
+}
+
+BlockPrefetcher *Ilwis::blockprefetcher() {
+    static BlockPrefetcher *prefetcher = new BlockPrefetcher();
+    return prefetcher;
+}
+
+BlockPrefetcher::BlockPrefetcher() : _depth(2), _requests(0), _loads(0), _hits(0), _stalls(0), _stallNanos(0), _avoidedNanos(0)
+{
+    _depth = std::max(0, ilwisconfig("system-settings/prefetch-depth", 2));
+    _threadCount = std::max(1, ilwisconfig("system-settings/prefetch-threads", 2));
+}
+
+BlockPrefetcher::~BlockPrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+        _queue.clear();
+    }
+    _wakeup.notify_all();
+    for(std::thread& thread : _threads) {
+        if ( thread.joinable())
+            thread.join();
+    }
+}
+
+void BlockPrefetcher::startWorkers()
+{
+    while((int)_threads.size() < _threadCount)
+        _threads.push_back(std::thread(&BlockPrefetcher::workerLoop, this));
+}
+
+void BlockPrefetcher::request(Grid *grid, const std::vector<quint32> &blocks)
+{
+    if ( blocks.empty())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if ( _stop)
+            return;
+        startWorkers();
+        for(quint32 block : blocks) {
+            auto item = std::make_pair(grid, block);
+            if ( std::find(_queue.begin(), _queue.end(), item) != _queue.end())
+                continue;
+            _queue.push_back(item);
+            ++_requests;
+        }
+        // a thread that walks faster than the blocks can be read makes the oldest requests useless
+        size_t maxQueue = std::max((size_t)16, (size_t)_depth * _threadCount * 4);
+        while(_queue.size() > maxQueue)
+            _queue.pop_front();
+    }
+    _wakeup.notify_all();
+}
+
+void BlockPrefetcher::cancel(Grid *grid)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _queue.erase(std::remove_if(_queue.begin(), _queue.end(), [grid](const std::pair<Grid *, quint32>& item){ return item.first == grid; }), _queue.end());
+    _done.wait(lock, [this, grid]{ return _busy.find(grid) == _busy.end(); });
+}
+
+bool BlockPrefetcher::holdUntilDone(const IIlwisObject &obj)
+{
+    if ( !_heldObjects)
+        return false;
+    _heldObjects->push_back(obj);
+    return true;
+}
+
+void BlockPrefetcher::workerLoop()
+{
+    std::vector<IIlwisObject> held;
+    _heldObjects = &held;
+    while(true) {
+        std::pair<Grid *, quint32> item;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wakeup.wait(lock, [this]{ return _stop || !_queue.empty(); });
+            if ( _stop)
+                return;
+            item = _queue.front();
+            _queue.pop_front();
+            ++_busy[item.first]; // the grid can't delete its blocks until this is done, see cancel()
+        }
+        try {
+            if ( item.first->prefetch(item.second))
+                ++_loads;
+        } catch(const ErrorObject& ) {
+            // reading ahead is only an optimization; the computing thread reports the error when it needs the block itself
+        } catch(const std::exception& ) {
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto iter = _busy.find(item.first);
+            if ( --(iter->second) == 0)
+                _busy.erase(iter);
+        }
+        _done.notify_all();
+        held.clear(); // the grid is no longer busy for this thread, so a raster that is deleted here can cancel its requests
+    }
+}
+
+int BlockPrefetcher::depth() const
+{
+    return _depth;
+}
+
+void BlockPrefetcher::depth(int n)
+{
+    _depth = std::max(0, n);
+}
+
+void BlockPrefetcher::countStall(qint64 nanos)
+{
+    ++_stalls;
+    _stallNanos += (quint64)std::max((qint64)0, nanos);
+}
+
+void BlockPrefetcher::countHit(qint64 nanosSaved)
+{
+    ++_hits;
+    _avoidedNanos += (quint64)std::max((qint64)0, nanosSaved);
+}
+
+BlockPrefetcher::Statistics BlockPrefetcher::statistics() const
+{
+    Statistics stats;
+    stats._requests = _requests;
+    stats._loads = _loads;
+    stats._hits = _hits;
+    stats._stalls = _stalls;
+    stats._stallNanos = _stallNanos;
+    stats._avoidedNanos = _avoidedNanos;
+    stats._depth = _depth;
+    std::lock_guard<std::mutex> lock(_mutex);
+    stats._threads = (quint32)_threads.size();
+    return stats;
+}
+
+void BlockPrefetcher::resetStatistics()
+{
+    _requests = _loads = _hits = _stalls = _stallNanos = _avoidedNanos = 0;
+}
@@ -0,0 +1,108 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#ifndef BLOCKPREFETCHER_H
+#define BLOCKPREFETCHER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "kernel_global.h"
+
+namespace Ilwis {
+
+class Grid;
+class IlwisObject;
+template<class T> class IlwisData;
+
+/*!
+ * \brief The BlockPrefetcher class reads grid blocks ahead of the threads that compute with them
+ *
+ * Iterators tell their grid in which order they walk through the blocks (Grid::readAhead). When a thread starts on a new block, the grid asks the prefetcher to
+ * make the next blocks in that order resident. A pool of I/O threads does this, so the decoding of the source (e.g. GDAL decompression) or the reading of the cache
+ * file overlaps the computation. The depth (system-settings/prefetch-depth) is the number of blocks that are read ahead; 0 switches reading ahead off.
+ *
+ * The statistics tell how much time the computing threads still spent waiting for blocks (stalls) and how much loading time the blocks that were read ahead saved.
+ */
+class KERNELSHARED_EXPORT BlockPrefetcher
+{
+public:
+    struct Statistics {
+        quint64 _requests = 0; // blocks asked for
+        quint64 _loads = 0; // blocks read ahead
+        quint64 _hits = 0; // blocks read ahead that a computing thread used before they were swapped out
+        quint64 _stalls = 0; // blocks a computing thread had to load itself
+        quint64 _stallNanos = 0;
+        quint64 _avoidedNanos = 0; // loading time the computing threads didn't have to wait for
+        quint32 _depth = 0;
+        quint32 _threads = 0;
+    };
+
+    BlockPrefetcher();
+    ~BlockPrefetcher();
+
+    /*!
+     * \brief request queues blocks of a grid to be read ahead; blocks that are already queued are skipped
+     */
+    void request(Grid *grid, const std::vector<quint32>& blocks);
+    /*!
+     * \brief cancel removes the queued blocks of a grid and waits until blocks of the grid that are being read are done; needed before the grid deletes its blocks
+     */
+    void cancel(Grid *grid);
+    /*!
+     * \brief holdUntilDone keeps a reference to the raster of a block that an I/O thread reads until the thread is done with the block. If that is the last reference, the
+     * raster is deleted after the block is finished; deleting it while reading would make the thread wait in cancel() for itself
+     * \return false if the calling thread is not an I/O thread of the prefetcher
+     */
+    static bool holdUntilDone(const IlwisData<IlwisObject>& obj);
+
+    int depth() const;
+    void depth(int n);
+
+    void countStall(qint64 nanos);
+    void countHit(qint64 nanosSaved);
+    Statistics statistics() const;
+    void resetStatistics();
+
+private:
+    void startWorkers();
+    void workerLoop();
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wakeup;
+    std::condition_variable _done;
+    std::deque<std::pair<Grid *, quint32>> _queue;
+    std::map<Grid *, int> _busy; // number of blocks of a grid that are being read
+    std::vector<std::thread> _threads;
+    int _threadCount = 2;
+    std::atomic<int> _depth;
+    bool _stop = false;
+    std::atomic<quint64> _requests;
+    std::atomic<quint64> _loads;
+    std::atomic<quint64> _hits;
+    std::atomic<quint64> _stalls;
+    std::atomic<quint64> _stallNanos;
+    std::atomic<quint64> _avoidedNanos;
+};
+
+KERNELSHARED_EXPORT BlockPrefetcher* blockprefetcher();
+}
+
+#endif // BLOCKPREFETCHER_H
@@ -14,24 +14,280 @@ GNU General Public License for more details.
 You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 
+#include <QElapsedTimer>
 #include "raster.h"
 #include "ilwiscontext.h"
 #include "connectorinterface.h"
 #include "geometries.h"
 #include "grid.h"
+#include "taskscheduler.h"
+#include "blockcache.h"
+#include "memorygovernor.h"
+#include "blockprefetcher.h"
 
 using namespace Ilwis;
 
+namespace {
+thread_local int _sourceFetches = 0; // > 0 while the thread fetches a block from the source of its raster
 
-GridBlockInternal::GridBlockInternal(Grid *parentGrid, quint32 blocknr,quint32 lines , quint32 width) :  _undef(undef<PIXVALUETYPE>()), _size(Size<>(width, lines,1)), _id(blocknr)
+template<typename T> void packAs(const std::vector<PIXVALUETYPE>& values, char *bytes) {
+    T *target = reinterpret_cast<T *>(bytes);
+    T sentinel = PackedType<T>::undef();
+    for(quint64 i = 0; i < values.size(); ++i)
+        target[i] = values[i] == PIXVALUEUNDEF ? sentinel : (T)values[i];
+}
+
+template<typename T> void unpackFrom(const char *bytes, bool undefs, T sentinel, std::vector<PIXVALUETYPE>& values) {
+    const T *source = reinterpret_cast<const T *>(bytes);
+    for(quint64 i = 0; i < values.size(); ++i)
+        values[i] = undefs && source[i] == sentinel ? PIXVALUEUNDEF : (PIXVALUETYPE)source[i];
+}
+
+template<typename T> bool matchesAs(const char *bytes, bool undefs, T sentinel, const std::vector<PIXVALUETYPE>& values) {
+    const T *source = reinterpret_cast<const T *>(bytes);
+    for(quint64 i = 0; i < values.size(); ++i) {
+        PIXVALUETYPE v = undefs && source[i] == sentinel ? PIXVALUEUNDEF : (PIXVALUETYPE)source[i];
+        if ( v != values[i])
+            return false;
+    }
+    return true;
+}
+
+PIXVALUETYPE defaultSentinel(IlwisTypes tp) {
+    switch(tp){
+    case itUINT8:
+        return PackedType<quint8>::undef();
+    case itINT16:
+        return PackedType<qint16>::undef();
+    case itUINT16:
+        return PackedType<quint16>::undef();
+    case itINT32:
+        return PackedType<qint32>::undef();
+    case itFLOAT:
+        return PackedType<float>::undef();
+    default:
+        return PIXVALUEUNDEF;
+    }
+}
+}
+
+MappedFile::MappedFile(const QString &path) : _file(path)
+{
+    if ( _file.open(QIODevice::ReadOnly) && _file.size() > 0)
+        _data = _file.map(0, _file.size());
+}
+
+MappedFile::~MappedFile()
+{
+    if ( _data)
+        _file.unmap(_data);
+}
+
+bool MappedFile::isValid() const
+{
+    return _data != 0;
+}
+
+const char *MappedFile::data(quint64 offset, quint64 bytes) const
+{
+    if ( !_data || offset + bytes > (quint64)_file.size())
+        return 0;
+    return reinterpret_cast<const char *>(_data) + offset;
+}
+
+//----------------------------------------------------------------------
+
+quint32 PackedBlock::typeSize(IlwisTypes tp)
+{
+    switch(tp){
+    case itUINT8:
+        return 1;
+    case itINT16:
+    case itUINT16:
+        return 2;
+    case itINT32:
+    case itFLOAT:
+        return 4;
+    default:
+        return sizeof(PIXVALUETYPE);
+    }
+}
+
+void PackedBlock::pack(const std::vector<PIXVALUETYPE> &values)
+{
+    bool integral = true, single = true, undefs = false, nan = false;
+    PIXVALUETYPE vmin = std::numeric_limits<PIXVALUETYPE>::max(), vmax = std::numeric_limits<PIXVALUETYPE>::lowest();
+    for(PIXVALUETYPE v : values) {
+        if ( v == PIXVALUEUNDEF) {
+            undefs = true;
+            continue;
+        }
+        if ( std::isnan(v)) {
+            integral = single = false;
+            nan = true;
+            break;
+        }
+        vmin = std::min(vmin, v);
+        vmax = std::max(vmax, v);
+        integral = integral && v == std::floor(v);
+        single = single && (PIXVALUETYPE)(float)v == v;
+        if ( !integral && !single && (vmin != vmax || undefs))
+            break;
+    }
+    // entirely undefined, or one value everywhere
+    bool constant = !nan && !values.empty() && (vmin > vmax || (vmin == vmax && !undefs));
+    // a range only fits if no value equals the reserved undef of the type, which is only reserved when the block contains undefs
+    auto fits = [&](PIXVALUETYPE lo, PIXVALUETYPE hi, PIXVALUETYPE sentinel) {
+        return vmin >= lo && vmax <= hi && !(undefs && (vmin == sentinel || vmax == sentinel));
+    };
+    IlwisTypes tp = itDOUBLE;
+    if ( integral) {
+        if ( fits(0, 255, PackedType<quint8>::undef()))
+            tp = itUINT8;
+        else if ( fits(-32768, 32767, PackedType<qint16>::undef()))
+            tp = itINT16;
+        else if ( fits(0, 65535, PackedType<quint16>::undef()))
+            tp = itUINT16;
+        else if ( fits(std::numeric_limits<qint32>::min(), std::numeric_limits<qint32>::max(), PackedType<qint32>::undef()))
+            tp = itINT32;
+    }
+    if ( tp == itDOUBLE && single && !(undefs && vmin == PackedType<float>::undef()))
+        tp = itFLOAT;
+
+    std::vector<PIXVALUETYPE> first;
+    if ( constant)
+        first.assign(1, values[0]);
+    const std::vector<PIXVALUETYPE>& source = constant ? first : values;
+    resize(tp, source.size(), undefs);
+    _constant = constant;
+    switch(tp){
+    case itUINT8:
+        packAs<quint8>(source, _bytes.data()); break;
+    case itINT16:
+        packAs<qint16>(source, _bytes.data()); break;
+    case itUINT16:
+        packAs<quint16>(source, _bytes.data()); break;
+    case itINT32:
+        packAs<qint32>(source, _bytes.data()); break;
+    case itFLOAT:
+        packAs<float>(source, _bytes.data()); break;
+    default:
+        std::copy(source.begin(), source.end(), reinterpret_cast<PIXVALUETYPE *>(_bytes.data()));
+    }
+}
+
+void PackedBlock::unpack(std::vector<PIXVALUETYPE> &values) const
+{
+    const char *bytes = constData();
+    std::vector<PIXVALUETYPE> first(_constant ? 1 : 0);
+    std::vector<PIXVALUETYPE>& target = _constant ? first : values;
+    switch(_type){
+    case itUINT8:
+        unpackFrom<quint8>(bytes, _undefs, (quint8)_sentinel, target); break;
+    case itINT16:
+        unpackFrom<qint16>(bytes, _undefs, (qint16)_sentinel, target); break;
+    case itUINT16:
+        unpackFrom<quint16>(bytes, _undefs, (quint16)_sentinel, target); break;
+    case itINT32:
+        unpackFrom<qint32>(bytes, _undefs, (qint32)_sentinel, target); break;
+    case itFLOAT:
+        unpackFrom<float>(bytes, _undefs, (float)_sentinel, target); break;
+    case itDOUBLE:
+        unpackFrom<double>(bytes, _undefs, _sentinel, target); break;
+    default:
+        std::fill(values.begin(), values.end(), PIXVALUEUNDEF);
+        return;
+    }
+    if ( _constant)
+        std::fill(values.begin(), values.end(), first[0]);
+}
+
+bool PackedBlock::matches(const std::vector<PIXVALUETYPE> &values) const
 {
-    _blockSize = _size.xsize()* _size.ysize();
+    if ( bytes() != values.size() * typeSize(_type))
+        return false;
+    const char *bytes = constData();
+    switch(_type){
+    case itUINT8:
+        return matchesAs<quint8>(bytes, _undefs, (quint8)_sentinel, values);
+    case itINT16:
+        return matchesAs<qint16>(bytes, _undefs, (qint16)_sentinel, values);
+    case itUINT16:
+        return matchesAs<quint16>(bytes, _undefs, (quint16)_sentinel, values);
+    case itINT32:
+        return matchesAs<qint32>(bytes, _undefs, (qint32)_sentinel, values);
+    case itFLOAT:
+        return matchesAs<float>(bytes, _undefs, (float)_sentinel, values);
+    case itDOUBLE:
+        return matchesAs<double>(bytes, _undefs, _sentinel, values);
+    default:
+        return false;
+    }
+}
+
+void PackedBlock::refer(const SPMappedFile &source, const char *data, IlwisTypes tp, quint64 n, bool undefs, PIXVALUETYPE sentinel)
+{
+    clear();
+    _source = source;
+    _external = data;
+    _externalBytes = n * typeSize(tp);
+    _type = tp;
+    _undefs = undefs;
+    _sentinel = sentinel;
+}
+
+void PackedBlock::share()
+{
+    if ( isExternal() || _constant || !isValid()) // a mapped file is already shared, a constant block is not worth it
+        return;
+    std::shared_ptr<std::vector<char>> payload(new std::vector<char>(std::move(_bytes)));
+    _bytes = std::vector<char>();
+    _payload = payload;
+    _external = payload->data();
+    _externalBytes = payload->size();
+}
+
+void PackedBlock::resize(IlwisTypes tp, quint64 n, bool undefs)
+{
+    try{
+        _bytes.resize(n * typeSize(tp));
+    } catch(const std::bad_alloc& ) {
+        throw OutOfMemoryError( TR("Couldnt allocate memory for raster"), false);
+    }
+    _source.reset();
+    _payload.reset();
+    _external = 0;
+    _type = tp;
+    _undefs = undefs;
+    _constant = false;
+    _sentinel = defaultSentinel(tp);
+}
+
+void PackedBlock::clear()
+{
+    _bytes = std::vector<char>();
+    _source.reset();
+    _payload.reset();
+    _external = 0;
+    _externalBytes = 0;
+    _type = itUNKNOWN;
+    _undefs = true;
+    _constant = false;
+    _sentinel = PIXVALUEUNDEF;
+}
+
+//----------------------------------------------------------------------
+
+GridBlockInternal::GridBlockInternal(Grid *parentGrid, quint32 blocknr,quint32 lines , quint32 width, quint32 bands) :  _undef(undef<PIXVALUETYPE>()), _size(Size<>(width, lines, bands)), _id(blocknr)
+{
+    _blockSize = _size.xsize()* _size.ysize() * _size.zsize();
     _parentGrid = parentGrid;
 }
 
 GridBlockInternal::~GridBlockInternal()
 {
-
+    Locker<> lock(_mutex); // the MemoryGovernor may be spilling this block
+    releasePacked();
 }
 
 Size<> GridBlockInternal::size() const
@@ -39,14 +295,25 @@ Size<> GridBlockInternal::size() const
     return _size;
 }
 
+/**
+ * @brief GridBlockInternal::clone
+ * Creates a block for a cloned grid. Packed values are shared with the new block instead of copied; resident values, that may still change, are packed
+ * for it. The values only go to the cache file of the new grid if the MemoryGovernor has no room for them
+ */
+
 GridBlockInternal *GridBlockInternal::clone(Grid *newParentGrid)
 {
-
-    GridBlockInternal *block = new GridBlockInternal(newParentGrid, blockNr(), _size.xsize(), _size.ysize());
-    block->init();
-    std::copy(_data.begin(), _data.end(), block->_data.begin());
-    block->_inMemory = true;
-    block->save2Cache(); // as a result, block->_inMemory becomes false
+    Locker<> lock(_mutex);
+    GridBlockInternal *block = new GridBlockInternal(newParentGrid, blockNr(), _size.ysize(), _size.xsize(), _size.zsize());
+    PackedBlock packed;
+    if ( _inMemory)
+        packed.pack(_data);
+    else if ( _packed.isValid()) {
+        _packed.share(); // from now on both blocks refer to the same values; the first that changes makes a packed block of its own
+        packed = _packed;
+    } else if ( !_onDisk || !readPacked(packed))
+        return block;
+    block->storePacked(packed);
     return block;
 }
 
@@ -55,19 +322,13 @@ char *GridBlockInternal::blockAsMemory()
     return (char *)&_data[0];
 }
 
-void GridBlockInternal::fill(const std::vector<PIXVALUETYPE>& values)
-{
-    copy(values.begin(), values.end(), _data.begin());
-    _inMemory = true;
-}
-
 quint32 GridBlockInternal::blockSize() {
     return _blockSize;
 }
 
 /**
  * @brief GridBlockInternal::save2Cache
- * Saves the content to disk-cache and unloads the gridblock from memory
+ * Packs the content and unloads the gridblock from memory. The packed data stays in memory if the MemoryGovernor allows it, otherwise it goes to the disk-cache
  * @return true if successful
  */
 
@@ -75,16 +336,184 @@ bool GridBlockInternal::save2Cache() {
     if (!_inMemory) // nothing to do
         return true;
     Locker<> lock(_mutex);
-    quint64 bytesNeeded = _data.size() * sizeof(PIXVALUETYPE);
-    _seekPosition = _id * _parentGrid->_blockSizes[0] * sizeof(PIXVALUETYPE);
-    _parentGrid->save2cache(0, _seekPosition, (char *)&_data[0], bytesNeeded);
+    if ( _packed.isExternal() && _packed.matches(_data)) { // unchanged since it was read from the mapped file or the shared values
+        _inMemory = false;
+        _data = std::vector<PIXVALUETYPE>();
+        return true;
+    }
+    PackedBlock packed;
+    packed.pack(_data);
     _inMemory = false;
     _data = std::vector<PIXVALUETYPE>();
+    storePacked(packed);
+
+    return true;
+}
+
+/**
+ * @brief GridBlockInternal::storePacked
+ * Takes over packed data as the content of the block, in memory or in the disk-cache
+ */
+
+void GridBlockInternal::storePacked(PackedBlock &packed)
+{
+    Locker<> lock(_mutex);
+    releasePacked();
     _dataLoadedFromSource = true; // apparently we have loaded the data from source and no longer need the source
-	
+    _packed = std::move(packed);
+    if ( _packed.isConstant()) { // a single value; not worth a place in the pool or the cache file
+        memorygovernor()->countConstantBlock(_blockSize * sizeof(PIXVALUETYPE));
+        return;
+    }
+    // a reference to a mapped file takes no memory; shared values are counted for every block that refers to them, which errs on the safe side
+    if ( _packed.isMapped() || memorygovernor()->reservePacked(this, _packed.bytes()))
+        return;
+    writePacked(_packed);
+    _packed.clear();
+}
+
+/**
+ * @brief GridBlockInternal::writePacked
+ * Writes packed data to the slot of the block in the disk-cache; the caller must hold the lock of the block
+ * @return true if successful
+ */
+
+bool GridBlockInternal::writePacked(const PackedBlock &packed)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const char *data = packed.constData();
+    quint64 bytes = packed.bytes();
+    QByteArray compressed;
+    bool isCompressed = false;
+    if ( _parentGrid->_compressCache && bytes >= 256 && !packed.isConstant()) { // fast zlib level; only kept if it actually saves space
+        compressed = qCompress(reinterpret_cast<const uchar *>(data), (int)bytes, 1);
+        if ( (quint64)compressed.size() < bytes) {
+            data = compressed.constData();
+            bytes = compressed.size();
+            isCompressed = true;
+        }
+    }
+    if ( _diskCapacity < bytes) { // the slot of the block in the cache file is reused when the data still fits
+        _seekPosition = _parentGrid->cacheSpace(bytes);
+        _diskCapacity = bytes;
+    }
+    if (!_parentGrid->save2cache(0, _seekPosition, data, bytes))
+        return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1,QString("cache file"));
+    _diskBytes = bytes;
+    _diskType = packed.type();
+    _diskUndefs = packed.hasUndefs();
+    _diskCompressed = isCompressed;
+    _onDisk = true;
+    memorygovernor()->countSpillWrite(_blockSize * sizeof(PIXVALUETYPE), bytes, timer.nsecsElapsed());
+    return true;
+}
+
+/**
+ * @brief GridBlockInternal::readPacked
+ * Reads the packed data of the block from its slot in the disk-cache
+ * @return true if successful
+ */
+
+bool GridBlockInternal::readPacked(PackedBlock &packed)
+{
+    QElapsedTimer timer;
+    timer.start();
+    packed.resize(_diskType, _blockSize, _diskUndefs);
+    bool ok;
+    if ( _diskCompressed) {
+        QByteArray compressed((int)_diskBytes, Qt::Uninitialized);
+        ok = _parentGrid->loadFromCache(0, _seekPosition, compressed.data(), _diskBytes);
+        if ( ok) {
+            QByteArray raw = qUncompress(compressed);
+            ok = (quint64)raw.size() == packed.bytes();
+            if ( ok)
+                std::copy(raw.constData(), raw.constData() + raw.size(), packed.data());
+        }
+    } else
+        ok = _parentGrid->loadFromCache(0, _seekPosition, packed.data(), _diskBytes);
+    memorygovernor()->countSpillRead(timer.nsecsElapsed());
+    return ok;
+}
+
+/**
+ * @brief GridBlockInternal::loadPacked
+ * Retrieves the packed data of the block from memory or from the disk-cache
+ * @return false if the block has no packed data
+ */
+
+bool GridBlockInternal::loadPacked(PackedBlock &packed)
+{
+    if ( _packed.isValid()) {
+        packed = _packed;
+        return true;
+    }
+    if ( !_onDisk)
+        return false;
+    return readPacked(packed);
+}
+
+void GridBlockInternal::releasePacked()
+{
+    if ( _packed.isValid()) {
+        if ( !_packed.isMapped())
+            memorygovernor()->releasePacked(this);
+        _packed.clear();
+    }
+    _onDisk = false; // the slot in the cache file is kept for the next time the block is swapped out
+}
+
+/**
+ * @brief GridBlockInternal::refer
+ * Lets the block use values in a mapped file. Only a block that has no data of its own, or that is being fetched from the source, accepts this
+ * @return false if the block didn't accept the values
+ */
+
+bool GridBlockInternal::refer(PackedBlock &packed)
+{
+    // a block that is locked by another thread is not waited for; that thread may be waiting for the source that calls this function.
+    // The reference is kept aside and taken when the block is loaded
+    std::unique_lock<std::recursive_mutex> lock(_mutex, std::try_to_lock);
+    if ( !lock.owns_lock()) {
+        if ( _size.zsize() == 1) {
+            std::lock_guard<std::mutex> pendingLock(_pendingMutex);
+            _pending = packed;
+        }
+        return false;
+    }
+    if ( _fetching) {
+        if ( _data.size() != _blockSize)
+            allocate();
+        packed.unpack(_data);
+    } else if ( _inMemory || _dataLoadedFromSource)
+        return false;
+    releasePacked();
+    _packed = packed;
+    _dataLoadedFromSource = true;
     return true;
 }
 
+/**
+ * @brief GridBlockInternal::detach
+ * Replaces a reference to a mapped file by a packed copy of the values
+ */
+
+void GridBlockInternal::detach()
+{
+    Locker<> lock(_mutex);
+    if ( !_packed.isMapped()) // shared values are in memory and never change
+        return;
+    if ( _inMemory) { // the resident values are the copy
+        releasePacked();
+        return;
+    }
+    std::vector<PIXVALUETYPE> values(_blockSize);
+    _packed.unpack(values);
+    PackedBlock packed;
+    packed.pack(values);
+    storePacked(packed);
+}
+
 /**
  * @brief GridBlockInternal::loadDiskDataToMemory
  * Loads the content of _data from either the cache file or the original source (in that order of preference)
@@ -95,13 +524,33 @@ void GridBlockInternal::loadDiskDataToMemory()
     if (_dataLoadedFromSource )
         loadFromCache();
     else{
-        fetchFromSource();
+        PackedBlock pending;
+        if ( takePending(pending))
+            pending.unpack(_data);
+        else
+            fetchFromSource();
         _dataLoadedFromSource = true;
     }
 
     _inMemory = true;
 }
 
+/**
+ * @brief GridBlockInternal::takePending
+ * Takes the values that a source delivered while another thread held the block
+ * @return false if there are none
+ */
+
+bool GridBlockInternal::takePending(PackedBlock &packed)
+{
+    std::lock_guard<std::mutex> lock(_pendingMutex);
+    if ( !_pending.isValid())
+        return false;
+    packed = std::move(_pending);
+    _pending.clear();
+    return true;
+}
+
 quint64 GridBlockInternal::blockNr()
 {
     return _id;
@@ -115,19 +564,100 @@ quint64 GridBlockInternal::blockNr()
 void GridBlockInternal::init() {
     if (!_inMemory) {
         Locker<> lock(_mutex);
-        try{
-        _data.resize(blockSize(), _undef);
+        allocate();
         _inMemory = true;
-        } catch(const std::bad_alloc& ) {
-            qDebug() << "err mem ";
-            throw OutOfMemoryError( TR("Couldnt allocate memory for raster"), false);
+    }
+}
+
+void GridBlockInternal::allocate()
+{
+    try{
+        _data.resize(blockSize(), _undef);
+    } catch(const std::bad_alloc& ) {
+        qDebug() << "err mem ";
+        throw OutOfMemoryError( TR("Couldnt allocate memory for raster"), false);
+    }
+}
+
+/**
+ * @brief GridBlockInternal::makeResident
+ * Brings the block into memory. Other than init() the block is only marked as being in memory after its data is available, so
+ * threads that test inMemory() never see a block that is still being loaded
+ */
+
+bool GridBlockInternal::makeResident(bool loadDiskData)
+{
+    Locker<> lock(_mutex);
+    if ( _inMemory)
+        return false;
+    allocate();
+    if (loadDiskData) {
+        _fetching = true; // setBlockData() calls for this block, as a result of fetchFromSource, fill the block directly
+        try {
+            loadDiskDataToMemory();
+        } catch(...) {
+            _fetching = false;
+            throw;
         }
+        _fetching = false;
     }
+    _inMemory = true;
+    return true;
+}
+
+/**
+ * @brief GridBlockInternal::retain
+ * Pins the block for a cache entry and makes the block resident
+ * @return true if the block had to be made resident
+ */
+
+bool GridBlockInternal::retain(bool loadDiskData)
+{
+    Locker<> lock(_mutex);
+    ++_cacheRefs;
+    return makeResident(loadDiskData);
+}
+
+/**
+ * @brief GridBlockInternal::release
+ * Unpins the block for a cache entry; the block stays resident until the BlockCache swaps it out
+ */
+
+void GridBlockInternal::release()
+{
+    Locker<> lock(_mutex);
+    _cacheRefs = std::max(0, _cacheRefs - 1);
+}
+
+/**
+ * @brief GridBlockInternal::trySwapOut
+ * Swaps the block out unless it is pinned or in use by another thread; the lock of the block is only tried
+ * @return true if the block is no longer resident
+ */
+
+bool GridBlockInternal::trySwapOut()
+{
+    std::unique_lock<std::recursive_mutex> lock(_mutex, std::try_to_lock);
+    if ( !lock.owns_lock() || _cacheRefs > 0 || _fetching)
+        return false;
+    return save2Cache();
+}
+
+/**
+ * @brief GridBlockInternal::unload
+ * Swaps the block out, whether it is pinned or not
+ */
+
+void GridBlockInternal::unload()
+{
+    Locker<> lock(_mutex);
+    _cacheRefs = 0;
+    save2Cache();
 }
 
 /**
  * @brief GridBlockInternal::loadFromCache
- * Loads the _data array from disk if it is available, otherwise fills it with _undef values
+ * Unpacks the _data array from memory or disk if it is available, otherwise fills it with _undef values
  * @return true if successful
  */
 
@@ -136,10 +666,21 @@ bool GridBlockInternal::loadFromCache() {
         std::fill(_data.begin(), _data.end(), _undef);
         return true; // totaly new block; never been swapped so no load needed
     }
-    quint64 bytesNeeded = _data.size() * sizeof(PIXVALUETYPE);
-    if (!_parentGrid->loadFromCache(0, _seekPosition, (char *)&_data[0], bytesNeeded))
-        return ERROR1(ERR_COULD_NOT_OPEN_READING_1,QString("cache file"));
-
+    if ( _packed.isValid()) {
+        _packed.unpack(_data);
+        if ( !_packed.isExternal()) // a reference to a mapped file or to shared values is kept; if the block is not changed it can return to it
+            releasePacked();
+        return true;
+    }
+    if ( _onDisk) {
+        PackedBlock packed;
+        if (!loadPacked(packed))
+            return ERROR1(ERR_COULD_NOT_OPEN_READING_1,QString("cache file"));
+        packed.unpack(_data);
+        releasePacked();
+        return true;
+    }
+    std::fill(_data.begin(), _data.end(), _undef);
     return true;
 }
 
@@ -152,11 +693,63 @@ void GridBlockInternal::fetchFromSource()
 {
     IIlwisObject obj = mastercatalog()->get(_parentGrid->_rasterid);
     if ( obj.isValid()){
+        blockprefetcher()->holdUntilDone(obj); // on an I/O thread the raster must outlive the read, also if the other references go meanwhile
         IRasterCoverage raster = obj.as<RasterCoverage>();
-        raster->getData(_id);
+        ++_sourceFetches;
+        try {
+            // a block of a band interleaved grid gets its bands one by one; the source delivers them as the blocks of a band
+            for(quint32 z = 0; z < _size.zsize(); ++z)
+                raster->getData(_id + z * _parentGrid->blocksPerBand());
+        } catch(...) {
+            --_sourceFetches;
+            throw;
+        }
+        --_sourceFetches;
     }
 }
 
+/**
+ * @brief GridBlockInternal::isFetchingSource
+ * A source may deliver more blocks than the one that is fetched. While a thread fetches, it must not wait for the other blocks: their owner may be waiting for the same source
+ * @return true if the calling thread is fetching a block from a source
+ */
+
+bool GridBlockInternal::isFetchingSource()
+{
+    return _sourceFetches > 0;
+}
+
+/**
+ * @brief GridBlockInternal::prefetch
+ * Makes the block resident on behalf of the BlockPrefetcher. Blocks that are resident, packed in memory or in use by another thread are left alone
+ * @return true if the block was loaded
+ */
+
+bool GridBlockInternal::prefetch()
+{
+    std::unique_lock<std::recursive_mutex> lock(_mutex, std::try_to_lock);
+    if ( !lock.owns_lock() || _inMemory || _packed.isValid())
+        return false;
+    QElapsedTimer timer;
+    timer.start();
+    makeResident(true);
+    _prefetchNanos = timer.nsecsElapsed();
+    return true;
+}
+
+/**
+ * @brief GridBlockInternal::takePrefetched
+ * @return the time it took to read the block ahead, or -1 if it wasn't read ahead; the block is no longer marked as read ahead
+ */
+
+qint64 GridBlockInternal::takePrefetched()
+{
+    Locker<> lock(_mutex);
+    qint64 nanos = _prefetchNanos;
+    _prefetchNanos = -1;
+    return nanos;
+}
+
 
 
 /**
@@ -166,13 +759,14 @@ void GridBlockInternal::fetchFromSource()
 
 void GridBlockInternal::dispose()
 {
+    releasePacked();
     _data = std::vector<PIXVALUETYPE>();
     _inMemory = false;
 }
 
 //----------------------------------------------------------------------
 
-Grid::Grid(int maxlines) : _maxCacheBlocks(1), _memUsed(0),_blocksPerBand(0), _maxLines(maxlines) {
+Grid::Grid(int maxlines) : _maxPinnedBlocks(4), _packedBudget(0), _packedBytes(0), _blocksPerBand(0), _maxLines(maxlines) {
     //Locker lock(_mutex);
     if ( _maxLines == iUNDEF){
         _maxLines =  context()->configurationRef()("system-settings/grid-blocksize", 500);
@@ -180,7 +774,8 @@ Grid::Grid(int maxlines) : _maxCacheBlocks(1), _memUsed(0),_blocksPerBand(0), _m
             _maxLines = max(1, 1e7 / (size().xsize() * 8));
          }
     }
-	_cache.resize(1);
+    _cache.resize(taskscheduler()->threadCount() + 1); // entry 0 is used by non threaded access, entries 1..n by the worker threads
+    _compressCache = context()->configurationRef()("system-settings/compress-cache-files", true);
     _gridid = Identity::newAnonymousId();
 }
 
@@ -192,7 +787,7 @@ quint32 Grid::blockSize(quint32 index) const {
 
 Grid::~Grid() {
     clear();
-    context()->changeMemoryLeft(_memUsed);
+    memorygovernor()->removeGrid(this);
    // qDebug() << "grid deleted:" << this;
 }
 
@@ -213,16 +808,25 @@ Grid *Grid::clone(quint64 newRasterId, quint32 index1, quint32 index2)
         return 0;
     }
     quint32 start = index1 == iUNDEF ? 0 : index1;
-    quint32 end = index2 == iUNDEF ? (quint32)_blocks.size() / _blocksPerBand : index2 + 1;
+    quint32 end = index2 == iUNDEF ? _size.zsize() : index2 + 1;
 
     Grid *grid = new Grid(_maxLines);
+    grid->storageType(_storageType);
+    grid->tileSize(_tiling);
+    grid->interleaved(_interleaved);
+    if ( _interleaved && end - start < _size.zsize()) { // blocks that hold all bands can't be shared with a grid that has fewer bands
+        grid->prepare(i64UNDEF, Size<>(_size.xsize(), _size.ysize(), end - start));
+        copyBands(grid, start);
+        grid->_rasterid = newRasterId;
+        return grid;
+    }
     grid->prepare(newRasterId,Size<>(_size.xsize(), _size.ysize(), end - start));
 
-    quint32 startBlock = start * _blocksPerBand;
-    quint32 endBlock = std::min(end * _blocksPerBand, (quint32)_blocks.size());
+    quint32 startBlock = start * _bandBlocks;
+    quint32 endBlock = std::min(startBlock + grid->blocks(), (quint32)_blocks.size());
     for(int i=startBlock, j=0; i < endBlock; ++i, ++j) {
 
-        if (!_blocks[i]->inMemory()) {
+        if (!_blocks[i]->inMemory() && !_blocks[i]->hasPackedData()) {
             update(i, true);
         }
         auto b = _blocks[i]->clone(grid);
@@ -231,25 +835,57 @@ Grid *Grid::clone(quint64 newRasterId, quint32 index1, quint32 index2)
     return grid;
 }
 
-void Grid::clear() {
-    _size = Size<>();
-    _blockSizes = std::vector<quint32>();
-    int next = true;
-    if ( _cache.size() > 0){
-        while(next ){
-            next = false; // next will become true again af a next iteration is needed
-            for(int i=0; i < _cache[0]._cacheBlocks.size(); ++i){
-                if (_cache[0]._cacheBlocks[i]._grid == this){
-                    _cache[0]._cacheBlocks.erase(_cache[0]._cacheBlocks.begin() + i);
-                    next = true;
-                    break;
-                }
+Grid *Grid::convert(bool interleaved)
+{
+    Locker<> lock(_mutex);
+    Grid *grid = new Grid(_maxLines);
+    grid->storageType(_storageType);
+    grid->tileSize(_tiling);
+    grid->interleaved(interleaved);
+    grid->prepare(i64UNDEF, _size); // without a raster the new blocks don't turn to a source; they get their values from this grid
+    copyBands(grid, 0);
+    grid->_rasterid = _rasterid;
+    return grid;
+}
+
+/**
+ * @brief Grid::copyBands
+ * Copies the bands firstBand.. of this grid to the bands 0.. of the target. The values are copied per row of a block, as far as the blocks of both grids go; the
+ * grids may differ in the size of their blocks and in the layout of the bands
+ */
+
+void Grid::copyBands(Grid *target, quint32 firstBand)
+{
+    auto rowEnd = [](const Grid *grid, qint32 x) {
+        return std::min((x / (qint32)grid->_tileWidth + 1) * (qint32)grid->_tileWidth, (qint32)grid->_size.xsize());
+    };
+    Size<> sz = target->size();
+    for(qint32 y = 0; y < (qint32)sz.ysize(); ++y) {
+        for(qint32 x = 0; x < (qint32)sz.xsize(); ) {
+            qint32 n = std::min(rowEnd(this, x), rowEnd(target, x)) - x;
+            for(qint32 z = 0; z < (qint32)sz.zsize(); ++z) {
+                // both blocks are pinned by the non threaded cache entries of their grids, so they stay resident while the row is copied
+                const PIXVALUETYPE *source = &value(blockIndex(x, y, z + firstBand), blockOffset(x, y, z + firstBand));
+                PIXVALUETYPE *destination = &target->value(target->blockIndex(x, y, z), target->blockOffset(x, y, z));
+                for(qint32 i = 0; i < n; ++i)
+                    destination[i * target->_pixelStride] = source[i * _pixelStride];
             }
+            x += n;
         }
     }
-    for(quint32 i = 0; i < _blocks.size(); ++i)
+}
+
+void Grid::clear() {
+    blockprefetcher()->cancel(this);
+    _size = Size<>();
+    _blockSizes = std::vector<quint32>();
+    for(quint32 i = 0; i < _blocks.size(); ++i) {
+        blockcache()->remove(_blocks[i]);
         delete _blocks[i];
+    }
     _blocks = std::vector< GridBlockInternal *>();
+    _packedBytes = 0;
+    _cacheFileEnd = 0;
     _blockSizes =  std::vector<quint32>();
     _blockOffsets = std::vector<quint32>();
     _size = Size<>();
@@ -260,40 +896,46 @@ void Grid::clear() {
             _cache[i]._cacheFile = 0;
         }
     }
-    _cache = std::vector<CacheEntry >();
+    _cache = std::vector<CacheEntry >(taskscheduler()->threadCount() + 1);
 }
 
 PIXVALUETYPE Grid::value(const Pixel &pix, int threadIndex) {
+    if ( threadIndex == 0) // random access (e.g. interpolation) from within an operation uses the cache of the calling worker thread
+        threadIndex = TaskScheduler::currentThreadIndex();
     if (pix.x <0 || pix.y < 0 || pix.x >= _size.xsize() || pix.y >= _size.ysize() )
         return PIXVALUEUNDEF;
    if ( pix.is3D() && (pix.z < 0 || pix.z >= _size.zsize()))
         return PIXVALUEUNDEF;
-    quint32 yoff = (qint32)pix.y % _maxLines;
-    quint32 block = pix.y / _maxLines;
-    quint32 bandBlocks = _blocksPerBand * (pix.is3D() ? pix.z : 0);
-	quint32 offset = yoff * _size.xsize() + pix.x;; // _offsets[yoff][pix.x];
-    return value(bandBlocks + block, offset, threadIndex);
+    qint32 z = pix.is3D() ? pix.z : 0;
+    return value(blockIndex(pix.x, pix.y, z), blockOffset(pix.x, pix.y, z), threadIndex);
 }
 
 PIXVALUETYPE &Grid::value(quint32 block, int offset, int threadIndex)  {
+    if ( threadIndex > 0 && threadIndex < _cache.size()) {
+        // a worker thread only uses blocks that are pinned by its own cache entry; the BlockCache can't swap these out
+        if ( _cache[threadIndex]._lastBlock != block) {
+            if(!update(block, true, threadIndex))
+                throw ErrorObject(TR("Grid block is out of bounds"));
+        }
+        return _blocks[block]->at(offset);
+    }
 	//Locker<> lock(_mutex);
-    if ( _blocks[block]->inMemory() ) // no load needed
+    if ( isPinned(block, 0) ) // no load needed
         return _blocks[block]->at(offset);
   //  Locker<> lock(_mutex); // slower case. must prevent other threads to messup admin
-    if ( !_blocks[block]->inMemory())
-      if(!update(block, true, threadIndex))
-          throw ErrorObject(TR("Grid block is out of bounds"));
+    if(!update(block, true, 0))
+        throw ErrorObject(TR("Grid block is out of bounds"));
     return _blocks[block]->at(offset); // block is now in memory
 }
 
 void Grid::setValue(quint32 block, int offset, PIXVALUETYPE v ) {
 	//Locker<> lock(_mutex);
-    if ( _blocks[block]->inMemory() ) {
+    if ( isPinned(block, 0) ) {
         _blocks[block]->at(offset) = v;
         return;
     }
     Locker<> lock(_mutex);
-    if ( !_blocks[block]->inMemory())
+    if ( !isPinned(block, 0))
         if(!update(block, true))
             return;
     _blocks[block]->at(offset) = v;
@@ -307,19 +949,101 @@ quint32 Grid::blocksPerBand() const {
     return _blocksPerBand;
 }
 
+quint32 Grid::blocksPerRow() const {
+    return _blocksPerRow;
+}
+
+void Grid::tileSize(const Size<> &sz)
+{
+    if ( sz.xsize() > 0 && sz.ysize() > 0)
+        _tiling = Size<>(sz.xsize(), sz.ysize(), 1);
+    else
+        _tiling = Size<>();
+}
+
+Size<> Grid::tileSize() const
+{
+    return Size<>(_tileWidth, _maxLines, 1);
+}
+
+bool Grid::isTiled() const
+{
+    return !_tiling.isNull();
+}
+
+void Grid::interleaved(bool yes)
+{
+    _interleaved = yes;
+}
+
+bool Grid::isInterleaved() const
+{
+    return _interleaved;
+}
+
+BoundingBox Grid::blockBox(quint32 block) const
+{
+    if ( _blocksPerBand == 0 || block >= _blockSizes.size())
+        return BoundingBox();
+    qint32 band = block / _blocksPerBand;
+    qint32 inBand = block % _blocksPerBand;
+    qint32 left = (inBand % _blocksPerRow) * _tileWidth;
+    qint32 top = (inBand / _blocksPerRow) * _maxLines;
+    qint32 right = std::min(left + (qint32)_tileWidth, (qint32)_size.xsize()) - 1;
+    qint32 bottom = std::min(top + (qint32)_maxLines, (qint32)_size.ysize()) - 1;
+    return BoundingBox(Pixel(left, top, band), Pixel(right, bottom, band));
+}
+
+quint32 Grid::stripLines(quint32 xsize)
+{
+    return max(1, 1e7 / (xsize * 8));
+}
+
 void Grid::setBlockData(quint32 block, const std::vector<PIXVALUETYPE>& data) { // this is the central function that brings in data from a raster coverage
-    if ( _blocks[block]->inMemory() ) {
-        _blocks[block]->fill(data);
-        return;
-    }
-    if(!update(block, false))
+    if ( block >= _blockSizes.size())
         return;
-    //block will be in memory now
-    _blocks[block]->fill(data);
+    // a resident block (or a block that is being fetched) is filled directly; others are packed without becoming resident, except those of a band interleaved grid
+    quint32 index = block % _blocks.size();
+    if ( _blocks[index]->write(data.data(), data.size(), PIXVALUEUNDEF, !GridBlockInternal::isFetchingSource(), block / _blocks.size()))
+        admitBlock(index);
+}
+
+void Grid::admitBlock(quint32 index)
+{
+    blockcache()->admit(_blocks[index]);
+}
+
+bool Grid::mapBlock(quint32 block, const SPMappedFile &file, quint64 offset, IlwisTypes tp, bool undefs, PIXVALUETYPE sentinel)
+{
+    // the values in a file are stored band by band; the blocks of a band interleaved grid can't refer to them
+    if ( _interleaved || block >= _blocks.size() || !file || !hasType(tp, itUINT8 | itINT16 | itUINT16 | itINT32 | itFLOAT | itDOUBLE))
+        return false;
+    const char *data = file->data(offset, (quint64)_blockSizes[block] * PackedBlock::typeSize(tp));
+    if ( !data)
+        return false;
+    PackedBlock packed;
+    packed.refer(file, data, tp, _blockSizes[block], undefs, sentinel);
+    return _blocks[block]->refer(packed);
+}
+
+void Grid::unmapBlocks()
+{
+    for(GridBlockInternal *block : _blocks)
+        block->detach();
+}
+
+void Grid::storageType(IlwisTypes tp)
+{
+    _storageType = tp;
+}
+
+IlwisTypes Grid::storageType() const
+{
+    return _storageType;
 }
 
 char *Grid::blockAsMemory(quint32 block) {
-    if ( _blocks[block]->inMemory() ) { // no load needed
+    if ( isPinned(block, 0) ) { // no load needed
         GridBlockInternal *du = _blocks[block];
         char * p = du->blockAsMemory();
         return p;
@@ -333,23 +1057,39 @@ char *Grid::blockAsMemory(quint32 block) {
 }
 
 void Grid::setBandProperties(RasterCoverage *raster, int n){
+    Locker<> lock(_mutex);
+    if ( _interleaved) { // the blocks hold all bands; they are replaced by blocks with room for the new bands
+        blockprefetcher()->cancel(this);
+        quint32 bands = _size.zsize() + n;
+        std::vector<GridBlockInternal *> blocks(_blocks.size());
+        std::vector<PIXVALUETYPE> values;
+        for(quint32 b = 0; b < _blocks.size(); ++b) {
+            BoundingBox box = blockBox(b);
+            blocks[b] = new GridBlockInternal(this, b, box.ylength(), box.xlength(), bands);
+            values.resize(_blockSizes[b]);
+            for(quint32 z = 0; z < std::min(_size.zsize(), bands); ++z) {
+                if ( readBlock(z * _blocksPerBand + b, values.data(), PIXVALUEUNDEF) && blocks[b]->write(values.data(), values.size(), PIXVALUEUNDEF, true, z))
+                    blockcache()->admit(blocks[b]);
+            }
+        }
+        resetCacheEntries();
+        for(GridBlockInternal *block : _blocks) {
+            blockcache()->remove(block);
+            delete block;
+        }
+        _blocks = blocks;
+    }
+    quint32 oldBlocks = (quint32)_blockSizes.size();
     _size.zsize(_size.zsize() + n);
-    quint32 oldBlocks = (quint32)_blocks.size();
     quint32 newBlocks = numberOfBlocks();
-    _blocks.resize(newBlocks);
+    if ( !_interleaved)
+        _blocks.resize(newBlocks);
     _blockSizes.resize(newBlocks);
     _blockOffsets.resize(newBlocks);
-    qint32 totalLines = _size.ysize();
-
-    for(quint32 block = oldBlocks; block < _blocks.size(); ++block) {
-        int linesPerBlock = std::min((qint32)_maxLines, totalLines);
-        _blocks[block] = new GridBlockInternal(this, block,linesPerBlock, _size.xsize());
-        _blockSizes[block] = linesPerBlock * _size.xsize();
-        _blockOffsets[block] = block == 0 ? 0 : _blockOffsets[block-1] +  _blockSizes[block];
-        totalLines -= _maxLines;
-        if ( totalLines <= 0) // to next band
-            totalLines = _size.ysize();
-    }
+    createBlocks(oldBlocks);
+    setBandLayout();
+    for(CacheEntry& entry : _cache)
+        entry._isPinned.resize(_blocks.size(), 0);
 }
 
 void Grid::resetBlocksPerBand(quint64 rasterid, quint32 blockCount, int maxlines) {
@@ -373,37 +1113,43 @@ bool Grid::prepare(quint64 rasterid, const Size<> &sz) {
         _size.zsize(1);
 
     _rasterid = rasterid;
-     _maxLines = max(1, 1e7 / (sz.xsize() * 8));
-
-    quint64 bytesNeeded = _size.linearSize() * sizeof(PIXVALUETYPE);
-    quint64 mleft = context()->memoryLeft();
-    if ( _memUsed != 0) // reszing a grid may reuse an older grid; in this case the memory has to be correctly given back
-        context()->changeMemoryLeft(_memUsed);
-    _memUsed = std::min(bytesNeeded, mleft/2);
-    context()->changeMemoryLeft(-_memUsed);
+    if ( isTiled()) { // the tiles at the right and bottom edges hold what is left of the grid
+        _tileWidth = std::min(_tiling.xsize(), _size.xsize());
+        _maxLines = std::min(_tiling.ysize(), _size.ysize());
+    } else {
+        _tileWidth = _size.xsize();
+        _maxLines = stripLines(_size.xsize() * (_interleaved ? _size.zsize() : 1)); // a line of a band interleaved grid holds all bands
+    }
+    _blocksPerRow = (_size.xsize() + _tileWidth - 1) / _tileWidth;
+
+    quint64 bytesNeeded = _size.linearSize() * PackedBlock::typeSize(_storageType); // swapped out blocks are packed, mostly in the type of the data
+    memorygovernor()->addGrid(this, bytesNeeded); // a resized grid only changes its need
     int nblocks = numberOfBlocks();
-    _maxCacheBlocks = std::max(_size.zsize(), (quint32)20); // allow more blocks when using maplists
-    _blocksPerBand = nblocks / sz.zsize();
+    _blocksPerBand = nblocks / _size.zsize();
+    setBandLayout();
 
-    qint32 totalLines = _size.ysize();
-    _blocks.resize(nblocks);
+    _blocks.resize(_interleaved ? _blocksPerBand : nblocks);
     _blockSizes.resize(nblocks);
     _blockOffsets.resize(nblocks);
-
-    for(quint32 i = 0; i < _blocks.size(); ++i) {
-        int linesPerBlock = std::min((qint32)_maxLines, totalLines);
-        _blocks[i] = new GridBlockInternal(this, i,linesPerBlock, _size.xsize());
-        _blockSizes[i] = linesPerBlock * _size.xsize();
-        _blockOffsets[i] = i == 0 ? 0 : _blockOffsets[i-1] +  _blockSizes[i];
-        totalLines -= _maxLines;
-        if ( totalLines <= 0) // to next band
-            totalLines = _size.ysize();
-    }
-    _cache.resize(1);
+    createBlocks(0);
+    _cache.resize(std::max(_cache.size(), (size_t)taskscheduler()->threadCount() + 1));
+    resetCacheEntries();
 
     return true;
 }
 
+void Grid::resetCacheEntries()
+{
+    for(CacheEntry& entry : _cache) {
+        for(quint32 block : entry._pinnedBlocks)
+            _blocks[block]->release();
+        entry._pinnedBlocks.clear();
+        entry._isPinned.assign(_blocks.size(), 0);
+        entry._next = 0;
+        entry._lastBlock = -1;
+    }
+}
+
 bool Grid::createCacheFile(int i){
 
     QString name = QString("gridblocks_%1_%2_%3.temp").arg(i).arg(_gridid).arg(_rasterid);
@@ -412,57 +1158,157 @@ bool Grid::createCacheFile(int i){
         localDir.mkpath(localDir.absolutePath());
     }
     QString filepath = localDir.absolutePath() + "/" + name;
-    _cache[i]._cacheFile = new QFile(filepath);
-    quint64 blocks = _blocks.size() / std::max(1, (int)_cache.size() - 1); // -1 because cache[0] is the unchanged original cache, cache[1...] are the caches used for the trheads
-    if (_cache[i]._cacheFile->open(QIODevice::ReadWrite)) {
-        if (!_cache[i]._cacheFile->resize(blocks * _blockSizes[0] * sizeof(PIXELVALUE))){
-            return false;
-        }
-    }else
-        return false;
-    return true;
+    _cache[i]._cacheFile = new QFile(filepath); // all blocks share one cache file, whatever thread swaps them out; the blocks get their space in the file through cacheSpace()
+    return _cache[i]._cacheFile->open(QIODevice::ReadWrite);
 }
+
+quint64 Grid::cacheSpace(quint64 bytesNeeded)
+{
+    std::lock_guard<std::mutex> lock(_cacheFileMutex);
+    quint64 position = _cacheFileEnd;
+    _cacheFileEnd += bytesNeeded;
+    return position;
+}
+
 int Grid::numberOfBlocks() {
-    PIXVALUETYPE rblocks = (PIXVALUETYPE)_size.ysize() / _maxLines;
-    int nblocks = (int)rblocks;
-    PIXVALUETYPE rest = rblocks - nblocks;
-    if ( rest >= (1.0 / ( _maxLines + 1))) {
-        nblocks++;
+    quint32 rows = (_size.ysize() + _maxLines - 1) / _maxLines;
+    return rows * _blocksPerRow * _size.zsize();
+}
+
+void Grid::createBlocks(quint32 first)
+{
+    // the sizes are those of the blocks of a band, as the connectors see them; a block of a band interleaved grid holds all bands
+    quint32 bands = _interleaved ? _size.zsize() : 1;
+    for(quint32 i = first; i < _blockSizes.size(); ++i) {
+        BoundingBox box = blockBox(i);
+        quint32 width = box.xlength();
+        quint32 lines = box.ylength();
+        if ( i < _blocks.size())
+            _blocks[i] = new GridBlockInternal(this, i, lines, width, bands);
+        _blockSizes[i] = lines * width;
+        _blockOffsets[i] = i == 0 ? 0 : _blockOffsets[i-1] +  _blockSizes[i];
     }
-    return nblocks * _size.zsize();
+}
+
+void Grid::setBandLayout()
+{
+    _bandBlocks = _interleaved ? 0 : _blocksPerBand;
+    _pixelStride = _interleaved ? _size.zsize() : 1;
+    _bandStep = _interleaved ? 1 : 0;
+    // a thread running through a stack (fZXY) needs a block of every band, unless a block holds all bands; a window around a pixel may span four tiles of a band.
+    // how many blocks stay resident is decided by the BlockCache
+    _maxPinnedBlocks = std::max((quint32)4, (_interleaved ? 1 : _size.zsize()) * (_blocksPerRow > 1 ? 4 : 1) + 1);
 }
 
 bool Grid::update(quint32 block, bool loadDiskData, int threadIndex) {
     if ( block >= _blocks.size() ) // illegal, blocknumber is outside the allowed range
         return false;
-    // update the _cache[_threadIndex] array to reflect the Most-Recently-Used blocks; the first position in the array is the MRU-block, the last position is the first candidate to be eliminated
-    auto iter = std::find(_cache[threadIndex]._cacheBlocks.begin(), _cache[threadIndex]._cacheBlocks.end(), GridBlockNrPair(this, block));
-    if ( iter != _cache[threadIndex]._cacheBlocks.end()){
-        auto gbnp = (*iter);
-        _cache[threadIndex]._cacheBlocks.erase(iter);
-        _cache[threadIndex]._cacheBlocks.insert(_cache[threadIndex]._cacheBlocks.begin(), gbnp);
-        if ( !_blocks[block]->inMemory()){
-            _blocks[block]->init();
-            _blocks[block]->loadDiskDataToMemory();
+    if ( threadIndex >= _cache.size())
+        threadIndex = 0;
+    // the entry of the non threaded access is shared by all callers; the entries of the worker threads are only used by their own thread
+    std::unique_lock<std::recursive_mutex> lock(_mutex, std::defer_lock);
+    if ( threadIndex == 0)
+        lock.lock();
+    CacheEntry& entry = _cache[threadIndex];
+    GridBlockInternal *gridBlock = _blocks[block];
+    bool loaded;
+    if ( entry._isPinned[block]) {
+        loaded = gridBlock->makeResident(true);
+    } else { // the pinned blocks form a ring; the oldest one makes place for the new one and becomes a normal member of the BlockCache
+        if ( entry._pinnedBlocks.size() >= _maxPinnedBlocks) {
+            quint32 oldest = entry._pinnedBlocks[entry._next];
+            entry._isPinned[oldest] = 0;
+            if ( entry._lastBlock == oldest)
+                entry._lastBlock = -1;
+            _blocks[oldest]->release();
+            entry._pinnedBlocks[entry._next] = block;
+            entry._next = (entry._next + 1) % entry._pinnedBlocks.size();
+        } else
+            entry._pinnedBlocks.push_back(block);
+        entry._isPinned[block] = 1;
+        QElapsedTimer timer;
+        timer.start();
+        loaded = gridBlock->retain(loadDiskData); // the data will be overwritten entirely by either loadFromCache or setBlockData
+        if ( loadDiskData) {
+            qint64 waited = timer.nsecsElapsed();
+            qint64 readAhead = gridBlock->takePrefetched();
+            if ( loaded)
+                blockprefetcher()->countStall(waited);
+            else if ( readAhead >= 0)
+                blockprefetcher()->countHit(readAhead - waited); // a block that is still being read ahead saves only part of the time
         }
-    } else { // block is not in memory, bring it in
-        if (_cache[threadIndex]._cacheBlocks.size() >= _maxCacheBlocks) { // keep list same size
-            _cache[threadIndex]._cacheBlocks.back()._grid->_blocks[_cache[threadIndex]._cacheBlocks.back()._blocknr]->save2Cache(); // least used element is saved to disk
-            _cache[threadIndex]._cacheBlocks.pop_back(); // least used element is eliminated from the cache list
+        if ( entry._readAhead && loadDiskData) {
+            int depth = blockprefetcher()->depth();
+            if ( depth > 0)
+                blockprefetcher()->request(this, blocksAhead(entry, block, depth));
         }
-        _blocks[block]->init(); // the data will be overwritten entirely by either loadFromCache or setBlockData
-        if (loadDiskData)
-            _blocks[block]->loadDiskDataToMemory();
-        if (_blocks[block]->inMemory())
-            _cache[threadIndex]._cacheBlocks.insert(_cache[threadIndex]._cacheBlocks.begin(), GridBlockNrPair(this, block));
     }
+    blockcache()->touch(gridBlock, loaded); // may swap out the least recently used blocks of any grid, but never pinned ones
+    if ( threadIndex > 0)
+        entry._lastBlock = block;
     return true;
 
 }
 
+void Grid::readAhead(int threadIndex, bool bandsFirst, quint32 zmin, quint32 zmax, quint32 rowMin, quint32 rowMax)
+{
+    if ( threadIndex < 0 || threadIndex >= _cache.size() || _blocksPerBand == 0)
+        return;
+    std::unique_lock<std::recursive_mutex> lock(_mutex, std::defer_lock);
+    if ( threadIndex == 0)
+        lock.lock();
+    CacheEntry& entry = _cache[threadIndex];
+    entry._readAhead = true;
+    entry._bandsFirst = bandsFirst;
+    entry._zmin = _interleaved ? 0 : zmin; // the blocks of a band interleaved grid hold all bands
+    entry._zmax = _interleaved ? 0 : std::min(zmax, _size.zsize() - 1);
+    entry._rowMin = rowMin;
+    entry._rowMax = std::min(rowMax, _blocksPerBand - 1);
+}
+
+std::vector<quint32> Grid::blocksAhead(const CacheEntry &entry, quint32 block, int depth) const
+{
+    std::vector<quint32> blocks;
+    quint32 z = block / _blocksPerBand;
+    quint32 row = block % _blocksPerBand;
+    while((int)blocks.size() < depth) {
+        if ( entry._bandsFirst) {
+            if ( ++z > entry._zmax) {
+                z = entry._zmin;
+                if ( ++row > entry._rowMax)
+                    break;
+            }
+        } else {
+            if ( ++row > entry._rowMax) {
+                row = entry._rowMin;
+                if ( ++z > entry._zmax)
+                    break;
+            }
+        }
+        quint32 next = z * _blocksPerBand + row;
+        if ( next >= _blocks.size())
+            break;
+        blocks.push_back(next);
+    }
+    return blocks;
+}
+
+bool Grid::prefetch(quint32 block)
+{
+    if ( block >= _blocks.size())
+        return false;
+    GridBlockInternal *gridBlock = _blocks[block];
+    if ( !gridBlock->prefetch())
+        return false;
+    blockcache()->admit(gridBlock);
+    return true;
+}
+
 void Grid::unloadInternal() {
+    resetCacheEntries();
     for (auto b : _blocks){
-        b->save2Cache();
+        blockcache()->remove(b);
+        b->unload();
     }
    // qDebug() << "grid unloaded:" << this;
 }
@@ -470,13 +1316,12 @@ void Grid::unloadInternal() {
 void Grid::setBlock(int index, GridBlockInternal *block)
 {
     Locker<> lock(_mutex);
-    if (_cache[0]._cacheBlocks.size() >= _maxCacheBlocks) { // keep list same size
-        _cache[0]._cacheBlocks.back()._grid->_blocks[_cache[0]._cacheBlocks.back()._blocknr]->save2Cache(); // least used element is saved to disk
-        _cache[0]._cacheBlocks.pop_back(); // least used element is eliminated from the cache list
-    }
-    _cache[0]._cacheBlocks.insert(_cache[0]._cacheBlocks.begin(), GridBlockNrPair(this, block->blockNr()));
     if ( index >= _blocks.size())
         _blocks.resize(index + 1);
+    else if ( _blocks[index] && _blocks[index] != block) {
+        blockcache()->remove(_blocks[index]);
+        delete _blocks[index];
+    }
     _blocks[index] = block;
 }
 
@@ -501,16 +1346,51 @@ std::map<quint32, std::vector<quint32> > Grid::calcBlockLimits(const IOOptions&
         }
     } else {
         auto bindex = options["blockindex"];
+        auto region = options["boundingbox"];
         if ( bindex.isValid()) {
             quint32 index = bindex.toUInt();
             int layer = index / blockplayer;
             result[layer].push_back(index);
+        } else if ( region.isValid()) {
+            BoundingBox box = region.canConvert<BoundingBox>() ? region.value<BoundingBox>() : BoundingBox(region.toString());
+            for(quint32 index : blocksIn(box))
+                result[index / blockplayer].push_back(index);
         }
     }
 
     return result;
 }
 
+std::vector<quint32> Grid::blocksIn(const BoundingBox &box) const
+{
+    std::vector<quint32> result;
+    if ( _blocksPerBand == 0 || !box.isValid())
+        return result;
+    // the box is clipped to the grid; with strips a box selects rows of blocks, with tiles also the columns of tiles
+    qint32 xmin = std::max(0, box.min_corner().x), xmax = std::min((qint32)_size.xsize() - 1, box.max_corner().x);
+    qint32 ymin = std::max(0, box.min_corner().y), ymax = std::min((qint32)_size.ysize() - 1, box.max_corner().y);
+    bool allBands = _interleaved || box.min_corner().z == iUNDEF || box.max_corner().z == iUNDEF; // a 2D box, or blocks that hold all bands
+    qint32 zmin = allBands ? 0 : std::max(0, box.min_corner().z);
+    qint32 zmax = allBands ? (qint32)_size.zsize() - 1 : std::min((qint32)_size.zsize() - 1, box.max_corner().z);
+    if ( xmin > xmax || ymin > ymax || zmin > zmax)
+        return result;
+    for(qint32 z = zmin; z <= zmax; ++z) {
+        for(qint32 row = ymin / (qint32)_maxLines; row <= ymax / (qint32)_maxLines; ++row) {
+            for(qint32 column = xmin / (qint32)_tileWidth; column <= xmax / (qint32)_tileWidth; ++column)
+                result.push_back(z * _blocksPerBand + row * _blocksPerRow + column);
+        }
+    }
+    return result;
+}
+
+bool Grid::hasData(quint32 block) const
+{
+    if ( block >= _blockSizes.size())
+        return false;
+    const GridBlockInternal *gridBlock = _blocks[block % _blocks.size()];
+    return gridBlock->inMemory() || gridBlock->hasPackedData();
+}
+
 bool Grid::isValid() const
 {
     return !(_size.isNull() || _size.isValid());
@@ -518,13 +1398,13 @@ bool Grid::isValid() const
 
 qint64 Grid::memUsed() const
 {
-    return _memUsed;
+    return _packedBytes;
 }
 
 PIXVALUETYPE Grid::findBigger(PIXVALUETYPE v)
 {
     for(int i=0; i < _blocks.size(); ++i){
-        if ( !_blocks[i]->inMemory() )
+        if ( !isPinned(i, 0) )
             update(i,true);
         for(int j=0; j < _blocks[i]->blockSize(); ++j){
             PIXVALUETYPE v2 = _blocks[i]->at(j);
@@ -537,33 +1417,34 @@ PIXVALUETYPE Grid::findBigger(PIXVALUETYPE v)
 }
 
 void Grid::prepare4Operation(int nThreads) {
-	//entry 0 remains untouched unless nthreads is 1 in which case nothing happens; the threads relevant cache will be loaded into 1...n threads
-	if (nThreads == 1)
-		return;
-	_cache.resize(nThreads + 1);
-    for(int t = 0; t < nThreads; ++t){
-        createCacheFile(t);
+    //entry 0 remains untouched; the worker threads 1..n each get their own ring of pinned blocks
+    if (nThreads <= 1)
+        return;
+    Locker<> lock(_mutex);
+    if ( _cache.size() < nThreads + 1) {
+        _cache.resize(nThreads + 1);
+        for(CacheEntry& entry : _cache)
+            entry._isPinned.resize(_blocks.size(), 0);
     }
-    for (int idx = 1; idx < _cache.size(); ++idx) {
-        int threadIdx = _cache[0]._cacheBlocks[idx]._blocknr / _blocksPerBand + 1;
-        _cache[threadIdx]._cacheBlocks.push_back({ _cache[0]._cacheBlocks[idx]._grid, _cache[0]._cacheBlocks[idx]._blocknr });
-	}
-	_maxCacheBlocks = std::max(1, 1 + (int)_maxCacheBlocks / nThreads);
 }
 
 void Grid::unprepare4Operation() {
+    Locker<> lock(_mutex);
+    // the blocks pinned by the worker threads are unpinned; they stay resident until the BlockCache needs the memory
     for (quint32 i = 1; i < _cache.size(); ++i) {
-        if (_cache[i]._cacheFile) {
-            _cache[i]._cacheFile->remove();
-            delete _cache[i]._cacheFile;
-            _cache[i]._cacheFile = 0;
+        CacheEntry& entry = _cache[i];
+        for(quint32 block : entry._pinnedBlocks) {
+            entry._isPinned[block] = 0;
+            _blocks[block]->release();
         }
+        entry._pinnedBlocks.clear();
+        entry._next = 0;
+        entry._lastBlock = -1;
     }
-	_cache.resize(1);
-	_maxCacheBlocks = std::max(_size.zsize(), (quint32)20);
 }
 
-bool Grid::save2cache(int cacheNr, quint64 seekPosition, char *dataBlock, quint64 bytesNeeded){
+bool Grid::save2cache(int cacheNr, quint64 seekPosition, const char *dataBlock, quint64 bytesNeeded){
+    std::lock_guard<std::mutex> lock(_cacheFileMutex);
     if ( !_cache[cacheNr]._cacheFile)
         if(!createCacheFile(cacheNr))
             return false;
@@ -575,6 +1456,9 @@ bool Grid::save2cache(int cacheNr, quint64 seekPosition, char *dataBlock, quint6
 }
 
 bool Grid::loadFromCache(int cacheNr, quint64 seekPosition, char * data, quint64 bytesNeeded){
+    std::lock_guard<std::mutex> lock(_cacheFileMutex);
+    if ( !_cache[cacheNr]._cacheFile)
+        return false;
     if( _cache[cacheNr]._cacheFile->seek(seekPosition)){
         quint64 total = _cache[cacheNr]._cacheFile->read(data, bytesNeeded);
         return total == bytesNeeded;
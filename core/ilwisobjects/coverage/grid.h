@@ -17,6 +17,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #ifndef Grid_H
 #define Grid_H
 
+#include <atomic>
+#include <cmath>
 #include <list>
 #include <mutex>
 #include <QDir>
@@ -26,31 +28,164 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #include "errorobject.h"
 #include "size.h"
 #include "location.h"
+#include "box.h"
 
 namespace Ilwis {
 
 class RasterCoverage;
 class IOOptions;
 
-struct GridBlockNrPair {
-    GridBlockNrPair(Grid *grid, quint32 bnr) : _blocknr(bnr), _grid(grid){}
+struct CacheEntry{
+    std::vector<quint32> _pinnedBlocks; // ring of the blocks pinned through this entry; when it is full the oldest is unpinned
+    std::vector<quint8> _isPinned; // per block of the grid, true if it is in _pinnedBlocks
+    quint32 _next = 0; // position of the oldest block in a full ring
+    QFile *_cacheFile = 0;
+    qint64 _lastBlock = -1; // block that was last accessed through this entry; only used by the worker threads
+    // the part of the grid an iterator of this entry walks through, and in which order; used to read the next blocks ahead
+    bool _readAhead = false;
+    bool _bandsFirst = false; // fZXY: all bands of a row of blocks before the next row; otherwise band after band
+    quint32 _zmin = 0;
+    quint32 _zmax = 0;
+    quint32 _rowMin = 0; // range of blocks within a band
+    quint32 _rowMax = 0;
+};
+
+/*!
+ * The storage types of a packed block. Every type reserves one value to represent undefined values; it is only reserved if the block contains undefined values.
+ */
+template<typename T> struct PackedType { static const IlwisTypes type = itUNKNOWN; };
+template<> struct PackedType<quint8> { static const IlwisTypes type = itUINT8; static quint8 undef() { return std::numeric_limits<quint8>::max(); } };
+template<> struct PackedType<qint16> { static const IlwisTypes type = itINT16; static qint16 undef() { return std::numeric_limits<qint16>::min(); } };
+template<> struct PackedType<quint16> { static const IlwisTypes type = itUINT16; static quint16 undef() { return std::numeric_limits<quint16>::max(); } };
+template<> struct PackedType<qint32> { static const IlwisTypes type = itINT32; static qint32 undef() { return std::numeric_limits<qint32>::min(); } };
+template<> struct PackedType<float> { static const IlwisTypes type = itFLOAT; static float undef() { return std::numeric_limits<float>::lowest(); } };
+template<> struct PackedType<double> { static const IlwisTypes type = itDOUBLE; static double undef() { return rUNDEF; } };
+
+/*!
+ * \brief The MappedFile class a read only file that is mapped in memory. Grid blocks can refer to its content instead of holding a copy; the operating system
+ * then loads the pages on first use and shares them with other processes that read the same file
+ */
+class KERNELSHARED_EXPORT MappedFile {
+public:
+    MappedFile(const QString& path);
+    ~MappedFile();
 
-    quint32 _blocknr = 0;
-    Grid *_grid = 0;
+    bool isValid() const;
+    /*!
+     * \brief data pointer to the mapped content at offset
+     * \return 0 if the range offset..offset+bytes is not part of the file
+     */
+    const char *data(quint64 offset, quint64 bytes) const;
+
+private:
+    QFile _file;
+    uchar *_data = 0;
 };
+typedef std::shared_ptr<MappedFile> SPMappedFile;
 
-inline bool operator==(const GridBlockNrPair& gbp1, const GridBlockNrPair& gbp2){
-    return gbp1._blocknr == gbp2._blocknr && gbp1._grid == gbp2._grid;
-}
+/*!
+ * \brief The PackedBlock class holds the values of a grid block in the smallest numeric type that represents all its values exactly
+ *
+ * Blocks that are being worked on are PIXVALUETYPE arrays, as the PixelIterator hands out references to the values. A block that is swapped out is packed;
+ * a byte image then needs one byte per pixel instead of eight, both in memory and in the cache file. A packed block may also refer to values in a
+ * memory mapped file (e.g. the data file of a raster) that are stored in one of the packed types. A block in which all values are equal (e.g. a block that is
+ * entirely undefined) is constant; it holds the value only once. The packed values of a block can be shared by the blocks of a cloned grid; shared values
+ * are never changed, a block that changes makes a new packed block of its own.
+ */
+class KERNELSHARED_EXPORT PackedBlock {
+public:
+    /*!
+     * \brief pack stores the values in the smallest type (uint8, int16, uint16, int32, float or double) that holds all of them exactly; equal values are stored once
+     */
+    void pack(const std::vector<PIXVALUETYPE>& values);
+    void unpack(std::vector<PIXVALUETYPE>& values) const;
 
-struct CacheEntry{
-    std::vector<GridBlockNrPair> _cacheBlocks;
-    QFile *_cacheFile = 0;
+    /*!
+     * \brief packNative stores values that are already in a storage type without a conversion through PIXVALUETYPE
+     * \param undefValue the value that marks undefined values in the input
+     */
+    template<typename T> void packNative(const T *values, quint64 n, T undefValue) {
+        T sentinel = PackedType<T>::undef();
+        bool undefs = false, collision = false;
+        for(quint64 i = 0; i < n; ++i) {
+            undefs = undefs || values[i] == undefValue;
+            collision = collision || (values[i] == sentinel && sentinel != undefValue);
+        }
+        if ( PackedType<T>::type == itUNKNOWN || PackedType<T>::type == itDOUBLE || (undefs && collision)) { // a value that collides with the reserved undef needs a wider type
+            std::vector<PIXVALUETYPE> converted(n);
+            for(quint64 i = 0; i < n; ++i)
+                converted[i] = values[i] == undefValue ? PIXVALUEUNDEF : (PIXVALUETYPE)values[i];
+            pack(converted);
+            return;
+        }
+        resize(PackedType<T>::type, n, undefs);
+        T *target = reinterpret_cast<T *>(_bytes.data());
+        for(quint64 i = 0; i < n; ++i)
+            target[i] = values[i] == undefValue ? sentinel : values[i];
+    }
+
+    /*!
+     * \brief unpackNative copies the values to an array of type T; if the block is packed in type T no conversion takes place
+     * \param undefValue the value that marks undefined values in the output
+     */
+    template<typename T> void unpackNative(T *values, quint64 n, T undefValue) const {
+        if ( PackedType<T>::type == _type && _type != itUNKNOWN && !_constant) {
+            T sentinel = (T)_sentinel;
+            const T *source = reinterpret_cast<const T *>(constData());
+            for(quint64 i = 0; i < n; ++i)
+                values[i] = _undefs && source[i] == sentinel ? undefValue : source[i];
+            return;
+        }
+        std::vector<PIXVALUETYPE> converted(n);
+        unpack(converted);
+        for(quint64 i = 0; i < n; ++i)
+            values[i] = converted[i] == PIXVALUEUNDEF ? undefValue : (T)converted[i];
+    }
+
+    /*!
+     * \brief refer lets the block use n values of type tp in a mapped file instead of a copy of its own
+     * \param sentinel the value that marks undefined values in the file; only used if undefs is true
+     */
+    void refer(const SPMappedFile& source, const char *data, IlwisTypes tp, quint64 n, bool undefs, PIXVALUETYPE sentinel);
+    /*!
+     * \brief matches true if the packed values are equal to the values; a block that was not changed doesn't need to be packed again
+     */
+    bool matches(const std::vector<PIXVALUETYPE>& values) const;
+    /*!
+     * \brief share makes the packed values immutable, so copies of the packed block refer to them instead of copying them
+     */
+    void share();
+
+    void resize(IlwisTypes tp, quint64 n, bool undefs=true);
+    void clear();
+    bool isValid() const { return _type != itUNKNOWN; }
+    bool isExternal() const { return _external != 0; }
+    bool isShared() const { return (bool)_payload; }
+    bool isMapped() const { return isExternal() && !isShared(); }
+    bool hasUndefs() const { return _undefs; }
+    bool isConstant() const { return _constant; }
+    IlwisTypes type() const { return _type; }
+    quint64 bytes() const { return _external ? _externalBytes : _bytes.size(); }
+    char *data() { return _bytes.data(); }
+    const char *constData() const { return _external ? _external : _bytes.data(); }
+
+    static quint32 typeSize(IlwisTypes tp);
+
+private:
+    std::vector<char> _bytes;
+    IlwisTypes _type = itUNKNOWN;
+    bool _undefs = true; // if false the reserved undef of the type is an ordinary value
+    bool _constant = false; // _bytes holds one value that is the value of all pixels
+    PIXVALUETYPE _sentinel = PIXVALUEUNDEF;
+    SPMappedFile _source; // keeps the mapping alive as long as a block refers to it
+    std::shared_ptr<const std::vector<char>> _payload; // shared values; alive as long as a block refers to them
+    const char *_external = 0;
+    quint64 _externalBytes = 0;
 };
 
 class GridBlockInternal {
 public:
-    GridBlockInternal(Grid *parentGrid, quint32 blocknr, quint32 lines , quint32 width);
+    GridBlockInternal(Grid *parentGrid, quint32 blocknr, quint32 lines , quint32 width, quint32 bands = 1);
     ~GridBlockInternal();
 
 
@@ -69,7 +204,6 @@ public:
     }
 
     char *blockAsMemory();
-    void fill(const std::vector<PIXVALUETYPE>& values);
     quint32 blockSize();
     bool inMemory() const { return _inMemory; }
     inline bool save2Cache() ;
@@ -77,10 +211,121 @@ public:
     void init();
     void loadDiskDataToMemory();
     quint64 blockNr();
+    bool retain(bool loadDiskData);
+    void release();
+    bool makeResident(bool loadDiskData);
+    bool trySwapOut();
+    void unload();
+    quint64 residentBytes() const { return _blockSize * sizeof(PIXVALUETYPE); }
+    bool isFetching() const { return _fetching; }
+    bool hasPackedData() const { return _packed.isValid() || _onDisk; }
+    bool refer(PackedBlock& packed);
+    void detach();
+    bool prefetch();
+    qint64 takePrefetched();
+    static bool isFetchingSource();
+
+    /*!
+     * \brief read gets the values of a band of the block; only a block of a band interleaved grid has more than one band
+     */
+    template<typename T> bool read(T *values, T undefValue, quint32 band = 0) {
+        Locker<> lock(_mutex);
+        quint32 bands = _size.zsize();
+        if ( _inMemory) {
+            for(quint64 i = 0, j = band; j < _blockSize; ++i, j += bands)
+                values[i] = _data[j] == PIXVALUEUNDEF ? undefValue : (T)_data[j];
+            return true;
+        }
+        if ( bands > 1 && hasPackedData()) { // the packed values hold all bands; the band is picked from the unpacked block
+            std::vector<PIXVALUETYPE> all(_blockSize);
+            PackedBlock packed;
+            if ( !loadPacked(packed))
+                return false;
+            packed.unpack(all);
+            for(quint64 i = 0, j = band; j < _blockSize; ++i, j += bands)
+                values[i] = all[j] == PIXVALUEUNDEF ? undefValue : (T)all[j];
+            return true;
+        }
+        if ( _packed.isValid()) {
+            _packed.unpackNative(values, _blockSize, undefValue);
+            return true;
+        }
+        if ( _onDisk) {
+            PackedBlock packed;
+            if (!loadPacked(packed))
+                return false;
+            packed.unpackNative(values, _blockSize, undefValue);
+            return true;
+        }
+        return false;
+    }
+
+    /*!
+     * \brief write sets the values of a band of the block
+     * \param mayWait false if the block is not waited for when another thread holds it; used for the blocks a source delivers besides the one that is fetched.
+     * The values are then kept aside and become the content of the block when it is loaded, instead of a fetch from the source
+     * \param band the band for a block of a band interleaved grid. Such a block can only change in memory; if it isn't resident it is made resident
+     * \return true if the block was made resident
+     */
+    template<typename T> bool write(const T *values, quint64 n, T undefValue, bool mayWait = true, quint32 band = 0) {
+        std::unique_lock<std::recursive_mutex> lock(_mutex, std::defer_lock);
+        if ( mayWait)
+            lock.lock();
+        else if ( !lock.try_lock()) {
+            if ( _size.zsize() == 1) {
+                PackedBlock packed;
+                pack(values, n, undefValue, packed);
+                std::lock_guard<std::mutex> pendingLock(_pendingMutex);
+                _pending = std::move(packed);
+            }
+            return false;
+        }
+        quint32 bands = _size.zsize();
+        n = std::min(n, _blockSize / bands);
+        bool loaded = false;
+        if ( bands > 1 && !_inMemory && !_fetching) {
+            if ( !mayWait) // delivered while the source fetches another block; this block gets all its bands when it is fetched itself
+                return false;
+            allocate();
+            loadFromCache();
+            _inMemory = _dataLoadedFromSource = loaded = true;
+        }
+        if ( _inMemory || _fetching) {
+            if ( _data.size() != _blockSize)
+                allocate();
+            for(quint64 i = 0, j = band; i < n; ++i, j += bands)
+                _data[j] = values[i] == undefValue ? PIXVALUEUNDEF : (PIXVALUETYPE)values[i];
+            _inMemory = true;
+            return loaded;
+        }
+        PackedBlock packed;
+        pack(values, n, undefValue, packed);
+        storePacked(packed);
+        return false;
+    }
 
 private:
+    template<typename T> void pack(const T *values, quint64 n, T undefValue, PackedBlock& packed) const {
+        if ( n < _blockSize) {
+            std::vector<T> complete(values, values + n);
+            complete.resize(_blockSize, undefValue);
+            packed.packNative(complete.data(), _blockSize, undefValue);
+        } else
+            packed.packNative(values, _blockSize, undefValue);
+    }
+
+    friend class BlockCache;
+    friend class MemoryGovernor;
+
     bool loadFromCache();
+    bool loadPacked(PackedBlock& packed);
+    void storePacked(PackedBlock& packed);
+    bool writePacked(const PackedBlock& packed);
+    bool readPacked(PackedBlock& packed);
+    void releasePacked();
     void fetchFromSource();
+    bool takePending(PackedBlock& packed);
+    void allocate();
     std::recursive_mutex _mutex;
     std::vector<PIXVALUETYPE> _data;
     PIXVALUETYPE _undef;
@@ -90,7 +335,25 @@ private:
     bool _dataLoadedFromSource = false;
     quint64 _blockSize;
     Grid *_parentGrid;
+    PackedBlock _packed; // values of the block when it is not resident and fitted in the pool of the MemoryGovernor, or a reference into a mapped file
     quint64 _seekPosition = i64UNDEF;
+    quint64 _diskCapacity = 0; // size of the slot of this block in the cache file
+    quint64 _diskBytes = 0;
+    IlwisTypes _diskType = itUNKNOWN;
+    bool _diskUndefs = true;
+    bool _diskCompressed = false;
+    bool _onDisk = false;
+    int _cacheRefs = 0; // number of cache entries that pin this block; the block can only be swapped out if none does
+    bool _fetching = false;
+    qint64 _prefetchNanos = -1; // time it took to read the block ahead; -1 if the block was not read ahead
+    std::mutex _pendingMutex;
+    PackedBlock _pending; // values a source delivered while another thread held the block; taken instead of a fetch from the source
+    GridBlockInternal *_lruPrev = 0; // links in the list of the BlockCache; guarded by the BlockCache
+    GridBlockInternal *_lruNext = 0;
+    bool _cached = false;
+    GridBlockInternal *_spillPrev = 0; // links in the list of packed blocks of the MemoryGovernor; guarded by the MemoryGovernor
+    GridBlockInternal *_spillNext = 0;
+    bool _spillListed = false;
 };
 
 class KERNELSHARED_EXPORT Grid
@@ -98,6 +361,7 @@ class KERNELSHARED_EXPORT Grid
 {
 public:
     friend class GridBlockInternal;
+    friend class MemoryGovernor;
 
     Grid(int maxLines=iUNDEF);
     virtual ~Grid();
@@ -108,19 +372,173 @@ public:
     PIXVALUETYPE value(const Pixel& pix, int threadIndex = 0) ;
     void setValue(quint32 block, int offset, PIXVALUETYPE v );
 
+    /*!
+     * \brief blocks the number of blocks; for a band interleaved grid this equals blocksPerBand()
+     */
     quint32 blocks() const;
     quint32 blocksPerBand() const;
+    /*!
+     * \brief blocksPerRow number of blocks next to each other in a row of blocks; 1 for a grid of full width strips
+     */
+    quint32 blocksPerRow() const;
+
+    /*!
+     * \brief tileSize selects the layout of the blocks. With a tile size the blocks are tiles of (at most) that many columns and rows, the tiles at the right
+     * and bottom edges hold what is left. Without one (the default) a block is a strip of full raster width. The layout takes effect at the next prepare()
+     * \param sz the size of a tile; a null size selects full width strips
+     */
+    void tileSize(const Size<>& sz);
+    /*!
+     * \brief tileSize the columns and rows of a block that is not at an edge of the grid
+     */
+    Size<> tileSize() const;
+    /*!
+     * \brief isTiled true if the layout was chosen through tileSize(); false for the default full width strips
+     */
+    bool isTiled() const;
+
+    /*!
+     * \brief interleaved selects how the bands are stored. In a band interleaved grid a block holds the values of all bands of its pixels, the values of a
+     * pixel next to each other; running through the bands of a pixel (fZXY) then stays within one block. Otherwise (the default) every band has blocks of its own.
+     * The layout takes effect at the next prepare()
+     */
+    void interleaved(bool yes);
+    bool isInterleaved() const;
+    /*!
+     * \brief convert a copy of this grid in which the bands are stored interleaved or not. See interleaved()
+     */
+    Grid *convert(bool interleaved);
+
+    /*!
+     * \brief blockIndex the block that holds pixel x,y of band z
+     */
+    quint32 blockIndex(qint32 x, qint32 y, qint32 z) const {
+        return z * _bandBlocks + (y / (qint32)_maxLines) * _blocksPerRow + x / (qint32)_tileWidth;
+    }
+    /*!
+     * \brief blockOffset the position of the value of pixel x,y of band z within its block
+     */
+    qint32 blockOffset(qint32 x, qint32 y, qint32 z = 0) const {
+        qint32 column = x / (qint32)_tileWidth;
+        return ((y % (qint32)_maxLines) * blockWidth(column) + x - column * (qint32)_tileWidth) * _pixelStride + z * _bandStep;
+    }
+    /*!
+     * \brief bandBlocks the distance between the blocks that hold a pixel in successive bands; 0 for a band interleaved grid
+     */
+    qint32 bandBlocks() const { return _bandBlocks; }
+    /*!
+     * \brief pixelStride the distance between the values of neighbouring pixels within a block; the number of bands for a band interleaved grid, otherwise 1
+     */
+    qint32 pixelStride() const { return _pixelStride; }
+    /*!
+     * \brief bandStep the distance between the values of a pixel in successive bands within a block; 1 for a band interleaved grid, otherwise 0
+     */
+    qint32 bandStep() const { return _bandStep; }
+    /*!
+     * \brief blockBox the pixels that are covered by a block; the z of the box is the band of the block. Like setBlockData(), readBlock() and writeBlock() the
+     * blocks are numbered band by band, also for a band interleaved grid; that numbering is what the connectors use
+     */
+    BoundingBox blockBox(quint32 block) const;
+    /*!
+     * \brief stripLines the number of lines of the blocks of a grid with full width strips
+     */
+    static quint32 stripLines(quint32 xsize);
 
     void setBlockData(quint32 block, const std::vector<PIXVALUETYPE>& data);
+
+    /*!
+     * \brief readBlock typed access to the values of a block. Blocks that are packed in type T are copied without a conversion, blocks that are not resident are not made
+     * resident, except those of a band interleaved grid
+     * \param values array of at least blockSize(block) elements
+     * \param undefValue the value that marks undefined values in the output
+     */
+    template<typename T> bool readBlock(quint32 block, T *values, T undefValue) {
+        if ( block >= _blockSizes.size())
+            return false;
+        quint32 index = block % _blocks.size(), band = block / _blocks.size();
+        if ( !_interleaved && _blocks[index]->read(values, undefValue))
+            return true;
+        // a block that never had any data has to come from the source first; a block that holds all bands is made resident rather than unpacked for every band
+        Locker<> lock(_mutex);
+        if(!update(index, true))
+            return false;
+        return _blocks[index]->read(values, undefValue, band);
+    }
+
+    /*!
+     * \brief writeBlock typed counterpart of setBlockData(). A block that is not resident is stored packed, without passing through a PIXVALUETYPE array
+     * \param values array of at least blockSize(block) elements
+     * \param undefValue the value that marks undefined values in the input
+     */
+    template<typename T> bool writeBlock(quint32 block, const T *values, T undefValue) {
+        if ( block >= _blockSizes.size())
+            return false;
+        quint32 index = block % _blocks.size();
+        if ( _blocks[index]->write(values, _blockSizes[block], undefValue, !GridBlockInternal::isFetchingSource(), block / _blocks.size()))
+            admitBlock(index);
+        return true;
+    }
+
+    /*!
+     * \brief storageType the type the values of the raster are expected to have; it is used to estimate the memory a grid needs. Blocks are always
+     * packed in the smallest type that fits their values, whatever this type is
+     */
+    void storageType(IlwisTypes tp);
+    IlwisTypes storageType() const;
+
+    /*!
+     * \brief mapBlock lets a block refer to its values in a mapped file instead of loading them. The block is only materialized when it has been changed and
+     * is swapped out. Blocks that already have data of their own are not affected
+     * \param offset position of the first value of the block in the file
+     * \param tp type of the values in the file; one of the packed types
+     * \param undefs false if the file has no undefined values
+     * \param sentinel the value that marks undefined values in the file
+     * \return false if the block can't refer to the file; the data must then be loaded through setBlockData()
+     */
+    bool mapBlock(quint32 block, const SPMappedFile& file, quint64 offset, IlwisTypes tp, bool undefs, PIXVALUETYPE sentinel);
+    /*!
+     * \brief unmapBlocks gives the blocks that refer to a mapped file a copy of their values; needed before the file is overwritten
+     */
+    void unmapBlocks();
+    /*!
+     * \brief readAhead tells which blocks an iterator of a thread is going to walk through; whenever that thread starts on a new block, the next blocks
+     * in this order are read by the BlockPrefetcher
+     * \param bandsFirst true for fZXY, where all bands of a row of blocks are visited before the next row
+     * \param rowMin first block within a band; with tiles the blocks of a row of tiles are visited before the next row
+     * \param rowMax last block within a band
+     */
+    void readAhead(int threadIndex, bool bandsFirst, quint32 zmin, quint32 zmax, quint32 rowMin, quint32 rowMax);
+    /*!
+     * \brief prefetch makes a block resident that is expected to be needed soon; used by the BlockPrefetcher
+     * \return false if the block was already available or in use
+     */
+    bool prefetch(quint32 block);
     char *blockAsMemory(quint32 block);
     void setBandProperties(RasterCoverage *raster, int n);
     bool prepare(quint64 rasterid, const Size<> &sz) ;
     quint32 blockSize(quint32 index) const;
     Size<> size() const;
     int maxLines() const;
+    /*!
+     * \brief clone a grid with the bands index1..index2 of this grid. The blocks of the clone share their packed values with the blocks of this grid; a block
+     * gets values of its own when it is changed
+     */
     Grid * clone(quint64 newRasterId, quint32 index1=iUNDEF, quint32 index2=iUNDEF) ;
     void unload(bool uselock=true);
+    /*!
+     * \brief calcBlockLimits the blocks a connector must load, per band. Without options all blocks; with "blockindex" that block; with "boundingbox" (a
+     * BoundingBox or its string form, in pixels) the blocks that intersect the box, so a small region of a large raster is read without the rest
+     */
     std::map<quint32, std::vector<quint32> > calcBlockLimits(const IOOptions &options);
+    /*!
+     * \brief blocksIn the blocks (numbered band by band) that intersect a box of pixels; the z range of the box selects the bands. A block of a band
+     * interleaved grid holds all bands, so there all bands are selected
+     */
+    std::vector<quint32> blocksIn(const BoundingBox& box) const;
+    /*!
+     * \brief hasData true if a block (numbered band by band) has values, resident or packed; its values don't come from the source anymore
+     */
+    bool hasData(quint32 block) const;
     bool isValid() const;
     qint64 memUsed() const;
 	void resetBlocksPerBand(quint64 rasterid, quint32 blockCount, int maxlines);
@@ -133,22 +551,43 @@ protected:
 
 private:
     int numberOfBlocks();
+    void createBlocks(quint32 first);
+    void setBandLayout();
+    void admitBlock(quint32 index);
+    void copyBands(Grid *target, quint32 firstBand);
+    qint32 blockWidth(qint32 column) const { return std::min((qint32)_tileWidth, (qint32)_size.xsize() - column * (qint32)_tileWidth); }
     inline bool update(quint32 block, bool loadDiskData, int threadIndex = 0);
     void unloadInternal();
     void setBlock(int index,GridBlockInternal *block);
-    bool save2cache(int cacheNr, quint64 seekPosition, char *dataBlock, quint64 bytesNeeded);
+    bool save2cache(int cacheNr, quint64 seekPosition, const char *dataBlock, quint64 bytesNeeded);
     bool loadFromCache(int cacheNr, quint64 seekPosition, char *dataBlock, quint64 bytesNeeded);
     bool createCacheFile(int i);
+    void resetCacheEntries();
+    std::vector<quint32> blocksAhead(const CacheEntry& entry, quint32 block, int depth) const;
+    bool isPinned(quint32 block, int threadIndex) const { return _cache[threadIndex]._isPinned[block] != 0; }
+    quint64 cacheSpace(quint64 bytesNeeded);
 
     std::recursive_mutex _mutex;
     std::vector< GridBlockInternal *> _blocks;
     std::vector<CacheEntry> _cache;
-    quint32 _maxCacheBlocks;
-    qint64 _memUsed;
+    std::mutex _cacheFileMutex;
+    quint32 _maxPinnedBlocks;
+    std::atomic<qint64> _packedBudget; // share of the pool for packed blocks; set by the MemoryGovernor
+    std::atomic<qint64> _packedBytes; // memory taken by packed blocks of this grid
+    quint64 _cacheFileEnd = 0;
+    IlwisTypes _storageType = itDOUBLE;
+    bool _compressCache = true; // blocks are compressed in the cache file
     quint32 _blocksPerBand;
     std::vector<quint32> _blockSizes;
     Size<> _size;
-    quint32 _maxLines;
+    quint32 _maxLines; // rows of a block
+    quint32 _tileWidth = 1; // columns of a block; the width of the grid for full width strips
+    quint32 _blocksPerRow = 1;
+    Size<> _tiling; // tile size chosen through tileSize(); null for full width strips
+    bool _interleaved = false; // a block holds all bands of its pixels
+    qint32 _bandBlocks = 0; // see bandBlocks(), pixelStride() and bandStep()
+    qint32 _pixelStride = 1;
+    qint32 _bandStep = 0;
     std::vector<quint32> _blockOffsets;
     quint64 _gridid = i64UNDEF;
     quint64 _rasterid;
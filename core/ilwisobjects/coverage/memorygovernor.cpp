@@ -0,0 +1,267 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#include <QFile>
+#include "raster.h"
+#include "ilwiscontext.h"
+#include "grid.h"
+#include "blockcache.h"
+#include "memorygovernor.h"
+#ifdef Q_OS_WIN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace Ilwis;
+
+namespace {
+quint64 cgroupLimit() {
+    // cgroup v2 and v1; a cgroup without a limit reports "max" (v2) or a number near the maximum of a 64 bit integer (v1)
+    for(const QString& path : {QString("/sys/fs/cgroup/memory.max"), QString("/sys/fs/cgroup/memory/memory.limit_in_bytes")}) {
+        QFile file(path);
+        if ( !file.open(QIODevice::ReadOnly))
+            continue;
+        bool ok;
+        quint64 limit = QString(file.readAll()).trimmed().toULongLong(&ok);
+        if ( ok && limit < ((quint64)1 << 60))
+            return limit;
+    }
+    return 0;
+}
+}
+
+MemoryGovernor *Ilwis::memorygovernor() {
+    static MemoryGovernor *governor = new MemoryGovernor();
+    return governor;
+}
+
+MemoryGovernor::MemoryGovernor() : _spillWrites(0), _spillReads(0), _spillRawBytes(0), _spillFileBytes(0), _constantBlocks(0), _constantBytes(0), _spillWriteNanos(0), _spillReadNanos(0)
+{
+    quint64 limit = (quint64)std::max(0, ilwisconfig("system-settings/memory-limit-mb", 0)) * 1024 * 1024;
+    if ( limit == 0) {
+        int percentage = std::min(100, std::max(1, ilwisconfig("system-settings/memory-percentage", 50)));
+        limit = detectLimit() / 100 * percentage;
+    }
+    setBudgets(limit);
+}
+
+quint64 MemoryGovernor::detectLimit()
+{
+    quint64 physical = 0;
+#ifdef Q_OS_WIN
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if ( GlobalMemoryStatusEx(&status))
+        physical = status.ullTotalPhys;
+#else
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGE_SIZE);
+    if ( pages > 0 && pageSize > 0)
+        physical = (quint64)pages * pageSize;
+#endif
+    quint64 cgroup = cgroupLimit();
+    if ( cgroup != 0 && (physical == 0 || cgroup < physical))
+        physical = cgroup;
+    return physical != 0 ? physical : 1800000000; // unknown; twice the old fixed limit of 900 MB, as only a percentage is used
+}
+
+void MemoryGovernor::setBudgets(quint64 limit)
+{
+    _limit = std::max(limit, (quint64)32 * 1024 * 1024);
+    int percentage = std::min(90, std::max(10, ilwisconfig("system-settings/block-cache-percentage", 50)));
+    _residentBudget = _limit / 100 * percentage;
+    _packedBudget = _limit - _residentBudget;
+}
+
+quint64 MemoryGovernor::limit() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _limit;
+}
+
+void MemoryGovernor::limit(quint64 bytes)
+{
+    quint64 residentBudget;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        setBudgets(bytes);
+        rebalance();
+        if ( _packedBytes > _packedBudget)
+            spill(_packedBytes - _packedBudget, true);
+        residentBudget = _residentBudget;
+    }
+    // the BlockCache calls this governor while it holds its own lock, so it is only called after the lock of the governor is released
+    blockcache()->budget(residentBudget);
+}
+
+quint64 MemoryGovernor::residentBudget() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _residentBudget;
+}
+
+void MemoryGovernor::addGrid(Grid *grid, quint64 bytesNeeded)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _grids[grid] = bytesNeeded;
+    rebalance();
+}
+
+void MemoryGovernor::removeGrid(Grid *grid)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if ( _grids.erase(grid) > 0)
+        rebalance();
+}
+
+void MemoryGovernor::rebalance()
+{
+    // max-min fairness: the smallest needs are met first, the rest of the pool is shared equally by the grids that need more
+    std::vector<std::pair<quint64, Grid *>> needs;
+    for(const auto& item : _grids)
+        needs.push_back({item.second, item.first});
+    std::sort(needs.begin(), needs.end());
+    quint64 left = _packedBudget;
+    for(quint32 i = 0; i < needs.size(); ++i) {
+        quint64 share = std::min(needs[i].first, left / (needs.size() - i));
+        needs[i].second->_packedBudget = share;
+        left -= share;
+    }
+}
+
+bool MemoryGovernor::reservePacked(GridBlockInternal *block, quint64 bytes)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Grid *grid = block->_parentGrid;
+    if ( _packedBytes + bytes > _packedBudget) {
+        // a grid that stays within its share may push out the blocks of any grid, a grid beyond its share only those of other greedy grids
+        bool withinShare = grid->_packedBytes + (qint64)bytes <= grid->_packedBudget;
+        spill(_packedBytes + bytes - _packedBudget, withinShare);
+        if ( _packedBytes + bytes > _packedBudget)
+            return false;
+    }
+    _packedBytes += bytes;
+    grid->_packedBytes += bytes;
+    block->_spillPrev = 0;
+    block->_spillNext = _head;
+    if ( _head)
+        _head->_spillPrev = block;
+    _head = block;
+    if ( !_tail)
+        _tail = block;
+    block->_spillListed = true;
+    return true;
+}
+
+void MemoryGovernor::releasePacked(GridBlockInternal *block)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if ( block->_spillListed)
+        unlink(block);
+}
+
+void MemoryGovernor::unlink(GridBlockInternal *block)
+{
+    if ( block->_spillPrev)
+        block->_spillPrev->_spillNext = block->_spillNext;
+    else
+        _head = block->_spillNext;
+    if ( block->_spillNext)
+        block->_spillNext->_spillPrev = block->_spillPrev;
+    else
+        _tail = block->_spillPrev;
+    block->_spillPrev = block->_spillNext = 0;
+    block->_spillListed = false;
+    quint64 bytes = block->_packed.bytes();
+    _packedBytes -= std::min(_packedBytes, bytes);
+    block->_parentGrid->_packedBytes -= (qint64)bytes;
+}
+
+void MemoryGovernor::spill(quint64 bytesNeeded, bool fromAllGrids)
+{
+    quint64 freed = 0;
+    for(int pass = 0; pass < (fromAllGrids ? 2 : 1); ++pass) {
+        GridBlockInternal *candidate = _tail;
+        while(candidate && freed < bytesNeeded) {
+            GridBlockInternal *previous = candidate->_spillPrev;
+            Grid *grid = candidate->_parentGrid;
+            if ( pass == 1 || grid->_packedBytes > grid->_packedBudget) {
+                // the block locks are only tried; the owner of a locked block may be waiting for this governor
+                std::unique_lock<std::recursive_mutex> blockLock(candidate->_mutex, std::try_to_lock);
+                if ( blockLock.owns_lock()) {
+                    quint64 bytes = candidate->_packed.bytes();
+                    if ( candidate->writePacked(candidate->_packed)) {
+                        unlink(candidate);
+                        candidate->_packed.clear();
+                        freed += bytes;
+                        ++_spilledBlocks;
+                        _spilledBytes += bytes;
+                    }
+                }
+            }
+            candidate = previous;
+        }
+    }
+}
+
+MemoryGovernor::Usage MemoryGovernor::usage() const
+{
+    Usage usage;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        usage._limit = _limit;
+        usage._packedBudget = _packedBudget;
+        usage._packedBytes = _packedBytes;
+        usage._spilledBlocks = _spilledBlocks;
+        usage._spilledBytes = _spilledBytes;
+        usage._grids = (quint32)_grids.size();
+    }
+    usage._spillWrites = _spillWrites;
+    usage._spillReads = _spillReads;
+    usage._spillFileBytes = _spillFileBytes;
+    usage._bytesSaved = _spillRawBytes - std::min(_spillRawBytes.load(), _spillFileBytes.load()) + _constantBytes;
+    usage._constantBlocks = _constantBlocks;
+    usage._spillWriteNanos = _spillWriteNanos;
+    usage._spillReadNanos = _spillReadNanos;
+    BlockCache::Statistics stats = blockcache()->statistics();
+    usage._residentBudget = stats._budget;
+    usage._residentBytes = stats._bytesUsed;
+    return usage;
+}
+
+void MemoryGovernor::countSpillWrite(quint64 rawBytes, quint64 fileBytes, qint64 nanos)
+{
+    ++_spillWrites;
+    _spillRawBytes += rawBytes;
+    _spillFileBytes += fileBytes;
+    _spillWriteNanos += (quint64)std::max((qint64)0, nanos);
+}
+
+void MemoryGovernor::countSpillRead(qint64 nanos)
+{
+    ++_spillReads;
+    _spillReadNanos += (quint64)std::max((qint64)0, nanos);
+}
+
+void MemoryGovernor::countConstantBlock(quint64 rawBytes)
+{
+    ++_constantBlocks;
+    _constantBytes += rawBytes;
+}
@@ -0,0 +1,124 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#ifndef MEMORYGOVERNOR_H
+#define MEMORYGOVERNOR_H
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include "kernel_global.h"
+
+namespace Ilwis {
+
+class Grid;
+class GridBlockInternal;
+
+/*!
+ * \brief The MemoryGovernor class decides how much memory the grids of the process may use for their blocks
+ *
+ * The limit is read from the configuration (system-settings/memory-limit-mb); when it is not set, a percentage (system-settings/memory-percentage) of the physical
+ * memory, or of the memory limit of the cgroup of the process if that is lower, is used. A part of the limit is the budget of the BlockCache for resident blocks,
+ * the remainder is the pool for packed (swapped out) blocks that are kept in memory.
+ *
+ * The pool is divided over the live grids by max-min fairness: a grid never gets more than it needs, the grids that need more share what is left equally. The
+ * shares are recalculated whenever a grid is prepared or destroyed. When the pool is full, the packed blocks that were packed longest ago are spilled to the cache files
+ * of their grids, whatever grid they belong to; blocks of grids that exceed their share go first.
+ *
+ * The governor also counts the traffic to the cache files: blocks are compressed there, and constant blocks (e.g. entirely undefined ones) never go there.
+ */
+class KERNELSHARED_EXPORT MemoryGovernor
+{
+public:
+    struct Usage {
+        quint64 _limit = 0;
+        quint64 _residentBudget = 0; // budget of the BlockCache
+        quint64 _residentBytes = 0;
+        quint64 _packedBudget = 0; // pool for packed blocks
+        quint64 _packedBytes = 0;
+        quint64 _spilledBlocks = 0; // packed blocks moved from memory to a cache file to make place for others
+        quint64 _spilledBytes = 0;
+        quint32 _grids = 0;
+        quint64 _spillWrites = 0; // blocks written to a cache file
+        quint64 _spillReads = 0;
+        quint64 _spillFileBytes = 0; // bytes written to the cache files
+        quint64 _bytesSaved = 0; // compared to writing every swapped out block as PIXVALUETYPE values
+        quint64 _constantBlocks = 0; // swapped out blocks that were kept as a single value
+        quint64 _spillWriteNanos = 0; // total time of the writes, including compression
+        quint64 _spillReadNanos = 0;
+    };
+
+    MemoryGovernor();
+
+    quint64 limit() const;
+    /*!
+     * \brief limit sets a new limit and redistributes the budgets; packed blocks that no longer fit are spilled
+     */
+    void limit(quint64 bytes);
+    quint64 residentBudget() const;
+    /*!
+     * \brief addGrid registers a grid, or changes its need, and rebalances the shares of all grids
+     * \param bytesNeeded memory that the grid would need to keep all its blocks packed in memory
+     */
+    void addGrid(Grid *grid, quint64 bytesNeeded);
+    void removeGrid(Grid *grid);
+    /*!
+     * \brief reservePacked claims memory for the packed data of a block; when the pool is full other blocks may be spilled
+     * \return false if there is no room; the block must then go to the cache file itself
+     */
+    bool reservePacked(GridBlockInternal *block, quint64 bytes);
+    /*!
+     * \brief releasePacked returns the memory of the packed data of a block; the block must be locked by the caller
+     */
+    void releasePacked(GridBlockInternal *block);
+    Usage usage() const;
+
+    void countSpillWrite(quint64 rawBytes, quint64 fileBytes, qint64 nanos);
+    void countSpillRead(qint64 nanos);
+    void countConstantBlock(quint64 rawBytes);
+
+private:
+    static quint64 detectLimit();
+    void setBudgets(quint64 limit);
+    void rebalance();
+    void spill(quint64 bytesNeeded, bool fromAllGrids);
+    void unlink(GridBlockInternal *block);
+
+    mutable std::mutex _mutex;
+    std::map<Grid *, quint64> _grids; // grid and the memory it needs
+    GridBlockInternal *_head = 0; // most recently packed
+    GridBlockInternal *_tail = 0;
+    quint64 _limit = 0;
+    quint64 _residentBudget = 0;
+    quint64 _packedBudget = 0;
+    quint64 _packedBytes = 0;
+    quint64 _spilledBlocks = 0;
+    quint64 _spilledBytes = 0;
+    // the cache file counters are updated without the lock
+    std::atomic<quint64> _spillWrites;
+    std::atomic<quint64> _spillReads;
+    std::atomic<quint64> _spillRawBytes;
+    std::atomic<quint64> _spillFileBytes;
+    std::atomic<quint64> _constantBlocks;
+    std::atomic<quint64> _constantBytes;
+    std::atomic<quint64> _spillWriteNanos;
+    std::atomic<quint64> _spillReadNanos;
+};
+
+KERNELSHARED_EXPORT MemoryGovernor* memorygovernor();
+}
+
+#endif // MEMORYGOVERNOR_H
@@ -0,0 +1,159 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#include "raster.h"
+#include "pixeliterator.h"
+#include "neighbourhoodwindow.h"
+
+using namespace Ilwis;
+
+RasterRows::RasterRows(const IRasterCoverage &raster, qint32 xmin, qint32 xmax, quint32 ringSize, EdgePolicy policy, int threadIndex) :
+    _raster(raster),
+    _xmin(xmin),
+    _width(xmax - xmin + 1),
+    _policy(policy),
+    _threadIndex(threadIndex),
+    _ring(std::max(1u, ringSize), std::vector<double>(_width)),
+    _ringRows(std::max(1u, ringSize), iUNDEF),
+    _columns(_width)
+{
+    qint32 xsize = _raster->size().xsize();
+    for(quint32 i = 0; i < _width; ++i)
+        _columns[i] = position(_xmin + i, xsize, _policy);
+}
+
+qint32 RasterRows::position(qint32 p, qint32 n, EdgePolicy policy)
+{
+    if ( p >= 0 && p < n)
+        return p;
+    switch(policy) {
+    case epCLAMP:
+        return p < 0 ? 0 : n - 1;
+    default:
+        return -1;
+    }
+}
+
+const double *RasterRows::row(qint32 y)
+{
+    for(quint32 slot = 0; slot < _ring.size(); ++slot) {
+        if ( _ringRows[slot] == y)
+            return _ring[slot].data();
+    }
+    // the oldest row makes place
+    quint32 slot = _next;
+    _next = (_next + 1) % _ring.size();
+    read(y, _ring[slot]);
+    _ringRows[slot] = y;
+    return _ring[slot].data();
+}
+
+void RasterRows::band(qint32 z)
+{
+    _band = z;
+    std::fill(_ringRows.begin(), _ringRows.end(), iUNDEF);
+    _next = 0;
+}
+
+void RasterRows::read(qint32 y, std::vector<double> &values)
+{
+    qint32 row = position(y, _raster->size().ysize(), _policy);
+    if ( row == -1) {
+        std::fill(values.begin(), values.end(), rUNDEF);
+        return;
+    }
+    // the part of the row inside the raster is read through spans; the positions outside it copy the pixel that provides their value
+    qint32 xsize = _raster->size().xsize();
+    qint32 xstart = std::max(0, _xmin);
+    qint32 xend = std::min(xsize - 1, _xmin + (qint32)_width - 1);
+    if ( xstart <= xend) {
+        PixelIterator iter(_raster, _threadIndex, BoundingBox(Pixel(xstart, row, _band), Pixel(xend, row, _band)));
+        qint32 offset = xstart - _xmin;
+        PixelSpan span;
+        while((span = iter.span())._length > 0) {
+            for(qint32 i = 0; i < span._length; ++i)
+                values[offset + i] = span[i];
+            offset += span._length;
+            iter += span._length;
+        }
+    }
+    for(quint32 i = 0; i < _width; ++i) {
+        qint32 x = _xmin + i;
+        if ( x >= xstart && x <= xend)
+            continue;
+        qint32 column = _columns[i];
+        if ( column == -1)
+            values[i] = rUNDEF;
+        else if ( column >= xstart && column <= xend)
+            values[i] = values[column - _xmin];
+        else {
+            PixelIterator iter(_raster, _threadIndex, BoundingBox(Pixel(column, row, _band), Pixel(column, row, _band)));
+            values[i] = *iter;
+        }
+    }
+}
+
+qint32 RasterRows::xmin() const
+{
+    return _xmin;
+}
+
+quint32 RasterRows::width() const
+{
+    return _width;
+}
+
+RasterRows::EdgePolicy RasterRows::edgePolicy() const
+{
+    return _policy;
+}
+
+//---------------------------------------------------------------------------------
+NeighbourhoodWindow::NeighbourhoodWindow(RasterRows &rows, quint32 columns, quint32 nrows) :
+    _rows(rows),
+    _columns(columns),
+    _nrows(nrows),
+    _values(columns * nrows)
+{
+}
+
+void NeighbourhoodWindow::moveTo(qint32 x, qint32 y)
+{
+    for(quint32 r = 0; r < _nrows; ++r) {
+        const double *row = _rows.row(y + r) + x - _rows.xmin();
+        std::copy(row, row + _columns, _values.begin() + r * _columns);
+    }
+}
+
+double NeighbourhoodWindow::operator()(quint32 column, quint32 row) const
+{
+    return _values[row * _columns + column];
+}
+
+const std::vector<double> &NeighbourhoodWindow::values() const
+{
+    return _values;
+}
+
+quint32 NeighbourhoodWindow::columns() const
+{
+    return _columns;
+}
+
+quint32 NeighbourhoodWindow::rows() const
+{
+    return _nrows;
+}
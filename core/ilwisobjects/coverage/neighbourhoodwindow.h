@@ -0,0 +1,95 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#ifndef NEIGHBOURHOODWINDOW_H
+#define NEIGHBOURHOODWINDOW_H
+
+namespace Ilwis {
+
+/*!
+ * \brief The RasterRows class a ring of rows of one band of a raster, for the neighbourhood operations that slide down over a raster.
+ *
+ * A row holds the pixels xmin..xmax, which may extend beyond the raster; the positions outside the raster (also rows above or below it) get their value
+ * from the edge policy. A row is read once, when it is first requested, and stays valid until ringSize other rows have been requested after it.
+ */
+class KERNELSHARED_EXPORT RasterRows {
+public:
+    enum EdgePolicy{ epCLAMP, // the edge pixel is repeated, as GridBlock does
+                     epUNDEF // positions outside the raster are undefined
+                   };
+
+    RasterRows(const IRasterCoverage& raster, qint32 xmin, qint32 xmax, quint32 ringSize, EdgePolicy policy = epCLAMP, int threadIndex = 0);
+
+    /*!
+     * \brief row the values of row y for the pixels xmin..xmax
+     */
+    const double *row(qint32 y);
+    /*!
+     * \brief band selects the band the rows are read from; the rows of the previous band are discarded
+     */
+    void band(qint32 z);
+    qint32 xmin() const;
+    quint32 width() const;
+    EdgePolicy edgePolicy() const;
+
+    /*!
+     * \brief position translates a position along an axis of n pixels to the pixel that provides its value; -1 if the position is undefined
+     */
+    static qint32 position(qint32 p, qint32 n, EdgePolicy policy);
+
+private:
+    IRasterCoverage _raster;
+    qint32 _xmin;
+    quint32 _width;
+    EdgePolicy _policy;
+    int _threadIndex;
+    qint32 _band = 0;
+    std::vector<std::vector<double>> _ring;
+    std::vector<qint32> _ringRows; // per slot, the row it holds
+    std::vector<qint32> _columns; // per position of a row, the column of the raster that provides its value; -1 if undefined
+    quint32 _next = 0;
+
+    void read(qint32 y, std::vector<double>& values);
+};
+
+/*!
+ * \brief The NeighbourhoodWindow class a window of columns x rows pixels whose values are contiguous in row order, e.g. the pixels of an aggregation group.
+ *
+ * The window is filled from RasterRows at moveTo(); its values are reused for every position, so moving it never allocates.
+ * The RasterRows must have a ring of at least as many rows as the window.
+ */
+class KERNELSHARED_EXPORT NeighbourhoodWindow {
+public:
+    NeighbourhoodWindow(RasterRows& rows, quint32 columns, quint32 nrows);
+
+    /*!
+     * \brief moveTo places the left-up corner of the window at pixel (x,y)
+     */
+    void moveTo(qint32 x, qint32 y);
+    double operator()(quint32 column, quint32 row) const;
+    const std::vector<double>& values() const;
+    quint32 columns() const;
+    quint32 rows() const;
+
+private:
+    RasterRows& _rows;
+    quint32 _columns;
+    quint32 _nrows;
+    std::vector<double> _values;
+};
+}
+
+#endif // NEIGHBOURHOODWINDOW_H
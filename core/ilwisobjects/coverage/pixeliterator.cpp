@@ -28,6 +28,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #include "feature.h"
 #include "pixeliterator.h"
 #include "bresenham.h"
+#include "taskscheduler.h"
 #include "vertexiterator.h"
 
 using namespace Ilwis;
@@ -139,6 +140,9 @@ PixelIterator::PixelIterator(PixelIterator&& iter) :
     _currentBlock(iter._currentBlock),
     _flow(iter._flow),
     _isValid(iter._isValid),
+    _blockMinX(iter._blockMinX),
+    _blockMaxX(iter._blockMaxX),
+    _pixelStride(iter._pixelStride),
     _endx(iter._endx),
     _endy(iter._endy),
     _endz(iter._endz),
@@ -149,7 +153,9 @@ PixelIterator::PixelIterator(PixelIterator&& iter) :
     _zChanged(iter._zChanged),
     _selectionPixels(iter._selectionPixels),
     _selectionIndex(iter._selectionIndex),
-    _insideSelection (iter._insideSelection)
+    _insideSelection (iter._insideSelection),
+    _step(iter._step),
+    _threadIndex(iter._threadIndex)
 {
 }
 
@@ -174,9 +180,14 @@ void PixelIterator::copy(const PixelIterator &iter) {
     _endposition = iter._endposition;
     _localOffset = iter._localOffset;
     _currentBlock = iter._currentBlock;
+    _blockMinX = iter._blockMinX;
+    _blockMaxX = iter._blockMaxX;
+    _pixelStride = iter._pixelStride;
     _selectionPixels  = iter._selectionPixels;
     _selectionIndex = iter._selectionIndex;
     _insideSelection = iter._insideSelection;
+    _step = iter._step;
+    _threadIndex = iter._threadIndex;
 
 }
 
@@ -199,6 +210,9 @@ void PixelIterator::init() {
     if ( isNumericalUndef(_endz))
         _endz = 0;
 
+    if ( _threadIndex == 0) // iterators created within a task of the scheduler use the block cache of their worker thread
+        _threadIndex = TaskScheduler::currentThreadIndex();
+
     _grid = _raster->gridRef().get();
     if ( _grid == 0) {
         _isValid = false;
@@ -210,6 +224,28 @@ void PixelIterator::init() {
     bool inside = contains(Pixel(_x,_y, _z));
     _isValid = inside;
     _xChanged = _yChanged = _zChanged = false;
+    announceReadAhead();
+}
+
+void PixelIterator::announceReadAhead()
+{
+    // the grid reads the blocks that follow in the flow of this iterator ahead, within its box
+    if ( !_grid || !_isValid || _grid->maxLines() == 0)
+        return;
+    qint32 zmin = isNumericalUndef(_box.min_corner().z) ? 0 : _box.min_corner().z;
+    _grid->readAhead(_threadIndex, _flow == fZXY, zmin, _endz, _grid->blockIndex(_box.min_corner().x, _box.min_corner().y, 0), _grid->blockIndex(_endx, _endy, 0));
+}
+
+void PixelIterator::setBlockPosition()
+{
+    _currentBlock = _grid->blockIndex(_x, _y, _z);
+    _localOffset = _grid->blockOffset(_x, _y, _z);
+    _pixelStride = _grid->pixelStride();
+    // the columns of the box within the current block; for full width strips these are the columns of the box
+    qint32 tileWidth = _grid->tileSize().xsize();
+    qint32 left = (_x / tileWidth) * tileWidth;
+    _blockMinX = std::max(_box.min_corner().x, left);
+    _blockMaxX = std::min(_endx, left + tileWidth - 1);
 }
 
 bool PixelIterator::moveXY(qint64 delta){
@@ -229,9 +265,7 @@ bool PixelIterator::moveXY(qint64 delta){
             return false;
         }
     }
-    qint32 ylocal = _y % _grid->maxLines();
-    _localOffset = _x + ylocal * _grid->size().xsize();
-    _currentBlock = _z * _grid->blocksPerBand() + _y / _grid->maxLines();
+    setBlockPosition();
     _linearposition = _x + _y * _grid->size().xsize() + _z * _grid->size().xsize() * _grid->size().ysize();
     return true;
 }
@@ -243,37 +277,28 @@ bool PixelIterator::moveXZ(qint64 delta)
     _y = _box.min_corner().y + ( _y - _box.min_corner().y) % (int)_box.ylength();
     _x += (tempy - _y) / _box.ylength();
     _xChanged = tempx != _x;
-    qint32 ylocal = _y % _grid->maxLines();
-    _localOffset = _x + ylocal * _grid->size().xsize();
     _linearposition = _x + _y * _grid->size().xsize() + _z * _grid->size().xsize() * _grid->size().ysize();
 
-    move2NextBlock();
-
+    // the next band is chosen before the block is; a column beyond the box may lie beyond the last block of a band interleaved or tiled grid
     if ( _x > _endx){
         quint32 newz = _z + (_x - _box.min_corner().x) / _box.xlength();
-        _currentBlock = newz * _grid->blocksPerBand() + _y / _grid->maxLines();
         _zChanged = newz != _z;
         _z = newz;
         tempx = _x;
         _x = _box.min_corner().x + (_x - _box.min_corner().x) % (int)_box.xlength();
         _xChanged = _x != tempx;
-        quint32 localblock = _y /  _grid->maxLines();
-        _localOffset = _y * _grid->size().xsize() + _x - localblock * _grid->maxLines() * _grid->size().xsize();
+        setBlockPosition();
         if ( _z > _endz) { // done with this iteration block
             _linearposition = _endposition;
             return false;
         }
-    }
+    } else
+        return move2NextBlock();
     return true;
 }
 
 bool PixelIterator::move2NextBlock() {
-    quint32 localblock = _y /  _grid->maxLines();
-    quint32 bandblocks = _grid->blocksPerBand() * _z;
-    if ( bandblocks + localblock != _currentBlock) {
-        _currentBlock = bandblocks + localblock;
-        _localOffset = _x + (_y % _grid->maxLines()) * _grid->size().xsize() ; // needs to be revised for z-dimension change (formula is wrong when moving with -- from topleft of band2 to bottomright of band1)
-    }
+    setBlockPosition();
     if ( _currentBlock >= _grid->blocks()){
         _linearposition = _endposition;
         return false;
@@ -305,19 +330,15 @@ bool PixelIterator::moveYZ(qint64 delta){
 
     _yChanged = tempy != _y;
     std::swap(_y,tempy);
-    qint32 ylocal = _y % _grid->maxLines();
-    _localOffset = _x + ylocal * _grid->size().xsize();
 
-    move2NextBlock();
+    // the next band is chosen before the block is; a line beyond the box may lie beyond the last block of a band interleaved grid, whose blocks hold all bands
     if ( _y > _endy) {
         quint32 newz = _z + (_y - _box.min_corner().y) / _box.ylength();
         _zChanged = newz != _z;
         _z = newz;
         _y = _box.min_corner().y + (_y - _box.min_corner().y) % (int)_box.ylength();
-        _currentBlock = newz * _grid->blocksPerBand() + _y / _grid->maxLines();
         _yChanged = _y != tempy;
-        quint32 localblock = _y /  _grid->maxLines();
-        _localOffset = _y * _grid->size().xsize() + _x - localblock * _grid->maxLines() * _grid->size().xsize();
+        setBlockPosition();
         if ( _z > _endz) { // done with this iteration block
             _linearposition = _endposition;
             return false;
@@ -326,13 +347,13 @@ bool PixelIterator::moveYZ(qint64 delta){
         _y = _box.max_corner().y;
         --_z;
         _zChanged = true;
-         quint32 localblock = _y /  _grid->maxLines();
-        _localOffset = _y * _grid->size().xsize() + _x - localblock * _grid->maxLines() * _grid->size().xsize();
+        setBlockPosition();
         if ( _z < 0) {
             return false;
         }
 
-    }
+    } else
+        return move2NextBlock();
     return true;
 }
 
@@ -341,6 +362,41 @@ Pixel PixelIterator::position() const
     return Pixel(_x, _y, _z);
 }
 
+PixelSpan PixelIterator::span()
+{
+    PixelSpan result;
+    if ( !_isValid || _grid == 0 || _linearposition >= _endposition)
+        return result;
+
+    result._values = &_grid->value(_currentBlock, _localOffset, _threadIndex);
+    result._position = Pixel(_x, _y, _z);
+    result._length = 1;
+    if ( _selectionIndex >= 0) // the boundaries of a selection are checked per pixel
+        return result;
+
+    if ( _flow == fXYZ) {
+        result._length = _blockMaxX - _x + 1;
+        result._stride = _pixelStride;
+    } else if ( _flow == fZXY && _grid->bandStep() == 1) { // only in a band interleaved grid are the bands of a pixel next to each other
+        result._length = _endz - _z + 1;
+    }
+    return result;
+}
+
+qint32 PixelIterator::spans(const std::vector<PixelIterator *> &iters, std::vector<PixelSpan> &result)
+{
+    result.resize(iters.size());
+    qint32 length = iters.size() > 0 ? std::numeric_limits<qint32>::max() : 0;
+    for(int i = 0; i < iters.size(); ++i) {
+        result[i] = iters[i]->span();
+        length = std::min(length, result[i]._length);
+    }
+    for(PixelSpan& sp : result)
+        sp._length = length;
+
+    return length;
+}
+
 const BoundingBox &PixelIterator::box() const
 {
     return _box;
@@ -439,11 +495,12 @@ void PixelIterator::toEnd()
     _z = _endz;
     _y = _endy;
     _linearposition = (_endx + 1) * (_endy + 1) * (_endz + 1)  -1;
-    _localOffset = _grid->blockSize(_grid->blocks() -1 ) - 1;
+    setBlockPosition();
 }
 
 void PixelIterator::setFlow(Flow flw) {
     _flow = flw;
+    announceReadAhead();
 }
 
 bool PixelIterator::contains(const Pixel& pix) {
@@ -481,9 +538,7 @@ void PixelIterator::initPosition() {
     const Size<>& sz = _raster->size();
     quint64 linpos = _y * sz.xsize() + _x;
     quint64 endpos = _endy * sz.xsize() + _endx;
-    _currentBlock = _y / _grid->maxLines();
-    _localOffset = linpos - _currentBlock * _grid->maxLines() * sz.xsize();
-    _currentBlock += _z * _grid->blocksPerBand();
+    setBlockPosition();
     _linearposition = sz.xsize() * sz.ysize() * _z + linpos;
     _endposition = sz.xsize() * sz.ysize() * _endz + endpos + 1; // one past the last valid position
 }
@@ -513,7 +568,7 @@ bool PixelIterator::move2NextSelection(int delta)
             return false;
         int xnew = _selectionPixels[_y][0];
         _linearposition += xnew - _box.min_corner().x;
-        _localOffset += xnew - _box.min_corner().x;
+        _localOffset += (xnew - _box.min_corner().x) * _pixelStride;
         _selectionIndex = 0;
         _insideSelection = false; //  we are not yet in a selection
         if ( _selectionPixels[_y].size() > 0){
@@ -523,7 +578,7 @@ bool PixelIterator::move2NextSelection(int delta)
     }else{
         int xnew = _selectionPixels[_y][++_selectionIndex];
         _linearposition += xnew - _box.min_corner().x;
-        _localOffset += xnew - _box.min_corner().x;
+        _localOffset += (xnew - _box.min_corner().x) * _pixelStride;
         _x = xnew;
         moveYZ(delta);
         _x -= 1;
@@ -82,6 +82,22 @@ typedef std::shared_ptr<Tranquilizer> SPTranquilizer;
  * Note that because the iterator ‘automatically’ moves in layer-index direction all algorithms also work on stacks of raster layers.
  *
  */
+/*!
+ * \brief The PixelSpan struct a run of pixels of one row (or, for the fZXY flow, of the bands of one pixel) that lie in the same block
+ *
+ * The values of the run are _values[0], _values[_stride], .. _values[(_length - 1) * _stride]. The stride is 1 unless the grid is band interleaved and the run goes over the columns of a row.
+ * The pointer may be used for reading and writing; it stays valid as long as the block is pinned by the iterator, i.e. until the iterator has moved to a few other blocks.
+ */
+struct PixelSpan {
+    PIXVALUETYPE *_values = 0;
+    qint32 _length = 0;
+    qint32 _stride = 1;
+    Pixel _position;
+
+    PIXVALUETYPE& operator[](qint32 i) { return _values[i * _stride]; }
+    const PIXVALUETYPE& operator[](qint32 i) const { return _values[i * _stride]; }
+};
+
 class KERNELSHARED_EXPORT PixelIterator   {
 public:
 	typedef std::random_access_iterator_tag iterator_category;
@@ -465,6 +481,7 @@ public:
     void setRaster(const IRasterCoverage &raster);
 	void threadIndex(int idx) {
 		_threadIndex = idx >= 0 ? idx : 0;
+		announceReadAhead();
 	}
 
     /*!
@@ -490,6 +507,28 @@ public:
 
     const Ilwis::IRasterCoverage &raster() const;
 
+    /*!
+     * \brief span gives the pixels from the current position onward that are stored contiguously (apart from the stride) in the current block. A kernel can
+     * process the run in a plain loop and then move the iterator with += span._length.
+     *
+     *    for(PixelSpan sp = iter.span(); sp._length > 0; iter += sp._length, sp = iter.span()) {
+     *        for(qint32 i = 0; i < sp._length; ++i)
+     *            sp[i] = ...;
+     *    }
+     *
+     * With a selection, or a flow other than fXYZ or fZXY, the span is a single pixel.
+     * \return the run; an empty span (length 0) if the iterator is at its end or invalid
+     */
+    PixelSpan span();
+
+    /*!
+     * \brief spans the spans of a number of iterators that move in step (e.g. inputs and output of a point operation), shortened to the length they have in common
+     * \param iters the iterators; all must have the same flow and box size
+     * \param result receives one span per iterator
+     * \return the common length; 0 if one of the iterators is at its end
+     */
+    static qint32 spans(const std::vector<PixelIterator *> &iters, std::vector<PixelSpan>& result);
+
 protected:
     PixelIterator(quint64 endpos ) :
         _grid(0),
@@ -513,6 +552,8 @@ protected:
 
     void init();
     void initPosition();
+    void announceReadAhead();
+    void setBlockPosition();
     //bool move(int n);
     //bool moveXYZ(int delta) ;
     void copy(const PixelIterator& iter);
@@ -527,6 +568,9 @@ protected:
     qint32 _currentBlock = 0;
     Flow _flow;
     bool _isValid;
+    qint32 _blockMinX = 0; // columns of the box that lie within the current block; moving beyond them means a move to another block
+    qint32 _blockMaxX = -1;
+    qint32 _pixelStride = 1; // distance between the values of neighbouring pixels in a block; the number of bands for a band interleaved grid
     qint32 _endx;
     qint32 _endy;
     qint32 _endz;
@@ -575,7 +619,9 @@ private:
         _linearposition += delta * _box.xlength() * _box.ylength();
         _zChanged = true;
         _xChanged = _yChanged = false;
-        _currentBlock  = _z * _grid->blocksPerBand() + _y / _grid->maxLines();
+        // the next band is in another block, or, in a band interleaved grid, at the next value of the same block
+        _currentBlock += delta * _grid->bandBlocks();
+        _localOffset += delta * _grid->bandStep();
         if (_selectionIndex < 0){
             if ( _z > _endz || _z < _box.min_corner().z){
                 return moveXY(delta);
@@ -587,29 +633,27 @@ private:
     bool moveYXZ(qint64 delta){
         _y += delta;
         _linearposition += delta * _box.xlength();
-        _localOffset += delta * _box.xlength();
         _yChanged = true;
         _xChanged = _zChanged = false;
         if (_selectionIndex < 0){
             if ( _y > _endy || _y < _box.min_corner().y){
                 return moveXZ(delta);
             }
-            if ( _localOffset >= _grid->blockSize(_currentBlock)){
-                return move2NextBlock();
-            }
         }
-        return true;
+        return move2NextBlock(); // the offset of the next row depends on the width of the block
     }
 
     bool moveXYZ(qint64 delta) {
         _x += delta;
         _linearposition += delta;
-        _localOffset += delta;
+        _localOffset += delta * _pixelStride;
         _xChanged = true;
         _yChanged = _zChanged = false;
         if ( _selectionIndex < 0){
-            if ( _x > _endx || _z > _endz || _x < _box.min_corner().x) {
-                return moveYZ(delta);
+            if ( _x > _blockMaxX || _z > _endz || _x < _blockMinX) {
+                if ( _x > _endx || _z > _endz || _x < _box.min_corner().x)
+                    return moveYZ(delta);
+                setBlockPosition(); // crossed into the next tile of the row
             }
         } else {
             int selectionPix = (int)_selectionPixels[_y].size();
@@ -34,9 +34,59 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #include "representation.h"
 #include "interval.h"
 #include "itemiterator.h"
+#include "rasterpyramid.h"
 
 using namespace Ilwis;
 
+namespace {
+// the type in which the grid can keep the values of the raster; it only serves to estimate the memory the grid will need
+IlwisTypes gridStorageType(const DataDefinition& def) {
+    if ( !def.isValid())
+        return itDOUBLE;
+    IlwisTypes tp = def.range().isNull() ? def.domain()->valueType() : def.range()->valueType();
+    if ( hasType(tp, itUINT8 | itINT16 | itUINT16 | itINT32 | itFLOAT))
+        return tp;
+    if ( tp == itINT8)
+        return itINT16;
+    if ( hasType(tp, itDOMAINITEM) && !hasType(tp, itCOLOR))
+        return itINT32; // raw values of items
+    return itDOUBLE;
+}
+
+// boxes of whole rows of blocks within one band. The statistics of the boxes are merged in the order of the boxes, so the boxes must not depend on the
+// number of threads; their number is limited as every box keeps its own accumulator (and quantile sketch) until the merge
+std::vector<BoundingBox> statisticsBoxes(RasterCoverage *raster) {
+    std::vector<BoundingBox> boxes;
+    Size<> sz = raster->size();
+    quint32 zsize = std::max((quint32)1, sz.zsize());
+    quint32 lines = std::max(1, raster->gridRef()->maxLines());
+    quint64 rowsOfBlocks = ((sz.ysize() + lines - 1) / lines) * (quint64)zsize;
+    lines *= (quint32)((rowsOfBlocks + 255) / 256);
+    for(quint32 z = 0; z < zsize; ++z) {
+        for(quint32 y = 0; y < sz.ysize(); y += lines)
+            boxes.push_back(BoundingBox(Pixel(0, y, z), Pixel(sz.xsize() - 1, std::min(y + lines, sz.ysize()) - 1, z)));
+    }
+    return boxes;
+}
+
+template<typename... Mapping> bool calculateStatistics(NumericStatistics& stats, RasterCoverage *raster, int mode, int bins, Mapping&... mapping) {
+    IRasterCoverage rc(raster);
+    std::vector<BoundingBox> boxes = statisticsBoxes(raster);
+    auto part = [&](quint32 p, int threadIndex) {
+        PixelIterator iter(rc, threadIndex, boxes[p]);
+        return std::make_pair(iter, iter.end());
+    };
+    // within a task of the scheduler the parts run inline on the worker; the cache entries of the grid belong to the operation that runs the task
+    bool nested = TaskScheduler::currentThreadIndex() != 0;
+    if ( !nested)
+        raster->gridRef()->prepare4Operation(taskscheduler()->threadCount());
+    bool ok = stats.calculateParallel((quint32)boxes.size(), part, mapping..., mode, bins);
+    if ( !nested)
+        raster->gridRef()->unprepare4Operation(); // the blocks pinned by the tasks go back to the BlockCache
+    return ok;
+}
+}
+
 RasterCoverage::RasterCoverage()
 {
 }
@@ -99,6 +149,7 @@ void RasterCoverage::georeference(const IGeoReference &grf, bool resetData)
     else
         _size = Size<>();
     if (!_grid && _size.isValid()){
+            gridRef()->storageType(gridStorageType(datadef()));
             gridRef()->prepare(this->id(),_size);
     }
     resourceRef().dimensions(_size.toString());
@@ -194,7 +245,7 @@ NumericStatistics RasterCoverage::statistics(const QString& attribute) const {
 NumericStatistics& RasterCoverage::statisticsRef(const QString& attribute)  {
     if (attribute == PIXELVALUE){
         if ( !_datadefCoverage.range()->isValid()){
-            _datadefCoverage.statisticsRef().calculate( begin(), end(),NumericStatistics::pBASIC);
+            calculateStatistics(_datadefCoverage.statisticsRef(), this, NumericStatistics::pBASIC, 0);
 
             if ( hasType(_datadefCoverage.domain()->valueType(), itNUMBER )){
                 auto &stats = _datadefCoverage.statisticsRef();
@@ -486,11 +537,22 @@ NumericStatistics &RasterCoverage::statistics(const QString& attribute, int mode
 						done = start.end();
 					}
 				}
-				if (hasType(mode, ContainerStatistics<PIXVALUETYPE>::pQUICKHISTOGRAM)) {
+				IRasterCoverage sample(this);
+				if (code().indexOf("band=") == 0) {
 					qint64 sz = done.linearPosition() - start.linearPosition();
 					int step = sz / 1e6 + 1;
 					start.step(step);
 				}
+				else { // the first overview with at most a million pixels; its pixels summarize all pixels of the raster instead of every n-th one
+					quint32 level = 0;
+					while (level < overviewLevels() && (size().linearSize() >> (2 * level)) > 1e6)
+						++level;
+					sample = overview(level);
+					if (!sample.isValid())
+						sample.set(this);
+					start = sample->begin();
+					done = sample->end();
+				}
 				calculateHistogram(attribute, start, done, mode, bins);
                 storeHistograms(attribute,mode);
                 if (hasType(context()->runMode(), rmDESKTOP)) {
@@ -502,7 +564,7 @@ NumericStatistics &RasterCoverage::statistics(const QString& attribute, int mode
 	else {
 		if (!histogramCalculated(attribute, mode, bins)) {
 			if (!loadHistograms(attribute,mode, bins)) {
-				calculateHistogram(attribute, begin(), end(), mode, bins);
+				calculateHistogram(attribute, mode, bins);
 				storeHistograms(attribute, mode);
 			}
 		}
@@ -529,6 +591,18 @@ std::unordered_map<qint32, double> RasterCoverage::keyMapping(const QString& att
 	}
 	return mapping;
 }
+void RasterCoverage::calculateHistogram(const QString& attribute, int mode, int bins) {
+	if (attribute == PIXELVALUE)
+		calculateStatistics(statisticsRef(attribute), this, mode, bins);
+	else {
+		if (hasAttributes()) {
+			std::unordered_map<qint32, double> mapping = keyMapping(attribute);
+			if (mapping.size() > 0)
+				calculateStatistics(statisticsRef(attribute), this, mode, bins, mapping);
+		}
+	}
+}
+
 void RasterCoverage::calculateHistogram(const QString& attribute, const PixelIterator& begin, const PixelIterator& end, int mode, int bins) {
 	if (attribute == PIXELVALUE)
 		statisticsRef(attribute).calculate(begin, end, (ContainerStatistics<PIXVALUETYPE>::PropertySets)mode, bins);
@@ -543,8 +617,11 @@ void RasterCoverage::calculateHistogram(const QString& attribute, const PixelIte
 
 UPGrid &RasterCoverage::gridRef()
 {
-    if (!_grid)
+    if (!_grid) {
         _grid.reset( new Grid);
+        _grid->tileSize(_tileSize);
+        _grid->interleaved(_interleaved);
+    }
     return _grid;
 }
 
@@ -569,6 +646,9 @@ void RasterCoverage::copyTo(IlwisObject *obj)
     }
     raster->_attributeTable = _attributeTable;
     raster->_size = _size;
+    raster->_tileSize = _tileSize;
+    raster->_interleaved = _interleaved;
+    raster->_expression = _expression; // blocks the copy doesn't have yet are computed the same way
     raster->_primaryKey = _primaryKey;
 
 }
@@ -594,6 +674,53 @@ Resource RasterCoverage::resource(int mode) const
     return resource;
 }
 
+void RasterCoverage::tileSize(const Size<> &sz)
+{
+    if ( isReadOnly())
+        return;
+    _tileSize = sz;
+    gridRef()->tileSize(sz);
+    if ( _size.isValid() && !_size.isNull()) {
+        changed(true);
+        gridRef()->prepare(this->id(), _size);
+    }
+}
+
+Size<> RasterCoverage::tileSize() const
+{
+    if ( _grid)
+        return _grid->tileSize();
+    return Size<>();
+}
+
+void RasterCoverage::interleaved(bool yes)
+{
+    Locker<> lock(_mutex);
+    _interleaved = yes;
+    if ( !_grid || _grid->isInterleaved() == yes)
+        return;
+    if ( _grid->size().isNull() || !_grid->size().isValid()) // not prepared yet; the values will come in the new layout
+        _grid->interleaved(yes);
+    else
+        _grid.reset(_grid->convert(yes));
+}
+
+bool RasterCoverage::isInterleaved() const
+{
+    return _interleaved;
+}
+
+void RasterCoverage::expression(const SPRasterExpression &expr)
+{
+    Locker<> lock(_loadMutex);
+    _expression = expr;
+}
+
+SPRasterExpression RasterCoverage::expression() const
+{
+    return _expression;
+}
+
 Size<> RasterCoverage::size() const
 {
     if (_size.isValid() && !_size.isNull())
@@ -607,6 +734,33 @@ Size<> RasterCoverage::size() const
 
 }
 
+IlwisData<RasterCoverage> RasterCoverage::overview(quint32 level)
+{
+    if ( level == 0)
+        return IRasterCoverage(this);
+    {
+        Locker<> lock(_loadMutex); // not held while the level is built; its tasks load blocks of this raster
+        if ( !_pyramid)
+            _pyramid.reset(new RasterPyramid(this));
+    }
+    return _pyramid->level(level);
+}
+
+void RasterCoverage::changed(bool yesno)
+{
+    Coverage::changed(yesno);
+    if ( !yesno)
+        return;
+    Locker<> lock(_loadMutex); // guards _pyramid, as in overview()
+    if ( _pyramid)
+        _pyramid->clear();
+}
+
+quint32 RasterCoverage::overviewLevels() const
+{
+    return RasterPyramid(const_cast<RasterCoverage *>(this)).levels();
+}
+
 void RasterCoverage::unload() {
     if (_grid != 0) {
         return _grid->unload();
@@ -805,11 +959,40 @@ bool RasterCoverage::bandPrivate(quint32 bandIndex,  PixelIterator inputIter)
 
 void RasterCoverage::getData(quint32 blockIndex)
 {
+    if ( !_expression && !connector().isNull() && connector()->isReentrant()) { // e.g. a connector with a handle per thread; the blocks are loaded in parallel
+        connector()->loadData(this, {"blockindex", blockIndex});
+        return;
+    }
+    Locker<> lock(_loadMutex);
+    if ( _expression) {
+        _expression->computeBlock(this, blockIndex);
+        return;
+    }
     if ( !connector().isNull()){
         connector()->loadData(this, {"blockindex", blockIndex});
     }
 }
 
+bool RasterCoverage::loadData(const IOOptions &options)
+{
+    if ( !options.contains("boundingbox") && !options.contains("envelope"))
+        return Coverage::loadData(options);
+    if ( connector().isNull())
+        return false;
+
+    IOOptions region(options);
+    if ( !region.contains("boundingbox")) { // the connectors select blocks by pixels
+        QVariant var = options["envelope"];
+        Envelope env = var.canConvert<Envelope>() ? var.value<Envelope>() : Envelope(var.toString());
+        if ( !_georef.isValid() || !env.isValid())
+            return false;
+        region.addOption("boundingbox", QVariant::fromValue(_georef->coord2Pixel(env)));
+    }
+    region.remove("envelope");
+    Locker<> lock(_loadMutex);
+    return connector()->loadData(this, region);
+}
+
 bool RasterCoverage::canUse(const IlwisObject *obj, bool strict) const
 {
     if ( Coverage::canUse(obj, strict))
@@ -844,6 +1027,7 @@ void RasterCoverage::size(const Size<> &sz)
     if (sz.xsize() > 0 && sz.ysize() > 0) {
         changed(true);
         _size = sz;
+        gridRef()->storageType(gridStorageType(datadef()));
         gridRef()->prepare(this->id(), sz);
         if (_georef.isValid())
             _georef->size(sz);
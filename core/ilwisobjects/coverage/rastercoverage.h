@@ -23,6 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #include "coverage.h"
 #include "georeference.h"
 #include "grid.h"
+#include "rasterexpression.h"
 
 namespace Ilwis {
 
@@ -34,6 +35,7 @@ class Resource;
 class Grid;
 class PixelIterator;
 class SubFeatureDefinition;
+class RasterPyramid;
 
 typedef SubFeatureDefinition RasterStackDefinition;
 /*!
@@ -59,6 +61,7 @@ public:
     friend class GridBlock;
     friend class Grid;
     friend class RasterInterpolator;
+    friend class RasterPyramid;
 
     /*!
      * The constructor for an empty RasterCoverage
@@ -145,6 +148,34 @@ public:
      */
     void size(const Size<>& sz);
 
+    /*!
+     * \brief tileSize lets the grid of this RasterCoverage hold its values in tiles of sz pixels instead of full width strips; a null size selects strips again.<br>
+     * The grid is prepared again, so the values of the raster are discarded.
+     *
+     * \param sz the size of a tile
+     */
+    void tileSize(const Size<>& sz);
+    /*!
+     * \brief tileSize the size of the blocks of the grid; for full width strips the width of the raster and the lines of a strip
+     */
+    Size<> tileSize() const;
+
+    /*!
+     * \brief interleaved lets the grid of this RasterCoverage keep the values of all bands of a pixel next to each other. This suits operations that run through
+     * the bands of every pixel, e.g. statistics over a time series. Values that are already in the grid are converted to the new layout; iterators on the raster must be
+     * created after this call.
+     *
+     * \param yes true for a band interleaved grid, false for a grid with blocks per band (the default)
+     */
+    void interleaved(bool yes);
+    bool isInterleaved() const;
+
+    /*!
+     * \brief expression makes this a deferred raster; its blocks are computed by the expression when they are first read instead of being loaded by the connector
+     */
+    void expression(const SPRasterExpression& expr);
+    SPRasterExpression expression() const;
+
     /*!
      * \brief copyBinary Copies the binary data of this RasterCoverage
      *
@@ -222,8 +253,26 @@ public:
     UPGrid& gridRef();
     const UPGrid &grid() const;
     void getData(quint32 blockIndex);
+    /*!
+     * \brief loadData loads the binary data of the raster. With a "boundingbox" (pixels) or an "envelope" (coordinates) option only the blocks that
+     * intersect that region are read from the source, also when other blocks have been loaded already; the other blocks are loaded when they are first used
+     */
+    bool loadData(const IOOptions& options = IOOptions()) override;
     void setPseudoUndef(PIXVALUETYPE v);
 
+    /*!
+     * \brief overview a decimated version of this raster, e.g. for drawing at a small scale or for estimating statistics; it is made when it is first requested
+     * \param level the overview has 1/2^level of the size of this raster in x and y; level 0 is this raster itself
+     * \return an invalid raster if the level is larger than overviewLevels()
+     * \sa RasterPyramid
+     */
+    IlwisData<RasterCoverage> overview(quint32 level);
+    quint32 overviewLevels() const;
+    /*!
+     * \brief changed also drops the overviews if the raster has changed; a writer of pixel values calls changed(true) when it is done
+     */
+    void changed(bool yesno) override;
+
     bool canUse(const IlwisObject *obj, bool strict=false) const ;
     bool histogramCalculated(const QString& attribute=PIXELVALUE, int mode=NumericStatistics::pQUICKHISTOGRAM, int bins=0) const;
     ITable histogramAsTable(const QString& attribute) ;
@@ -247,15 +296,21 @@ private:
     RasterStackDefinition _bandDefinition;
     IGeoReference _georef;
     Size<> _size;
+    Size<> _tileSize; // tile size of the grid; null for full width strips
+    bool _interleaved = false; // the grid keeps all bands of a pixel together
+    SPRasterExpression _expression; // computes the blocks of a deferred raster
     ITable _attributeTable;
     QString _primaryKey = "coverage_key";
     std::map<Raw, int> _recordLookup; // lookup table for converting a raw value to a record in the attribute table
+    std::recursive_mutex _loadMutex; // most connectors are not reentrant; their blocks are loaded one at a time (see ConnectorInterface::isReentrant)
+    std::unique_ptr<RasterPyramid> _pyramid;
 
     bool bandPrivate(quint32 bandIndex,  PixelIterator inputIter) ;
     PixelIterator bandPrivate(quint32 index, const Ilwis::BoundingBox &box=BoundingBox());
 	bool loadHistograms(const QString& attribute, int mode, int bins=0);
 	void storeHistograms(const QString& attribute, int mode) ;
 	void calculateHistogram(const QString& attribute, const PixelIterator& begin, const PixelIterator& end, int mode, int bins);
+	void calculateHistogram(const QString& attribute, int mode, int bins); // all pixels, in parallel
 	void storeDataDef(const NumericStatistics& bins, QJsonObject& stats, int mode) const;
 	bool loadBand(const QString& attribute, const std::map < QString, int>& mp, QJsonObject& jband, int mode, int reqBins=0);
 };
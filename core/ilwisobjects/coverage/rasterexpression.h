@@ -0,0 +1,50 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+
+#ifndef RASTEREXPRESSION_H
+#define RASTEREXPRESSION_H
+
+#include <memory>
+
+namespace Ilwis {
+
+class RasterCoverage;
+
+/*!
+ * \brief The RasterExpression class the deferred content of a raster that is a pixel wise function of other rasters.
+ *
+ * A raster with an expression holds no data of its own until a block of it is read; the block is then computed from the inputs (see RasterCoverage::getData()).
+ * Pixel wise operations that consume such a raster can take over its expression instead of reading its data, so a chain of them is evaluated in one pass
+ * without materializing the intermediate rasters. The inputs are read when a block is computed; an input must not be changed while rasters depend on it.
+ */
+class KERNELSHARED_EXPORT RasterExpression
+{
+public:
+    virtual ~RasterExpression() {}
+
+    /*!
+     * \brief computeBlock computes a block of the raster and hands it to the grid through setBlockData()
+     * \param block the block, numbered band by band as with Grid::blockBox()
+     * \return false if the block could not be computed
+     */
+    virtual bool computeBlock(RasterCoverage *raster, quint32 block) = 0;
+};
+
+typedef std::shared_ptr<RasterExpression> SPRasterExpression;
+}
+
+#endif // RASTEREXPRESSION_H
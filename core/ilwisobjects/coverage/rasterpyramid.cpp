@@ -0,0 +1,294 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#include <QDataStream>
+#include <QDir>
+#include "kernel.h"
+#include "ilwiscontext.h"
+#include "raster.h"
+#include "connectorinterface.h"
+#include "pixeliterator.h"
+#include "neighbourhoodwindow.h"
+#include "taskscheduler.h"
+#include "rasterpyramid.h"
+
+using namespace Ilwis;
+
+namespace {
+const quint32 OVERVIEWMAGIC = 0x4f565259; // "OVRY", marks an overview file
+const quint32 OVERVIEWVERSION = 1;
+const qint32 ROWSPERTASK = 16;
+
+double reduce(double v1, double v2, double v3, double v4, RasterPyramid::Resampling method) {
+    double values[4] = { v1, v2, v3, v4 };
+    switch(method) {
+    case RasterPyramid::rsMEAN: {
+        double sum = 0;
+        int n = 0;
+        for(double v : values) {
+            if ( v != rUNDEF) {
+                sum += v;
+                ++n;
+            }
+        }
+        return n == 0 ? rUNDEF : sum / n;
+    }
+    case RasterPyramid::rsMODE: { // the most frequent item; on a tie the first in the order left-up, right-up, left-down, right-down
+        double result = rUNDEF;
+        int best = 0;
+        for(int i = 0; i < 4; ++i) {
+            if ( values[i] == rUNDEF)
+                continue;
+            int n = 0;
+            for(int j = i; j < 4; ++j)
+                n += values[j] == values[i] ? 1 : 0;
+            if ( n > best) {
+                best = n;
+                result = values[i];
+            }
+        }
+        return result;
+    }
+    default:
+        for(double v : values) {
+            if ( v != rUNDEF)
+                return v;
+        }
+        return rUNDEF;
+    }
+}
+}
+
+RasterPyramid::RasterPyramid(RasterCoverage *raster) : _raster(raster), _cleared(false)
+{
+}
+
+IlwisData<RasterCoverage> RasterPyramid::level(quint32 level)
+{
+    if ( level == 0)
+        return IRasterCoverage(_raster);
+    if ( level > levels())
+        return IRasterCoverage();
+
+    Locker<std::mutex> lock(_mutex);
+    if ( _cleared.exchange(false)) {
+        _levels.clear();
+        _stale = true;
+    }
+    while(_levels.size() < level) {
+        quint32 current = _levels.size() + 1;
+        IRasterCoverage overview = create(current);
+        if ( !overview.isValid())
+            return IRasterCoverage();
+        bool loaded = false;
+        {
+            Locker<> loadLock(_raster->_loadMutex);
+            if ( !_stale && !_raster->connector().isNull())
+                loaded = _raster->connector()->loadOverview(_raster, current, overview.ptr());
+        }
+        if ( !loaded && !load(current, overview)) {
+            IRasterCoverage source = current == 1 ? IRasterCoverage(_raster) : _levels.back();
+            if ( !decimate(source, overview, resampling(_raster->datadef())))
+                return IRasterCoverage();
+            store(current, overview);
+        }
+        _levels.push_back(overview);
+    }
+    return _levels[level - 1];
+}
+
+quint32 RasterPyramid::levels() const
+{
+    Size<> sz = _raster->size();
+    quint32 extent = std::max(sz.xsize(), sz.ysize());
+    quint32 n = 0;
+    while(extent > 1) {
+        extent = (extent + 1) / 2;
+        ++n;
+    }
+    return n;
+}
+
+void RasterPyramid::clear()
+{
+    _cleared = true;
+}
+
+RasterPyramid::Resampling RasterPyramid::resampling(const DataDefinition &def)
+{
+    if ( !def.isValid())
+        return rsNEAREST;
+    IlwisTypes tp = def.domain()->ilwisType();
+    if ( tp == itNUMERICDOMAIN)
+        return rsMEAN;
+    if ( hasType(tp, itITEMDOMAIN))
+        return rsMODE;
+    return rsNEAREST; // e.g. colors, which can not be averaged as a number
+}
+
+bool RasterPyramid::decimate(const IlwisData<RasterCoverage> &source, IlwisData<RasterCoverage> &target, Resampling method)
+{
+    Size<> sz = target->size();
+    qint32 blocksPerBand = (sz.ysize() + ROWSPERTASK - 1) / ROWSPERTASK;
+    int threads = taskscheduler()->threadCount();
+    bool nested = TaskScheduler::currentThreadIndex() != 0; // reached from a task (e.g. statistics); the caches of the grids are those of the operation that runs it
+    if (!nested) {
+        source->gridRef()->prepare4Operation(threads);
+        target->gridRef()->prepare4Operation(threads);
+    }
+    bool ok = taskscheduler()->run(blocksPerBand * sz.zsize(), [&](quint32 task, int threadIndex)->bool{
+        qint32 z = task / blocksPerBand;
+        qint32 ystart = (task % blocksPerBand) * ROWSPERTASK;
+        qint32 yend = std::min((qint32)sz.ysize(), ystart + ROWSPERTASK) - 1;
+        // the source rows are read over twice the width of the overview; an odd last column or row falls outside the source and is undefined
+        RasterRows rows(source, 0, 2 * sz.xsize() - 1, 2, RasterRows::epUNDEF, threadIndex);
+        rows.band(z);
+        PixelIterator iter(target, threadIndex, BoundingBox(Pixel(0, ystart, z), Pixel(sz.xsize() - 1, yend, z)));
+        for(qint32 y = ystart; y <= yend; ++y) {
+            const double *upper = rows.row(2 * y);
+            const double *lower = rows.row(2 * y + 1);
+            qint32 x = 0;
+            while(x < (qint32)sz.xsize()) {
+                PixelSpan span = iter.span();
+                if ( span._length == 0)
+                    return false;
+                qint32 n = std::min(span._length, (qint32)sz.xsize() - x);
+                for(qint32 i = 0; i < n; ++i, ++x)
+                    span[i] = reduce(upper[2 * x], upper[2 * x + 1], lower[2 * x], lower[2 * x + 1], method);
+                iter += n;
+            }
+        }
+        return true;
+    });
+    if (!nested) {
+        source->gridRef()->unprepare4Operation();
+        target->gridRef()->unprepare4Operation();
+    }
+    return ok;
+}
+
+IlwisData<RasterCoverage> RasterPyramid::create(quint32 level) const
+{
+    IGeoReference georef = _raster->georeference();
+    if ( !georef.isValid())
+        return IRasterCoverage();
+    quint32 factor = 1 << level;
+    Size<> sz = _raster->size();
+    Size<> ovSize((sz.xsize() + factor - 1) / factor, (sz.ysize() + factor - 1) / factor, sz.zsize());
+
+    // the envelope covers the whole pixels of the overview, so its pixels are exactly factor times as large as those of the raster
+    Envelope env = georef->pixel2Coord(BoundingBox(Size<>(ovSize.xsize() * factor, ovSize.ysize() * factor, 1)));
+    QString name = QString("%1_overview%2").arg(_raster->id()).arg(level);
+    Resource resource(QUrl("ilwis://internalcatalog/georeference_" + name), itGEOREF);
+    resource.addProperty("size", IVARIANT(Size<>(ovSize.xsize(), ovSize.ysize(), 1)));
+    resource.addProperty("envelope", IVARIANT(env));
+    CoordinateSystem::addCsyProperty(_raster->coordinateSystem(), resource);
+    resource.addProperty("name", "georeference_" + name);
+    resource.addProperty("centerofpixel", georef->centerOfPixel());
+    IGeoReference grf;
+    if ( !grf.prepare(resource))
+        return IRasterCoverage();
+
+    IRasterCoverage overview;
+    overview.prepare();
+    overview->name(_raster->name() + "_overview" + QString::number(level));
+    overview->coordinateSystem(_raster->coordinateSystem());
+    overview->georeference(grf);
+    overview->datadefRef() = _raster->datadef();
+    overview->size(ovSize);
+    for(quint32 z = 0; z < ovSize.zsize(); ++z)
+        overview->datadefRef(z) = _raster->datadef(z);
+
+    return overview;
+}
+
+QString RasterPyramid::sidecar(quint32 level, QString &dataFile) const
+{
+    // the overviews are kept next to the histograms of the raster; see RasterCoverage::storeHistograms
+    QString path = _raster->resource().container(true).toLocalFile();
+    QFileInfo inf(path);
+    if ( path == "" || !inf.exists())
+        return sUNDEF;
+    QString name = _raster->resource().name();
+    QString dataName = name;
+    if ( inf.isFile()) {
+        dataFile = path;
+        int idx = path.lastIndexOf("/");
+        dataName = path.mid(idx + 1);
+        path = path.left(idx);
+        if ( dataName != name) // a band or a raster in a multi raster file
+            dataName += "_" + name;
+    }else
+        dataFile = _raster->resource().url(true).toLocalFile();
+    if ( !QFileInfo(dataFile).exists())
+        return sUNDEF;
+
+    return path + "/.ilwis/" + dataName + ".ovr" + QString::number(level);
+}
+
+bool RasterPyramid::load(quint32 level, IlwisData<RasterCoverage> &overview) const
+{
+    QString dataFile;
+    QString name = sidecar(level, dataFile);
+    if ( _stale || name == sUNDEF)
+        return false;
+    QFile file(name);
+    if ( !file.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream stream(&file);
+    quint32 magic, version;
+    QString lastModified;
+    quint32 xsize, ysize, zsize;
+    stream >> magic >> version >> lastModified >> xsize >> ysize >> zsize;
+    Size<> sz = overview->size();
+    if ( magic != OVERVIEWMAGIC || version != OVERVIEWVERSION || lastModified != QFileInfo(dataFile).lastModified().toString() ||
+         xsize != sz.xsize() || ysize != sz.ysize() || zsize != sz.zsize())
+        return false;
+
+    PixelIterator iter(overview);
+    for(PixelSpan span = iter.span(); span._length > 0; iter += span._length, span = iter.span()) {
+        for(qint32 i = 0; i < span._length; ++i) {
+            double v;
+            stream >> v;
+            span[i] = v;
+        }
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+void RasterPyramid::store(quint32 level, const IlwisData<RasterCoverage> &overview) const
+{
+    QString dataFile;
+    QString name = sidecar(level, dataFile);
+    if ( _stale || name == sUNDEF || !ilwisconfig("system-settings/persist-overviews", true))
+        return;
+    QString path = QFileInfo(name).absolutePath();
+    if ( !QDir(path).exists()) {
+        if ( !QDir(QFileInfo(path).absolutePath()).mkdir(".ilwis"))
+            return;
+    }
+    QFile file(name);
+    if ( !file.open(QIODevice::WriteOnly))
+        return;
+    QDataStream stream(&file);
+    Size<> sz = overview->size();
+    stream << OVERVIEWMAGIC << OVERVIEWVERSION << QFileInfo(dataFile).lastModified().toString() << sz.xsize() << sz.ysize() << sz.zsize();
+    PixelIterator iter(overview);
+    for(PixelSpan span = iter.span(); span._length > 0; iter += span._length, span = iter.span()) {
+        for(qint32 i = 0; i < span._length; ++i)
+            stream << (double)span[i];
+    }
+}
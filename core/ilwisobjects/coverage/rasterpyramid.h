@@ -0,0 +1,75 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#ifndef RASTERPYRAMID_H
+#define RASTERPYRAMID_H
+
+#include <mutex>
+#include <atomic>
+
+namespace Ilwis {
+
+/*!
+ * \brief The RasterPyramid class the overviews of a raster: decimated versions of it, each level half the width and height of the previous one
+ *
+ * A level is made when it is first requested. It is read from the source of the raster if that provides it (e.g. the overviews of a GeoTIFF), else from a copy
+ * kept in the .ilwis folder next to the data file of the raster (as long as the data file has not changed since), else it is built from the previous level.
+ * A built level is kept in the .ilwis folder for the next session. The resampling depends on the domain: numeric values are averaged, items take the most
+ * frequent value of the four pixels and colors the left-up pixel. Undefined pixels do not take part; a pixel of which all four sources are undefined is undefined.
+ */
+class KERNELSHARED_EXPORT RasterPyramid
+{
+public:
+    enum Resampling{ rsNEAREST, rsMEAN, rsMODE };
+
+    RasterPyramid(RasterCoverage *raster);
+
+    /*!
+     * \brief level the raster of a level; level 0 is the raster itself
+     * \return an invalid raster if the level is larger than levels()
+     */
+    IlwisData<RasterCoverage> level(quint32 level);
+    /*!
+     * \brief levels the number of levels below the raster itself; the last one has a size of one pixel in its largest direction
+     */
+    quint32 levels() const;
+    /*!
+     * \brief clear drops the levels, e.g. when the values of the raster have changed; neither the copies in the .ilwis folder nor the overviews of the source
+     * are used again. The levels are dropped at the next request, so clear() doesn't wait for a level that is being built
+     */
+    void clear();
+
+    static Resampling resampling(const DataDefinition& def);
+    /*!
+     * \brief decimate fills target with source reduced by a factor two in both directions
+     */
+    static bool decimate(const IlwisData<RasterCoverage>& source, IlwisData<RasterCoverage>& target, Resampling method);
+
+private:
+    RasterCoverage *_raster;
+    std::vector<IlwisData<RasterCoverage>> _levels; // _levels[0] is level 1
+    std::mutex _mutex;
+    bool _stale = false; // the copies in the .ilwis folder and the overviews of the source don't reflect the values of the raster anymore
+    std::atomic<bool> _cleared;
+
+    IlwisData<RasterCoverage> create(quint32 level) const;
+    QString sidecar(quint32 level, QString& dataFile) const;
+    bool load(quint32 level, IlwisData<RasterCoverage>& overview) const;
+    void store(quint32 level, const IlwisData<RasterCoverage>& overview) const;
+};
+}
+
+#endif // RASTERPYRAMID_H
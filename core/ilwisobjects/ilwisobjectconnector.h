@@ -18,6 +18,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #define ILWISOBJECTCONNECTOR_H
 
 #include <QBuffer>
+#include <atomic>
 #include "kernel_global.h"
 #include "kernel.h"
 #include "connectorinterface.h"
@@ -73,7 +74,7 @@ protected:
     }
 
     Resource _resource;
-    bool _binaryIsLoaded;
+    std::atomic<bool> _binaryIsLoaded; // set by the threads that load blocks in parallel
     std::recursive_mutex _mutex;
     IlwisObject::ConnectorMode _mode = IlwisObject::cmINPUT;
 
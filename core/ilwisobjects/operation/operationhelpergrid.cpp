@@ -174,23 +174,22 @@ void OperationHelperRaster::subdivideTasks(int cores,const IRasterCoverage& rast
 		return;
     }
 
-	int nBlocks = raster->gridRef()->blocksPerBand();
-    int blockYSize = std::min(raster->gridRef()->maxLines(), (int)raster->size().ysize()-1);
-	double f = (double)nBlocks / cores;
-	int coreBlocks = std::ceil(f);
-	if (coreBlocks == 0)
-		cores = 1;
-
-	boxes.clear();
-	boxes.resize(cores);
-
-	int lastY = 0;
-	for (int i = 0; i < cores - 1; ++i) {
-		boxes[i] = BoundingBox( Pixel( 0, lastY ), Pixel( raster->size().xsize()-1, lastY + blockYSize * coreBlocks -1 ) );
-		lastY += blockYSize * coreBlocks;
-	}
-	boxes[cores - 1] = BoundingBox(Pixel(0, lastY ), Pixel( raster->size().xsize()-1, raster->size().ysize() - 1 ) );
-
+    boxes.clear();
+    int xsize = raster->size().xsize();
+    int ysize = raster->size().ysize();
+    int zmax = std::max(1, (int)raster->size().zsize()) - 1;
+	int nBlocks = raster->gridRef()->blocksPerBand() / std::max((quint32)1, raster->gridRef()->blocksPerRow()); // rows of blocks
+    int blockYSize = std::max(1, raster->gridRef()->maxLines());
+    // more tasks than threads; a thread that is done with its own boxes takes over boxes of the others
+    int nTasks = std::max(1, std::min(cores * 4, ysize));
+    int linesPerTask = (ysize + nTasks - 1) / nTasks;
+    if ( nBlocks >= nTasks) // tasks at block boundaries, a block is then used by one thread only
+        linesPerTask = ((linesPerTask + blockYSize - 1) / blockYSize) * blockYSize;
+
+    for(int y = 0; y < ysize; y += linesPerTask) {
+        int lastY = std::min(y + linesPerTask, ysize) - 1;
+        boxes.push_back(BoundingBox(Pixel(0, y, 0), Pixel(xsize - 1, lastY, zmax)));
+    }
 }
 
 IRasterCoverage OperationHelperRaster::resample(const IRasterCoverage& sourceRaster, const IGeoReference& targetGrf) {
@@ -17,6 +17,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #ifndef OPERATIONHELPERRASTER_H
 #define OPERATIONHELPERRASTER_H
 
+#include "taskscheduler.h"
+#include "outputstatistics.h"
+
 namespace Ilwis {
 
 typedef  std::function<bool(const BoundingBox&, int threadIdx)> BoxedAsyncFunc;
@@ -33,84 +36,82 @@ public:
 	static bool addCsyFromInput(const Coverage* cov, Resource& res);
 	static bool addGrfFromInput(const RasterCoverage* cov, Resource& resource);
 
-    template<typename T> static bool execute(ExecutionContext* ctx, T func, const std::vector<IRasterCoverage>& rasters) {
+    /*!
+     * \brief execute runs func for the boxes of the output raster (the last raster) on the task scheduler. For a numeric output the ranges of the bands
+     * and of the raster are set from the values the tasks have written, see OutputStatistics. A func that takes an OutputStatistics::Written as third
+     * parameter counts the values in its write loop; otherwise they are read back from its box
+     * \param statistics optional; receives the collected values, e.g. to see whether all values are integers
+     */
+    template<typename T> static bool execute(ExecutionContext* ctx, T func, const std::vector<IRasterCoverage>& rasters, OutputStatistics *statistics = 0) {
         std::vector<BoundingBox> boxes;
 
 		auto outputRaster = rasters.back(); // last entry is always the output raster and determines the core use.
 		if (!outputRaster.isValid())
 			return false;
-		int cores = 1;
-        ctx->_threaded = false;
+		int threads = 1;
 		if (ctx->_threaded) {
-			cores = QThread::idealThreadCount();
-			int prefCount = outputRaster->grid()->blocks() / 2 + 1;
-			if (prefCount < cores) {
-				cores = prefCount;
-			}
-
-
+			threads = taskscheduler()->threadCount();
+			OperationHelperRaster::subdivideTasks(threads, outputRaster, boxes);
+		}
+		if (threads <= 1 || boxes.size() <= 1 || TaskScheduler::currentThreadIndex() != 0) { // an operation within a task runs inline on its worker
+			threads = 1;
+			boxes = { BoundingBox(outputRaster->size()) };
+		}
+		auto prepare = [&](bool start) {
+			if (threads == 1)
+				return;
 			for (auto raster : rasters) {
 				if (raster.isValid()) {
-					OperationHelperRaster::subdivideTasks(cores, raster, boxes);
-					raster->gridRef()->prepare4Operation(cores);
+					if (start)
+						raster->gridRef()->prepare4Operation(threads);
+					else
+						raster->gridRef()->unprepare4Operation();
 				}
 			}
-		}
-		else {
-			boxes.push_back(BoundingBox(outputRaster->size()));
-		}
-
-       // std::vector<std::future<bool>> futures(cores);
-        bool res = true;
-        res = func(boxes[0],0);
-
-        //2022-02-06 : for the moment disabled. for unknown reasons the std::async(std::launch::async, func, boxes[i],cores > 1 ? i + 1 : 0) statement crashes for all operations without every arriving at the function call.
-        // At this moment I can not find any reason for this as nothing has changed in this respect. What the call std::async() is doing is quite complex with regards to moves and copies etc... so I suspect a compiler bug
-        // as I have seen those before with regard to temporary objects being copied/moved but why now? Will investigate later
-
-       // for(int i =0; i < cores; ++i) {
-       //     futures[i] = std::async(std::launch::async, func, boxes[i],cores > 1 ? i + 1 : 0); // threadindex starts at 1 as the 0 is the default ( no threads). In the grid administration, the cache at index 0 is the standard cache used in the non threading case.
-       // }
+		};
 
-      //  for(int i =0; i < cores; ++i) {
-       //     res &= futures[i].get();
-      //  }
-		for (auto raster : rasters)
-			raster->gridRef()->unprepare4Operation();
+        OutputStatistics localStatistics;
+        OutputStatistics& collected = statistics ? *statistics : localStatistics;
+        bool numeric = hasType(outputRaster->datadef().domain<>()->valueType(), itNUMBER);
+        if ( numeric)
+            collected.prepare((quint32)boxes.size(), outputRaster->size().zsize());
 
-        double minv=1e307,maxv = -1e307;
-        double minBand = minv, maxBand = maxv;
-        quint32 bandIx = 0;
-        if ( res && outputRaster.isValid()) {
-            if ( outputRaster->datadef().domain<>()->valueType() & itNUMBER) {
-                PixelIterator iter(outputRaster);
-                auto end = iter.end();
-                while(iter != end){
-                    double v = *iter;
-                    minv = Ilwis::min(v,minv);
-                    maxv = Ilwis::max(v,maxv);
-                    minBand = Ilwis::min(v,minBand);
-                    maxBand = Ilwis::max(v,maxBand);
-                    ++iter;
-                    if ( iter.zchanged()){
-                        outputRaster->datadefRef(bandIx).range<NumericRange>()->max(maxBand);
-                        outputRaster->datadefRef(bandIx).range<NumericRange>()->min(minBand);
-                        minBand = 1e307;
-                        maxBand = -1e307;
-                        ++bandIx;
-                    }
-                }
-                double resolution = outputRaster->datadefRef().range<NumericRange>()->resolution();
-                NumericRange *rng = new NumericRange(minv, maxv, resolution);
-                for(int i=0; i < outputRaster->size().zsize(); ++i){
-                    outputRaster->datadefRef(i).range<NumericRange>()->resolution(resolution)    ;
+        prepare(true);
+        bool res = true;
+        try {
+            // every box is a task; the thread index (0 when not threaded) selects the block cache of the worker thread in the grids
+            res = taskscheduler()->run((quint32)boxes.size(), [&](quint32 task, int threadIdx) {
+                OutputStatistics::Written written(outputRaster->size().zsize());
+                if (!runTask(func, boxes[task], threadIdx, written, 0))
+                    return false;
+                if ( numeric) {
+                    if ( written.counted())
+                        collected.add(task, written);
+                    else // the box is read right after it was written, while its blocks are still in the cache of the thread
+                        collected.collect(task, outputRaster, boxes[task], threadIdx);
                 }
-                outputRaster->datadefRef().range(rng);
-            }
+                return true;
+            }, threads);
+        } catch(...) {
+            prepare(false);
+            throw;
         }
+        prepare(false);
+
+        if ( res && numeric)
+            collected.setRanges(outputRaster);
         return res;
     }
     static IIlwisObject initialize(const IIlwisObject &inputObject, IlwisTypes tp, quint64 what);
+
+private:
+    template<typename T> static auto runTask(T& func, const BoundingBox& box, int threadIdx, OutputStatistics::Written& written, int) -> decltype(func(box, threadIdx, written)) {
+        written.counting();
+        return func(box, threadIdx, written);
+    }
+    template<typename T> static bool runTask(T& func, const BoundingBox& box, int threadIdx, OutputStatistics::Written&, long) {
+        return func(box, threadIdx);
+    }
 };
 }
 
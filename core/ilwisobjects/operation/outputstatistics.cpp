@@ -0,0 +1,99 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#include "kernel.h"
+#include "ilwisdata.h"
+#include "datadefinition.h"
+#include "columndefinition.h"
+#include "raster.h"
+#include "pixeliterator.h"
+#include "outputstatistics.h"
+
+using namespace Ilwis;
+
+void OutputStatistics::Values::merge(const Values &other)
+{
+    _min = std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+    _count += other._count;
+    _undefs += other._undefs;
+    _integer = _integer && other._integer;
+}
+
+OutputStatistics::OutputStatistics()
+{
+}
+
+void OutputStatistics::prepare(quint32 parts, quint32 bands)
+{
+    _bands = std::max((quint32)1, bands);
+    _values.assign(parts * _bands, Values());
+}
+
+void OutputStatistics::collect(quint32 part, const IRasterCoverage &raster, const BoundingBox &box, int threadIndex)
+{
+    std::vector<Values> local(_bands);
+    PixelIterator iter(raster, threadIndex, box);
+    for(PixelSpan sp = iter.span(); sp._length > 0; iter += sp._length, sp = iter.span()) {
+        Values& values = local[std::min((quint32)sp._position.z, _bands - 1)];
+        for(qint32 i = 0; i < sp._length; ++i)
+            values.add(sp[i]);
+    }
+    for(quint32 z = 0; z < _bands; ++z)
+        _values[part * _bands + z].merge(local[z]);
+}
+
+void OutputStatistics::add(quint32 part, quint32 band, const Values &values)
+{
+    _values[part * _bands + std::min(band, _bands - 1)].merge(values);
+}
+
+void OutputStatistics::add(quint32 part, const Written &written)
+{
+    for(quint32 z = 0; z < written.bands(); ++z)
+        add(part, z, written.band(z));
+}
+
+OutputStatistics::Values OutputStatistics::band(quint32 z) const
+{
+    Values result;
+    for(quint32 i = z; i < _values.size(); i += _bands)
+        result.merge(_values[i]);
+    return result;
+}
+
+OutputStatistics::Values OutputStatistics::total() const
+{
+    Values result;
+    for(const Values& values : _values)
+        result.merge(values);
+    return result;
+}
+
+void OutputStatistics::setRanges(IRasterCoverage &raster, double resolution) const
+{
+    if ( resolution == rUNDEF)
+        resolution = raster->datadefRef().range<NumericRange>()->resolution();
+    for(quint32 z = 0; z < raster->size().zsize() && z < _bands; ++z) {
+        Values values = band(z);
+        auto range = raster->datadefRef(z).range<NumericRange>();
+        range->max(values.max());
+        range->min(values.min());
+        range->resolution(resolution);
+    }
+    Values values = total();
+    raster->datadefRef().range(new NumericRange(values.min(), values.max(), resolution));
+}
@@ -0,0 +1,109 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#ifndef OUTPUTSTATISTICS_H
+#define OUTPUTSTATISTICS_H
+
+#include <limits>
+#include <cmath>
+
+namespace Ilwis {
+
+/*!
+ * \brief The OutputStatistics class collects the value ranges of the bands of an output raster while an operation writes it
+ *
+ * Every task (box) of the operation has its own part. A task counts the values in its write loop (see Written) and they are added to its part when the
+ * task is done; for a task that does not count them, collect() reads its box back from the block cache of its thread. The parts are combined in task order,
+ * so the result does not depend on the number of threads. setRanges() sets the ranges of the bands and of the raster.
+ */
+class KERNELSHARED_EXPORT OutputStatistics
+{
+public:
+    struct Values {
+        void add(PIXVALUETYPE v) {
+            if ( v == PIXVALUEUNDEF || !std::isfinite(v)) { // NaN and infinity have no place in a range
+                ++_undefs;
+                return;
+            }
+            ++_count;
+            if ( v < _min)
+                _min = v;
+            if ( v > _max)
+                _max = v;
+            if ( _integer && std::floor(v) != v)
+                _integer = false;
+        }
+        void merge(const Values& other);
+        double min() const { return _count == 0 ? rUNDEF : _min; }
+        double max() const { return _count == 0 ? rUNDEF : _max; }
+
+        double _min = std::numeric_limits<double>::max();
+        double _max = -std::numeric_limits<double>::max();
+        quint64 _count = 0; // defined values
+        quint64 _undefs = 0;
+        bool _integer = true;
+    };
+
+    /*!
+     * \brief The Written class the values a task has written, per band
+     */
+    class Written {
+    public:
+        Written(quint32 bands = 1) : _bands(std::max((quint32)1, bands)) {}
+        void add(qint32 z, PIXVALUETYPE v) {
+            _bands[std::min((quint32)z, (quint32)_bands.size() - 1)].add(v);
+        }
+        const Values& band(quint32 z) const { return _bands[z]; }
+        quint32 bands() const { return (quint32)_bands.size(); }
+        void counting() { _counted = true; }
+        /*!
+         * \brief counted true if the task counts its values; false if they must be read back from its box
+         */
+        bool counted() const { return _counted; }
+
+    private:
+        std::vector<Values> _bands;
+        bool _counted = false;
+    };
+
+    OutputStatistics();
+
+    void prepare(quint32 parts, quint32 bands);
+    /*!
+     * \brief collect adds the values of a box of the raster to a part
+     * \param threadIndex the thread index of the task that wrote the box; selects the block cache the values are read from
+     */
+    void collect(quint32 part, const IRasterCoverage& raster, const BoundingBox& box, int threadIndex);
+    /*!
+     * \brief add adds values that were counted elsewhere, e.g. while they were computed, to a band of a part
+     */
+    void add(quint32 part, quint32 band, const Values& values);
+    void add(quint32 part, const Written& written);
+    Values band(quint32 z) const;
+    Values total() const;
+    /*!
+     * \brief setRanges sets the numeric ranges of the bands and of the raster from the collected values
+     * \param resolution resolution of the ranges; rUNDEF keeps the resolution of the range of the raster
+     */
+    void setRanges(IRasterCoverage& raster, double resolution = rUNDEF) const;
+
+private:
+    quint32 _bands = 0;
+    std::vector<Values> _values; // part * _bands + band
+};
+}
+
+#endif // OUTPUTSTATISTICS_H
@@ -18,10 +18,97 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #include "raster.h"
 #include "pixeliterator.h"
 #include "blockiterator.h"
+#include "neighbourhoodwindow.h"
+#include "outputstatistics.h"
 #include "rasterfilter.h"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FILTER_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FILTER_SSE2
+#endif
+
 using namespace Ilwis;
 
+namespace {
+// result[i] += factor * values[i] for n values; the multiply-accumulate of all filter taps
+void accumulate(double *result, const double *values, double factor, quint32 n) {
+    quint32 i = 0;
+#if defined(FILTER_AVX)
+    __m256d f = _mm256_set1_pd(factor);
+    for(; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(result + i, _mm256_add_pd(_mm256_loadu_pd(result + i), _mm256_mul_pd(f, _mm256_loadu_pd(values + i))));
+#elif defined(FILTER_SSE2)
+    __m128d f = _mm_set1_pd(factor);
+    for(; i + 2 <= n; i += 2)
+        _mm_storeu_pd(result + i, _mm_add_pd(_mm_loadu_pd(result + i), _mm_mul_pd(f, _mm_loadu_pd(values + i))));
+#endif
+    for(; i < n; ++i)
+        result[i] += factor * values[i];
+}
+
+// a row of the input of a linear filter
+struct FilterRow {
+    qint32 _row = iUNDEF; // the (unclamped) row of the raster held by this buffer
+    std::vector<double> _values; // undefined values are replaced by 0
+    std::vector<double> _horizontal; // separable filter: the row filtered horizontally
+    std::vector<quint32> _undefs; // per pixel of the box: the number of undefined values under the filter in this row
+
+    void read(RasterRows& rows, qint32 row, quint32 columns) {
+        const double *values = rows.row(row);
+        std::copy(values, values + _values.size(), _values.begin());
+        std::vector<quint32> undefs(_values.size());
+        for(quint32 i = 0; i < _values.size(); ++i) {
+            undefs[i] = _values[i] == rUNDEF ? 1 : 0;
+            if ( undefs[i])
+                _values[i] = 0;
+        }
+        // sliding count of the undefined values under the filter
+        quint32 count = 0;
+        for(quint32 i = 0; i < columns; ++i)
+            count += undefs[i];
+        for(quint32 x = 0; x < _undefs.size(); ++x) {
+            _undefs[x] = count;
+            if ( x + columns < undefs.size())
+                count = count + undefs[x + columns] - undefs[x];
+        }
+        _row = row;
+    }
+};
+
+// counts per bin (a Fenwick tree); adding and removing a value and selecting the k-th smallest value take O(log bins)
+class RankHistogram {
+public:
+    void reset(quint32 bins) {
+        _counts.assign(bins + 1, 0);
+        _top = 1;
+        while(_top * 2 <= bins)
+            _top *= 2;
+    }
+    void add(quint32 bin, qint32 count) {
+        for(quint32 i = bin + 1; i < _counts.size(); i += i & (~i + 1))
+            _counts[i] += count;
+    }
+    // the bin of the k-th (0 based) smallest value
+    quint32 select(qint32 k) const {
+        quint32 pos = 0;
+        for(quint32 step = _top; step > 0; step >>= 1) {
+            if ( pos + step < _counts.size() && _counts[pos + step] <= k) {
+                pos += step;
+                k -= _counts[pos];
+            }
+        }
+        return pos;
+    }
+
+private:
+    std::vector<qint32> _counts;
+    quint32 _top = 1;
+};
+}
+
 RasterFilter::RasterFilter() : _valid(false)
 {
 }
@@ -34,12 +121,13 @@ bool RasterFilter::isValid() const
 //-------------------------------------
 LinearGridFilter::LinearGridFilter(const QString &name)
 {
-    definition(name);
+    if ( definition(name))
+        separate();
 }
 
 bool LinearGridFilter::fillDef(int xsize, int ysize, const QStringList& numbers){
-    _rows = xsize;
-    _columns = ysize;
+    _columns = xsize;
+    _rows = ysize;
     int index = 0;
     double sum = 0;
     _filterdef.resize( ysize);
@@ -148,11 +236,114 @@ double LinearGridFilter::applyTo(const GridBlock& block)
     return v;
 }
 
+void LinearGridFilter::applyTo(const IRasterCoverage &input, const IRasterCoverage &output, const BoundingBox &box, int threadIndex, OutputStatistics::Written *written) const
+{
+    qint32 dy = _rows / 2;
+    quint32 width = box.xlength();
+    bool separable = isSeparable();
+    std::vector<FilterRow> ring(_rows);
+    for(FilterRow& buffer : ring) {
+        buffer._values.resize(width + _columns - 1);
+        buffer._undefs.resize(width);
+        if ( separable)
+            buffer._horizontal.resize(width);
+    }
+    std::vector<double> result(width);
+    std::vector<quint32> undefs(width);
+    const Pixel& pmin = box.min_corner();
+    const Pixel& pmax = box.max_corner();
+    RasterRows rows(input, pmin.x - (qint32)_columns / 2, pmax.x + (qint32)_columns / 2, 1, RasterRows::epCLAMP, threadIndex); // the ring of FilterRows keeps the rows
+    for(qint32 z = pmin.z; z <= pmax.z; ++z) {
+        rows.band(z);
+        for(FilterRow& buffer : ring)
+            buffer._row = iUNDEF;
+        for(qint32 y = pmin.y; y <= pmax.y; ++y) {
+            std::fill(result.begin(), result.end(), 0);
+            std::fill(undefs.begin(), undefs.end(), 0);
+            for(qint32 r = 0; r < (qint32)_rows; ++r) {
+                qint32 row = y - dy + r;
+                // a row stays in the ring while the filter slides down over it, so it is read only once
+                FilterRow& buffer = ring[(row % (qint32)_rows + _rows) % _rows];
+                if ( buffer._row != row) {
+                    buffer.read(rows, row, _columns);
+                    if ( separable) {
+                        std::fill(buffer._horizontal.begin(), buffer._horizontal.end(), 0);
+                        for(quint32 c = 0; c < _columns; ++c)
+                            accumulate(buffer._horizontal.data(), buffer._values.data() + c, _rowKernel[c], width);
+                    }
+                }
+                if ( separable)
+                    accumulate(result.data(), buffer._horizontal.data(), _columnKernel[r], width);
+                else {
+                    for(quint32 c = 0; c < _columns; ++c)
+                        accumulate(result.data(), buffer._values.data() + c, _filterdef[r][c], width);
+                }
+                for(quint32 x = 0; x < width; ++x)
+                    undefs[x] += buffer._undefs[x];
+            }
+            PixelIterator iterOut(output, threadIndex, BoundingBox(Pixel(pmin.x, y, z), Pixel(pmax.x, y, z)));
+            quint32 x = 0;
+            PixelSpan span;
+            while((span = iterOut.span())._length > 0) {
+                for(qint32 i = 0; i < span._length; ++i, ++x)
+                    span[i] = undefs[x] == 0 ? result[x] * _gain : rUNDEF;
+                iterOut += span._length;
+            }
+            if ( written) {
+                for(quint32 i = 0; i < width; ++i)
+                    written->add(z, undefs[i] == 0 ? result[i] * _gain : rUNDEF);
+            }
+        }
+    }
+}
+
 QSize LinearGridFilter::size() const
 {
     return QSize(_columns, _rows);
 }
 
+bool LinearGridFilter::isSeparable() const
+{
+    return _rowKernel.size() > 0;
+}
+
+/*!
+ * \brief LinearGridFilter::separate splits the filter into a column and a row kernel if it is their product (rank one), e.g. the smoothing and gaussian filters
+ */
+void LinearGridFilter::separate()
+{
+    _rowKernel.clear();
+    _columnKernel.clear();
+    if ( _rows < 2 || _columns < 2 || _filterdef.size() != _rows)
+        return;
+    // the largest element is the pivot; its row is the row kernel and its column, relative to the pivot, the column kernel
+    quint32 pr = 0, pc = 0;
+    double largest = 0;
+    for(quint32 r = 0; r < _rows; ++r) {
+        for(quint32 c = 0; c < _columns; ++c) {
+            if ( std::abs(_filterdef[r][c]) > largest) {
+                largest = std::abs(_filterdef[r][c]);
+                pr = r;
+                pc = c;
+            }
+        }
+    }
+    if ( largest == 0)
+        return;
+    std::vector<double> rowKernel = _filterdef[pr];
+    std::vector<double> columnKernel(_rows);
+    for(quint32 r = 0; r < _rows; ++r)
+        columnKernel[r] = _filterdef[r][pc] / _filterdef[pr][pc];
+    for(quint32 r = 0; r < _rows; ++r) {
+        for(quint32 c = 0; c < _columns; ++c) {
+            if ( std::abs(columnKernel[r] * rowKernel[c] - _filterdef[r][c]) > EPS10 * largest)
+                return;
+        }
+    }
+    _rowKernel = rowKernel;
+    _columnKernel = columnKernel;
+}
+
 //-------------------------------------------------------------------
 RankOrderGridFilter::RankOrderGridFilter(const QString &name)
 {
@@ -184,6 +375,115 @@ double RankOrderGridFilter::applyTo(const GridBlock &block)
     return rUNDEF;
 }
 
+void RankOrderGridFilter::applyTo(const IRasterCoverage &input, const IRasterCoverage &output, const BoundingBox &box, int threadIndex, OutputStatistics::Written *written) const
+{
+    const qint32 CHUNKROWS = 256; // rows of the box that share their bins; bounds the memory of the binned input rows
+    const double MAXDIRECTBINS = 65536; // integers with a larger range are ranked, which bounds the size of the histogram by the number of distinct values
+    qint32 dy = _rows / 2;
+    quint32 width = box.xlength();
+    quint32 paddedWidth = width + _columns - 1;
+    std::vector<double> values;
+    std::vector<quint32> bins;
+    std::vector<double> binValues; // the value of every bin; bin 0 holds the undefined values, which rank lowest
+    std::vector<double> result(width);
+    RankHistogram histogram;
+    const Pixel& pmin = box.min_corner();
+    const Pixel& pmax = box.max_corner();
+    RasterRows inputRows(input, pmin.x - (qint32)_columns / 2, pmax.x + (qint32)_columns / 2, 1, RasterRows::epCLAMP, threadIndex); // every row is binned once
+    for(qint32 z = pmin.z; z <= pmax.z; ++z) {
+        inputRows.band(z);
+        for(qint32 top = pmin.y; top <= pmax.y; top += CHUNKROWS) {
+            qint32 bottom = std::min(top + CHUNKROWS - 1, pmax.y);
+            quint32 nLines = bottom - top + _rows;
+            values.resize(nLines * paddedWidth);
+            double vmin = rUNDEF, vmax = rUNDEF;
+            bool integers = true;
+            for(quint32 line = 0; line < nLines; ++line) {
+                const double *row = inputRows.row(top - dy + line);
+                std::copy(row, row + paddedWidth, values.begin() + line * paddedWidth);
+                for(const double *v = row; v != row + paddedWidth; ++v) {
+                    if ( *v == rUNDEF)
+                        continue;
+                    vmin = vmin == rUNDEF ? *v : std::min(vmin, *v);
+                    vmax = vmax == rUNDEF ? *v : std::max(vmax, *v);
+                    integers &= *v == std::floor(*v);
+                }
+            }
+            // the bins stay the same for all rows of the chunk, so a row is binned once and the histogram only changes by the values that leave and enter.
+            // integer values are their own bins if their range is small; otherwise the distinct values are ranked first
+            bool direct = vmin == rUNDEF || (integers && vmax - vmin < MAXDIRECTBINS);
+            binValues.clear();
+            if ( !direct) {
+                for(double v : values) {
+                    if ( v != rUNDEF)
+                        binValues.push_back(v);
+                }
+                std::sort(binValues.begin(), binValues.end());
+                binValues.erase(std::unique(binValues.begin(), binValues.end()), binValues.end());
+            }
+            quint32 nBins = direct ? (vmin == rUNDEF ? 1 : (quint32)(vmax - vmin) + 2) : (quint32)binValues.size() + 1;
+            bins.resize(values.size());
+            for(quint32 i = 0; i < values.size(); ++i) {
+                double v = values[i];
+                if ( v == rUNDEF)
+                    bins[i] = 0;
+                else
+                    bins[i] = direct ? (quint32)(v - vmin) + 1 : 1 + (quint32)(std::lower_bound(binValues.begin(), binValues.end(), v) - binValues.begin());
+            }
+
+            // the window goes back and forth over the rows of the chunk, to the right on even rows and to the left on odd ones. It only moves by one column
+            // or one row at a time, so the histogram is filled once per chunk and then changes by the values that leave and enter
+            histogram.reset(nBins);
+            for(quint32 r = 0; r < _rows; ++r) {
+                for(quint32 c = 0; c < _columns; ++c)
+                    histogram.add(bins[r * paddedWidth + c], 1);
+            }
+            for(qint32 y = top; y <= bottom; ++y) {
+                const quint32 *window = bins.data() + (y - top) * paddedWidth;
+                bool rightwards = (y - top) % 2 == 0;
+                for(quint32 step = 0; step < width; ++step) {
+                    quint32 x = rightwards ? step : width - 1 - step;
+                    if ( _index >= _rows * _columns)
+                        result[x] = rUNDEF;
+                    else {
+                        quint32 bin = histogram.select(_index);
+                        result[x] = bin == 0 ? rUNDEF : (direct ? vmin + bin - 1 : binValues[bin - 1]);
+                    }
+                    if ( step + 1 == width)
+                        break;
+                    quint32 leaving = rightwards ? x : x + _columns - 1;
+                    quint32 entering = rightwards ? x + _columns : x - 1;
+                    for(quint32 r = 0; r < _rows; ++r) {
+                        histogram.add(window[r * paddedWidth + leaving], -1);
+                        histogram.add(window[r * paddedWidth + entering], 1);
+                    }
+                }
+                if ( y < bottom) { // at the end of the row the window moves down: its top line leaves, the line below it enters
+                    const quint32 *leaving = window + (rightwards ? width - 1 : 0);
+                    const quint32 *entering = leaving + _rows * paddedWidth;
+                    for(quint32 c = 0; c < _columns; ++c) {
+                        histogram.add(leaving[c], -1);
+                        histogram.add(entering[c], 1);
+                    }
+                }
+
+                PixelIterator iterOut(output, threadIndex, BoundingBox(Pixel(pmin.x, y, z), Pixel(pmax.x, y, z)));
+                quint32 x = 0;
+                PixelSpan span;
+                while((span = iterOut.span())._length > 0) {
+                    for(qint32 i = 0; i < span._length; ++i, ++x)
+                        span[i] = result[x];
+                    iterOut += span._length;
+                }
+                if ( written) {
+                    for(double v : result)
+                        written->add(z, v);
+                }
+            }
+        }
+    }
+}
+
 void RankOrderGridFilter::colrow(quint32 col, quint32 row)
 {
     _rows = row;
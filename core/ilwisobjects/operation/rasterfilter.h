@@ -39,15 +39,25 @@ public:
     LinearGridFilter(const QString& name);
 
     double applyTo(const Ilwis::GridBlock &block);
+    /*!
+     * \brief applyTo filters all pixels of a box of the input into the output, with the same edge and undefined rules as filtering pixel by pixel.
+     * Every input row is read once into a ring of row buffers; a separable filter is applied as a horizontal and a vertical pass
+     * \param written optional; counts the values written into the output
+     */
+    void applyTo(const IRasterCoverage& input, const IRasterCoverage& output, const BoundingBox& box, int threadIndex, OutputStatistics::Written *written = 0) const;
     QSize size() const;
+    bool isSeparable() const;
 
 private:
     quint32 _columns;
     quint32 _rows;
     double _gain;
     std::vector<std::vector<double>> _filterdef;
+    std::vector<double> _rowKernel; // a separable filter is the product of _columnKernel (per row) and _rowKernel (per column); empty otherwise
+    std::vector<double> _columnKernel;
 
     bool definition(const QString& name);
+    void separate();
     bool makeCustomFilter(const QString &definition);
     bool fillDef(int xsize, int ysize, const QStringList &numbers);
 };
@@ -57,6 +67,12 @@ public:
     RankOrderGridFilter(const QString& name);
 
     double applyTo(const Ilwis::GridBlock &block);
+    /*!
+     * \brief applyTo filters all pixels of a box of the input into the output. The values under the filter are kept in a histogram that slides along the rows (and down to the next row),
+     * so a pixel costs a few histogram updates instead of sorting the whole window. Undefined values rank lowest, as with applyTo(GridBlock)
+     * \param written optional; counts the values written into the output
+     */
+    void applyTo(const IRasterCoverage& input, const IRasterCoverage& output, const BoundingBox& box, int threadIndex, OutputStatistics::Written *written = 0) const;
     void colrow(quint32 col, quint32 row);
     void index(quint32 index);
     QSize size() const;
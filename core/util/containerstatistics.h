@@ -34,6 +34,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #include <boost/accumulators/statistics/moment.hpp>
 #include <boost/accumulators/statistics/kurtosis.hpp>
 #include "tranquilizer.h"
+#include "quantilesketch.h"
+#include "taskscheduler.h"
 
 #include "mathhelper.h"
 
@@ -63,6 +65,76 @@ public:
 					  pQUICKHISTOGRAM =65536,pLAST= 131072, pALL=2147483647};
     static const quint32 pNUMERICS = pMIN | pMAX | pDISTANCE | pDELTA | pNETTOCOUNT | pCOUNT | pSUM | pMEAN | pMEDIAN | pPREDOMINANT | pVARIANCE | pSKEW | pKURTOSIS;
 
+    /*!
+     * \brief The Accumulator struct collects the statistics of (a part of) a container in one pass; accumulators of different parts can be merged
+     *
+     * The central moments are updated incrementally (Welford/Pebay) so merging the parts is numerically stable. The median comes from a QuantileSketch.
+     */
+    struct Accumulator{
+        Accumulator(int mode = pBASIC, quint32 sketchSize = 0) :
+            _moments(hasType(mode, pVARIANCE | pSTDEV | pSKEW | pKURTOSIS)),
+            _sketch(sketchSize == 0 ? 8 : sketchSize),
+            _quantiles(sketchSize > 0) {}
+
+        // only for defined samples; _count (which includes the undefineds) is maintained by the caller
+        void add(double sample) {
+            _min = Ilwis::min(_min, sample);
+            _max = Ilwis::max(_max, sample);
+            _sum += sample;
+            double n1 = _netCount;
+            ++_netCount;
+            if (_moments) {
+                double n = _netCount;
+                double delta = sample - _mean;
+                double deltaN = delta / n;
+                double deltaN2 = deltaN * deltaN;
+                double term = delta * deltaN * n1;
+                _mean += deltaN;
+                _m4 += term * deltaN2 * (n * n - 3 * n + 3) + 6 * deltaN2 * _m2 - 4 * deltaN * _m3;
+                _m3 += term * deltaN * (n - 2) - 3 * deltaN * _m2;
+                _m2 += term;
+            }
+            if (_quantiles)
+                _sketch.add(sample);
+        }
+
+        void merge(const Accumulator& other) {
+            _count += other._count;
+            if (other._netCount == 0)
+                return;
+            _min = Ilwis::min(_min, other._min);
+            _max = Ilwis::max(_max, other._max);
+            _sum += other._sum;
+            if (_moments) {
+                double na = _netCount, nb = other._netCount, n = na + nb;
+                double delta = other._mean - _mean;
+                double delta2 = delta * delta;
+                double m2 = _m2 + other._m2 + delta2 * na * nb / n;
+                double m3 = _m3 + other._m3 + delta2 * delta * na * nb * (na - nb) / (n * n) + 3 * delta * (na * other._m2 - nb * _m2) / n;
+                double m4 = _m4 + other._m4 + delta2 * delta2 * na * nb * (na * na - na * nb + nb * nb) / (n * n * n) +
+                            6 * delta2 * (na * na * other._m2 + nb * nb * _m2) / (n * n) + 4 * delta * (na * other._m3 - nb * _m3) / n;
+                _mean += delta * nb / n;
+                _m2 = m2;
+                _m3 = m3;
+                _m4 = m4;
+            }
+            if (_quantiles)
+                _sketch.merge(other._sketch);
+            _netCount += other._netCount;
+        }
+
+        quint64 _count = 0;
+        quint64 _netCount = 0;
+        double _min = rUNDEF;
+        double _max = rUNDEF;
+        double _sum = 0;
+        double _mean = 0;
+        double _m2 = 0, _m3 = 0, _m4 = 0; // sums of the 2nd, 3rd and 4th powers of the deviations from the mean
+        bool _moments;
+        QuantileSketch _sketch;
+        bool _quantiles;
+    };
+
     ContainerStatistics(){
         _sigDigits = shUNDEF;
         _markers.resize(index(pLAST));
@@ -193,138 +265,103 @@ public:
 	}
 
     template<typename IterType> bool calculate(const IterType& begin, const IterType& end, std::unique_ptr<Tranquilizer>& tranquilizer, int mode = pBASIC, int bins = 0, double pseudoUndef = rILLEGAL) {
-        //Basic basicMarkers;
-        Median median;
-        Variance var;
-        Skew skew;
-        Kurtosis kurt;
-        DataType undefined;
-        undefined = pseudoUndef != rILLEGAL ? undef<DataType>() : pseudoUndef;
-        double sigDigits = 0;
-        double rest = 0;
-		qint32 imax = -1e9, imin = 1e9;
-		std::vector<double> vmap; // this map contain a mapping of the rawvalue of the raster to a value from the attribute table; only relevant for rasters with attributes. In other cases this is empty
-		if (_mapping.size() > 0) {
-			for (auto& item : _mapping) {
-				imax = std::max(item.first, imax);
-				imin = std::min(item.first, imin);
-			}
-			vmap.resize(imax+1);
-			for (auto& item : _mapping) {
-				vmap[item.first] = item.second;
-			}
-		}
-
-        double pmin = rUNDEF, pmax = rUNDEF, psum = 0;
-        quint64 pcount=0, pnetcount = 0;
+        std::vector<double> vmap = valueMap();
+        Accumulator acc(mode, hasType(mode, pMEDIAN) ? QuantileSketch::configuredSize() : 0);
         for (auto iter = begin; iter != end; ++iter) {
             DataType sample = *iter;
 			if (vmap.size() > 0) {
 				sample = vmap[(quint32)sample];
 			}
-			++pcount;
-            if (!isNumericalUndef(sample)) {
-                rest = fabs(sample - (qint64)sample);
-                sigDigits = std::max(sigDigits, rest - sigDigits);
-                pmin = Ilwis::min(pmin, sample);
-                pmax = Ilwis::max(pmax, sample);
-                ++pnetcount;
-                psum += sample;
-
-                if (hasType(mode, pVARIANCE))
-                    var(sample);
-                if (hasType(mode, pMEDIAN)) {
-                    median(sample);
-                }
-                if (hasType(mode, pSKEW)) {
-                    skew(sample);
-                }
-                if (hasType(mode, pKURTOSIS)) {
-                    kurt(sample);
-                }
+            ++acc._count;
+            if (!isNumericalUndef(sample) && sample != pseudoUndef) {
+                acc.add(sample);
                 if (tranquilizer.get() != 0)
                     tranquilizer->update(1);
-
             }
         }
-        bool isUndefined = pnetcount == 0;
-        std::fill(_markers.begin(), _markers.end(), rUNDEF);
-		_markers[index(pCOUNT)] = pcount;
-		_markers[index(pNETTOCOUNT)] = pnetcount;
-        if (!isUndefined) {
-            _markers[index(pMIN)] = pmin;
-            _markers[index(pMAX)] = pmax;
-            _markers[index(pDISTANCE)] = std::abs(prop(pMAX) - prop(pMIN));
-            _markers[index(pDELTA)] = prop(pMAX) - prop(pMIN);
-            _markers[index(pSUM)] = psum;
-            _markers[index(pMEAN)] = pnetcount > 0 ? psum / pnetcount : rUNDEF;
-            _markers[index(pMEDIAN)] = boost::accumulators::median(median);
-            _markers[index(pVARIANCE)] = boost::accumulators::moment<2>(var);
-            _markers[index(pSKEW)] = boost::accumulators::moment<3>(skew);
-            _markers[index(pKURTOSIS)] = boost::accumulators::kurtosis(kurt);
-            //_sigDigits = findSignificantDigits(begin, end, undefined);
-
-            if (mode & pSTDEV) {
-                _markers[index(pSTDEV)] = calcStdDev(begin, end, undefined);
+        setMarkers(acc);
+        if (acc._netCount > 0 && hasType(mode, pHISTOGRAM| pQUICKHISTOGRAM)) {
+            prepareBins(acc, bins);
+            double rmin = prop(pMIN);
+            double rdelta = prop(pDELTA);
+            for (auto iter = begin; iter != end; ++iter) {
+                DataType sample = *iter;
+				if (vmap.size() > 0) {
+					sample = vmap[(quint32)sample];
+				}
+                _bins.at(binIndex(sample, rmin, rdelta, pseudoUndef))._count++;
             }
-            if (hasType(mode, pHISTOGRAM| pQUICKHISTOGRAM)) {
+        }
 
-                double ncount = prop(pNETTOCOUNT);
-                if (ncount > 1) {
-                    if (bins <= 0) {
-                     /*   if (prop(pSTDEV) == rUNDEF) {
-                            _markers[index(pSTDEV)] = calcStdDev(begin, end, undefined);
-                        }
-                        if (_markers[index(pSTDEV)] != rUNDEF) {
-                            double h = 3.5 * _markers[index(pSTDEV)] / pow(ncount, 0.3333);
-                            _binCount = prop(pDISTANCE) / h;
-                        }*/
-						bins = 5 * std::sqrt(std::sqrt(pnetcount)) + 1;
-						if (std::ceil(psum) == psum) {// integer
-							double delta = prop(pDELTA);
-							if (delta <= 255) // special case for images
-								bins = delta + 1;
-							else {
-                                double f = delta / (bins - 1);
-								double cf = std::ceil(f);
-								if (pcount < psum && cf != f && cf > 1.0) {
-									bins = 1 + delta / (int)(cf);
-								}
-							}
-						}
-                    }
-                }
+        return true;
+    }
 
-                _bins.resize(bins + 1); // last cell is for undefineds
-                double delta = prop(pDELTA);
-                for (int i = 0; i < bins - 1; ++i) {
-                    _bins[i] = HistogramBin(prop(pMIN) + i * (delta / (bins - 1)));
+    /*!
+     * \brief calculateParallel computes the statistics of a container that consists of independent parts, e.g. the row boxes of a raster, on the threads of the task scheduler
+     *
+     * Every part gets its own Accumulator (and histogram counts); they are merged in the order of the parts, so the result does not depend on the number of threads.
+     * The statistics need one pass over the data, the histogram a second one. Memory use is bounded by the quantile sketches of the parts (see QuantileSketch).
+     * \param parts number of parts
+     * \param part function (quint32 part, int threadIndex) that returns the begin and end iterator of a part; the iterators must be safe to use on the given thread
+     */
+    template<typename PartFunc> bool calculateParallel(quint32 parts, PartFunc part, int mode = pBASIC, int bins = 0, double pseudoUndef = rILLEGAL) {
+        std::vector<double> vmap = valueMap();
+        quint32 sketchSize = hasType(mode, pMEDIAN) ? QuantileSketch::configuredSize() : 0;
+        std::vector<Accumulator> accumulators(parts, Accumulator(mode, sketchSize));
+        bool ok = taskscheduler()->run(parts, [&](quint32 p, int threadIndex) -> bool {
+            auto range = part(p, threadIndex);
+            Accumulator& acc = accumulators[p];
+            for (auto iter = range.first; iter != range.second; ++iter) {
+                DataType sample = *iter;
+                if (vmap.size() > 0) {
+                    sample = vmap[(quint32)sample];
                 }
-                _bins[bins - 1] = HistogramBin(prop(pMAX)); // Compute separately, for extra precision
-                _bins[bins] = HistogramBin(rUNDEF);
-                double rmin = prop(pMIN);
-                double rdelta = prop(pDELTA);
-				int binsize = _bins.size();
-                for (auto iter = begin; iter != end; ++iter) {
+                ++acc._count;
+                if (!isNumericalUndef(sample) && sample != pseudoUndef)
+                    acc.add(sample);
+            }
+            return true;
+        });
+        if (!ok)
+            return false;
+
+        Accumulator total(mode, sketchSize);
+        for (const Accumulator& acc : accumulators)
+            total.merge(acc);
+        accumulators.clear();
+        setMarkers(total);
+
+        if (total._netCount > 0 && hasType(mode, pHISTOGRAM| pQUICKHISTOGRAM)) {
+            prepareBins(total, bins);
+            double rmin = prop(pMIN);
+            double rdelta = prop(pDELTA);
+            std::vector<std::vector<quint64>> counts(parts);
+            ok = taskscheduler()->run(parts, [&](quint32 p, int threadIndex) -> bool {
+                auto range = part(p, threadIndex);
+                std::vector<quint64>& local = counts[p];
+                local.resize(_bins.size(), 0);
+                for (auto iter = range.first; iter != range.second; ++iter) {
                     DataType sample = *iter;
-					if (vmap.size() > 0) {
-						sample = vmap[(quint32)sample];
-					}
-                    quint16 index = (quint16)binsize - 1;
-                    if (!isNumericalUndef(sample)) {
-						double d = (double)(sample - rmin);
-						double idx = (double)(binsize-2) * d / rdelta;
-						index = idx; // floor
-                        index =  index > binsize-2 ? index - 2 : index; // -2 is the last 'real' number, -1 is the place for undefs; through rounding the index may endup at index -1 which is not what we want;
+                    if (vmap.size() > 0) {
+                        sample = vmap[(quint32)sample];
                     }
-                    _bins.at(index)._count++;
+                    ++local[binIndex(sample, rmin, rdelta, pseudoUndef)];
                 }
+                return true;
+            });
+            for (const auto& local : counts) {
+                for (size_t i = 0; i < local.size(); ++i)
+                    _bins[i]._count += local[i];
             }
         }
-
-        return true;
+        return ok;
     }
 
+        template<typename PartFunc> bool calculateParallel(quint32 parts, PartFunc part, std::unordered_map<qint32, double>& mapping, int mode = pBASIC, int bins = 0, double pseudoUndef = rILLEGAL) {
+            _mapping = mapping;
+            return calculateParallel(parts, part, mode, bins, pseudoUndef);
+        }
+
         template<typename IterType> bool calculate(const IterType& begin,  const IterType& end, int mode=pBASIC, int bins = 0, double pseudoUndef=rILLEGAL){
             std::unique_ptr<Tranquilizer> tranquilizer;
             return calculate(begin, end, tranquilizer, mode, bins, pseudoUndef);
@@ -456,18 +493,82 @@ public:
         std::vector<HistogramBin> _bins;
 		PropertySets _histogramMode = pNONE;
 
-        template<typename IterType> double calcStdDev(const IterType& begin,  const IterType& end, DataType undefined) {
-            double ncount = prop(pNETTOCOUNT);
-            if ( ncount < 2)
-                return rUNDEF;
-            double acc = 0;
-            double mean = prop(pMEAN);
-            std::for_each(begin, end, [&] (const DataType& sample){
-                if ( sample != undefined)
-                    acc += (sample - mean) * (sample - mean);
-            });
-            return sqrt(acc / (ncount-1));
+        std::vector<double> valueMap() const {
+            std::vector<double> vmap; // this map contain a mapping of the rawvalue of the raster to a value from the attribute table; only relevant for rasters with attributes. In other cases this is empty
+            if (_mapping.size() > 0) {
+                qint32 imax = -1e9;
+                for (auto& item : _mapping)
+                    imax = std::max(item.first, imax);
+                vmap.resize(imax + 1);
+                for (auto& item : _mapping)
+                    vmap[item.first] = item.second;
+            }
+            return vmap;
+        }
 
+        void setMarkers(const Accumulator& acc) {
+            std::fill(_markers.begin(), _markers.end(), rUNDEF);
+            _markers[index(pCOUNT)] = acc._count;
+            _markers[index(pNETTOCOUNT)] = acc._netCount;
+            if (acc._netCount == 0)
+                return;
+
+            double n = acc._netCount;
+            _markers[index(pMIN)] = acc._min;
+            _markers[index(pMAX)] = acc._max;
+            _markers[index(pDISTANCE)] = std::abs(acc._max - acc._min);
+            _markers[index(pDELTA)] = acc._max - acc._min;
+            _markers[index(pSUM)] = acc._sum;
+            _markers[index(pMEAN)] = acc._sum / n;
+            if (acc._sketch.count() > 0)
+                _markers[index(pMEDIAN)] = acc._sketch.quantile(0.5);
+            if (acc._moments) {
+                _markers[index(pVARIANCE)] = acc._m2 / n;
+                if (n > 1)
+                    _markers[index(pSTDEV)] = std::sqrt(acc._m2 / (n - 1));
+                if (acc._m2 > 0) {
+                    _markers[index(pSKEW)] = std::sqrt(n) * acc._m3 / std::pow(acc._m2, 1.5);
+                    _markers[index(pKURTOSIS)] = n * acc._m4 / (acc._m2 * acc._m2) - 3.0;
+                }
+            }
+        }
+
+        void prepareBins(const Accumulator& acc, int bins) {
+            double delta = prop(pDELTA);
+            if (bins <= 0 && acc._netCount > 1) {
+                bins = 5 * std::sqrt(std::sqrt(acc._netCount)) + 1;
+                if (std::ceil(acc._sum) == acc._sum) {// integer
+                    if (delta <= 255) // special case for images
+                        bins = delta + 1;
+                    else {
+                        double f = delta / (bins - 1);
+                        double cf = std::ceil(f);
+                        if (acc._count < acc._sum && cf != f && cf > 1.0) {
+                            bins = 1 + delta / (int)(cf);
+                        }
+                    }
+                }
+            }
+            bins = std::max(1, bins);
+
+            _bins.resize(bins + 1); // last cell is for undefineds
+            for (int i = 0; i < bins - 1; ++i) {
+                _bins[i] = HistogramBin(prop(pMIN) + i * (delta / (bins - 1)));
+            }
+            _bins[bins - 1] = HistogramBin(prop(pMAX)); // Compute separately, for extra precision
+            _bins[bins] = HistogramBin(rUNDEF);
+        }
+
+        quint16 binIndex(const DataType& sample, double rmin, double rdelta, double pseudoUndef) const {
+            int binsize = _bins.size();
+            quint16 index = (quint16)binsize - 1;
+            if (!isNumericalUndef(sample) && sample != pseudoUndef) {
+                double d = (double)(sample - rmin);
+                double idx = rdelta > 0 ? (double)(binsize-2) * d / rdelta : 0;
+                index = idx; // floor
+                index =  index > binsize-2 ? index - 2 : index; // -2 is the last 'real' number, -1 is the place for undefs; through rounding the index may endup at index -1 which is not what we want;
+            }
+            return index;
         }
 
         quint16 getOffsetFactorFor(const DataType& sample, double rmin, double rdelta) const {
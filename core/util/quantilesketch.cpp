@@ -0,0 +1,152 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#include <cmath>
+#include <algorithm>
+#include "kernel.h"
+#include "ilwiscontext.h"
+#include "quantilesketch.h"
+
+using namespace Ilwis;
+
+QuantileSketch::QuantileSketch(quint32 k) : _k(k == 0 ? configuredSize() : std::max((quint32)8, k))
+{
+}
+
+quint32 QuantileSketch::sizeForError(double rankError)
+{
+    if ( rankError <= 0 || rankError == rUNDEF)
+        rankError = 0.01;
+    double k = std::ceil(std::pow(2.446 / rankError, 1.0 / 0.9433));
+    return (quint32)std::max(8.0, std::min(k, 65536.0));
+}
+
+quint32 QuantileSketch::configuredSize()
+{
+    return sizeForError(ilwisconfig("system-settings/quantile-sketch-error", 0.01));
+}
+
+quint64 QuantileSketch::count() const
+{
+    return _count;
+}
+
+quint32 QuantileSketch::k() const
+{
+    return _k;
+}
+
+void QuantileSketch::clear()
+{
+    _count = 0;
+    _items = 0;
+    _maxItems = 0;
+    _levels.clear();
+    _odd.clear();
+}
+
+quint32 QuantileSketch::capacity(quint32 level) const
+{
+    quint32 depth = (quint32)_levels.size() - level - 1;
+    return std::max((quint32)2, (quint32)std::ceil(_k * std::pow(2.0 / 3.0, depth)));
+}
+
+void QuantileSketch::grow()
+{
+    _levels.push_back(std::vector<double>());
+    _odd.push_back(false);
+    _maxItems = 0;
+    for(quint32 h = 0; h < _levels.size(); ++h)
+        _maxItems += capacity(h);
+}
+
+void QuantileSketch::add(double value)
+{
+    if ( _levels.empty())
+        grow();
+    _levels[0].push_back(value);
+    ++_count;
+    if ( ++_items >= _maxItems)
+        compress();
+}
+
+void QuantileSketch::merge(const QuantileSketch &other)
+{
+    if ( other._count == 0)
+        return;
+    while(_levels.size() < other._levels.size())
+        grow();
+    for(quint32 h = 0; h < other._levels.size(); ++h)
+        _levels[h].insert(_levels[h].end(), other._levels[h].begin(), other._levels[h].end());
+    _count += other._count;
+    _items += other._items;
+    if ( _items >= _maxItems)
+        compress();
+}
+
+void QuantileSketch::compress()
+{
+    for(quint32 h = 0; h < _levels.size(); ++h) {
+        if ( _levels[h].size() >= capacity(h)) {
+            if ( h + 1 >= _levels.size())
+                grow();
+            compact(h);
+            if ( _items < _maxItems)
+                break;
+        }
+    }
+}
+
+void QuantileSketch::compact(quint32 level)
+{
+    std::vector<double>& items = _levels[level];
+    std::vector<double>& up = _levels[level + 1];
+    std::sort(items.begin(), items.end());
+    // with an odd number of items the largest one stays behind; the others are halved
+    bool keepLast = items.size() % 2 == 1;
+    double last = keepLast ? items.back() : 0;
+    if ( keepLast)
+        items.pop_back();
+    for(size_t i = _odd[level] ? 1 : 0; i < items.size(); i += 2)
+        up.push_back(items[i]);
+    _odd[level] = !_odd[level];
+    _items -= items.size() / 2;
+    items.clear();
+    if ( keepLast)
+        items.push_back(last);
+}
+
+double QuantileSketch::quantile(double q) const
+{
+    if ( _count == 0)
+        return rUNDEF;
+
+    std::vector<std::pair<double, quint64>> weighted;
+    weighted.reserve(_items);
+    for(quint32 h = 0; h < _levels.size(); ++h) {
+        for(double value : _levels[h])
+            weighted.push_back(std::make_pair(value, (quint64)1 << h));
+    }
+    std::sort(weighted.begin(), weighted.end());
+    double target = std::max(0.0, std::min(1.0, q)) * _count;
+    quint64 cumulative = 0;
+    for(const auto& item : weighted) {
+        cumulative += item.second;
+        if ( cumulative >= target)
+            return item.first;
+    }
+    return weighted.back().first;
+}
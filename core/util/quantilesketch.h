@@ -0,0 +1,79 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#ifndef QUANTILESKETCH_H
+#define QUANTILESKETCH_H
+
+#include <vector>
+#include "kernel_global.h"
+
+namespace Ilwis {
+
+/*!
+ * \brief The QuantileSketch class estimates quantiles (e.g. the median) of a stream of values in bounded memory
+ *
+ * The sketch is a KLL sketch: a stack of compactors where every item at level h represents 2^h values of the stream. A full level is sorted and every second item
+ * moves one level up; the capacity of a level shrinks by 2/3 for every level below the top. The size of the sketch is O(k log(n/k)) for n values.
+ * Sketches of parts of a container can be merged, so the parts can be processed on different threads. As long as fewer than k values are added the sketch is exact.
+ * The compactions alternate between the odd and even items instead of choosing randomly; the same sequence of additions and merges gives the same result.
+ */
+class KERNELSHARED_EXPORT QuantileSketch
+{
+public:
+    /*!
+     * \brief QuantileSketch creates an empty sketch
+     * \param k size parameter of the sketch; the normalized rank error is roughly 2.4/k^0.94 (about 1% for k=340). 0 means configuredSize()
+     */
+    QuantileSketch(quint32 k = 0);
+
+    void add(double value);
+    void merge(const QuantileSketch& other);
+    void clear();
+
+    /*!
+     * \brief quantile the smallest value in the sketch of which the (weighted) rank is at least q * count()
+     * \param q fraction 0..1; 0.5 gives the median
+     * \return rUNDEF if the sketch is empty
+     */
+    double quantile(double q) const;
+    quint64 count() const;
+    quint32 k() const;
+
+    /*!
+     * \brief sizeForError the k for which the normalized rank error is about rankError
+     */
+    static quint32 sizeForError(double rankError);
+    /*!
+     * \brief configuredSize the k for the rank error in the configuration key system-settings/quantile-sketch-error (default 0.01)
+     */
+    static quint32 configuredSize();
+
+private:
+    quint32 capacity(quint32 level) const;
+    void grow();
+    void compress();
+    void compact(quint32 level);
+
+    quint32 _k;
+    quint64 _count = 0;
+    quint64 _items = 0; // retained items over all levels
+    quint64 _maxItems = 0; // sum of the capacities of the levels; exceeding it triggers a compaction
+    std::vector<std::vector<double>> _levels;
+    std::vector<bool> _odd; // per level, which half of the items is kept by the next compaction
+};
+}
+
+#endif // QUANTILESKETCH_H
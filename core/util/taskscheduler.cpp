@@ -0,0 +1,188 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#include <QThread>
+#include "kernel.h"
+#include "ilwiscontext.h"
+#include "taskscheduler.h"
+
+using namespace Ilwis;
+
+namespace {
+thread_local int _currentThreadIndex = 0;
+}
+
+TaskScheduler *Ilwis::taskscheduler() {
+    static TaskScheduler *scheduler = new TaskScheduler();
+    return scheduler;
+}
+
+TaskScheduler::TaskScheduler() : _result(true)
+{
+    int ideal = std::max(1, QThread::idealThreadCount());
+    _threadCount = std::max(1, ilwisconfig("system-settings/max-threads", ideal));
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    stopWorkers();
+}
+
+int TaskScheduler::currentThreadIndex()
+{
+    return _currentThreadIndex;
+}
+
+int TaskScheduler::threadCount() const
+{
+    return _threadCount;
+}
+
+void TaskScheduler::threadCount(int n)
+{
+    std::lock_guard<std::mutex> lock(_jobMutex);
+    _threadCount = std::max(1, n);
+}
+
+bool TaskScheduler::run(quint32 nTasks, const Task &task, int maxThreads)
+{
+    if ( nTasks == 0)
+        return true;
+
+    int nThreads = maxThreads == iUNDEF ? threadCount() : std::min(maxThreads, threadCount());
+    nThreads = std::min(nThreads, (int)nTasks);
+    if ( nThreads <= 1 || _currentThreadIndex != 0) { // serial case, or a job started from within a worker which is executed inline
+        for(quint32 t = 0; t < nTasks; ++t) {
+            if (!task(t, _currentThreadIndex))
+                return false;
+        }
+        return true;
+    }
+
+    std::lock_guard<std::mutex> jobLock(_jobMutex);
+    startWorkers(nThreads);
+
+    // every worker starts with a contiguous range of tasks; neighbouring boxes of a raster are then mostly handled by the same thread
+    quint32 chunk = nTasks / nThreads;
+    quint32 rest = nTasks % nThreads;
+    quint32 start = 0;
+    for(int w = 0; w < nThreads; ++w) {
+        quint32 count = chunk + ((quint32)w < rest ? 1 : 0);
+        std::lock_guard<std::mutex> lock(_workers[w]->_lock);
+        _workers[w]->_queue.clear();
+        for(quint32 t = start; t < start + count; ++t)
+            _workers[w]->_queue.push_back(t);
+        start += count;
+    }
+
+    std::unique_lock<std::mutex> lock(_stateMutex);
+    _job = &task;
+    _result = true;
+    _error = std::exception_ptr();
+    _participants = nThreads;
+    _busyWorkers = nThreads;
+    ++_generation;
+    _startCondition.notify_all();
+    _doneCondition.wait(lock, [this]{ return _busyWorkers == 0; });
+    _job = 0;
+
+    if ( _error)
+        std::rethrow_exception(_error);
+
+    return _result;
+}
+
+void TaskScheduler::startWorkers(int n)
+{
+    std::lock_guard<std::mutex> lock(_stateMutex);
+    while((int)_threads.size() < n) {
+        _workers.push_back(std::unique_ptr<Worker>(new Worker()));
+        // the current generation is passed so a worker that starts late still recognizes the job that caused its creation
+        _threads.push_back(std::thread(&TaskScheduler::workerLoop, this, (int)_threads.size(), _generation));
+    }
+}
+
+void TaskScheduler::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(_stateMutex);
+        _stop = true;
+    }
+    _startCondition.notify_all();
+    for(std::thread& thread : _threads) {
+        if ( thread.joinable())
+            thread.join();
+    }
+    _threads.clear();
+}
+
+void TaskScheduler::workerLoop(int index, quint64 generation)
+{
+    _currentThreadIndex = index + 1; // 0 is reserved for the non threaded case
+    quint64 seen = generation;
+    while(true) {
+        const Task *job = 0;
+        {
+            std::unique_lock<std::mutex> lock(_stateMutex);
+            _startCondition.wait(lock, [&]{ return _stop || _generation != seen; });
+            if ( _stop)
+                return;
+            seen = _generation;
+            if ( index >= _participants)
+                continue;
+            job = _job;
+        }
+        quint32 task;
+        while(_result && nextTask(index, task)) {
+            try {
+                if (!(*job)(task, _currentThreadIndex))
+                    _result = false;
+            } catch(...) {
+                std::lock_guard<std::mutex> lock(_stateMutex);
+                if ( !_error)
+                    _error = std::current_exception();
+                _result = false;
+            }
+        }
+        std::lock_guard<std::mutex> lock(_stateMutex);
+        if ( --_busyWorkers == 0)
+            _doneCondition.notify_all();
+    }
+}
+
+bool TaskScheduler::nextTask(int index, quint32 &task)
+{
+    {
+        Worker& own = *_workers[index];
+        std::lock_guard<std::mutex> lock(own._lock);
+        if ( !own._queue.empty()) {
+            task = own._queue.front();
+            own._queue.pop_front();
+            return true;
+        }
+    }
+    // steal from the back of the queue of another worker; the back is the part of the range its owner would reach last
+    for(int i = 1; i < _participants; ++i) {
+        Worker& victim = *_workers[(index + i) % _participants];
+        std::lock_guard<std::mutex> lock(victim._lock);
+        if ( !victim._queue.empty()) {
+            task = victim._queue.back();
+            victim._queue.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,99 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "kernel_global.h"
+#include "ilwis.h"
+
+namespace Ilwis {
+
+/*!
+ * \brief The TaskScheduler class a process wide pool of persistent worker threads that executes a set of independent tasks
+ *
+ * A job is a number of tasks (e.g. the row boxes of a raster operation) that are identified by their index. At the start of a job every worker
+ * receives a contiguous range of task indexes in its own queue; it works from the front of its own queue and, when that is empty, steals from the back of the
+ * queue of another worker. Contiguous ranges keep the blocks of a raster local to a worker, stealing keeps all cores busy when tasks differ in cost.
+ *
+ * Every worker has a fixed thread index (1..n). The index 0 is reserved for the non threaded case; it is used by the grids to select the block cache of a thread.
+ * Jobs started from within a worker are executed inline (serially) to prevent the pool from waiting on itself.
+ */
+class KERNELSHARED_EXPORT TaskScheduler
+{
+public:
+    typedef std::function<bool(quint32 task, int threadIndex)> Task;
+
+    TaskScheduler();
+    ~TaskScheduler();
+
+    /*!
+     * \brief run executes the tasks 0..nTasks-1 on the worker threads and waits until all are done
+     * \param nTasks number of tasks
+     * \param task function executed for every task index
+     * \param maxThreads upper limit of threads used for this job; iUNDEF means threadCount()
+     * \return false if one of the tasks returned false
+     */
+    bool run(quint32 nTasks, const Task& task, int maxThreads = iUNDEF);
+
+    int threadCount() const;
+    void threadCount(int n);
+
+    /*!
+     * \brief currentThreadIndex the thread index of the calling thread; 0 if the caller is not a worker of the scheduler
+     */
+    static int currentThreadIndex();
+
+private:
+    struct Worker {
+        std::deque<quint32> _queue;
+        std::mutex _lock;
+    };
+
+    void workerLoop(int index, quint64 generation);
+    void startWorkers(int n);
+    void stopWorkers();
+    bool nextTask(int index, quint32& task);
+
+    std::vector<std::thread> _threads;
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::mutex _jobMutex; // one job at a time
+    std::mutex _stateMutex;
+    std::condition_variable _startCondition;
+    std::condition_variable _doneCondition;
+    const Task *_job = 0;
+    quint64 _generation = 0;
+    int _participants = 0;
+    int _busyWorkers = 0;
+    std::atomic<bool> _result;
+    std::exception_ptr _error; // first exception thrown by a task; rethrown in run()
+    bool _stop = false;
+    int _threadCount = 0;
+};
+
+KERNELSHARED_EXPORT TaskScheduler* taskscheduler();
+}
+
+#endif // TASKSCHEDULER_H
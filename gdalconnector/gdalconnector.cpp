@@ -113,6 +113,16 @@ bool GdalConnector::getHandle(IlwisObject *data) {
 	}
 	return true;
 }
+QString GdalConnector::datasetName() const
+{
+    if ( _code != sUNDEF)
+        return _code;
+    QFileInfo fileinf(_fileUrl.toLocalFile());
+    if (_prefix != "")
+        return _prefix + fileinf.fileName();
+    return fileinf.absoluteFilePath();
+}
+
 bool GdalConnector::loadMetaData(IlwisObject *data, const IOOptions &options){
     if (data == nullptr)
         return false;
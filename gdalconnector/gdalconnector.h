@@ -42,6 +42,10 @@ protected:
     QString constructOutputName(GDALDriverH hdriver) const;
     void getTypes(const std::multimap<QString, DataFormat>& formats, IlwisTypes & tp, IlwisTypes & extendedType) const;
 	bool getHandle(IlwisObject *data);
+    /*!
+     * \brief datasetName the name under which GDAL opens the source; the same name getHandle() uses
+     */
+    QString datasetName() const;
     QUrl _fileUrl;
     QString _internalPath;
     QString _gdalShortName;
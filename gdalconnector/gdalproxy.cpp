@@ -60,6 +60,117 @@ void* GdalHandle::handle(){
     return _handle;
 }
 
+GdalDatasetPool::GdalDatasetPool()
+{
+    _maxOpen = std::max(1, ilwisconfig("system-settings/gdal-max-open-datasets", 64));
+}
+
+GDALDatasetH GdalDatasetPool::acquire(const QString &filename)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto thread = std::this_thread::get_id();
+    auto found = _entries.end();
+    for(auto iter = _entries.begin(); iter != _entries.end(); ++iter) {
+        if ( iter->_inUse || iter->_stale || iter->_filename != filename)
+            continue;
+        if ( found == _entries.end() || iter->_thread == thread)
+            found = iter;
+        if ( iter->_thread == thread)
+            break;
+    }
+    if ( found != _entries.end()) {
+        found->_inUse = true;
+        found->_thread = thread;
+        found->_lastUse = ++_clock;
+        ++_reused;
+        return found->_handle;
+    }
+
+    // the least recently used idle handles make place for the new one
+    while(_entries.size() >= _maxOpen) {
+        auto oldest = _entries.end();
+        for(auto iter = _entries.begin(); iter != _entries.end(); ++iter) {
+            if ( !iter->_inUse && (oldest == _entries.end() || iter->_lastUse < oldest->_lastUse))
+                oldest = iter;
+        }
+        if ( oldest == _entries.end()) // all handles are in use; the cap is exceeded rather than waiting for one
+            break;
+        closeEntry(oldest);
+    }
+    GDALDatasetH handle = gdal()->open(filename.toLocal8Bit(), GA_ReadOnly);
+    if ( !handle)
+        return 0;
+    Entry entry;
+    entry._filename = filename;
+    entry._handle = handle;
+    entry._thread = thread;
+    entry._lastUse = ++_clock;
+    entry._inUse = true;
+    _entries.push_back(entry);
+    ++_opened;
+    return handle;
+}
+
+void GdalDatasetPool::release(GDALDatasetH handle)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for(auto iter = _entries.begin(); iter != _entries.end(); ++iter) {
+        if ( iter->_handle == handle) {
+            iter->_inUse = false;
+            if ( iter->_stale || _entries.size() > _maxOpen)
+                closeEntry(iter);
+            return;
+        }
+    }
+}
+
+void GdalDatasetPool::close(const QString &filename)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for(auto iter = _entries.begin(); iter != _entries.end();) {
+        if ( iter->_filename != filename) {
+            ++iter;
+        } else if ( iter->_inUse) {
+            iter->_stale = true;
+            ++iter;
+        } else
+            iter = closeEntry(iter);
+    }
+}
+
+std::vector<GdalDatasetPool::Entry>::iterator GdalDatasetPool::closeEntry(std::vector<Entry>::iterator iter)
+{
+    gdal()->close(iter->_handle);
+    ++_closed;
+    return _entries.erase(iter);
+}
+
+QVariantMap GdalDatasetPool::statistics() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    QVariantMap result;
+    result["opened"] = _opened;
+    result["reused"] = _reused;
+    result["closed"] = _closed;
+    result["open"] = (quint64)_entries.size();
+    return result;
+}
+
+PooledDataset::PooledDataset(const QString &filename) : _handle(gdal()->datasets().acquire(filename))
+{
+}
+
+PooledDataset::~PooledDataset()
+{
+    if ( _handle)
+        gdal()->datasets().release(_handle);
+}
+
+GDALDatasetH PooledDataset::handle() const
+{
+    return _handle;
+}
+
 GDALProxy::GDALProxy() {
 	QFileInfo ilw = context()->ilwisFolder();
 	QFileInfo respath = context()->resourcesLocation("gdalconnector");
@@ -85,6 +196,7 @@ GDALProxy::GDALProxy() {
         ERROR2(ERR_COULD_NOT_LOAD_2, TR("name"), "gdal connector,error :" + _libgdal.errorString());
     }
     _isValid = ok;
+    _datasetPool.reset(new GdalDatasetPool());
 }
 
 GDALProxy::~GDALProxy(){
@@ -112,12 +224,19 @@ bool GDALProxy::prepare() {
     layerCount = add<IGDALGetSize>("GDALGetRasterCount");
     getRasterBand = add<IGDALGetRasterBand>("GDALGetRasterBand");
     create = add<IGDALCreate>("GDALCreate");
+    createCopy = add<IGDALCreateCopy>("GDALCreateCopy");
+    buildOverviews = add<IGDALBuildOverviews>("GDALBuildOverviews");
     rasterDataType = add<IGDALGetRasterDataType>("GDALGetRasterDataType");
     getProjectionRef = add<IGDALGetProjectionRef>("GDALGetProjectionRef");
     setProjection = add<IGDALSetProjection>("GDALSetProjection");
     getGeotransform = add<IGDALGetGeoTransform>("GDALGetGeoTransform");
     setGeoTransform = add<IGDALSetGeoTransform>("GDALSetGeoTransform");
     rasterIO = add<IGDALRasterIO>("GDALRasterIO");
+    getBlockSize = add<IGDALGetBlockSize>("GDALGetBlockSize");
+    getOverviewCount = add<IGDALGetOverviewCount>("GDALGetOverviewCount");
+    getOverview = add<IGDALGetOverview>("GDALGetOverview");
+    bandXSize = add<IGDALGetRasterBandSize>("GDALGetRasterBandXSize");
+    bandYSize = add<IGDALGetRasterBandSize>("GDALGetRasterBandYSize");
     getDataTypeSize = add<IGDALGetDataTypeSize>("GDALGetDataTypeSize");
     getAccess = add<IGDALGetAccess>("GDALGetAccess");
     getAttributeValue = add<IOSRGetAttrValue>("OSRGetAttrValue");
@@ -543,6 +662,11 @@ void GDALProxy::releaseSrsHandle(GdalHandle *handle, OGRSpatialReferenceH srshan
     }
 }
 
+GdalDatasetPool &GDALProxy::datasets()
+{
+    return *_datasetPool;
+}
+
 Envelope GDALProxy::envelope(GdalHandle* handle, int index, bool force){
 
     Envelope bbox;
@@ -19,6 +19,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 
 #include <QHash>
 #include <QLibrary>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include "gdal/ogr_api.h"
 #include "gdal/gdal.h"
@@ -37,6 +41,8 @@ typedef GDALDatasetH (*IGDALOpen )(const char *, GDALAccess) ;
 typedef int (*IGDALGetSize )(GDALDatasetH) ;
 typedef GDALRasterBandH (*IGDALGetRasterBand )(GDALDatasetH, int) ;
 typedef GDALDatasetH (*IGDALCreate )(GDALDriverH hDriver, const char *, int, int, int, GDALDataType, char **) ;
+typedef GDALDatasetH (*IGDALCreateCopy )(GDALDriverH, const char *, GDALDatasetH, int, char **, GDALProgressFunc, void *) ;
+typedef CPLErr (*IGDALBuildOverviews )(GDALDatasetH, const char *, int, int *, int, int *, GDALProgressFunc, void *) ;
 typedef GDALDataType (*IGDALGetRasterDataType )(GDALRasterBandH) ;
 typedef char * (*IGDALGetProjectionRef )(GDALDatasetH) ;
 typedef OGRSpatialReferenceH (*IOSRNewSpatialReference )(const char *) ;
@@ -44,6 +50,10 @@ typedef CPLErr (*IGDALSetProjection)(GDALDatasetH,const char *);
 typedef CPLErr (*IGDALGetGeoTransform )(GDALDatasetH, double *) ;
 typedef CPLErr (*IGDALSetGeoTransform)(GDALDatasetH, double * );
 typedef CPLErr (*IGDALRasterIO )(GDALRasterBandH , GDALRWFlag , int , int , int , int , void *, int , int , GDALDataType , int , int ) ;
+typedef void (*IGDALGetBlockSize )(GDALRasterBandH , int *, int *) ;
+typedef int (*IGDALGetOverviewCount )(GDALRasterBandH) ;
+typedef GDALRasterBandH (*IGDALGetOverview )(GDALRasterBandH, int) ;
+typedef int (*IGDALGetRasterBandSize )(GDALRasterBandH) ;
 typedef int (*IGDALGetDataTypeSize )(GDALDataType) ;
 typedef int (*IGDALGetAccess )(GDALDatasetH) ;
 typedef GDALDriverH (*IGDALGetDriver )(int) ;
@@ -185,6 +195,62 @@ class GdalHandle {
         quint64 _owner;
 };
 
+/*!
+ * \brief The GdalDatasetPool class read only dataset handles for loading the blocks of rasters, so blocks are loaded without opening the file (and parsing its header)
+ * again for every block, and by several threads at once.
+ *
+ * A handle is used by one thread at a time: acquire() hands out an idle handle of the file, preferably the one the calling thread used before, or opens a new one;
+ * release() returns it. When more than "system-settings/gdal-max-open-datasets" handles are open, the idle handle that was used least recently is closed.
+ */
+class GdalDatasetPool {
+public:
+    GdalDatasetPool();
+
+    GDALDatasetH acquire(const QString& filename);
+    void release(GDALDatasetH handle);
+    /*!
+     * \brief close closes the handles of a file, e.g. before it is written; handles that are in use are closed when they are released
+     */
+    void close(const QString& filename);
+    /*!
+     * \brief statistics the number of handles that were opened, reused and closed, and the number that is open now
+     */
+    QVariantMap statistics() const;
+
+private:
+    struct Entry {
+        QString _filename;
+        GDALDatasetH _handle = 0;
+        std::thread::id _thread; // the thread that used the handle last
+        quint64 _lastUse = 0;
+        bool _inUse = false;
+        bool _stale = false; // the file is changed; the handle is closed when it is released
+    };
+
+    std::vector<Entry>::iterator closeEntry(std::vector<Entry>::iterator iter);
+
+    mutable std::mutex _mutex;
+    std::vector<Entry> _entries;
+    quint64 _clock = 0;
+    quint32 _maxOpen;
+    quint64 _opened = 0;
+    quint64 _reused = 0;
+    quint64 _closed = 0;
+};
+
+/*!
+ * \brief The PooledDataset class a handle of the GdalDatasetPool for the duration of a scope
+ */
+class PooledDataset {
+public:
+    PooledDataset(const QString& filename);
+    ~PooledDataset();
+    GDALDatasetH handle() const;
+
+private:
+    GDALDatasetH _handle;
+};
+
 class GDALProxy {
 
     friend GDALProxy* gdal();
@@ -215,6 +281,7 @@ class GDALProxy {
         OGRSpatialReferenceH srsHandle(GdalHandle* handle, const QString& source, bool message=true);
         void releaseSrsHandle(GdalHandle* handle, OGRSpatialReferenceH srshandle, const QString& source);
         Envelope envelope(GdalHandle *handle, int index, bool force=false);
+        GdalDatasetPool& datasets();
 
         static QString translateOGRERR(char ogrErrCode);
         static IlwisTypes translateOGRType(OGRwkbGeometryType type) ;
@@ -235,6 +302,7 @@ class GDALProxy {
         QStringList _allExtensions;
 
         QHash<QString, GdalHandle*> _openedDatasets;
+        std::unique_ptr<GdalDatasetPool> _datasetPool;
 
  public:
         IGDALClose close;
@@ -251,12 +319,19 @@ class GDALProxy {
 
         IGDALGetRasterBand getRasterBand;
         IGDALCreate create;
+        IGDALCreateCopy createCopy;
+        IGDALBuildOverviews buildOverviews;
         IGDALGetRasterDataType rasterDataType;
         IGDALGetProjectionRef getProjectionRef;
         IGDALSetProjection setProjection;
         IGDALGetGeoTransform getGeotransform;
         IGDALSetGeoTransform setGeoTransform;
         IGDALRasterIO rasterIO;
+        IGDALGetBlockSize getBlockSize;
+        IGDALGetOverviewCount getOverviewCount;
+        IGDALGetOverview getOverview;
+        IGDALGetRasterBandSize bandXSize;
+        IGDALGetRasterBandSize bandYSize;
         IGDALGetDataTypeSize getDataTypeSize;
         IGDALGetAccess getAccess;
         IGDALGetDriver getDriver;
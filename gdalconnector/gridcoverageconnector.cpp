@@ -19,6 +19,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #include <QFile>
 #include <QDir>
 #include <QColor>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "kernel.h"
 #include "raster.h"
@@ -30,6 +33,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #include "numericrange.h"
 #include "numericdomain.h"
 #include "pixeliterator.h"
+#include "taskscheduler.h"
 #include "columndefinition.h"
 #include "table.h"
 #include "catalog.h"
@@ -53,6 +57,153 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 using namespace Ilwis;
 using namespace Gdal;
 
+namespace {
+const qint64 POOLRETRYINTERVAL = 1000; // msecs a source that the pool failed to open is read through the handle of the connector before the pool is tried again
+
+/*
+ * The decoding of a block of one GDAL data type: the conversion to PIXVALUETYPE, the scale and offset of the band and the mapping of nodata (and for floating
+ * point types NaN and infinity) to undefined happen in one pass over the block, without a dispatch on the data type per value. Nodata is a raw value of the band,
+ * so it is compared before the scale and offset are applied
+ */
+template<typename T> void decodeValues(const char *block, quint64 n, PIXVALUETYPE *out, double scale, double offset, double nodata) {
+    const T *values = reinterpret_cast<const T *>(block);
+    bool scaled = scale != rUNDEF && offset != rUNDEF;
+    for(quint64 i = 0; i < n; ++i) {
+        double v = values[i];
+        bool undef = v == nodata || (!std::numeric_limits<T>::is_integer && !std::isfinite(v));
+        out[i] = undef ? PIXVALUEUNDEF : (scaled ? v * scale + offset : v);
+    }
+}
+
+/*
+ * Integer values without a scale and offset go to the grid in their own type; the grid packs them without a conversion. This requires a nodata value of that type,
+ * without one any value of the type can occur and there is no value left to mark undefined pixels with
+ */
+template<typename T> bool writeNative(UPGrid& grid, quint32 index, const char *block, double scale, double offset, double nodata) {
+    if ( scale != rUNDEF && offset != rUNDEF)
+        return false;
+    if ( nodata == rUNDEF || nodata < std::numeric_limits<T>::lowest() || nodata > std::numeric_limits<T>::max() || (double)(T)nodata != nodata)
+        return false;
+    return grid->writeBlock(index, reinterpret_cast<const T *>(block), (T)nodata);
+}
+
+const quint32 ROWSPERWRITETASK = 16;
+const quint64 STRIPBYTES = 64 * 1024 * 1024; // upper limit of the size of a strip of the save; a strip has at least one row of GDAL blocks
+
+/*
+ * One thread that hands the strips of a save to GDAL, one at a time, while the tasks of the scheduler convert the next strip. write() waits until the previous
+ * strip is written, so the buffer of the strip before that may be filled again when write() returns
+ */
+class StripWriter {
+public:
+    StripWriter() : _thread([this]{ run(); }) {}
+    ~StripWriter() {
+        finish();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _done = true;
+        }
+        _changed.notify_all();
+        _thread.join();
+    }
+
+    bool write(GDALRasterBandH band, quint32 ystart, quint32 xsize, quint32 nrows, void *values, GDALDataType type) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _changed.wait(lock, [this]{ return !_pending; });
+        if (!_ok)
+            return false;
+        _band = band; _ystart = ystart; _xsize = xsize; _nrows = nrows; _values = values; _type = type;
+        _pending = true;
+        lock.unlock();
+        _changed.notify_all();
+        return true;
+    }
+
+    bool finish() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _changed.wait(lock, [this]{ return !_pending; });
+        return _ok;
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while(true) {
+            _changed.wait(lock, [this]{ return _pending || _done; });
+            if (!_pending)
+                return;
+            lock.unlock();
+            bool ok = gdal()->rasterIO(_band, GF_Write, 0, _ystart, _xsize, _nrows, _values, _xsize, _nrows, _type, 0, 0) == CE_None;
+            lock.lock();
+            _ok = _ok && ok;
+            _pending = false;
+            _changed.notify_all();
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    bool _pending = false;
+    bool _done = false;
+    bool _ok = true;
+    GDALRasterBandH _band = 0;
+    quint32 _ystart = 0, _xsize = 0, _nrows = 0;
+    void *_values = 0;
+    GDALDataType _type = GDT_Unknown;
+    std::thread _thread; // the last member; it starts when the others are initialized
+};
+
+/*
+ * The creation options of a GDAL driver as the null terminated list of "KEY=VALUE" strings GDAL expects
+ */
+class CreationOptions {
+public:
+    void add(const QString& key, const QString& value) {
+        _items.push_back((key + "=" + value).toLatin1());
+    }
+    char **list() {
+        if ( _items.empty())
+            return 0;
+        _pointers.clear();
+        for(QByteArray& item : _items)
+            _pointers.push_back(item.data());
+        _pointers.push_back(0);
+        return _pointers.data();
+    }
+
+private:
+    std::vector<QByteArray> _items;
+    std::vector<char *> _pointers;
+};
+
+int tileSize(const IOOptions& options) {
+    int size = options.value("tilesize", 256).toInt();
+    return std::max(16, (size + 15) / 16 * 16); // GeoTIFF tiles are a multiple of 16 pixels
+}
+}
+
+void RasterCoverageConnector::decode(GDALDataType type, const char *block, quint64 n, PIXVALUETYPE *values, const GdalOffsetScale& offsetScale, double nodata)
+{
+    switch (type) {
+    case GDT_Byte:
+        decodeValues<quint8>(block, n, values, offsetScale.scale, offsetScale.offset, nodata); break;
+    case GDT_Int16:
+        decodeValues<qint16>(block, n, values, offsetScale.scale, offsetScale.offset, nodata); break;
+    case GDT_UInt16:
+        decodeValues<quint16>(block, n, values, offsetScale.scale, offsetScale.offset, nodata); break;
+    case GDT_Int32:
+        decodeValues<qint32>(block, n, values, offsetScale.scale, offsetScale.offset, nodata); break;
+    case GDT_UInt32:
+        decodeValues<quint32>(block, n, values, offsetScale.scale, offsetScale.offset, nodata); break;
+    case GDT_Float32:
+        decodeValues<float>(block, n, values, offsetScale.scale, offsetScale.offset, nodata); break;
+    case GDT_Float64:
+        decodeValues<double>(block, n, values, offsetScale.scale, offsetScale.offset, nodata); break;
+    default:
+        std::fill(values, values + n, PIXVALUEUNDEF);
+    }
+}
+
 ConnectorInterface *RasterCoverageConnector::create(const Resource &resource, bool load, const IOOptions &options) {
     return new RasterCoverageConnector(resource, load, options);
 
@@ -88,6 +239,11 @@ bool RasterCoverageConnector::loadMetaData(IlwisObject *data, const IOOptions &o
 
         auto layerHandle = gdal()->getRasterBand(_handle->handle(), layer != iUNDEF  ? layer + 1 : 1);
         GDALColorInterp colorType = gdal()->colorInterpretation(layerHandle);
+        // a tiled source (e.g. a tiled GeoTIFF) keeps its tiling in the grid; a block of the grid is then read as one block of the source
+        int tileXSize = 0, tileYSize = 0;
+        gdal()->getBlockSize(layerHandle, &tileXSize, &tileYSize);
+        if ( tileXSize > 0 && tileYSize > 0 && tileXSize < (int)rastersize.xsize())
+            raster->tileSize(Size<>(tileXSize, tileYSize, 1));
         bool ok = false;
         if ( layer != iUNDEF){
             raster->size(rastersize);
@@ -472,16 +628,14 @@ void RasterCoverageConnector::setColorValues(GDALColorInterp colorType, std::vec
     }
 }
 
-void RasterCoverageConnector::readData(UPGrid& grid, GDALRasterBandH layerHandle, int inLayerBlockIndex, quint32 linesPerBlock, char *block, quint64 linesLeft) const
+void RasterCoverageConnector::readData(UPGrid& grid, GDALRasterBandH layerHandle, quint32 index, char *block) const
 {
-    CPLErr err;
-    if ( linesLeft > linesPerBlock)
-        err = gdal()->rasterIO(layerHandle,GF_Read,0,inLayerBlockIndex * linesPerBlock,grid->size().xsize(), linesPerBlock,
-                         block,grid->size().xsize(), linesPerBlock,_gdalValueType,0,0 );
-    else {
-        err = gdal()->rasterIO(layerHandle,GF_Read,0,inLayerBlockIndex * linesPerBlock,grid->size().xsize(), linesLeft,
-                         block,grid->size().xsize(), linesLeft,_gdalValueType,0,0 );
-    }
+    // the window of the block within its band; for a grid with the tiling of the source this is one block of the source
+    BoundingBox box = grid->blockBox(index);
+    int columns = box.xlength();
+    int lines = box.ylength();
+    CPLErr err = gdal()->rasterIO(layerHandle,GF_Read,box.min_corner().x,box.min_corner().y,columns, lines,
+                         block,columns, lines,_gdalValueType,0,0 );
     if ( err != CE_None){
         QString message( gdal()->getLastErrorMsg());
         if ( message != "")
@@ -489,27 +643,23 @@ void RasterCoverageConnector::readData(UPGrid& grid, GDALRasterBandH layerHandle
     }
 }
 
-bool RasterCoverageConnector::moveIndexes(quint32& linesPerBlock, quint64& linesLeft, int& inLayerBlockIndex)
+bool RasterCoverageConnector::isReentrant() const
 {
-    ++inLayerBlockIndex;
-    if ( linesLeft < linesPerBlock )
-        return false;
-    linesLeft -= linesPerBlock;
-
     return true;
 }
 
-bool RasterCoverageConnector::loadData(IlwisObject* data, const IOOptions& options ){
-	if (!getHandle(data)) {
-		return false;
-	}
-    quint32 bandindex = sourceRef().hasProperty("bandindex") ? sourceRef()["bandindex"].toUInt(): iUNDEF;
-    auto layerHandle = gdal()->getRasterBand(_handle->handle(), bandindex != iUNDEF ? bandindex + 1 : 1);
-    if (!layerHandle) {
-        ERROR2(ERR_COULD_NOT_LOAD_2, "GDAL","layer");
-        return false;
-    }
-    RasterCoverage *raster = static_cast<RasterCoverage *>(data);
+QVariantMap RasterCoverageConnector::statistics() const
+{
+    QVariantMap result = gdal()->datasets().statistics();
+    result["pooled"] = _poolFailedAt == 0;
+    return result;
+}
+
+void RasterCoverageConnector::prepareLoad()
+{
+    std::lock_guard<std::mutex> lock(_prepareMutex);
+    if ( _loadPrepared)
+        return;
 	if (sourceRef().hasProperty("scale"))
 	{
 		_offsetScales.resize(1);
@@ -531,67 +681,146 @@ bool RasterCoverageConnector::loadData(IlwisObject* data, const IOOptions& optio
 		} if (cmodel == "cmyka")
 			_colorModel = ColorRangeBase::cmCYMKA;
 	}
+    _loadPrepared = true;
+}
+
+bool RasterCoverageConnector::loadData(IlwisObject* data, const IOOptions& options ){
+    // every thread reads through a handle of its own from the pool; a source that the pool can't open by name uses the handle of the connector, one thread at a time.
+    // The failure may be passing (e.g. too many open files), so the pool is tried again after a while
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 failedAt = _poolFailedAt;
+    std::unique_ptr<PooledDataset> pooled(failedAt == 0 || now - failedAt >= POOLRETRYINTERVAL ? new PooledDataset(datasetName()) : 0);
+    std::unique_lock<std::mutex> sharedLock(_sharedHandleMutex, std::defer_lock);
+    GDALDatasetH dataset = pooled ? pooled->handle() : 0;
+    if ( pooled)
+        _poolFailedAt = dataset ? 0 : now;
+    if (!dataset) {
+        sharedLock.lock();
+        if (!getHandle(data) || !_handle)
+            return false;
+        dataset = _handle->handle();
+    }
+    prepareLoad();
+    quint32 bandindex = sourceRef().hasProperty("bandindex") ? sourceRef()["bandindex"].toUInt(): iUNDEF;
+    auto layerHandle = gdal()->getRasterBand(dataset, bandindex != iUNDEF ? bandindex + 1 : 1);
+    if (!layerHandle) {
+        ERROR2(ERR_COULD_NOT_LOAD_2, "GDAL","layer");
+        return false;
+    }
+    RasterCoverage *raster = static_cast<RasterCoverage *>(data);
 
     UPGrid& grid = raster->gridRef();
 
-    quint32 linesPerBlock = grid->maxLines();
-    qint64 blockSizeBytes = grid->blockSize(0) * _typeSize;
-    char *block = new char[blockSizeBytes];
-    quint64 totalLines =grid->size().ysize();
+    qint64 blockSizeBytes = grid->blockSize(0) * _typeSize; // no block is larger than the first
+    static thread_local std::vector<char> buffer; // the raw values of a block as GDAL delivers them; kept between the loads of blocks
+    if ( buffer.size() < blockSizeBytes)
+        buffer.resize(blockSizeBytes);
+    char *block = buffer.data();
     std::map<quint32, std::vector<quint32> > blocklimits;
 
     //blocklimits; key = band number, value= blocks needed from this band
-    if ( bandindex == iUNDEF)
-        blocklimits = grid->calcBlockLimits(options);
-    else{
-        for(int i = 0; i < std::ceil((double)totalLines / linesPerBlock); ++i)
-            blocklimits[bandindex].push_back(i);
+    blocklimits = grid->calcBlockLimits(options);
+    if ( bandindex != iUNDEF && blocklimits.size() > 0) { // the grid of a single band raster has one band; it is read from band bandindex of the source
+        auto blocks = blocklimits.begin()->second;
+        blocklimits.clear();
+        blocklimits[bandindex] = blocks;
     }
 
-	double nodata;
-	if (sourceRef().hasProperty("undefined")) {
-		nodata = sourceRef()["undefined"].toDouble();
-	}
-	else {
-		int ok;
-		nodata = gdal()->getUndefinedValue(layerHandle, &ok);
-		if (ok == 0)
-			nodata = rUNDEF;
-	}
-
     for(const auto& layer : blocklimits){
-        int inLayerBlockIndex = layer.second[0] % grid->blocksPerBand(); //
-        quint64 linesLeft = totalLines - grid->maxLines() * inLayerBlockIndex; //std::min((quint64)grid->maxLines(), totalLines - grid->maxLines() * layer.second[0]);
         if ( _colorModel == ColorRangeBase::cmNONE || raster->datadef().domain()->valueType() == itPALETTECOLOR){ // palette entries are just integers so we can use the numeric read for it
-            layerHandle = gdal()->getRasterBand(_handle->handle(), layer.first + 1);
+            layerHandle = gdal()->getRasterBand(dataset, layer.first + 1);
+            double nodata = undefinedValue(layerHandle);
             for(const auto& index : layer.second) {
                 quint32 offsetIndex = bandindex == iUNDEF ? layer.first : (layer.first - bandindex);
-                loadNumericBlock(layerHandle, index, inLayerBlockIndex, linesPerBlock, linesLeft, block, raster,offsetIndex, nodata );
-                if(!moveIndexes(linesPerBlock, linesLeft, inLayerBlockIndex))
-                    break;
+                loadNumericBlock(layerHandle, index, block, raster,offsetIndex, nodata );
             }
         }else { // continous colorcase, combining 3/4 (gdal)layers into one
             for(const auto& index : layer.second) {
-                loadColorBlock(layer.first,index,inLayerBlockIndex,linesPerBlock,linesLeft,block,grid);
-                if(!moveIndexes(linesPerBlock, linesLeft, inLayerBlockIndex)) // ensures that the administration with respect how much needs to be done is inorder
-                    break;
+                loadColorBlock(dataset, layer.first,index,block,grid);
             }
         }
     }
 
-    delete [] block;
     _binaryIsLoaded = true;
     return true;
 }
 
-void RasterCoverageConnector::loadColorBlock(quint32 ilwisLayer, quint32 index, quint32 inLayerBlockIndex, quint32 linesPerBlock, quint64 linesLeft,char *block, UPGrid& grid) const{
+double RasterCoverageConnector::undefinedValue(GDALRasterBandH band) const
+{
+    if (source().hasProperty("undefined"))
+        return source()["undefined"].toDouble();
+    int ok;
+    double nodata = gdal()->getUndefinedValue(band, &ok);
+    return ok == 0 ? rUNDEF : nodata;
+}
+
+bool RasterCoverageConnector::loadOverview(IlwisObject *data, quint32 level, IlwisObject *overview)
+{
+    RasterCoverage *raster = static_cast<RasterCoverage *>(data);
+    // only numeric values; the overviews of a file with classes or colors may have been averaged
+    if ( _colorModel != ColorRangeBase::cmNONE || raster->datadef().domain()->ilwisType() != itNUMERICDOMAIN)
+        return false;
+    PooledDataset pooled(datasetName());
+    std::unique_lock<std::mutex> sharedLock(_sharedHandleMutex, std::defer_lock);
+    GDALDatasetH dataset = pooled.handle();
+    if (!dataset) {
+        sharedLock.lock();
+        if (!getHandle(data) || !_handle)
+            return false;
+        dataset = _handle->handle();
+    }
+
+    IRasterCoverage target;
+    target.set(static_cast<RasterCoverage *>(overview));
+    Size<> sz = target->size();
+    quint32 bandindex = sourceRef().hasProperty("bandindex") ? sourceRef()["bandindex"].toUInt(): iUNDEF;
+    std::vector<GDALRasterBandH> handles;
+    for(quint32 z = 0; z < sz.zsize(); ++z) {
+        auto layerHandle = gdal()->getRasterBand(dataset, (bandindex != iUNDEF ? bandindex : z) + 1);
+        if (!layerHandle)
+            return false;
+        // the overview levels of a file need not be consecutive powers of two; the one with the size of this level is used
+        GDALRasterBandH overviewHandle = 0;
+        for(int i = 0; i < gdal()->getOverviewCount(layerHandle) && !overviewHandle; ++i) {
+            auto candidate = gdal()->getOverview(layerHandle, i);
+            if ( candidate && gdal()->bandXSize(candidate) == (int)sz.xsize() && gdal()->bandYSize(candidate) == (int)sz.ysize())
+                overviewHandle = candidate;
+        }
+        if (!overviewHandle)
+            return false;
+        handles.push_back(overviewHandle);
+    }
+
+    std::vector<double> values(sz.xsize());
+    PixelIterator iter(target);
+    for(quint32 z = 0; z < sz.zsize(); ++z) {
+        double nodata = undefinedValue(handles[z]); // bands may differ in their nodata
+        quint32 offsetIndex = bandindex == iUNDEF ? z : 0;
+        bool hasScaleOffset = offsetIndex < _offsetScales.size() && _offsetScales[offsetIndex].offset != rUNDEF && _offsetScales[offsetIndex].scale != rUNDEF;
+        for(quint32 y = 0; y < sz.ysize(); ++y) {
+            if ( gdal()->rasterIO(handles[z], GF_Read, 0, y, sz.xsize(), 1, (void *)&values[0], sz.xsize(), 1, GDT_Float64, 0, 0) != CE_None)
+                return false;
+            for(double v : values) {
+                if (std::isnan(v) || std::isinf(v) || v == nodata)
+                    v = rUNDEF;
+                else if (hasScaleOffset)
+                    v = v * _offsetScales[offsetIndex].scale + _offsetScales[offsetIndex].offset;
+                *iter = v;
+                ++iter;
+            }
+        }
+    }
+    return true;
+}
+
+void RasterCoverageConnector::loadColorBlock(GDALDatasetH dataset, quint32 ilwisLayer, quint32 index, char *block, UPGrid& grid) const{
     std::vector<double> values;
     // ilwis color layers consist of 3 or 4 gdal layers
     quint32 noOfComponents = _hasTransparency ? 4 : 3; // do we have a transparency layer?
     for( int component = 0; component < noOfComponents ; ++component){
-        auto layerHandle = gdal()->getRasterBand(_handle->handle(), noOfComponents * ilwisLayer + component + 1);
+        auto layerHandle = gdal()->getRasterBand(dataset, noOfComponents * ilwisLayer + component + 1);
         GDALColorInterp colorType = gdal()->colorInterpretation(layerHandle);
-        readData(grid, layerHandle, inLayerBlockIndex, linesPerBlock, block, linesLeft);
+        readData(grid, layerHandle, index, block);
 
         quint32 noItems = grid->blockSize(index);
         if ( noItems == iUNDEF)
@@ -605,35 +834,38 @@ void RasterCoverageConnector::loadColorBlock(quint32 ilwisLayer, quint32 index,
 
 void RasterCoverageConnector::loadNumericBlock(GDALRasterBandH layerHandle,
                                                quint32 index,
-                                               quint32 inLayerBlockIndex,
-                                               quint32 linesPerBlock,
-                                               quint64 linesLeft,
                                                char *block, RasterCoverage *raster,
                                                int bandIndex, double nodata) const {
     UPGrid& grid = raster->gridRef();
-    readData(grid, layerHandle, inLayerBlockIndex, linesPerBlock, block, linesLeft);
+    readData(grid, layerHandle, index, block);
     
     quint32 noItems = grid->blockSize(index);
     if ( noItems == iUNDEF)
         return ;
-    std::vector<double> values(noItems, rUNDEF);
+    static thread_local std::vector<PIXVALUETYPE> decoded;
+    if ( decoded.size() < noItems)
+        decoded.resize(noItems);
     if (bandIndex < _offsetScales.size()) {
-        bool hasScaleOffset = _offsetScales[bandIndex].offset != rUNDEF && _offsetScales[bandIndex].scale != rUNDEF;
-        for (quint32 i = 0; i < noItems; ++i) {
-            double v = value(block, i);
-            if (std::isnan(v) || std::isinf(v))
-                continue;
-
-            if (hasScaleOffset)
-                v = v * _offsetScales[bandIndex].scale + _offsetScales[bandIndex].offset;
-
-            if (nodata == rUNDEF)
-                values[i] = v;
-            else
-                values[i] =nodata == v ? rUNDEF : v;
+        const GdalOffsetScale& offsetScale = _offsetScales[bandIndex];
+        bool written = false;
+        switch (_gdalValueType) {
+        case GDT_Byte:
+            written = writeNative<quint8>(grid, index, block, offsetScale.scale, offsetScale.offset, nodata); break;
+        case GDT_Int16:
+            written = writeNative<qint16>(grid, index, block, offsetScale.scale, offsetScale.offset, nodata); break;
+        case GDT_UInt16:
+            written = writeNative<quint16>(grid, index, block, offsetScale.scale, offsetScale.offset, nodata); break;
+        case GDT_Int32:
+            written = writeNative<qint32>(grid, index, block, offsetScale.scale, offsetScale.offset, nodata); break;
+        default:
+            break;
         }
-    } // else we are trying to read beyond the available data, perhaps because a new band was added; just return the undef block
-    grid->setBlockData(index, values);
+        if ( written)
+            return;
+        decode(_gdalValueType, block, noItems, decoded.data(), offsetScale, nodata);
+    } else // we are trying to read beyond the available data, perhaps because a new band was added; just return the undef block
+        std::fill(decoded.begin(), decoded.begin() + noItems, PIXVALUEUNDEF);
+    grid->writeBlock(index, decoded.data(), PIXVALUEUNDEF);
 }
 
 bool RasterCoverageConnector::setGeotransform(RasterCoverage *raster,GDALDatasetH dataset) {
@@ -672,8 +904,112 @@ bool RasterCoverageConnector::loadDriver()
 
 
 
+template<typename DT> bool RasterCoverageConnector::save(RasterCoverage *prasterCoverage, GDALDatasetH dataset,GDALDataType gdaltype){
+    IRasterCoverage raster;
+    raster.set(prasterCoverage);
+    Size<> sz = raster->size();
+    bool isFloat = gdaltype == GDT_Float32 || gdaltype == GDT_Float64;
+    DT undefined = undef<DT>();
+    for(quint32 z = 0; z < sz.zsize(); ++z) {
+        GDALRasterBandH hband = gdal()->getRasterBand(dataset, z + 1);
+        if (!hband) {
+            return ERROR1(ERR_NO_INITIALIZED_1,"raster band");
+        }
+        if ( gdaltype != GDT_Byte) // every byte value is valid; undefined pixels become 0, as before
+            gdal()->setUndefinedValue(hband, undefined);
+    }
+    int blockXSize, blockYSize;
+    gdal()->getBlockSize(gdal()->getRasterBand(dataset, 1), &blockXSize, &blockYSize);
+    quint64 rowBytes = (quint64)sz.xsize() * sizeof(DT);
+    quint32 rows = std::max<quint64>(blockYSize, STRIPBYTES / (rowBytes * blockYSize) * blockYSize);
+    rows = std::min(rows, (quint32)sz.ysize());
+    quint32 stripsPerBand = (sz.ysize() + rows - 1) / rows;
+
+    std::vector<DT> buffers[2] = { std::vector<DT>((quint64)rows * sz.xsize()), std::vector<DT>((quint64)rows * sz.xsize()) };
+    StripWriter writer;
+    bool nested = TaskScheduler::currentThreadIndex() != 0; // saved from a task, the caches of the grid are those of the operation that runs it
+    if (!nested)
+        raster->gridRef()->prepare4Operation(taskscheduler()->threadCount());
+    bool ok = true;
+    for(quint32 strip = 0; strip < stripsPerBand * sz.zsize() && ok; ++strip) {
+        quint32 z = strip / stripsPerBand;
+        quint32 ystart = (strip % stripsPerBand) * rows;
+        quint32 nrows = std::min(rows, (quint32)sz.ysize() - ystart);
+        std::vector<DT>& buffer = buffers[strip % 2];
+        ok = taskscheduler()->run((nrows + ROWSPERWRITETASK - 1) / ROWSPERWRITETASK, [&](quint32 task, int threadIndex)->bool{
+            quint32 y = ystart + task * ROWSPERWRITETASK;
+            quint32 yend = std::min(ystart + nrows, y + ROWSPERWRITETASK) - 1;
+            PixelIterator iter(raster, threadIndex, BoundingBox(Pixel(0, y, z), Pixel(sz.xsize() - 1, yend, z)));
+            DT *out = buffer.data() + (quint64)(y - ystart) * sz.xsize();
+            quint64 n = (quint64)(yend - y + 1) * sz.xsize();
+            for(quint64 i = 0; i < n; ) {
+                PixelSpan span = iter.span();
+                if ( span._length == 0)
+                    return false;
+                qint32 length = std::min<quint64>(span._length, n - i);
+                for(qint32 j = 0; j < length; ++j) {
+                    PIXVALUETYPE v = span[j];
+                    out[i + j] = v == PIXVALUEUNDEF ? undefined : (isFloat ? (DT)v : (DT)(qint64)floor(0.5 + v));
+                }
+                i += length;
+                iter += length;
+            }
+            return true;
+        });
+        if (!ok)
+            break;
+        ok = writer.write(gdal()->getRasterBand(dataset, z + 1), ystart, sz.xsize(), nrows, (void *)buffer.data(), gdaltype);
+    }
+    ok = writer.finish() && ok;
+    if (!nested)
+        raster->gridRef()->unprepare4Operation();
+    if (!ok)
+        kernel()->issues()->log(QString(gdal()->getLastErrorMsg()));
+    return ok;
+}
+
+bool RasterCoverageConnector::storeCloudOptimized(GDALDatasetH source, const QString &filename, const IOOptions &options, bool average) const
+{
+    int tile = tileSize(options);
+    int extent = std::max(gdal()->xsize(source), gdal()->ysize(source));
+    std::vector<int> levels;
+    for(int factor = 2; extent / (factor / 2) > tile; factor *= 2) // until the smallest overview fits in one tile
+        levels.push_back(factor);
+    if ( levels.size() > 0 && gdal()->buildOverviews(source, average ? "AVERAGE" : "NEAREST", levels.size(), levels.data(), 0, 0, 0, 0) != CE_None) {
+        kernel()->issues()->log(QString(gdal()->getLastErrorMsg()));
+        return false;
+    }
+
+    CreationOptions creation;
+    creation.add("COMPRESS", options.value("compress", "LZW").toString().toUpper());
+    creation.add("NUM_THREADS", QString::number(taskscheduler()->threadCount()));
+    creation.add("BIGTIFF", "IF_SAFER");
+    GDALDriverH driver = gdal()->getGDALDriverByName("COG");
+    if ( driver) {
+        creation.add("BLOCKSIZE", QString::number(tile));
+        creation.add("OVERVIEWS", "FORCE_USE_EXISTING");
+    } else { // GDAL before 3.1; a tiled GeoTIFF copied with its overviews has the same layout, the overviews before the full resolution data
+        driver = _driver;
+        creation.add("TILED", "YES");
+        creation.add("BLOCKXSIZE", QString::number(tile));
+        creation.add("BLOCKYSIZE", QString::number(tile));
+        creation.add("COPY_SRC_OVERVIEWS", "YES");
+    }
+    GDALDatasetH target = gdal()->createCopy(driver, filename.toLocal8Bit(), source, FALSE, creation.list(), 0, 0);
+    if (!target) {
+        kernel()->issues()->log(QString(gdal()->getLastErrorMsg()));
+        return false;
+    }
+    gdal()->close(target);
+    return true;
+}
+
 bool RasterCoverageConnector::store(IlwisObject *obj, const IOOptions &options )
 {
+    // a cloud optimized GeoTIFF is written in two passes: the data goes to a temporary tiled file, which is copied with its overviews
+    bool cog = options.value("cog", false).toBool();
+    if ( cog && format() != "GTiff")
+        return ERROR2(ERR_OPERATION_NOTSUPPORTED2, "cloud optimized output", format());
     if(!loadDriver())
         return false;
 
@@ -695,16 +1031,28 @@ bool RasterCoverageConnector::store(IlwisObject *obj, const IOOptions &options )
 		filename = options["outputname"].toString();
 	}else
 		filename = constructOutputName(_driver);
+    gdal()->datasets().close(filename); // idle handles of the pool would still see the previous content
 
     bool isColorMap = currentDef.domain()->ilwisType() == itCOLORDOMAIN;
     bool ispaletteMap = currentDef.domain()->valueType() == itPALETTECOLOR;
 
-    GDALDatasetH dataset = 0;
-    if ( ispaletteMap && format() == "GTiff"){
-        char options[20] = "PHOTOMETRIC=PALETTE";
-        dataset = gdal()->create( _driver, filename.toLocal8Bit(), sz.xsize(), sz.ysize(),  sz.zsize(), gdalType, (char **)options);
-    }else
-        dataset = gdal()->create( _driver, filename.toLocal8Bit(), sz.xsize(), sz.ysize(),  isColorMap ?  sz.zsize() * 3 : sz.zsize(), gdalType, 0 );
+    QString datafile = cog ? filename + ".tmp.tif" : filename;
+    CreationOptions creation;
+    if ( format() == "GTiff") {
+        if ( ispaletteMap)
+            creation.add("PHOTOMETRIC", "PALETTE");
+        if ( cog || options.value("tiled", false).toBool()) {
+            creation.add("TILED", "YES");
+            creation.add("BLOCKXSIZE", QString::number(tileSize(options)));
+            creation.add("BLOCKYSIZE", QString::number(tileSize(options)));
+        }
+        if ( !cog && options.contains("compress")) { // the temporary file of a cloud optimized one is left uncompressed, it is compressed while it is copied
+            creation.add("COMPRESS", options["compress"].toString().toUpper());
+            creation.add("NUM_THREADS", QString::number(taskscheduler()->threadCount()));
+        }
+        creation.add("BIGTIFF", "IF_SAFER");
+    }
+    GDALDatasetH dataset = gdal()->create( _driver, datafile.toLocal8Bit(), sz.xsize(), sz.ysize(),  isColorMap && !ispaletteMap ?  sz.zsize() * 3 : sz.zsize(), gdalType, creation.list());
     if ( dataset == 0) {
         return ERROR2(ERR_COULDNT_CREATE_OBJECT_FOR_2, "data set",_fileUrl.toLocalFile());
     }
@@ -712,8 +1060,11 @@ bool RasterCoverageConnector::store(IlwisObject *obj, const IOOptions &options )
     if (ok)
         ok = setSRS(raster, dataset);
 
-    if (!ok)
+    if (!ok) {
+        if ( cog)
+            QFile::remove(datafile);
         return false;
+    }
 
     if ( isColorMap ){
         ok = storeColorRaster(raster, dataset)    ;
@@ -737,8 +1088,12 @@ bool RasterCoverageConnector::store(IlwisObject *obj, const IOOptions &options )
             ok= ERROR1(ERR_NO_INITIALIZED_1, "gdal Data type");
         }
     }
+    if ( ok && cog)
+        ok = storeCloudOptimized(dataset, filename, options, raster->datadef().domain()->ilwisType() == itNUMERICDOMAIN);
 
     gdal()->close(dataset);
+    if ( cog)
+        QFile::remove(datafile);
 
     return ok;
 }
@@ -36,6 +36,9 @@ public:
 
     bool loadMetaData(IlwisObject *data, const IOOptions &options);
     bool loadData(Ilwis::IlwisObject *data, const IOOptions& options = IOOptions()) ;
+    bool loadOverview(IlwisObject *data, quint32 level, IlwisObject *overview);
+    bool isReentrant() const;
+    QVariantMap statistics() const;
 
     static ConnectorInterface *create(const Ilwis::Resource &resource, bool load=true,const IOOptions& options=IOOptions());
     Ilwis::IlwisObject *create() const;
@@ -53,69 +56,42 @@ private:
     ColorRangeBase::ColorModel _colorModel = ColorRangeBase::cmNONE;
     bool _hasTransparency = false;   
     GdalOffsetScales _offsetScales;
+    std::mutex _prepareMutex;
+    bool _loadPrepared = false;
+    std::atomic<qint64> _poolFailedAt{0}; // the time (msecs since the epoch) the pool last failed to open the source by its name; 0 if it didn't
+    std::mutex _sharedHandleMutex; // guards the use of the handle of the connector when the source isn't pooled
 
 
     double value(char *block, int index) const;
+    static void decode(GDALDataType type, const char *block, quint64 n, PIXVALUETYPE *values, const GdalOffsetScale& offsetScale, double nodata);
     bool setGeotransform(RasterCoverage *raster, GDALDatasetH dataset);
     void setColorValues(GDALColorInterp colorType, std::vector<double> &values, quint32 noItems, char *block) const;
-    void readData(UPGrid& grid, GDALRasterBandH layerHandle, int gdalindex, quint32 linesPerBlock, char *block, quint64 linesLeft) const;
+    void readData(UPGrid& grid, GDALRasterBandH layerHandle, quint32 index, char *block) const;
+    /*!
+     * \brief undefinedValue the nodata value of a band; the "undefined" property of the source overrides it
+     */
+    double undefinedValue(GDALRasterBandH band) const;
 
     bool saveByteBand(RasterCoverage *prasterCoverage, GDALDatasetH dataset, int gdalindex, int band, GDALColorInterp colorType);
 
 
-    template<typename DT> bool save(RasterCoverage *prasterCoverage, GDALDatasetH dataset,GDALDataType gdaltype){
-        quint32 columns = prasterCoverage->size().xsize();
-        IRasterCoverage raster;
-        raster.set(prasterCoverage);
-        PixelIterator iter(raster);
-        int bandcount = 1;
-        std::vector<DT> data(columns);
-        GDALRasterBandH hband = gdal()->getRasterBand(dataset,bandcount);
-        if (!hband) {
-            return ERROR1(ERR_NO_INITIALIZED_1,"raster band");
-        }
-        while(iter != iter.end()) {
-            if (gdaltype == GDT_Float32 || gdaltype == GDT_Float64) {
-                for_each(data.begin(), data.end(), [&](DT& v){
-                    v = *iter;
-                    ++iter;
-                });
-            } else {
-                for_each(data.begin(), data.end(), [&](DT& v){
-                    v = (qint64)floor(0.5 + *iter);
-                    ++iter;
-                });
-            }
-
-            double y = iter.zchanged() ? iter.box().ylength()  : iter.position().y;
-
-            if(iter == iter.end()){
-                y = iter.box().ylength();
-            }
-
-            gdal()->rasterIO(hband, GF_Write, 0, y - 1, columns, 1, (void *)&data[0],columns,1, gdaltype,0,0 );
-
-            if ( iter.zchanged()) {
-                if (bandcount == raster->size().zsize())
-                    break;
-                hband = gdal()->getRasterBand(dataset,++bandcount);
-                if (hband == 0)
-                    break;
-            }
-        }
-        return true;
-    }
+    /*!
+     * \brief save writes the bands of a numeric raster in strips of whole GDAL blocks. The values of a strip are converted to DT by the tasks of the scheduler while
+     * GDAL writes (and, with compression, encodes) the previous strip
+     */
+    template<typename DT> bool save(RasterCoverage *prasterCoverage, GDALDatasetH dataset,GDALDataType gdaltype);
+    bool storeCloudOptimized(GDALDatasetH source, const QString& filename, const IOOptions &options, bool average) const;
 
     bool loadDriver();
+    void prepareLoad();
     DataDefinition createDataDef(double vmin, double vmax, double resolution, bool accurate, GdalOffsetScale gdalOffsetScale);
     DataDefinition createDataDefColor(std::map<int, int> &vminRaster, std::map<int, int> &vmaxRaster);
-    void loadNumericBlock(GDALRasterBandH bandhandle, quint32 index, quint32 gdalindex, quint32 linesPerBlock, quint64 linesLeft, char *block, Ilwis::RasterCoverage *raster, int bandIndex, double nodata) const;
-    void loadColorBlock(quint32 ilwisLayer, quint32 index, quint32 gdalindex, quint32 linesPerBlock, quint64 linesLeft, char *block, UPGrid &grid) const;
+    void loadNumericBlock(GDALRasterBandH bandhandle, quint32 index, char *block, Ilwis::RasterCoverage *raster, int bandIndex, double nodata) const;
+    void loadColorBlock(GDALDatasetH dataset, quint32 ilwisLayer, quint32 index, char *block, UPGrid &grid) const;
     bool handleNumericCase(const Size<> &rastersize, RasterCoverage *raster);
     bool handleColorCase(const Size<> &rastersize, RasterCoverage *raster, GDALColorInterp colorType);
     bool handlePaletteCase(Size<> &rastersize, RasterCoverage *raster);
 
-    bool moveIndexes(quint32 &linesPerBlock, quint64 &linesLeft, int &gdalindex);
     bool storeColorRaster(RasterCoverage *raster, GDALDatasetH dataset);
     bool handleNumericLayerCase(int layer, RasterCoverage *raster);
 };
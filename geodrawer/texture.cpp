@@ -118,8 +118,9 @@ const TextureData & Texture::data() const {
 
 bool Texture::DrawTexture(long offsetX, long offsetY, long texSizeX, long texSizeY, unsigned int zoomFactor, TextureData & texture_data, volatile bool* fDrawStop)
 {
-    long imageWidth = _raster->size().xsize();
-    long imageHeight = _raster->size().ysize();
+    IRasterCoverage raster = overview(offsetX, offsetY, texSizeX, texSizeY, zoomFactor);
+    long imageWidth = raster->size().xsize();
+    long imageHeight = raster->size().ysize();
     long sizeX = texSizeX; // the size of the input (pixeliterator)
     long sizeY = texSizeY;
     if (offsetX + sizeX > imageWidth)
@@ -139,7 +140,7 @@ bool Texture::DrawTexture(long offsetX, long offsetY, long texSizeX, long texSiz
     quint32 size = texSizeX * texSizeY * 4; // r,g,b,a
     if (texture_data.size() == 0)
         texture_data.resize(size); // allowed the first time only; after this the vector will always be in-use by a webGL object
-    PixelIterator pixIter(_raster, bb); // This iterator runs through bb. The corners of bb are "inclusive".
+    PixelIterator pixIter(raster, bb); // This iterator runs through bb. The corners of bb are "inclusive".
 
     if (*fDrawStop)
         return false;
@@ -187,6 +188,25 @@ bool Texture::DrawTexture(long offsetX, long offsetY, long texSizeX, long texSiz
 	return true;
 }
 
+IRasterCoverage Texture::overview(long& offsetX, long& offsetY, long& texSizeX, long& texSizeY, unsigned int& zoomFactor) const
+{
+    // a zoom factor that is a power of two is served by the overview of that level; its pixels summarize the pixels that would otherwise be skipped
+    if (zoomFactor <= 1 || (zoomFactor & (zoomFactor - 1)) != 0 || offsetX % zoomFactor != 0 || offsetY % zoomFactor != 0 || texSizeX % zoomFactor != 0 || texSizeY % zoomFactor != 0)
+        return _raster;
+    quint32 level = 0;
+    while ((1u << level) < zoomFactor)
+        ++level;
+    IRasterCoverage raster = _raster->overview(level);
+    if (!raster.isValid())
+        return _raster;
+    offsetX /= zoomFactor;
+    offsetY /= zoomFactor;
+    texSizeX /= zoomFactor;
+    texSizeY /= zoomFactor;
+    zoomFactor = 1;
+    return raster;
+}
+
 double Texture::getStretchedValue(double value, const NumericRange& actualRange, const NumericRange& stretchRange) const
 {
     if (value == rUNDEF)
@@ -213,8 +233,9 @@ double Texture::getStretchedValue(double value, const NumericRange& actualRange,
 
 bool Texture::DrawTexturePaletted(long offsetX, long offsetY, long texSizeX, long texSizeY, unsigned int zoomFactor, TextureData & texture_data, volatile bool* fDrawStop)
 {
-    long imageWidth = _raster->size().xsize();
-    long imageHeight = _raster->size().ysize();
+    IRasterCoverage raster = overview(offsetX, offsetY, texSizeX, texSizeY, zoomFactor);
+    long imageWidth = raster->size().xsize();
+    long imageHeight = raster->size().ysize();
     long sizeX = texSizeX; // the size of the input (pixeliterator)
     long sizeY = texSizeY;
     if (offsetX + sizeX > imageWidth)
@@ -234,7 +255,7 @@ bool Texture::DrawTexturePaletted(long offsetX, long offsetY, long texSizeX, lon
     quint32 size = texSizeX * texSizeY;
     if (texture_data.size() == 0)
         texture_data.resize(size); // allowed the first time only; after this the vector will always be in-use by a webGL object
-    PixelIterator pixIter(_raster, bb); // This iterator runs through bb. The corners of bb are "inclusive".
+    PixelIterator pixIter(raster, bb); // This iterator runs through bb. The corners of bb are "inclusive".
 
     if (*fDrawStop)
         return false;
@@ -252,7 +273,7 @@ bool Texture::DrawTexturePaletted(long offsetX, long offsetY, long texSizeX, lon
             quint32 position = 0;
             while (pixIter != end && position < size) {
                 double value = *pixIter;
-                int index = isNumericalUndef2(value, _raster) ? 0 : 1 + (iPaletteSize - 2) * getStretchedValue(value, actualRange, stretchRange);
+                int index = isNumericalUndef2(value, raster) ? 0 : 1 + (iPaletteSize - 2) * getStretchedValue(value, actualRange, stretchRange);
                 texture_data[position] = index; // int32 to quint8 conversion (do we want this?)
                 pixIter += zoomFactor;
                 if (pixIter.ychanged()) {
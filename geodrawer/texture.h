@@ -46,6 +46,7 @@ namespace Ilwis {
         protected:
             bool DrawTexture(long offsetX, long offsetY, long texSizeX, long texSizeY, unsigned int zoomFactor,TextureData & texture_data, volatile bool* fDrawStop);
             bool DrawTexturePaletted(long offsetX, long offsetY, long texSizeX, long texSizeY, unsigned int zoomFactor, TextureData & texture_data, volatile bool* fDrawStop);
+            IRasterCoverage overview(long& offsetX, long& offsetY, long& texSizeX, long& texSizeY, unsigned int& zoomFactor) const;
             double getStretchedValue(double value, const NumericRange& actualRange, const NumericRange& stretchRange) const;
             TextureData texture_data;
             const unsigned long sizeX, sizeY;
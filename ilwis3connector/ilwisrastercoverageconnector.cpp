@@ -355,31 +355,100 @@ qint64  RasterCoverageConnector::conversion(QFile& file, Grid *grid, int& count)
 
     return totalRead;
 }
-void RasterCoverageConnector::loadBlock(UPGrid& grid,QFile& file, quint32 blockIndex, quint32 fileBlock) {
-    qint64 blockSizeBytes = grid->blockSize(0) * _storesize;
+void RasterCoverageConnector::loadBlock(UPGrid& grid,QFile& file, quint32 blockIndex) {
+    quint32 noItems = grid->blockSize(blockIndex);
+    if ( noItems == iUNDEF)
+        return; // we are trying to read beyond the available data, perhaps because a new band was added; just return
+    // the data file holds the lines of a band one after the other; a strip is one read, a tile is read line by line
+    BoundingBox box = grid->blockBox(blockIndex);
+    quint64 xsize = grid->size().xsize();
+    bool strip = box.xlength() == xsize;
+    qint32 lastLine = strip ? box.min_corner().y : box.max_corner().y;
+    quint64 bytesPerRead = (quint64)box.xlength() * (strip ? box.ylength() : 1) * _storesize;
+    QByteArray bytes;
+    for(qint32 y = box.min_corner().y; y <= lastLine; ++y) {
+        if (!file.seek((y * xsize + box.min_corner().x) * _storesize)) {
+            ERROR2(ERR_COULD_NOT_OPEN_READING_2,file.fileName(),TR("seek failed"));
+            return;
+        }
+        bytes.append(file.read(bytesPerRead));
+    }
+    double sentinel;
+    bool hasUndef = undefSentinel(_storetype, sentinel); // the same undef as a mapped block, so the file reads the same either way
+    noItems = std::min((quint64)noItems, (quint64)bytes.size() / _storesize);
+    vector<double> values(noItems);
+    for (quint32 i = 0; i < noItems; ++i) {
+        double v = value(bytes.constData(), i);
+        if (_converter.isNeutral())
+            values[i] = hasUndef && v == sentinel ? rUNDEF : v;
+        else
+            values[i] = _converter.raw2real(v);
+    }
+    grid->setBlockData(blockIndex, values);
+}
 
-    quint64 seekPos = fileBlock * blockSizeBytes;
-    if (file.seek(seekPos)) {
-        QByteArray bytes = file.read(blockSizeBytes);
-        quint32 noItems = grid->blockSize(blockIndex);
-        if (noItems != iUNDEF) {
-            vector<double> values(noItems);
-            for (quint32 i = 0; i < noItems; ++i) {
-                double v = value(bytes.constData(), i);
-                if (_converter.isNeutral()) {
-                    if (v != iILW3UNDEF && v != shILW3UNDEF)
-                        values[i] = v;
-                    else
-                        values[i] = rUNDEF;
-                }
-                else
-                    values[i] = _converter.raw2real(v);
-            }
-            grid->setBlockData(blockIndex, values);
-        } // else we are trying to read beyond the available data, perhaps because a new band was added; just return
-    }else
-        ERROR2(ERR_COULD_NOT_OPEN_READING_2,file.fileName(),TR("seek failed"));
+/*!
+ * \brief RasterCoverageConnector::mapBlock lets a block of the grid refer to the data file directly; only possible if the values in the file need no conversion
+ * and the block is a full width strip, so that its values are contiguous in the file
+ */
+bool RasterCoverageConnector::mapBlock(UPGrid &grid, const SPMappedFile &mapped, quint32 blockIndex)
+{
+    if ( grid->blocksPerRow() != 1)
+        return false;
+    BoundingBox box = grid->blockBox(blockIndex);
+    if ( !box.isValid())
+        return false;
+    quint64 seekPos = (quint64)box.min_corner().y * grid->size().xsize() * _storesize;
+    double sentinel;
+    switch(_storetype){
+    case itUINT8:
+    case itINT16:
+    case itINT32:
+    case itFLOAT:
+    case itDOUBLE:
+        return grid->mapBlock(blockIndex, mapped, seekPos, _storetype, undefSentinel(_storetype, sentinel), sentinel);
+    }
+    return false;
+}
 
+/*!
+ * \brief RasterCoverageConnector::undefSentinel the value that marks undefined pixels in a data file without a conversion; used by both mapped and loaded blocks
+ * \return false if the store type has no undef
+ */
+bool RasterCoverageConnector::undefSentinel(IlwisTypes storetype, double &sentinel)
+{
+    switch(storetype){
+    case itINT16:
+        sentinel = shILW3UNDEF;
+        return true;
+    case itINT32:
+        sentinel = iILW3UNDEF;
+        return true;
+    case itDOUBLE:
+        sentinel = rUNDEF;
+        return true;
+    default: // the byte and float stores have no undef
+        sentinel = rUNDEF;
+        return false;
+    }
+}
+
+SPMappedFile RasterCoverageConnector::mappedFile(quint32 layer, const QString &path)
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN // ilwis3 data files are little endian
+    if ( !_converter.isNeutral() || !ilwisconfig("system-settings/map-raster-files", true))
+        return SPMappedFile();
+    auto iter = _mappedFiles.find(layer);
+    if ( iter != _mappedFiles.end())
+        return iter->second;
+    SPMappedFile mapped(new MappedFile(path));
+    if ( !mapped->isValid())
+        mapped.reset();
+    _mappedFiles[layer] = mapped;
+    return mapped;
+#else
+    return SPMappedFile();
+#endif
 }
 
 bool RasterCoverageConnector::loadData(IlwisObject* data, const IOOptions &options)
@@ -410,9 +479,15 @@ bool RasterCoverageConnector::loadData(IlwisObject* data, const IOOptions &optio
             return ERROR1(ERR_COULD_NOT_OPEN_READING_1,datafile);
         }
 
+        SPMappedFile mapped = mappedFile(layer.first, localfile.absoluteFilePath());
         for(const auto& index : layer.second) {
-            quint32 fileBlock = index - layer.first * grid->blocksPerBand();
-            loadBlock(grid, file, index, fileBlock );
+            if ( !mapped || !mapBlock(grid, mapped, index))
+                loadBlock(grid, file, index);
+        }
+        if ( mapped) { // the other blocks of the band refer to the file as well; they don't have to come through loadData anymore
+            quint32 firstBlock = layer.first * grid->blocksPerBand();
+            for(quint32 index = firstBlock; index < firstBlock + grid->blocksPerBand(); ++index)
+                mapBlock(grid, mapped, index);
         }
 
         file.close();
@@ -455,6 +530,8 @@ bool RasterCoverageConnector::storeBinaryData(IlwisObject *obj)
     QString filename;
 
     filename = inf.absolutePath() + "/" + QString(inf.baseName()).replace(QRegExp("[/ .'\"]"),"_") + ".mp#";
+    raster->gridRef()->unmapBlocks(); // the file may be the one the grid refers to
+    _mappedFiles.clear();
 
     Size<> sz = raster->size();
     bool ok = false;
@@ -47,7 +47,10 @@ private:
     bool storeMetaDataMapList(Ilwis::IlwisObject *obj);
     QString getGrfName(const IRasterCoverage &raster);
     bool setDataType(IlwisObject *data, const Ilwis::IOOptions &options);
-    void loadBlock(UPGrid &grid, QFile &file, quint32 blockIndex, quint32 fileBlock);
+    void loadBlock(UPGrid &grid, QFile &file, quint32 blockIndex);
+    bool mapBlock(UPGrid &grid, const SPMappedFile& mapped, quint32 blockIndex);
+    static bool undefSentinel(IlwisTypes storetype, double& sentinel);
+    SPMappedFile mappedFile(quint32 layer, const QString& path);
     void updateConverter(const IniFile & odf);
 
     template<typename T> bool save(std::ofstream& output_file,const RawConverter& conv, const IRasterCoverage& raster, const Size<>& sz) const{
@@ -82,6 +85,7 @@ private:
     }
 
     vector<QUrl> _dataFiles;
+    std::map<quint32, SPMappedFile> _mappedFiles; // data files per layer that are mapped in memory
     int _storesize;
     IlwisTypes _storetype;
     IlwisTypes _dataType;
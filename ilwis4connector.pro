@@ -36,9 +36,11 @@ SOURCES += \
    ilwis4connector/ilwis4georefconnector.cpp \
    ilwis4connector/ilwis4objectfactory.cpp \
    ilwis4connector/ilwis4rasterconnector.cpp \
+   ilwis4connector/ilwis4rasterchunks.cpp \
    ilwis4connector/ilwis4representationconnector.cpp \
    ilwis4connector/ilwis4scriptconnector.cpp \
    ilwis4connector/ilwis4tableconnector.cpp \
+   ilwis4connector/ilwis4tablecolumns.cpp \
    ilwis4connector/ilwis4workflowconnector.cpp \
    ilwis4connector/iwis4connectormodule.cpp \
    ilwis4connector/qtcsv/sources/contentiterator.cpp \
@@ -57,9 +59,11 @@ HEADERS += \
   ilwis4connector/ilwis4georefconnector.h \
   ilwis4connector/ilwis4objectfactory.h \
   ilwis4connector/ilwis4rasterconnector.h \
+  ilwis4connector/ilwis4rasterchunks.h \
   ilwis4connector/ilwis4representationconnector.h \
   ilwis4connector/ilwis4scriptconnector.h \
   ilwis4connector/ilwis4tableconnector.h \
+  ilwis4connector/ilwis4tablecolumns.h \
   ilwis4connector/ilwis4workflowconnector.h \
   ilwis4connector/iwis4connectormodule.h \
   ilwis4connector/qtcsv/include/abstractdata.h \
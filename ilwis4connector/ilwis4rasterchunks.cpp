@@ -0,0 +1,459 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+
+#include <QFile>
+#include <QDataStream>
+#include <QSysInfo>
+#include "kernel.h"
+#include "ilwisdata.h"
+#include "raster.h"
+#include "pixeliterator.h"
+#include "taskscheduler.h"
+#include "ilwis4rasterchunks.h"
+
+using namespace Ilwis;
+using namespace Ilwis4C;
+
+namespace {
+const quint32 CHUNKMAGIC = 0x4952434b; // "IRCK"
+const quint32 CHUNKVERSION = 1;
+const quint32 CHUNKSPERTHREAD = 4; // chunks a thread packs before the batch is written; bounds the memory of a store
+const quint8 fUNDEFS = 1; // the reserved undef of the type of the chunk marks undefined pixels
+const quint8 fCOMPRESSED = 2;
+
+PIXVALUETYPE sentinel(IlwisTypes tp) {
+	switch(tp){
+	case itUINT8:
+		return PackedType<quint8>::undef();
+	case itINT16:
+		return PackedType<qint16>::undef();
+	case itUINT16:
+		return PackedType<quint16>::undef();
+	case itINT32:
+		return PackedType<qint32>::undef();
+	case itFLOAT:
+		return PackedType<float>::undef();
+	default:
+		return PackedType<double>::undef();
+	}
+}
+
+/*
+ * A chunk in the type T goes to the grid without a conversion. Without undefined pixels the reserved undef of T may be an ordinary value of the chunk;
+ * it then can't be passed as the undef, and the chunk is converted instead
+ */
+template<typename T> bool writeChunk(UPGrid& grid, quint32 block, const char *data, quint64 n, bool undefs) {
+	const T *values = reinterpret_cast<const T *>(data);
+	T undef = PackedType<T>::undef();
+	if ( !undefs && std::find(values, values + n, undef) != values + n)
+		return false;
+	return grid->writeBlock(block, values, undef);
+}
+
+void writeHeader(QDataStream& stream, const Size<>& sz, const Size<>& tile, quint32 overviews, quint64 indexOffset) {
+	stream << CHUNKMAGIC << CHUNKVERSION << (quint8)QSysInfo::ByteOrder << sz.xsize() << sz.ysize() << sz.zsize() << tile.xsize() << tile.ysize() << overviews << indexOffset;
+}
+}
+
+bool Ilwis4RasterChunks::store(const IRasterCoverage &raster, const QString &path, const IOOptions &options)
+{
+	quint32 size = std::max(16, options.value("tilesize", 256).toInt());
+	Size<> tile(size, size, 1);
+	int compression = std::max(0, std::min(9, options.value("compression", 0).toInt()));
+	Size<> sz = raster->size();
+	quint32 overviews = 0;
+	if ( options.value("overviews", false).toBool()) { // down to the level that fits in one chunk
+		for(quint32 extent = std::max(sz.xsize(), sz.ysize()); extent > size && overviews < raster->overviewLevels(); extent = (extent + 1) / 2)
+			++overviews;
+	}
+
+	// the file replaces the old one when it is complete; blocks of a raster that was loaded from the old one may still refer to it
+	QString temp = path + ".tmp";
+	QFile file(temp);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1, temp);
+	QDataStream stream(&file);
+	writeHeader(stream, sz, tile, overviews, 0);
+	std::vector<Chunk> chunks;
+	bool ok = storeLevel(raster, tile, compression, file, chunks);
+	for(quint32 level = 1; level <= overviews && ok; ++level) {
+		IRasterCoverage overview = raster->overview(level);
+		ok = overview.isValid() && storeLevel(overview, tile, compression, file, chunks);
+	}
+	if ( ok) {
+		quint64 indexOffset = file.pos();
+		for(const Chunk& chunk : chunks)
+			stream << chunk._offset << chunk._bytes << chunk._type << chunk._flags << chunk._summary._min << chunk._summary._max << chunk._summary._undefs;
+		file.seek(0);
+		writeHeader(stream, sz, tile, overviews, indexOffset);
+		ok = stream.status() == QDataStream::Ok;
+	}
+	file.close();
+	if (!ok) {
+		QFile::remove(temp);
+		return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1, path);
+	}
+	// the old file can't be removed while it is mapped (on Windows); the caller releases its mappings first
+	if ( (QFile::exists(path) && !QFile::remove(path)) || !QFile::rename(temp, path)) {
+		QFile::remove(temp);
+		return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1, path);
+	}
+	return true;
+}
+
+bool Ilwis4RasterChunks::storeLevel(const IRasterCoverage &raster, const Size<> &tile, int compression, QFile &file, std::vector<Chunk> &chunks)
+{
+	Level lvl = level(raster->size(), tile, chunks.size());
+	quint32 n = lvl._chunksPerBand * raster->size().zsize();
+	int threads = taskscheduler()->threadCount();
+	quint32 batch = threads * CHUNKSPERTHREAD;
+	std::vector<QByteArray> payloads(batch);
+	std::vector<Chunk> packed(batch);
+	bool nested = TaskScheduler::currentThreadIndex() != 0; // stored from a task, the caches of the grid are those of the operation that runs it
+	if (!nested)
+		raster->gridRef()->prepare4Operation(threads);
+	bool ok = true;
+	for(quint32 first = 0; first < n && ok; first += batch) {
+		quint32 count = std::min(batch, n - first);
+		ok = taskscheduler()->run(count, [&](quint32 task, int threadIndex)->bool{
+			qint32 z = (first + task) / lvl._chunksPerBand;
+			BoundingBox box = chunkBox(lvl, tile, (first + task) % lvl._chunksPerBand);
+			std::vector<PIXVALUETYPE> values((quint64)box.xlength() * box.ylength());
+			PixelIterator iter(raster, threadIndex, BoundingBox(Pixel(box.min_corner().x, box.min_corner().y, z), Pixel(box.max_corner().x, box.max_corner().y, z)));
+			for(quint64 i = 0; i < values.size(); ) {
+				PixelSpan span = iter.span();
+				if ( span._length == 0)
+					return false;
+				qint32 length = std::min<quint64>(span._length, values.size() - i);
+				for(qint32 j = 0; j < length; ++j)
+					values[i + j] = span[j];
+				i += length;
+				iter += length;
+			}
+			packed[task] = Chunk();
+			payloads[task] = pack(values, compression, packed[task]);
+			return true;
+		});
+		// the chunks are written in their order; a chunk starts at a multiple of 8 bytes, so the values of a mapped chunk are aligned
+		for(quint32 i = 0; i < count && ok; ++i) {
+			quint64 padding = (8 - file.pos() % 8) % 8;
+			if ( padding > 0)
+				file.write(QByteArray(padding, 0));
+			packed[i]._offset = file.pos();
+			ok = file.write(payloads[i]) == payloads[i].size();
+			chunks.push_back(packed[i]);
+		}
+	}
+	if (!nested)
+		raster->gridRef()->unprepare4Operation();
+	return ok;
+}
+
+QByteArray Ilwis4RasterChunks::pack(const std::vector<PIXVALUETYPE> &values, int compression, Chunk &chunk)
+{
+	Summary& summary = chunk._summary;
+	PIXVALUETYPE vmin = std::numeric_limits<PIXVALUETYPE>::max(), vmax = std::numeric_limits<PIXVALUETYPE>::lowest();
+	bool nan = false;
+	for(PIXVALUETYPE v : values) {
+		if ( v == PIXVALUEUNDEF)
+			++summary._undefs;
+		else if ( std::isnan(v))
+			nan = true;
+		else {
+			vmin = std::min(vmin, v);
+			vmax = std::max(vmax, v);
+		}
+	}
+	summary._min = vmin <= vmax ? vmin : rUNDEF;
+	summary._max = vmin <= vmax ? vmax : rUNDEF;
+	if ( !nan && (summary._undefs == values.size() || (vmin == vmax && summary._undefs == 0))) { // one value everywhere; the summary holds it
+		chunk._type = itDOUBLE;
+		return QByteArray();
+	}
+
+	PackedBlock packed;
+	packed.pack(values);
+	chunk._type = packed.type();
+	chunk._flags = packed.hasUndefs() ? fUNDEFS : 0;
+	QByteArray payload(packed.constData(), packed.bytes());
+	if ( compression > 0) {
+		QByteArray compressed = qCompress(payload, compression);
+		if ( compressed.size() < payload.size()) {
+			payload = compressed;
+			chunk._flags |= fCOMPRESSED;
+		}
+	}
+	chunk._bytes = payload.size();
+	return payload;
+}
+
+Ilwis4RasterChunks::Level Ilwis4RasterChunks::level(const Size<> &sz, const Size<> &tile, quint32 firstChunk)
+{
+	Level lvl;
+	lvl._size = sz;
+	lvl._chunksPerRow = (sz.xsize() + tile.xsize() - 1) / tile.xsize();
+	lvl._chunksPerBand = lvl._chunksPerRow * ((sz.ysize() + tile.ysize() - 1) / tile.ysize());
+	lvl._firstChunk = firstChunk;
+	return lvl;
+}
+
+BoundingBox Ilwis4RasterChunks::chunkBox(const Level &lvl, const Size<> &tile, quint32 chunk)
+{
+	qint32 left = (chunk % lvl._chunksPerRow) * tile.xsize();
+	qint32 top = (chunk / lvl._chunksPerRow) * tile.ysize();
+	qint32 right = std::min(left + (qint32)tile.xsize(), (qint32)lvl._size.xsize()) - 1;
+	qint32 bottom = std::min(top + (qint32)tile.ysize(), (qint32)lvl._size.ysize()) - 1;
+	return BoundingBox(Pixel(left, top), Pixel(right, bottom));
+}
+
+bool Ilwis4RasterChunks::open(const QString &path)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly))
+		return ERROR1(ERR_COULD_NOT_OPEN_READING_1, path);
+	QDataStream stream(&file);
+	quint32 magic, version, xsize, ysize, zsize, tileWidth, tileHeight, overviews;
+	quint8 byteOrder;
+	quint64 indexOffset;
+	stream >> magic >> version >> byteOrder >> xsize >> ysize >> zsize >> tileWidth >> tileHeight >> overviews >> indexOffset;
+	if ( stream.status() != QDataStream::Ok || magic != CHUNKMAGIC || version > CHUNKVERSION || indexOffset == 0)
+		return ERROR2(ERR_INVALID_PROPERTY_FOR_2, "header", path);
+	if ( byteOrder != (quint8)QSysInfo::ByteOrder) // the values of the chunks are in the byte order of the machine that wrote them
+		return ERROR2(ERR_INVALID_PROPERTY_FOR_2, "byte order", path);
+
+	_size = Size<>(xsize, ysize, zsize);
+	_tile = Size<>(tileWidth, tileHeight, 1);
+	_levels.clear();
+	quint32 chunkCount = 0;
+	for(quint32 l = 0; l <= overviews; ++l) {
+		quint32 factor = 1 << l;
+		_levels.push_back(level(Size<>((xsize + factor - 1) / factor, (ysize + factor - 1) / factor, zsize), _tile, chunkCount));
+		chunkCount += _levels.back()._chunksPerBand * zsize;
+	}
+	file.seek(indexOffset);
+	_chunks.resize(chunkCount);
+	for(Chunk& chunk : _chunks)
+		stream >> chunk._offset >> chunk._bytes >> chunk._type >> chunk._flags >> chunk._summary._min >> chunk._summary._max >> chunk._summary._undefs;
+	if ( stream.status() != QDataStream::Ok)
+		return ERROR2(ERR_INVALID_PROPERTY_FOR_2, "chunk index", path);
+	file.close();
+
+	_mapped.reset(new MappedFile(path));
+	if ( !_mapped->isValid()) {
+		_mapped.reset();
+		return ERROR1(ERR_COULD_NOT_OPEN_READING_1, path);
+	}
+	return true;
+}
+
+bool Ilwis4RasterChunks::isValid() const
+{
+	return (bool)_mapped;
+}
+
+Size<> Ilwis4RasterChunks::tileSize() const
+{
+	return _tile;
+}
+
+quint32 Ilwis4RasterChunks::levels() const
+{
+	return _levels.empty() ? 0 : _levels.size() - 1;
+}
+
+bool Ilwis4RasterChunks::values(const Chunk &chunk, std::vector<PIXVALUETYPE> &values) const
+{
+	if ( chunk._bytes == 0) {
+		std::fill(values.begin(), values.end(), chunk._summary._undefs == 0 ? chunk._summary._min : PIXVALUEUNDEF);
+		return true;
+	}
+	const char *data = _mapped->data(chunk._offset, chunk._bytes);
+	if (!data)
+		return false;
+	QByteArray payload = chunk._flags & fCOMPRESSED ? qUncompress(reinterpret_cast<const uchar *>(data), chunk._bytes) : QByteArray::fromRawData(data, chunk._bytes);
+	if ( (quint64)payload.size() != values.size() * PackedBlock::typeSize(chunk._type))
+		return false;
+	PackedBlock packed;
+	packed.resize(chunk._type, values.size(), chunk._flags & fUNDEFS);
+	std::copy(payload.constBegin(), payload.constEnd(), packed.data());
+	packed.unpack(values);
+	return true;
+}
+
+const Ilwis4RasterChunks::Chunk *Ilwis4RasterChunks::chunkOfBlock(const UPGrid &grid, quint32 block, quint32 firstBand) const
+{
+	BoundingBox box = grid->blockBox(block);
+	const Level& base = _levels[0];
+	quint32 chunk = (box.min_corner().y / _tile.ysize()) * base._chunksPerRow + box.min_corner().x / _tile.xsize();
+	BoundingBox cbox = chunkBox(base, _tile, chunk);
+	if ( cbox.min_corner().x != box.min_corner().x || cbox.min_corner().y != box.min_corner().y || cbox.max_corner().x != box.max_corner().x || cbox.max_corner().y != box.max_corner().y)
+		return 0;
+	return &_chunks[base._firstChunk + (firstBand + box.min_corner().z) * base._chunksPerBand + chunk];
+}
+
+bool Ilwis4RasterChunks::mapBlock(UPGrid &grid, quint32 block, const Chunk &chunk) const
+{
+	if ( chunk._bytes == 0 || (chunk._flags & fCOMPRESSED))
+		return false;
+	return grid->mapBlock(block, _mapped, chunk._offset, chunk._type, chunk._flags & fUNDEFS, sentinel(chunk._type));
+}
+
+bool Ilwis4RasterChunks::loadBlock(UPGrid &grid, quint32 block, quint32 firstBand) const
+{
+	BoundingBox box = grid->blockBox(block);
+	if ( !box.isValid())
+		return false;
+	quint64 n = (quint64)box.xlength() * box.ylength();
+	if ( const Chunk *chunk = chunkOfBlock(grid, block, firstBand)) {
+		if ( mapBlock(grid, block, *chunk))
+			return true;
+		if ( chunk->_bytes != 0) {
+			const char *data = _mapped->data(chunk->_offset, chunk->_bytes);
+			if (!data)
+				return false;
+			QByteArray payload = chunk->_flags & fCOMPRESSED ? qUncompress(reinterpret_cast<const uchar *>(data), chunk->_bytes) : QByteArray::fromRawData(data, chunk->_bytes);
+			if ( (quint64)payload.size() != n * PackedBlock::typeSize(chunk->_type))
+				return false;
+			bool undefs = chunk->_flags & fUNDEFS;
+			bool written = false;
+			switch(chunk->_type){
+			case itUINT8:
+				written = writeChunk<quint8>(grid, block, payload.constData(), n, undefs); break;
+			case itINT16:
+				written = writeChunk<qint16>(grid, block, payload.constData(), n, undefs); break;
+			case itUINT16:
+				written = writeChunk<quint16>(grid, block, payload.constData(), n, undefs); break;
+			case itINT32:
+				written = writeChunk<qint32>(grid, block, payload.constData(), n, undefs); break;
+			case itFLOAT:
+				written = writeChunk<float>(grid, block, payload.constData(), n, undefs); break;
+			default:
+				break;
+			}
+			if ( written)
+				return true;
+		}
+		std::vector<PIXVALUETYPE> data(n);
+		if (!values(*chunk, data))
+			return false;
+		grid->setBlockData(block, data);
+		return true;
+	}
+
+	// the blocks of the grid differ from the chunks (e.g. full width strips); the block is put together from the chunks it overlaps
+	const Level& base = _levels[0];
+	quint32 band = firstBand + box.min_corner().z;
+	std::vector<PIXVALUETYPE> data(n, PIXVALUEUNDEF);
+	for(qint32 row = box.min_corner().y / (qint32)_tile.ysize(); row <= box.max_corner().y / (qint32)_tile.ysize(); ++row) {
+		for(qint32 column = box.min_corner().x / (qint32)_tile.xsize(); column <= box.max_corner().x / (qint32)_tile.xsize(); ++column) {
+			quint32 chunk = row * base._chunksPerRow + column;
+			BoundingBox cbox = chunkBox(base, _tile, chunk);
+			std::vector<PIXVALUETYPE> chunkValues((quint64)cbox.xlength() * cbox.ylength());
+			if (!values(_chunks[base._firstChunk + band * base._chunksPerBand + chunk], chunkValues))
+				return false;
+			qint32 xmin = std::max(box.min_corner().x, cbox.min_corner().x), xmax = std::min(box.max_corner().x, cbox.max_corner().x);
+			qint32 ymin = std::max(box.min_corner().y, cbox.min_corner().y), ymax = std::min(box.max_corner().y, cbox.max_corner().y);
+			for(qint32 y = ymin; y <= ymax; ++y) {
+				const PIXVALUETYPE *source = &chunkValues[(y - cbox.min_corner().y) * (qint32)cbox.xlength() + xmin - cbox.min_corner().x];
+				std::copy(source, source + xmax - xmin + 1, &data[(y - box.min_corner().y) * (qint32)box.xlength() + xmin - box.min_corner().x]);
+			}
+		}
+	}
+	grid->setBlockData(block, data);
+	return true;
+}
+
+bool Ilwis4RasterChunks::load(UPGrid &grid, quint32 firstBand, const IOOptions &options) const
+{
+	if (!isValid())
+		return false;
+	std::map<quint32, std::vector<quint32> > blocklimits = grid->calcBlockLimits(options);
+	std::vector<quint32> blocks;
+	for(const auto& layer : blocklimits) {
+		if ( firstBand + layer.first >= _size.zsize())
+			return ERROR2(ERR_INVALID_PROPERTY_FOR_2, "band", QString::number(firstBand + layer.first));
+		blocks.insert(blocks.end(), layer.second.begin(), layer.second.end());
+	}
+	// a single block is what the grid asks for when a block is first used, possibly by the prefetcher; it is loaded by the calling thread
+	bool ok = blocks.size() == 1 ? loadBlock(grid, blocks[0], firstBand) : taskscheduler()->run(blocks.size(), [&](quint32 task, int)->bool{
+		return loadBlock(grid, blocks[task], firstBand);
+	});
+	if (!ok)
+		return false;
+	// on the first load of a band the other blocks of the band refer to the file as well, as far as their chunks are not compressed; they don't have to
+	// come through loadData anymore. Later loads only get the blocks that can't be mapped
+	std::vector<quint32> bands;
+	{
+		std::lock_guard<std::mutex> lock(_mapMutex);
+		if ( _mappedGrid != grid.get()) {
+			_mappedGrid = grid.get();
+			_mappedBands.assign(_size.zsize(), false);
+		}
+		for(const auto& layer : blocklimits) {
+			if ( !_mappedBands[firstBand + layer.first]) {
+				_mappedBands[firstBand + layer.first] = true;
+				bands.push_back(layer.first);
+			}
+		}
+	}
+	for(quint32 band : bands) {
+		for(quint32 block = band * grid->blocksPerBand(); block < (band + 1) * grid->blocksPerBand(); ++block) {
+			if ( const Chunk *chunk = chunkOfBlock(grid, block, firstBand))
+				mapBlock(grid, block, *chunk);
+		}
+	}
+	return true;
+}
+
+bool Ilwis4RasterChunks::loadOverview(quint32 level, quint32 firstBand, RasterCoverage *overview) const
+{
+	if ( !isValid() || level == 0 || level > levels())
+		return false;
+	const Level& lvl = _levels[level];
+	IRasterCoverage target;
+	target.set(overview);
+	Size<> sz = target->size();
+	if ( sz.xsize() != lvl._size.xsize() || sz.ysize() != lvl._size.ysize() || firstBand + sz.zsize() > _size.zsize())
+		return false;
+	int threads = taskscheduler()->threadCount();
+	bool nested = TaskScheduler::currentThreadIndex() != 0; // loaded from a task, the caches of the grid are those of the operation that runs it
+	if (!nested)
+		target->gridRef()->prepare4Operation(threads);
+	bool ok = taskscheduler()->run(lvl._chunksPerBand * sz.zsize(), [&](quint32 task, int threadIndex)->bool{
+		qint32 z = task / lvl._chunksPerBand;
+		quint32 chunk = task % lvl._chunksPerBand;
+		BoundingBox box = chunkBox(lvl, _tile, chunk);
+		std::vector<PIXVALUETYPE> data((quint64)box.xlength() * box.ylength());
+		if (!values(_chunks[lvl._firstChunk + (firstBand + z) * lvl._chunksPerBand + chunk], data))
+			return false;
+		PixelIterator iter(target, threadIndex, BoundingBox(Pixel(box.min_corner().x, box.min_corner().y, z), Pixel(box.max_corner().x, box.max_corner().y, z)));
+		for(quint64 i = 0; i < data.size(); ) {
+			PixelSpan span = iter.span();
+			if ( span._length == 0)
+				return false;
+			qint32 length = std::min<quint64>(span._length, data.size() - i);
+			for(qint32 j = 0; j < length; ++j)
+				span[j] = data[i + j];
+			i += length;
+			iter += length;
+		}
+		return true;
+	});
+	if (!nested)
+		target->gridRef()->unprepare4Operation();
+	return ok;
+}
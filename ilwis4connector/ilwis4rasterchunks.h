@@ -0,0 +1,104 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+
+#ifndef ILWIS4RASTERCHUNKS_H
+#define ILWIS4RASTERCHUNKS_H
+
+namespace Ilwis {
+	class RasterCoverage;
+	typedef IlwisData<RasterCoverage> IRasterCoverage;
+
+	namespace Ilwis4C {
+
+		/*!
+		 * \brief The Ilwis4RasterChunks class the binary data file of an ilwis4 raster. Every band is divided in chunks, tiles of a fixed size; a chunk is stored
+		 * in the smallest type that holds all its values exactly (see PackedBlock), optionally compressed. An index at the end of the file gives the position of
+		 * every chunk, so chunks are read in any order and a region of the raster is read without the rest. The index also holds the minimum, maximum and number
+		 * of undefined pixels of a chunk; a chunk with one value everywhere (e.g. one that is entirely undefined) has no data in the file, its value comes from
+		 * the index. The file may also hold overview levels of the raster, in the same layout.
+		 *
+		 * Chunks are written and read by the tasks of the scheduler. Uncompressed chunks of a grid whose tiles have the size of the chunks are not read at all;
+		 * the blocks of a band refer to them in the memory mapped file from the first load of the band on.
+		 */
+		class Ilwis4RasterChunks
+		{
+		public:
+			/*!
+			 * \brief store writes the raster to a chunk file. Options: "tilesize" (the size of a chunk in both directions, default 256), "compression"
+			 * (zlib level 0-9 per chunk, default 0), "overviews" (true to add overview levels down to one chunk)
+			 */
+			static bool store(const IRasterCoverage& raster, const QString& path, const IOOptions& options);
+
+			bool open(const QString& path);
+			bool isValid() const;
+			Size<> tileSize() const;
+			/*!
+			 * \brief levels the number of overview levels in the file, not counting the raster itself
+			 */
+			quint32 levels() const;
+			/*!
+			 * \brief load gets the blocks that calcBlockLimits() selects with the options into the grid
+			 * \param firstBand the band of the file that is band 0 of the grid; for a raster that is one band of the file
+			 */
+			bool load(UPGrid& grid, quint32 firstBand, const IOOptions& options) const;
+			/*!
+			 * \brief loadOverview fills overview, which has the size of the level, with the overview level of the file
+			 */
+			bool loadOverview(quint32 level, quint32 firstBand, RasterCoverage *overview) const;
+
+		private:
+			struct Summary {
+				double _min = rUNDEF;
+				double _max = rUNDEF;
+				quint32 _undefs = 0; // number of undefined pixels
+			};
+			struct Chunk {
+				quint64 _offset = 0;
+				quint32 _bytes = 0; // 0 for a chunk with one value; that value is the minimum of the summary
+				IlwisTypes _type = itUNKNOWN;
+				quint8 _flags = 0;
+				Summary _summary;
+			};
+			struct Level {
+				Size<> _size;
+				quint32 _chunksPerRow = 0;
+				quint32 _chunksPerBand = 0;
+				quint32 _firstChunk = 0;
+			};
+
+			static Level level(const Size<>& sz, const Size<>& tile, quint32 firstChunk);
+			static QByteArray pack(const std::vector<PIXVALUETYPE>& values, int compression, Chunk& chunk);
+			static bool storeLevel(const IRasterCoverage& raster, const Size<>& tile, int compression, QFile& file, std::vector<Chunk>& chunks);
+			static BoundingBox chunkBox(const Level& level, const Size<>& tile, quint32 chunk);
+			bool values(const Chunk& chunk, std::vector<PIXVALUETYPE>& values) const;
+			const Chunk *chunkOfBlock(const UPGrid& grid, quint32 block, quint32 firstBand) const;
+			bool loadBlock(UPGrid& grid, quint32 block, quint32 firstBand) const;
+			bool mapBlock(UPGrid& grid, quint32 block, const Chunk& chunk) const;
+
+			Size<> _size;
+			Size<> _tile;
+			std::vector<Level> _levels;
+			std::vector<Chunk> _chunks;
+			SPMappedFile _mapped;
+			mutable std::mutex _mapMutex;
+			mutable const Grid *_mappedGrid = 0; // the grid whose blocks refer to the file; a new grid (e.g. after an unload) is mapped again
+			mutable std::vector<bool> _mappedBands; // the bands of the file that are mapped into that grid
+		};
+	}
+}
+
+#endif // ILWIS4RASTERCHUNKS_H
@@ -32,6 +32,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #include "raster.h"
 #include "ilwisobjectconnector.h"
 #include "ilwis4connector.h"
+#include "ilwis4rasterchunks.h"
 #include "ilwis4rasterconnector.h"
 #include "ilwis4coordinatesystemconnector.h"
 #include "ilwis4georefconnector.h"
@@ -54,6 +55,10 @@ Ilwis4RasterConnector::Ilwis4RasterConnector(const Ilwis::Resource &resource, bo
 	_version = 1;
 }
 
+Ilwis4RasterConnector::~Ilwis4RasterConnector()
+{
+}
+
 bool Ilwis4RasterConnector::store(IlwisObject *obj, const IOOptions &options)
 {
 	QJsonArray objects;
@@ -127,7 +132,14 @@ bool Ilwis4RasterConnector::store(IlwisObject *obj, const IOOptions& options, QJ
 	Resource res = obj->resource(IlwisObject::cmOUTPUT);
 	QString path = res.url(true).toLocalFile();
 	QFileInfo inf(path);
-	jraster.insert("binarydata", inf.baseName() + ".tif_");
+	// the pixels go to a chunk file, unless the GeoTIFF data file of earlier versions is asked for
+	if (options.value("binaryformat").toString().toLower() == "gtiff")
+		jraster.insert("binarydata", inf.baseName() + ".tif_");
+	else {
+		jraster.insert("binarydata", inf.baseName() + ".ichunks");
+		int tile = std::max(16, options.value("tilesize", 256).toInt());
+		jraster.insert("tilesize", Size<>(tile, tile, 1).toString());
+	}
 	jraster.insert("size", raster->size().toString());
 	
 	return true;
@@ -135,6 +147,19 @@ bool Ilwis4RasterConnector::store(IlwisObject *obj, const IOOptions& options, QJ
 
 bool Ilwis4RasterConnector::storeData(IlwisObject *obj, const IOOptions &options) {
 
+	if (options.value("binaryformat").toString().toLower() != "gtiff") {
+		RasterCoverage *raster = static_cast<RasterCoverage *>(obj);
+		QString pathOut = obj->resource(IlwisObject::cmOUTPUT).url(true).toLocalFile().remove(".ilwis4") + ".ichunks";
+		// the file may be the one the grid and the chunks of the source refer to; their mappings must be gone before it is replaced
+		raster->gridRef()->unmapBlocks();
+		releaseChunks();
+		if (Ilwis4RasterConnector *source = dynamic_cast<Ilwis4RasterConnector *>(obj->connector(IlwisObject::cmINPUT).data()))
+			source->releaseChunks();
+		IRasterCoverage data;
+		data.set(raster);
+		return Ilwis4RasterChunks::store(data, pathOut, options);
+	}
+
 	const ConnectorFactory *factory = kernel()->factory<ConnectorFactory>("ilwis::ConnectorFactory");
 	if (!factory) {
 		kernel()->issues()->log("Couldn't find factory for gdal connector");
@@ -176,6 +201,8 @@ bool Ilwis4RasterConnector::loadMetaData(IlwisObject *obj, const IOOptions &opti
 				Ilwis4GeorefConnector::loadMetaData(grf.ptr(), options, jraster["georeference"].toObject());
 
 				raster->georeference(grf);
+				if (jraster["tilesize"].isString()) // the blocks of the grid get the size of the chunks, so they are loaded (or mapped) without a conversion
+					raster->tileSize(Size<>(jraster["tilesize"].toString()));
 				raster->size(jraster["size"].toString());
 				QJsonObject jdata = jraster["data"].toObject();
 				QJsonObject jstackDomain = jdata["stackdomain"].toObject();
@@ -205,6 +232,8 @@ bool Ilwis4RasterConnector::loadMetaData(IlwisObject *obj, const IOOptions &opti
 				Ilwis4GeorefConnector::loadMetaData(grf.ptr(), options, jraster["georeference"].toObject());
 
 				raster->georeference(grf);
+				if (jraster["tilesize"].isString()) // the blocks of the grid get the size of the chunks, so they are loaded (or mapped) without a conversion
+					raster->tileSize(Size<>(jraster["tilesize"].toString()));
 				raster->size(jraster["size"].toString());
 
 				QJsonObject jdata = jraster["data"].toObject();
@@ -247,6 +276,14 @@ bool Ilwis4RasterConnector::loadMetaData(IlwisObject *obj, const IOOptions &opti
 
 bool Ilwis4RasterConnector::loadData(IlwisObject* obj, const IOOptions& options) {
 
+	if (isChunked()) {
+		std::shared_ptr<const Ilwis4RasterChunks> data = chunks();
+		if (!data)
+			return false;
+		RasterCoverage *raster = static_cast<RasterCoverage *>(obj);
+		return data->load(raster->gridRef(), firstBand(obj), options);
+	}
+
 	QFileInfo inf(sourceRef().toLocalFile());
 	QString path = inf.absolutePath() + "/" + _datafile;
 	if (!_dataRaster.isValid()){
@@ -262,3 +299,46 @@ bool Ilwis4RasterConnector::loadData(IlwisObject* obj, const IOOptions& options)
 
 	return true;
 }
+
+bool Ilwis4RasterConnector::loadOverview(IlwisObject *obj, quint32 level, IlwisObject *overview)
+{
+	if (!isChunked())
+		return false;
+	std::shared_ptr<const Ilwis4RasterChunks> data = chunks();
+	return data && data->loadOverview(level, firstBand(obj), static_cast<RasterCoverage *>(overview));
+}
+
+bool Ilwis4RasterConnector::isReentrant() const
+{
+	return isChunked();
+}
+
+bool Ilwis4RasterConnector::isChunked() const
+{
+	return _datafile.endsWith(".ichunks");
+}
+
+std::shared_ptr<const Ilwis4RasterChunks> Ilwis4RasterConnector::chunks()
+{
+	std::lock_guard<std::mutex> lock(_chunksMutex);
+	if (!_chunks) {
+		QFileInfo inf(sourceRef().toLocalFile());
+		std::shared_ptr<Ilwis4RasterChunks> data(new Ilwis4RasterChunks());
+		if (!data->open(inf.absolutePath() + "/" + _datafile))
+			return std::shared_ptr<const Ilwis4RasterChunks>();
+		_chunks = data;
+	}
+	return _chunks;
+}
+
+void Ilwis4RasterConnector::releaseChunks()
+{
+	// the index and the mapping of the file are read again by the next load
+	std::lock_guard<std::mutex> lock(_chunksMutex);
+	_chunks.reset();
+}
+
+quint32 Ilwis4RasterConnector::firstBand(const IlwisObject *obj)
+{
+	return obj->code().indexOf("band=") == 0 ? obj->code().mid(5).toUInt() : 0;
+}
@@ -20,23 +20,34 @@ namespace Ilwis {
 	typedef IlwisData<RasterCoverage> IRasterCoverage;
 
 	namespace Ilwis4C {
+		class Ilwis4RasterChunks;
 
 		class Ilwis4RasterConnector : public Ilwis4Connector
 		{
 		public:
 			Ilwis4RasterConnector(const Ilwis::Resource &resource, bool load, const IOOptions& options = IOOptions());
+			~Ilwis4RasterConnector();
 
 			bool store(IlwisObject *obj, const IOOptions& options = IOOptions());
 			bool loadMetaData(IlwisObject*obj, const IOOptions & options);
 			static ConnectorInterface *create(const Ilwis::Resource &resource, bool load, const IOOptions& options = IOOptions());
 			bool loadData(IlwisObject *, const IOOptions &options = IOOptions());
 			bool storeData(IlwisObject *obj, const IOOptions &options);
+			bool loadOverview(IlwisObject *obj, quint32 level, IlwisObject *overview);
+			bool isReentrant() const;
 
 		protected:
 			static bool store(IlwisObject *obj, const IOOptions& options, QJsonObject& jroot);
 
 		private:
-			IRasterCoverage _dataRaster;
+			bool isChunked() const;
+			std::shared_ptr<const Ilwis4RasterChunks> chunks();
+			void releaseChunks();
+			static quint32 firstBand(const IlwisObject *obj);
+
+			IRasterCoverage _dataRaster; // the GeoTIFF data file of files that don't have a chunk file
+			std::shared_ptr<const Ilwis4RasterChunks> _chunks; // shared with the loads that use it, so it can be released while they run
+			std::mutex _chunksMutex;
 
 		};
 	}
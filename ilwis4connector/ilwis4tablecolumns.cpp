@@ -0,0 +1,364 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#include <QFile>
+#include <QDataStream>
+#include <QSysInfo>
+#include "kernel.h"
+#include "ilwisdata.h"
+#include "domain.h"
+#include "datadefinition.h"
+#include "columndefinition.h"
+#include "table.h"
+#include "grid.h"
+#include "taskscheduler.h"
+#include "ilwis4tablecolumns.h"
+
+using namespace Ilwis;
+using namespace Ilwis4C;
+
+namespace {
+const quint32 COLUMNMAGIC = 0x4954434c; // "ITCL"
+const quint32 COLUMNVERSION = 1;
+const quint32 ROWSPERCHUNK = 65536;
+const quint8 fUNDEFS = 1; // the reserved undef of the type of the chunk marks undefined values
+const quint8 fCOMPRESSED = 2;
+
+void writeHeader(QDataStream& stream, quint32 records, quint32 columns, quint32 rowsPerChunk, quint64 indexOffset) {
+	stream << COLUMNMAGIC << COLUMNVERSION << (quint8)QSysInfo::ByteOrder << records << columns << rowsPerChunk << indexOffset;
+}
+
+template<typename C> void writeChunk(QDataStream& stream, const C& chunk) {
+	stream << chunk._offset << chunk._bytes << chunk._type << chunk._flags << chunk._value;
+}
+
+template<typename C> void readChunk(QDataStream& stream, C& chunk) {
+	stream >> chunk._offset >> chunk._bytes >> chunk._type >> chunk._flags >> chunk._value;
+}
+
+bool writeAligned(QFile& file, const QByteArray& payload, quint64& offset) {
+	quint64 padding = (8 - file.pos() % 8) % 8;
+	if ( padding > 0)
+		file.write(QByteArray(padding, 0));
+	offset = file.pos();
+	return file.write(payload) == payload.size();
+}
+}
+
+bool Ilwis4TableColumns::store(Table *table, const QString &path, const IOOptions &options)
+{
+	quint32 rowsPerChunk = std::max(1024, options.value("chunkrows", ROWSPERCHUNK).toInt());
+	int compression = std::max(0, std::min(9, options.value("compression", 0).toInt()));
+	quint32 records = table->recordCount();
+	quint32 columns = table->columnCount();
+
+	QString temp = path + ".tmp";
+	QFile file(temp);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1, temp);
+	QDataStream stream(&file);
+	writeHeader(stream, records, columns, rowsPerChunk, 0);
+
+	// a batch of columns is taken from the table and encoded by the tasks, one column per task; the table itself is only accessed by this thread
+	std::vector<Column> index(columns);
+	quint32 batch = taskscheduler()->threadCount();
+	std::vector<std::vector<QVariant>> values(batch);
+	std::vector<std::vector<QByteArray>> payloads(batch);
+	std::vector<bool> numeric(batch);
+	bool ok = true;
+	for(quint32 first = 0; first < columns && ok; first += batch) {
+		quint32 count = std::min(batch, columns - first);
+		for(quint32 i = 0; i < count; ++i) {
+			// the values of numeric and item domains are numbers in the table (the raw values of the items)
+			const ColumnDefinition& coldef = table->columndefinitionRef(first + i);
+			index[first + i]._name = coldef.name();
+			numeric[i] = coldef.datadef().domain().isValid() && hasType(coldef.datadef().domain()->ilwisType(), itNUMERICDOMAIN | itITEMDOMAIN);
+			values[i] = table->column(first + i);
+		}
+		ok = taskscheduler()->run(count, [&](quint32 task, int)->bool{
+			values[task].resize(records);
+			payloads[task] = encode(values[task], numeric[task], rowsPerChunk, compression, index[first + task]);
+			return true;
+		});
+		for(quint32 i = 0; i < count && ok; ++i) {
+			Column& column = index[first + i];
+			quint32 p = 0;
+			if ( column._encoding == eDICTIONARY)
+				ok = writeAligned(file, payloads[i][p++], column._dictionary._offset);
+			for(Chunk& chunk : column._chunks) {
+				if ( ok)
+					ok = writeAligned(file, payloads[i][p++], chunk._offset);
+			}
+			values[i].clear();
+			payloads[i].clear();
+		}
+	}
+	if ( ok) {
+		quint64 indexOffset = file.pos();
+		for(const Column& column : index) {
+			stream << column._name << column._encoding;
+			writeChunk(stream, column._dictionary);
+			stream << (quint32)column._chunks.size();
+			for(const Chunk& chunk : column._chunks)
+				writeChunk(stream, chunk);
+		}
+		file.seek(0);
+		writeHeader(stream, records, columns, rowsPerChunk, indexOffset);
+		ok = stream.status() == QDataStream::Ok;
+	}
+	file.close();
+	if (!ok) {
+		QFile::remove(temp);
+		return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1, path);
+	}
+	QFile::remove(path);
+	return QFile::rename(temp, path);
+}
+
+std::vector<QByteArray> Ilwis4TableColumns::encode(const std::vector<QVariant> &values, bool numeric, quint32 rowsPerChunk, int compression, Column &column)
+{
+	std::vector<QByteArray> payloads;
+	std::vector<PIXVALUETYPE> numbers(values.size());
+	if ( numeric) {
+		column._encoding = eNUMBERS;
+		for(quint64 i = 0; i < values.size(); ++i) {
+			bool ok;
+			double v = values[i].toDouble(&ok);
+			numbers[i] = ok ? v : rUNDEF;
+		}
+	} else {
+		// the numbers are the positions of the values in the dictionary. Strings, the common case, are looked up by their text; other values by their serialized form
+		column._encoding = eDICTIONARY;
+		QHash<QString, quint32> strings;
+		QHash<QByteArray, quint32> others;
+		QByteArray dictionary;
+		QDataStream stream(&dictionary, QIODevice::WriteOnly);
+		quint32 entries = 0;
+		stream << entries;
+		for(quint64 i = 0; i < values.size(); ++i) {
+			const QVariant& v = values[i];
+			quint32 position;
+			if ( v.type() == QVariant::String) {
+				auto iter = strings.find(v.toString());
+				position = iter != strings.end() ? iter.value() : *strings.insert(v.toString(), entries);
+			} else {
+				QByteArray key;
+				QDataStream keyStream(&key, QIODevice::WriteOnly);
+				keyStream << v;
+				auto iter = others.find(key);
+				position = iter != others.end() ? iter.value() : *others.insert(key, entries);
+			}
+			if ( position == entries) { // a new value
+				stream << v;
+				++entries;
+			}
+			numbers[i] = position;
+		}
+		stream.device()->seek(0);
+		stream << entries;
+		payloads.push_back(compress(dictionary, compression, column._dictionary));
+	}
+
+	for(quint64 first = 0; first < numbers.size(); first += rowsPerChunk) {
+		std::vector<PIXVALUETYPE> chunkValues(numbers.begin() + first, numbers.begin() + std::min<quint64>(first + rowsPerChunk, numbers.size()));
+		column._chunks.push_back(Chunk());
+		payloads.push_back(pack(chunkValues, compression, column._chunks.back()));
+	}
+	return payloads;
+}
+
+QByteArray Ilwis4TableColumns::pack(const std::vector<PIXVALUETYPE> &values, int compression, Chunk &chunk)
+{
+	if ( std::all_of(values.begin(), values.end(), [&](PIXVALUETYPE v){ return v == values[0]; })) { // one value everywhere; the index holds it
+		chunk._type = itDOUBLE;
+		chunk._value = values[0];
+		return QByteArray();
+	}
+	PackedBlock packed;
+	packed.pack(values);
+	chunk._type = packed.type();
+	chunk._flags = packed.hasUndefs() ? fUNDEFS : 0;
+	return compress(QByteArray(packed.constData(), packed.bytes()), compression, chunk);
+}
+
+QByteArray Ilwis4TableColumns::compress(const QByteArray &payload, int compression, Chunk &chunk)
+{
+	QByteArray result = payload;
+	if ( compression > 0) {
+		QByteArray compressed = qCompress(payload, compression);
+		if ( compressed.size() < payload.size()) {
+			result = compressed;
+			chunk._flags |= fCOMPRESSED;
+		}
+	}
+	chunk._bytes = result.size();
+	return result;
+}
+
+QStringList Ilwis4TableColumns::selectedColumns(const IOOptions &options)
+{
+	QVariant columns = options.value("columns");
+	if ( columns.type() == QVariant::StringList)
+		return columns.toStringList();
+	return columns.toString().split("|", QString::SkipEmptyParts);
+}
+
+bool Ilwis4TableColumns::open(const QString &path)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly))
+		return ERROR1(ERR_COULD_NOT_OPEN_READING_1, path);
+	QDataStream stream(&file);
+	quint32 magic, version, records, columns, rowsPerChunk;
+	quint8 byteOrder;
+	quint64 indexOffset;
+	stream >> magic >> version >> byteOrder >> records >> columns >> rowsPerChunk >> indexOffset;
+	if ( stream.status() != QDataStream::Ok || magic != COLUMNMAGIC || version > COLUMNVERSION || indexOffset == 0 || rowsPerChunk == 0)
+		return ERROR2(ERR_INVALID_PROPERTY_FOR_2, "header", path);
+	if ( byteOrder != (quint8)QSysInfo::ByteOrder) // the values of the chunks are in the byte order of the machine that wrote them
+		return ERROR2(ERR_INVALID_PROPERTY_FOR_2, "byte order", path);
+
+	_records = records;
+	_rowsPerChunk = rowsPerChunk;
+	file.seek(indexOffset);
+	_columns.resize(columns);
+	for(Column& column : _columns) {
+		quint32 chunks;
+		stream >> column._name >> column._encoding;
+		readChunk(stream, column._dictionary);
+		stream >> chunks;
+		if ( stream.status() != QDataStream::Ok || chunks != (records + rowsPerChunk - 1) / rowsPerChunk)
+			return ERROR2(ERR_INVALID_PROPERTY_FOR_2, "column index", path);
+		column._chunks.resize(chunks);
+		for(Chunk& chunk : column._chunks)
+			readChunk(stream, chunk);
+	}
+	if ( stream.status() != QDataStream::Ok)
+		return ERROR2(ERR_INVALID_PROPERTY_FOR_2, "column index", path);
+	file.close();
+
+	_mapped.reset(new MappedFile(path));
+	if ( !_mapped->isValid()) {
+		_mapped.reset();
+		return ERROR1(ERR_COULD_NOT_OPEN_READING_1, path);
+	}
+	return true;
+}
+
+bool Ilwis4TableColumns::isValid() const
+{
+	return (bool)_mapped;
+}
+
+quint32 Ilwis4TableColumns::recordCount() const
+{
+	return _records;
+}
+
+bool Ilwis4TableColumns::load(Table *table) const
+{
+	if (!isValid())
+		return false;
+
+	// only the columns of the table are read; a table that was opened with a selection of columns has no others
+	std::vector<std::pair<quint32, const Column *>> work;
+	for(quint32 c = 0; c < table->columnCount(); ++c) {
+		QString name = table->columndefinitionRef(c).name();
+		auto iter = std::find_if(_columns.begin(), _columns.end(), [&](const Column& column){ return column._name == name; });
+		if ( iter != _columns.end())
+			work.push_back({c, &*iter});
+	}
+
+	// a batch of columns is decoded by the tasks; the values go to the table on this thread
+	quint32 batch = taskscheduler()->threadCount();
+	std::vector<std::vector<QVariant>> values(batch);
+	for(quint32 first = 0; first < work.size(); first += batch) {
+		quint32 count = std::min<quint32>(batch, work.size() - first);
+		bool ok = taskscheduler()->run(count, [&](quint32 task, int)->bool{
+			return decode(*work[first + task].second, values[task]);
+		});
+		if (!ok)
+			return false;
+		for(quint32 i = 0; i < count; ++i) {
+			quint32 c = work[first + i].first;
+			for(quint32 rec = 0; rec < values[i].size(); ++rec)
+				table->setCell(c, rec, values[i][rec], true);
+			values[i].clear();
+		}
+	}
+	return true;
+}
+
+QByteArray Ilwis4TableColumns::payload(const Chunk &chunk) const
+{
+	const char *data = _mapped->data(chunk._offset, chunk._bytes);
+	if (!data)
+		return QByteArray();
+	return chunk._flags & fCOMPRESSED ? qUncompress(reinterpret_cast<const uchar *>(data), chunk._bytes) : QByteArray::fromRawData(data, chunk._bytes);
+}
+
+bool Ilwis4TableColumns::unpack(const Chunk &chunk, std::vector<PIXVALUETYPE> &values) const
+{
+	if ( chunk._bytes == 0) {
+		std::fill(values.begin(), values.end(), chunk._value);
+		return true;
+	}
+	QByteArray data = payload(chunk);
+	if ( (quint64)data.size() != values.size() * PackedBlock::typeSize(chunk._type))
+		return false;
+	PackedBlock packed;
+	packed.resize(chunk._type, values.size(), chunk._flags & fUNDEFS);
+	std::copy(data.constBegin(), data.constEnd(), packed.data());
+	packed.unpack(values);
+	return true;
+}
+
+bool Ilwis4TableColumns::decode(const Column &column, std::vector<QVariant> &values) const
+{
+	std::vector<QVariant> dictionary;
+	if ( column._encoding == eDICTIONARY) {
+		QByteArray data = payload(column._dictionary);
+		QDataStream stream(data);
+		quint32 entries = 0;
+		stream >> entries;
+		if ( stream.status() != QDataStream::Ok || (quint64)entries > (quint64)data.size())
+			return false;
+		dictionary.resize(entries);
+		for(QVariant& entry : dictionary)
+			stream >> entry;
+		if ( stream.status() != QDataStream::Ok)
+			return false;
+	}
+
+	values.resize(_records);
+	std::vector<PIXVALUETYPE> numbers;
+	for(quint32 c = 0; c < column._chunks.size(); ++c) {
+		quint32 first = c * _rowsPerChunk;
+		numbers.resize(std::min(_rowsPerChunk, _records - first));
+		if (!unpack(column._chunks[c], numbers))
+			return false;
+		for(quint32 i = 0; i < numbers.size(); ++i) {
+			if ( column._encoding == eNUMBERS)
+				values[first + i] = numbers[i];
+			else {
+				if ( numbers[i] < 0 || numbers[i] >= dictionary.size())
+					return false;
+				values[first + i] = dictionary[(quint32)numbers[i]];
+			}
+		}
+	}
+	return true;
+}
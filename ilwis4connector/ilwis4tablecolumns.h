@@ -0,0 +1,86 @@
+/*IlwisObjects is a framework for analysis, processing and visualization of remote sensing and gis data
+Copyright (C) 2018  52n North
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
+
+#ifndef ILWIS4TABLECOLUMNS_H
+#define ILWIS4TABLECOLUMNS_H
+
+namespace Ilwis {
+	class Table;
+
+	namespace Ilwis4C {
+
+		/*!
+		 * \brief The Ilwis4TableColumns class the binary data file of an ilwis4 table. The values are stored column by column, every column in chunks of a
+		 * fixed number of records. A numeric column is stored in the smallest type that holds all values of a chunk exactly (see PackedBlock); any other column
+		 * (text, thematic, identifier, ...) is stored as a dictionary of its distinct values and, per chunk, the packed positions of the values in the dictionary.
+		 * Every column is compressed on its own, and only where that makes it smaller. An index at the end of the file gives the position of every column, so
+		 * a column is read without the others.
+		 *
+		 * Columns are encoded and decoded by the tasks of the scheduler.
+		 */
+		class Ilwis4TableColumns
+		{
+		public:
+			/*!
+			 * \brief store writes the columns of the table. Options: "compression" (zlib level 0-9, default 0), "chunkrows" (the number of records in a chunk,
+			 * default 65536)
+			 */
+			static bool store(Table *table, const QString& path, const IOOptions& options);
+			/*!
+			 * \brief selectedColumns the names in the option "columns" (separated by '|'); empty if all columns are to be loaded
+			 */
+			static QStringList selectedColumns(const IOOptions& options);
+
+			bool open(const QString& path);
+			bool isValid() const;
+			quint32 recordCount() const;
+			/*!
+			 * \brief load fills the columns of the table with the columns of the same name in the file; columns that are not in the file are not touched
+			 */
+			bool load(Table *table) const;
+
+		private:
+			enum Encoding{ eNUMBERS = 0, eDICTIONARY = 1 };
+			struct Chunk {
+				quint64 _offset = 0;
+				quint32 _bytes = 0; // 0 for a chunk with one value; _value is then that value
+				IlwisTypes _type = itUNKNOWN;
+				quint8 _flags = 0;
+				double _value = rUNDEF;
+			};
+			struct Column {
+				QString _name;
+				quint8 _encoding = eNUMBERS;
+				Chunk _dictionary; // the QVariants of a dictionary column, as written by a QDataStream
+				std::vector<Chunk> _chunks;
+			};
+
+			static QByteArray pack(const std::vector<PIXVALUETYPE>& values, int compression, Chunk& chunk);
+			static QByteArray compress(const QByteArray& payload, int compression, Chunk& chunk);
+			static std::vector<QByteArray> encode(const std::vector<QVariant>& values, bool numeric, quint32 rowsPerChunk, int compression, Column& column);
+			QByteArray payload(const Chunk& chunk) const;
+			bool decode(const Column& column, std::vector<QVariant>& values) const;
+			bool unpack(const Chunk& chunk, std::vector<PIXVALUETYPE>& values) const;
+
+			quint32 _records = 0;
+			quint32 _rowsPerChunk = 0;
+			std::vector<Column> _columns;
+			SPMappedFile _mapped;
+		};
+	}
+}
+
+#endif // ILWIS4TABLECOLUMNS_H
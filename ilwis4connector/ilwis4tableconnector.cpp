@@ -27,6 +27,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #include "table.h"
 #include "ilwisobjectconnector.h"
 #include "ilwis4connector.h"
+#include "grid.h"
+#include "ilwis4tablecolumns.h"
 #include "ilwis4tableconnector.h"
 #include "ilwisobjectconnector.h"
 #include "operationhelper.h"
@@ -93,7 +95,11 @@ bool Ilwis4TableConnector::store(IlwisObject *obj, const IOOptions& options, QJs
 	jtable.insert("columndefinitions", defs);
 	QString path = obj->resource(IlwisObject::cmOUTPUT).url(true).toLocalFile();
 	QFileInfo inf(path);
-	jtable.insert("binarydata", inf.baseName() + ".izip");
+	// the values go to a column file, unless the csv data file of earlier versions is asked for
+	if (options.value("binaryformat").toString().toLower() == "csv")
+		jtable.insert("binarydata", inf.baseName() + ".izip");
+	else
+		jtable.insert("binarydata", inf.baseName() + ".icolumns");
 	return true;
 }
 
@@ -101,6 +107,9 @@ bool Ilwis4TableConnector::storeData(IlwisObject *obj, const IOOptions &options
 	
 	QFileInfo fi(_resource.url(true).toLocalFile());
 	QString basename = fi.baseName();
+	if (options.value("binaryformat").toString().toLower() != "csv")
+		return Ilwis4TableColumns::store(static_cast<Table *>(obj), fi.absolutePath() + "/" + basename + ".icolumns", options);
+
 	QString path = fi.absolutePath() + "/" + basename + ".csv_";
 	
 	QtCSV::Writer writer;
@@ -156,14 +165,19 @@ bool Ilwis4TableConnector::loadMetaData(IlwisObject *obj, const IOOptions &optio
 			QJsonArray jobjects = doc.array();
 			QJsonValue jvalue = jobjects.at(0);
 			QJsonValue jtable = jvalue["ilwisobject"];
-
-
+			_datafile = jtable["binarydata"].toString();
+			// a column file can be read in part; the table then only gets the selected columns
+			QStringList selected;
+			if (_datafile.endsWith(".icolumns"))
+				selected = Ilwis4TableColumns::selectedColumns(options.contains("columns") ? options : ioOptions());
 
 			int idx = 0;
 			QJsonArray jdefs = jtable["columndefinitions"].toArray();
 			for (auto jdefr : jdefs) {
 				QJsonObject jdef = jdefr.toObject();
 				QString cname = jdef["name"].toString();
+				if (selected.size() > 0 && !selected.contains(cname))
+					continue;
 				DataDefinition def;
 				loadDataDef(def, jdef["datadefinition"].toObject());
 				table->addColumn(ColumnDefinition( cname, def, idx++ ));
@@ -180,6 +194,12 @@ bool Ilwis4TableConnector::loadData(IlwisObject* obj, const IOOptions& options){
 	_binaryIsLoaded = false;
 	Resource res = obj->resource();
 	QString path = res.url(true).toLocalFile();
+	if (_datafile.endsWith(".icolumns")) {
+		Ilwis4TableColumns columns;
+		if (columns.open(QFileInfo(path).absolutePath() + "/" + _datafile))
+			_binaryIsLoaded = columns.load(static_cast<Table *>(obj));
+		return _binaryIsLoaded;
+	}
 	QString zipPath = path.replace(".ilwis4", ".izip");
 
 	QuaZip zipfile(zipPath);
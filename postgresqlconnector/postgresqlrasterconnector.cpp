@@ -187,20 +187,16 @@ bool PostgresqlRasterConnector::loadData(IlwisObject *data, const IOOptions &opt
 
     UPGrid& grid = coverage->gridRef();
     //blocklimits: key = band number, value= blocks needed from this band
-    quint32 linesPerBlock = grid->maxLines();
-    quint32 totalLines =grid->size().ysize();
     std::map<quint32, std::vector<quint32> > blocklimits;
     if ( layer == iUNDEF)
         blocklimits = grid->calcBlockLimits(options);
     else{
-        for(int i = 0; i < totalLines / linesPerBlock; ++i)
+        for(quint32 i = 0; i < grid->blocksPerBand(); ++i)
             blocklimits[layer].push_back(i);
     }
     std::vector<double> values;;
     for(const auto& layer : blocklimits) { // loop over layers
-        quint32 linesLeft = totalLines - grid->maxLines() * layer.second[0];
         quint32 layerNr = layer.first;
-        int inLayerBlockIndex = layer.second[0] % grid->blocksPerBand(); // blocknumber within a layer
         for(const auto& blockIndex : layer.second) { // loop over the blocknumbers (over all layers)
             quint32 noItems = grid->blockSize(blockIndex);
             if ( noItems == iUNDEF)
@@ -208,10 +204,12 @@ bool PostgresqlRasterConnector::loadData(IlwisObject *data, const IOOptions &opt
 
             values.resize(noItems);
 
-            quint32 gridblock_x_start = 0;
-            quint32 gridblock_y_start = inLayerBlockIndex * linesPerBlock;
-            quint32 gridblock_x_size = grid->size().xsize();
-            quint32 gridblock_y_size = std::min(linesPerBlock, linesLeft);
+            // the window of the block within its band; a full width strip or, for a tiled grid, a tile
+            BoundingBox box = grid->blockBox(blockIndex);
+            quint32 gridblock_x_start = box.min_corner().x;
+            quint32 gridblock_y_start = box.min_corner().y;
+            quint32 gridblock_x_size = box.xlength();
+            quint32 gridblock_y_size = box.ylength();
 
             QString sqlBuilder;
             if (!params.rasterID().isEmpty()) { // each record is an independent raster
@@ -370,9 +368,6 @@ bool PostgresqlRasterConnector::loadData(IlwisObject *data, const IOOptions &opt
             }
 
             grid->setBlockData(blockIndex, values);
-
-            if(!moveIndexes(linesPerBlock, linesLeft, inLayerBlockIndex))
-                break;
         }
     }
 
@@ -380,15 +375,6 @@ bool PostgresqlRasterConnector::loadData(IlwisObject *data, const IOOptions &opt
     return true;
 }
 
-bool PostgresqlRasterConnector::moveIndexes(quint32& linesPerBlock, quint32& linesLeft, int& inLayerBlockIndex)
-{
-    ++inLayerBlockIndex;
-    if ( linesLeft < linesPerBlock )
-        return false;
-    linesLeft -= linesPerBlock;
-    return true;
-}
-
 bool PostgresqlRasterConnector::store(IlwisObject *data, const IOOptions &options)
 {  
     return true;
@@ -37,7 +37,6 @@ public:
     bool store(IlwisObject* data, const IOOptions &options);
 
 private:
-    bool moveIndexes(quint32 &linesPerBlock, quint32 &linesLeft, int &gdalindex);
     IlwisTypes getStoreType(QString pixel_type, IDomain & dom) const;
     static char hex2dec(const char * str);
     static double getNodataVal(QString val, QString & pixel_type);
@@ -24,6 +24,10 @@
 #include "../../core/ilwisobjects/coverage/rastercoverage.h"
 
 #include "../../core/util/box.h"
+#include "../../core/util/taskscheduler.h"
+#include "../../core/ilwisobjects/coverage/blockcache.h"
+#include "../../core/ilwisobjects/coverage/memorygovernor.h"
+#include "../../core/ilwisobjects/coverage/blockprefetcher.h"
 
 #include "../../core/ilwisobjects/coverage/featurecoverage.h"
 #include "../../core/ilwisobjects/coverage/feature.h"
@@ -48,6 +52,7 @@ qint64 Engine::_do2(std::string output_name, std::string operation, std::string
     Ilwis::SymbolTable symtbl;
     Ilwis::ExecutionContext ctx;
     ctx.clear();
+    ctx._threaded = true;
     //is no internal result name is given it will look like operation_id
     //but the id is to be added afterwards
     bool rename = false;
@@ -160,6 +165,7 @@ Object* Engine::_do(std::string output_name, std::string operation, std::string
     Ilwis::SymbolTable symtbl;
     Ilwis::ExecutionContext ctx;
     ctx.clear();
+    ctx._threaded = true;
     //is no internal result name is given it will look like operation_id
     //but the id is to be added afterwards
     bool rename = false;
@@ -311,6 +317,84 @@ void Engine::setWorkingCatalog(const std::string& location) {
         throw Ilwis::ErrorObject(QString("invalid container location: '%1'").arg(location.c_str()));
 }
 
+void Engine::setThreadCount(int n){
+    Ilwis::taskscheduler()->threadCount(n);
+}
+
+int Engine::threadCount(){
+    return Ilwis::taskscheduler()->threadCount();
+}
+
+void Engine::setBlockCacheSize(qint64 bytes){
+    Ilwis::blockcache()->budget(std::max((qint64)0, bytes));
+}
+
+qint64 Engine::blockCacheSize(){
+    return Ilwis::blockcache()->budget();
+}
+
+PyObject* Engine::blockCacheStatistics(){
+    Ilwis::BlockCache::Statistics stats = Ilwis::blockcache()->statistics();
+    PyObject* dict = PyDictNew();
+    PyDictSetItemString(dict, "hits", PyLongFromUnsignedLongLong(stats._hits));
+    PyDictSetItemString(dict, "misses", PyLongFromUnsignedLongLong(stats._misses));
+    PyDictSetItemString(dict, "evictions", PyLongFromUnsignedLongLong(stats._evictions));
+    PyDictSetItemString(dict, "bytesused", PyLongFromUnsignedLongLong(stats._bytesUsed));
+    PyDictSetItemString(dict, "budget", PyLongFromUnsignedLongLong(stats._budget));
+    return dict;
+}
+
+void Engine::setMemoryLimit(qint64 bytes){
+    Ilwis::memorygovernor()->limit(std::max((qint64)0, bytes));
+}
+
+qint64 Engine::memoryLimit(){
+    return Ilwis::memorygovernor()->limit();
+}
+
+PyObject* Engine::memoryUsage(){
+    Ilwis::MemoryGovernor::Usage usage = Ilwis::memorygovernor()->usage();
+    PyObject* dict = PyDictNew();
+    PyDictSetItemString(dict, "limit", PyLongFromUnsignedLongLong(usage._limit));
+    PyDictSetItemString(dict, "residentbudget", PyLongFromUnsignedLongLong(usage._residentBudget));
+    PyDictSetItemString(dict, "residentbytes", PyLongFromUnsignedLongLong(usage._residentBytes));
+    PyDictSetItemString(dict, "packedbudget", PyLongFromUnsignedLongLong(usage._packedBudget));
+    PyDictSetItemString(dict, "packedbytes", PyLongFromUnsignedLongLong(usage._packedBytes));
+    PyDictSetItemString(dict, "spilledblocks", PyLongFromUnsignedLongLong(usage._spilledBlocks));
+    PyDictSetItemString(dict, "spilledbytes", PyLongFromUnsignedLongLong(usage._spilledBytes));
+    PyDictSetItemString(dict, "grids", PyLongFromUnsignedLongLong(usage._grids));
+    PyDictSetItemString(dict, "spillwrites", PyLongFromUnsignedLongLong(usage._spillWrites));
+    PyDictSetItemString(dict, "spillreads", PyLongFromUnsignedLongLong(usage._spillReads));
+    PyDictSetItemString(dict, "spillfilebytes", PyLongFromUnsignedLongLong(usage._spillFileBytes));
+    PyDictSetItemString(dict, "bytessaved", PyLongFromUnsignedLongLong(usage._bytesSaved));
+    PyDictSetItemString(dict, "constantblocks", PyLongFromUnsignedLongLong(usage._constantBlocks));
+    PyDictSetItemString(dict, "spillwritetime", PyLongFromUnsignedLongLong(usage._spillWriteNanos));
+    PyDictSetItemString(dict, "spillreadtime", PyLongFromUnsignedLongLong(usage._spillReadNanos));
+    return dict;
+}
+
+void Engine::setPrefetchDepth(int blocks){
+    Ilwis::blockprefetcher()->depth(blocks);
+}
+
+int Engine::prefetchDepth(){
+    return Ilwis::blockprefetcher()->depth();
+}
+
+PyObject* Engine::prefetchStatistics(){
+    Ilwis::BlockPrefetcher::Statistics stats = Ilwis::blockprefetcher()->statistics();
+    PyObject* dict = PyDictNew();
+    PyDictSetItemString(dict, "requests", PyLongFromUnsignedLongLong(stats._requests));
+    PyDictSetItemString(dict, "loads", PyLongFromUnsignedLongLong(stats._loads));
+    PyDictSetItemString(dict, "hits", PyLongFromUnsignedLongLong(stats._hits));
+    PyDictSetItemString(dict, "stalls", PyLongFromUnsignedLongLong(stats._stalls));
+    PyDictSetItemString(dict, "stalltime", PyLongFromUnsignedLongLong(stats._stallNanos));
+    PyDictSetItemString(dict, "avoidedtime", PyLongFromUnsignedLongLong(stats._avoidedNanos));
+    PyDictSetItemString(dict, "depth", PyLongFromUnsignedLongLong(stats._depth));
+    PyDictSetItemString(dict, "threads", PyLongFromUnsignedLongLong(stats._threads));
+    return dict;
+}
+
 std::string Engine::getLocation(){
     Ilwis::ICatalog cat = Ilwis::context()->workingCatalog();
     QUrl location = cat->filesystemLocation();
@@ -15,6 +15,17 @@ namespace pythonapi {
         static void setWorkingCatalog(const std::string& location);
         static void _setWorkingCatalog(const std::string& location);
         static std::string getLocation();
+        static void setThreadCount(int n);
+        static int threadCount();
+        static void setBlockCacheSize(qint64 bytes);
+        static qint64 blockCacheSize();
+        static PyObject* blockCacheStatistics();
+        static void setMemoryLimit(qint64 bytes);
+        static qint64 memoryLimit();
+        static PyObject* memoryUsage();
+        static void setPrefetchDepth(int blocks);
+        static int prefetchDepth();
+        static PyObject* prefetchStatistics();
         static PyObject* operations();
         static std::string operationMetaData(const std::string& name, const std::string &element = "syntax");
         static std::string _operationMetaData(const std::string& name, const std::string &element1 = "syntax", int ordinal=-1, const std::string &element2 = "");
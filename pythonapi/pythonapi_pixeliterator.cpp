@@ -135,8 +135,10 @@ double PixelIterator::__getitem__(quint32 linearPosition){
 }
 
 void PixelIterator::__setitem__(quint32 linearPosition, double value){
-    if (linearPosition < _endposition)
+    if (linearPosition < _endposition) {
         this->ptr()[linearPosition] = value;
+        this->ptr().raster()->changed(true);
+    }
 }
 
 PixelIterator PixelIterator::operator+ (int n){
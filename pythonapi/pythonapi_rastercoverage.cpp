@@ -6,6 +6,7 @@
 #include "../../core/ilwisobjects/ilwisobject.h"
 
 #include "../../core/ilwisobjects/ilwisdata.h"
+#include "../../core/connectorinterface.h"
 #include "../../core/ilwisobjects/domain/domain.h"
 #include "../../core/ilwisobjects/domain/datadefinition.h"
 #include "../../core/ilwisobjects/table/columndefinition.h"
@@ -484,6 +485,7 @@ void pythonapi::RasterCoverage::_array2Raster(PyObject* container, int band)
         setValues((double*)pybuf.buf, nItems, iter);
     else if (format == itBOOL)
         setValues((bool*)pybuf.buf, nItems, iter);
+    raster->changed(true); // e.g. the overviews no longer apply
 
     PyBuffer_Release(&pybuf);
 }
@@ -510,6 +512,7 @@ void RasterCoverage::_list2Raster(PyObject *container, int band)
         ++iter;
         Py_DECREF(item);
     }
+    raster->changed(true);
 
     Py_DECREF(iterator);
 }
@@ -530,10 +533,54 @@ void RasterCoverage::setSize(const Size &sz){
     this->ptr()->as<Ilwis::RasterCoverage>()->size(sz.data());
 }
 
+Size RasterCoverage::tileSize(){
+    return Size(this->ptr()->as<Ilwis::RasterCoverage>()->tileSize());
+}
+
+void RasterCoverage::setTileSize(const Size &sz){
+    this->ptr()->as<Ilwis::RasterCoverage>()->tileSize(sz.data());
+}
+
+bool RasterCoverage::isInterleaved(){
+    return this->ptr()->as<Ilwis::RasterCoverage>()->isInterleaved();
+}
+
+void RasterCoverage::setInterleaved(bool yes){
+    this->ptr()->as<Ilwis::RasterCoverage>()->interleaved(yes);
+}
+
+RasterCoverage* RasterCoverage::overview(quint32 level){
+    Ilwis::IRasterCoverage ilwRc = this->ptr()->as<Ilwis::RasterCoverage>()->overview(level);
+    return new RasterCoverage(ilwRc);
+}
+
+quint32 RasterCoverage::overviewLevels(){
+    return this->ptr()->as<Ilwis::RasterCoverage>()->overviewLevels();
+}
+
 void RasterCoverage::unload(){
     this->ptr()->as<Ilwis::RasterCoverage>()->unload();
 }
 
+bool RasterCoverage::loadData(const IOOptions& options){
+    return this->ptr()->as<Ilwis::RasterCoverage>()->loadData(options.ptr());
+}
+
+bool RasterCoverage::hasBlockData(quint32 block){
+    return this->ptr()->as<Ilwis::RasterCoverage>()->gridRef()->hasData(block);
+}
+
+PyObject* RasterCoverage::connectorStatistics(){
+    QVariantMap stats;
+    auto& connector = this->ptr()->as<Ilwis::RasterCoverage>()->connector();
+    if ( !connector.isNull())
+        stats = connector->statistics();
+    PyObject* dict = PyDictNew();
+    for(auto iter = stats.begin(); iter != stats.end(); ++iter)
+        PyDictSetItemString(dict, iter.key().toStdString().c_str(), QVariant2PyObject(iter.value()));
+    return dict;
+}
+
 RasterCoverage* RasterCoverage::toRasterCoverage(Object* obj){
     RasterCoverage* ptr = dynamic_cast<RasterCoverage*>(obj);
     if(!ptr)
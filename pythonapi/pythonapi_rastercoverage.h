@@ -75,7 +75,16 @@ namespace pythonapi {
 
         Size size();
         void setSize(const Size& sz);
+        Size tileSize();
+        void setTileSize(const Size& sz);
+        bool isInterleaved();
+        void setInterleaved(bool yes);
+        RasterCoverage* overview(quint32 level);
+        quint32 overviewLevels();
         void unload();
+        bool loadData(const IOOptions& options);
+        bool hasBlockData(quint32 block);
+        PyObject* connectorStatistics();
 
         CoordinateSystem coordinateSystem();
 
@@ -281,6 +281,7 @@ namespace pythonapi {
     class IOOptions{
         friend class IlwisObject;
         friend class Table;
+        friend class RasterCoverage;
     public:
         IOOptions();
         IOOptions(const std::string& key, PyObject* value);
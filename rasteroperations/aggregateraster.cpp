@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.*/
 #include "symboltable.h"
 #include "ilwisoperation.h"
 #include "blockiterator.h"
+#include "neighbourhoodwindow.h"
 #include "aggregateraster.h"
 
 using namespace Ilwis;
@@ -43,10 +44,28 @@ AggregateRaster::AggregateRaster(quint64 metaid, const Ilwis::OperationExpressio
 }
 
 
-void AggregateRaster::executeGrouped(const BoundingBox& inpBox){
+void AggregateRaster::executeGrouped(const BoundingBox& inpBox, const BoundingBox& outBox, int threadIdx){
+    if ( groupSize(2) == 1) { // the groups of a band are read as windows on a ring of rows; nothing is allocated per group
+        RasterRows rows(_inputObj.as<RasterCoverage>(), inpBox.min_corner().x, inpBox.max_corner().x, groupSize(1), RasterRows::epCLAMP, threadIdx);
+        NeighbourhoodWindow window(rows, groupSize(0), groupSize(1));
+        PixelIterator iterOut(_outputObj.as<RasterCoverage>(), threadIdx, outBox);
+        PixelIterator iterEnd = iterOut.end();
+        qint32 band = iUNDEF;
+        while(iterOut != iterEnd) {
+            Pixel pix = iterOut.position();
+            if ( pix.z != band)
+                rows.band(band = pix.z);
+            window.moveTo(pix.x * groupSize(0), pix.y * groupSize(1));
+            *iterOut = OperationHelper::statisticalMarker(window.values(), _method);
+            ++iterOut;
+
+            updateTranquilizer(iterOut.linearPosition(), 1000);
+        }
+        return;
+    }
     BlockIterator blockInputIter(_inputObj.as<RasterCoverage>(),Size<>(groupSize(0),groupSize(1), groupSize(2)), inpBox);
 
-    PixelIterator iterOut(_outputObj.as<RasterCoverage>());
+    PixelIterator iterOut(_outputObj.as<RasterCoverage>(), threadIdx, outBox);
     PixelIterator iterEnd = iterOut.end();
     while(iterOut != iterEnd) {
         std::vector<double> values= (*blockInputIter).toVector();
@@ -94,11 +113,13 @@ bool AggregateRaster::execute(ExecutionContext *ctx, SymbolTable& symTable)
                       (box.max_corner().z + 1) * groupSize(2) - 1) );
 
             if ( _grouped)
-                executeGrouped( inpBox);
+                executeGrouped( inpBox, box, threadIdx);
             else
                 executeNonGrouped( inpBox);
         return true;
     };
+    if ( !_grouped) // the boxes of the threads are not aligned with the aggregation groups
+        ctx->_threaded = false;
 	bool res = OperationHelperRaster::execute(ctx, aggregateFun, { _inputObj.as<RasterCoverage>(), outputRaster });
 
     if ( res && ctx != 0) {
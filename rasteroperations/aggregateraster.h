@@ -42,7 +42,7 @@ private:
     std::vector<quint32> _groupSize = {1,1,1};
 
     NumericStatistics::PropertySets toMethod(const QString &nm);
-    void executeGrouped(const BoundingBox &inpBox);
+    void executeGrouped(const BoundingBox &inpBox, const BoundingBox &outBox, int threadIdx);
     void executeNonGrouped(const BoundingBox &inpBox);
 };
 }
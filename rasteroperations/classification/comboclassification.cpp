@@ -67,7 +67,8 @@ bool ComboClassification::execute(ExecutionContext *ctx,SymbolTable& symTable){
         }
     }
 
-    quint64 currentCount = 0;
+    std::atomic<quint64> currentCount(0);
+    std::mutex rangeMutex;
     std::function<bool(const BoundingBox, int)> binaryMath = [&](const BoundingBox box, int threadIdx) -> bool {
         PixelIterator iterInX(_inputRasterX, box);
         PixelIterator iterInY(_inputRasterY, box);
@@ -90,6 +91,7 @@ bool ComboClassification::execute(ExecutionContext *ctx,SymbolTable& symTable){
             ++iterOut;
             updateTranquilizer(currentCount++, 1000);
         };
+		std::lock_guard<std::mutex> lock(rangeMutex); // the range of the output is shared by all threads
 		auto itemdom = _outputRaster->datadef().domain().as<ItemDomain<DomainItem>>();
 		for (quint32 i = 0; i < allRaws.size(); ++i) {
 			if (allRaws[i]) {
@@ -48,6 +48,7 @@ bool RasterSlicing::execute(ExecutionContext *ctx, SymbolTable &symTable)
         if((_prepState = prepare(ctx,symTable)) != sPREPARED)
             return false;
 
+    std::mutex tableMutex;
     BoxedAsyncFunc sliceFun = [&](const BoundingBox& box, int threadIdx) -> bool {
         PixelIterator iterOut(_outputRaster, box);
         PixelIterator iterEnd = iterOut.end();
@@ -74,7 +75,10 @@ bool RasterSlicing::execute(ExecutionContext *ctx, SymbolTable &symTable)
                             lastIndex = i;
                             lastRaw = _bounds[lastIndex]->raw();
                             outValue = lastRaw;
-                            attTable->setCell(colIndex,(quint32)outValue,outValue);
+                            {
+                                std::lock_guard<std::mutex> lock(tableMutex); // the attribute table is shared by all threads
+                                attTable->setCell(colIndex,(quint32)outValue,outValue);
+                            }
                             break;
                         }
                     }
@@ -225,6 +225,7 @@ bool DistanceRaster::execute(ExecutionContext *ctx, SymbolTable& symTable)
         return true;
     };
 
+    ctx->_threaded = false; // operation works on the whole raster and can not be run in parallel
 	bool resource = OperationHelperRaster::execute(ctx, distanceFun, { _inputRaster, _inputOptWeightRaster,_inputThiessenRaster, _outputRaster });
 
     if ( resource && ctx != 0) {
@@ -48,15 +48,8 @@ bool RankOrderRasterFilter::execute(ExecutionContext *ctx, SymbolTable &symTable
         if((_prepState = prepare(ctx,symTable)) != sPREPARED)
             return false;
 
-   BoxedAsyncFunc filterFun = [&](const BoundingBox& box, int threadIdx) -> bool {
-        PixelIterator iterOut(_outputRaster, box);
-        BlockIterator blockIter(_inputRaster,_filter->size(), box, Size<>(1,1,1));
-        PixelIterator iterEnd = iterOut.end();
-        while(iterOut != iterEnd) {
-            *iterOut = _filter->applyTo(*blockIter);
-            ++iterOut;
-            ++blockIter;
-        }
+   auto filterFun = [&](const BoundingBox& box, int threadIdx, OutputStatistics::Written& written) -> bool {
+        _filter->applyTo(_inputRaster, _outputRaster, box, threadIdx, &written);
         return true;
     };
 
@@ -72,6 +72,7 @@ bool StackMinMaxFilter::execute(ExecutionContext *ctx, SymbolTable &symTable)
         return true;
     };
 
+   ctx->_threaded = false; // the output of a pixel is only written when the iteration reaches the next pixel; a box boundary would lose pixels
    bool res = OperationHelperRaster::execute(ctx, filterFun, { _inputRaster, _outputRaster });
 
     if ( res && ctx != 0) {
@@ -145,6 +145,7 @@ bool MirrorRotateRaster::execute(ExecutionContext *ctx, SymbolTable &symTable)
 
     };
 
+    ctx->_threaded = false; // operation works on the whole raster and can not be run in parallel
 	bool ok = OperationHelperRaster::execute(ctx, Transform, { _inputRaster, _outputRaster });
 
     if ( ok && ctx != 0) {
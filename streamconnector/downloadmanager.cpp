@@ -68,14 +68,16 @@ bool DownloadManager::loadData(IlwisObject *object, const IOOptions &options){
     QUrlQuery query(url);
     if ( object->ilwisType() == itRASTER){
         RasterCoverage *raster = static_cast<RasterCoverage*>(object);
+        // the server sends full width lines, which are only the blocks of a grid of strips; see loadMetaData()
+        if ( raster->grid()->blocksPerRow() != 1)
+            return ERROR2(ERR_OPERATION_NOTSUPPORTED2, TR("reading tiles"), raster->name());
         _blockSizeBytes = raster->grid()->blockSize(0);
         if ( options.contains("blockindex")){
             _currentBlock = options["blockindex"].toInt();
-            int layer = _currentBlock / raster->grid()->blocksPerBand();
-            int relativeBlock = _currentBlock - layer * raster->grid()->blocksPerBand();
-            unsigned int minLine = raster->grid()->maxLines() * relativeBlock ;
-            unsigned int maxLine = std::min( minLine + raster->grid()->maxLines(), raster->size().ysize());
-            query.addQueryItem("lines",QString("%1 %2 %3").arg(layer).arg(minLine).arg(maxLine));
+            BoundingBox box = raster->grid()->blockBox(_currentBlock);
+            quint32 minLine = box.min_corner().y;
+            quint32 maxLine = box.max_corner().y + 1;
+            query.addQueryItem("lines",QString("%1 %2 %3").arg(box.min_corner().z).arg(minLine).arg(maxLine));
         }
     }
     query.addQueryItem("datatype","data");
@@ -128,6 +130,13 @@ bool DownloadManager::loadMetaData(IlwisObject *object, const IOOptions &options
 
     delete reply;*/
 
+    if ( object->ilwisType() == itRASTER){
+        // the blocks of a remote raster are the full width strips the server sends, whatever tiles the raster had at its source
+        RasterCoverage *raster = static_cast<RasterCoverage*>(object);
+        if ( raster->gridRef()->isTiled())
+            raster->tileSize(Size<>());
+    }
+
     return true;
 }
 
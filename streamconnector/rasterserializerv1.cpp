@@ -42,7 +42,30 @@ RasterSerializerV1::RasterSerializerV1(QDataStream& stream, const QString &versi
 
 template<typename T> void storeBulk(const RawConverter& converter, QDataStream& stream, StreamConnector *streamconnector, const BoundingBox& box, const IRasterCoverage& raster){
     quint64 count = streamconnector->position();
-    if ( streamconnector->isFileBased()){
+    if ( streamconnector->isFileBased() && (raster->grid()->isTiled() || raster->grid()->isInterleaved())){
+        // the stream holds full width strips of a band, as the grid on the reading side has them; the values of a tiled or band interleaved grid are regrouped
+        const UPGrid& grid = raster->grid();
+        Size<> sz = grid->size();
+        quint32 lines = Grid::stripLines(sz.xsize());
+        quint32 stripsPerBand = (sz.ysize() + lines - 1) / lines;
+        quint32 blockCount = stripsPerBand * sz.zsize();
+        stream << blockCount;
+        std::vector<T> rawData((quint64)lines * sz.xsize());
+        for(quint32 i = 0; i < blockCount; ++i){
+            quint32 z = i / stripsPerBand;
+            quint32 firstLine = (i % stripsPerBand) * lines;
+            quint32 endLine = std::min(firstLine + lines, sz.ysize());
+            quint64 blockSize = (quint64)(endLine - firstLine) * sz.xsize();
+            stream << i;
+            stream << blockSize;
+            quint64 j = 0;
+            for(quint32 y = firstLine; y < endLine; ++y)
+                for(quint32 x = 0; x < sz.xsize(); ++x)
+                    rawData[j++] = converter.real2raw(grid->value(Pixel(x, y, z)));
+            stream.writeRawData((const char *)rawData.data(), blockSize * sizeof(T));
+        }
+        streamconnector->flush(true);
+    } else if ( streamconnector->isFileBased()){
         const UPGrid& grid = raster->grid();
         quint32 blockCount = grid->blocks();
         stream << blockCount;
@@ -71,6 +94,34 @@ template<typename T> void storeBulk(const RawConverter& converter, QDataStream&
     }
 }
 
+// the stream holds full width strips; for a grid of tiles (or of strips of another height) the lines are collected per row of blocks and the blocks
+// of that row are set once all their lines are there
+void setStripData(const UPGrid& grid, quint32 z, quint32 firstLine, const std::vector<PIXVALUETYPE>& strip, std::vector<PIXVALUETYPE>& blockRow){
+    quint64 xsize = grid->size().xsize();
+    quint32 ysize = grid->size().ysize();
+    quint32 linesPerRow = grid->maxLines();
+    if ( blockRow.size() != linesPerRow * xsize)
+        blockRow.resize(linesPerRow * xsize);
+    quint32 lines = strip.size() / xsize;
+    for(quint32 line = 0; line < lines && firstLine + line < ysize; ++line){
+        quint32 y = firstLine + line;
+        std::copy(strip.begin() + line * xsize, strip.begin() + (line + 1) * xsize, blockRow.begin() + (y % linesPerRow) * xsize);
+        if ( (y + 1) % linesPerRow != 0 && y + 1 != ysize)
+            continue;
+        quint32 firstBlock = z * grid->blocksPerBand() + (y / linesPerRow) * grid->blocksPerRow();
+        for(quint32 block = firstBlock; block < firstBlock + grid->blocksPerRow(); ++block){
+            BoundingBox bbox = grid->blockBox(block);
+            std::vector<PIXVALUETYPE> values;
+            values.reserve(grid->blockSize(block));
+            for(qint32 by = bbox.min_corner().y; by <= bbox.max_corner().y; ++by){
+                auto rowStart = blockRow.begin() + (by % linesPerRow) * xsize;
+                values.insert(values.end(), rowStart + bbox.min_corner().x, rowStart + bbox.max_corner().x + 1);
+            }
+            grid->setBlockData(block, values);
+        }
+    }
+}
+
 template<typename T> void loadBulk(std::vector<T>& rawdata, std::vector<PIXVALUETYPE>& realdata,const RawConverter& converter, QDataStream& stream, StreamConnector *streamconnector, const BoundingBox& box, const IRasterCoverage& raster){
 
     if ( streamconnector->isFileBased()){
@@ -80,7 +131,8 @@ template<typename T> void loadBulk(std::vector<T>& rawdata, std::vector<PIXVALUE
         if ( !box.isNull() && box.isValid()){
             //for the moment we only accept whole layers as possible subsets, might improve this in the future
             int layer = box.min_corner().z ;
-            blockCount =  raster->grid()->blocksPerBand();
+            quint32 stripLines = Grid::stripLines(raster->size().xsize()); // the strips of the stream, whatever the layout of the grid
+            blockCount = (raster->size().ysize() + stripLines - 1) / stripLines;
             int extraOffsets = blockCount * layer * (sizeof(quint32) + sizeof(qint64)); // per block there is an index and a blocksize - 12 bytes;
             int seekPos = stream.device()->pos() + extraOffsets + layer * (raster->size().xsize() * raster->size().ysize() * sizeof(T));
             stream.device()->seek(seekPos);
@@ -92,6 +144,12 @@ template<typename T> void loadBulk(std::vector<T>& rawdata, std::vector<PIXVALUE
         stream >> blockIndex;
         stream >> blockSize;
         initBlockSize = blockSize;
+        // the blocks of the stream are full width strips; a grid with the same strips takes them as they are
+        const UPGrid& grid = raster->grid();
+        quint32 linesPerStrip = std::max((quint64)1, initBlockSize / raster->size().xsize());
+        quint32 stripsPerBand = (raster->size().ysize() + linesPerStrip - 1) / linesPerStrip;
+        bool sameBlocks = !grid->isInterleaved() && grid->blocksPerRow() == 1 && grid->maxLines() == linesPerStrip;
+        std::vector<PIXVALUETYPE> blockRow;
 
 		if (initBlockSize != rawdata.size())
 			rawdata.resize(initBlockSize);
@@ -110,7 +168,10 @@ template<typename T> void loadBulk(std::vector<T>& rawdata, std::vector<PIXVALUE
 			//	}
 				realdata[j] = converter.raw2real(rawdata[j]);
 			}
-            raster->gridRef()->setBlockData(i, realdata);
+            if ( sameBlocks)
+                raster->gridRef()->setBlockData(i, realdata);
+            else
+                setStripData(raster->gridRef(), i / stripsPerBand, (i % stripsPerBand) * linesPerStrip, realdata, blockRow);
             if ( i < blockCount - 1){
                 stream >> blockIndex;
                 stream >> blockSize;
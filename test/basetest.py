@@ -4,6 +4,8 @@ import config
 import numpy as np
 import math
 from os.path import abspath
+import glob
+import os
 
 
 def testExceptionCondition6(p, func, parm1, parm2, parm3, parm4, parm5, parm6, message):
@@ -52,13 +54,21 @@ class BaseTest(unittest.TestCase):
     def prepare(self, testdir):
         try:
             ilwis.disconnectIssueLogger()
-            workingdir = abspath('.') + '/' + testdir
-            ilwis.Engine.setWorkingCatalog(workingdir)
+            self.workingdir = abspath('.') + '/' + testdir
+            ilwis.Engine.setWorkingCatalog(self.workingdir)
             ilwis.connectIssueLogger()
         except ilwis.IlwisException:
             ilwis.connectIssueLogger()
             self.skipTest("could not set working directory!")
 
+    def removeFiles(self, pattern):
+        # removes the files a test wrote in the working directory; a file that is still open is left
+        for path in glob.glob(self.workingdir + '/' + pattern):
+            try:
+                os.remove(path)
+            except OSError:
+                pass
+
     def isEqual(self, str1, str2, msg):
         config.testCount += 1 
         result = 'SUCCESS'
@@ -128,6 +138,20 @@ class BaseTest(unittest.TestCase):
 
         return rc
 
+    def createNumericRaster(self, xsize, ysize, zsize, values, tileSize = None, interleaved = False):
+        # a raster with the given values in the layout of the grid under test; tileSize (an ilwis.Size) selects tiles instead of strips
+        grf = ilwis.GeoReference("epsg:4326", ilwis.Envelope("0 25 30 60") , ilwis.Size(xsize,ysize))
+        rc = ilwis.RasterCoverage()
+        rc.setGeoReference(grf)
+        rc.setDataDef(ilwis.DataDefinition(ilwis.NumericDomain("code=value"), ilwis.NumericRange(-100000, 100000, 0)))
+        if tileSize is not None:
+            rc.setTileSize(tileSize)
+        if interleaved:
+            rc.setInterleaved(True)
+        rc.setSize(ilwis.Size(xsize, ysize, zsize))
+        rc.array2raster(values)
+        return rc
+
     def createThematicDomain(self):
         tr = ilwis.ThematicRange()
         tr.add("grass", "1", "mostely green")
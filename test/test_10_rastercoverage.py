@@ -3,6 +3,7 @@ import basetest as bt
 import ilwis
 import inspect
 import numpy as np
+import struct
 
 class TestBasicRasterCoverage(bt.BaseTest):
     def setUp(self):
@@ -10,6 +11,13 @@ class TestBasicRasterCoverage(bt.BaseTest):
         self.baseXSize = 15
         self.baseYSize = 12
         self.baseZSize = 3
+        # tests that change the memory settings of the engine get them restored, also when they fail
+        self.memoryLimit = ilwis.Engine.memoryLimit()
+        self.blockCacheSize = ilwis.Engine.blockCacheSize()
+
+    def tearDown(self):
+        ilwis.Engine.setMemoryLimit(self.memoryLimit)
+        ilwis.Engine.setBlockCacheSize(self.blockCacheSize)
       
 
 
@@ -73,7 +81,375 @@ class TestBasicRasterCoverage(bt.BaseTest):
         self.isEqual(rc.pix2value(ilwis.Pixel(2,11,1)), 3470, "Checking pixel value at 2,11,1, band 1, bulk fill")
         self.isEqual(rc.pix2value(ilwis.Pixel(2,11,2)),5270, "Checking pixel value at 2,11,2, band 2, bulk fill")
 
-    
+    def test_06_packedBlocks(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
 
+        # a block cache of a few blocks, so blocks that are not pinned are swapped out (packed) and brought back
+        ilwis.Engine.setBlockCacheSize(4 * 100 * 8)
+        grf = ilwis.GeoReference("epsg:4326", ilwis.Envelope("0 25 30 60") , ilwis.Size(10,10))
+        rc = ilwis.RasterCoverage()
+        rc.setGeoReference(grf)
+        rc.setDataDef(ilwis.DataDefinition(ilwis.NumericDomain("code=value"), ilwis.NumericRange(-1e12, 1e12, 0)))
+        rc.setSize(ilwis.Size(10, 10, 36))
+        patterns = [lambda i : min(255, int(i * 2.6)), # bytes, including 255
+                    lambda i : ilwis.Const.rUNDEF if i == 7 else min(255, int(i * 2.6)), # bytes, including 255, and undefined values
+                    lambda i : i - 50, # int16
+                    lambda i : i * 650, # uint16
+                    lambda i : i * 1000000 - 3, # int32
+                    lambda i : i * 0.5, # float
+                    lambda i : i * 0.1, # double
+                    lambda i : 3e38 * i if i > 0 else ilwis.Const.rUNDEF, # beyond float
+                    lambda i : 2.0 ** 40 + i] # integers beyond int32
+        expected = []
+        for z in range(36):
+            band = np.empty(100, dtype = np.float64)
+            pattern = patterns[z % len(patterns)]
+            for i in range(100):
+                band[i] = pattern(i)
+            rc.array2raster(band, z)
+            expected.append(band)
 
-        
+        for z in range(36):
+            for i in range(0, 100, 7):
+                self.isEqual(rc.pix2value(ilwis.Pixel(i % 10, i // 10, z)), expected[z][i], "Packed value at " + str(i) + " of band " + str(z))
+
+        stats = ilwis.Engine.blockCacheStatistics()
+        self.isTrue(stats["misses"] > 0, "Packed blocks made resident through the block cache")
+        self.isEqual(stats["budget"], 4 * 100 * 8, "Block cache budget")
+
+    def test_07_memoryGovernor(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # half of the limit is the pool for packed blocks; the first raster fills it, the second one gets half of it and spills blocks of the first
+        ilwis.Engine.setMemoryLimit(32 * 1024 * 1024)
+        usage = ilwis.Engine.memoryUsage()
+        self.isEqual(usage["limit"], 32 * 1024 * 1024, "Memory limit")
+        self.isEqual(usage["residentbudget"] + usage["packedbudget"], usage["limit"], "Budgets within the limit")
+
+        grf = ilwis.GeoReference("epsg:4326", ilwis.Envelope("0 25 30 60") , ilwis.Size(1000,1000))
+        rasters = []
+        for r in range(2):
+            rc = ilwis.RasterCoverage()
+            rc.setGeoReference(grf)
+            rc.setDataDef(ilwis.DataDefinition(ilwis.NumericDomain("code=value"), ilwis.NumericRange(-1e12, 1e12, 0)))
+            rc.setSize(ilwis.Size(1000, 1000, 2))
+            for z in range(2):
+                rc.array2raster(np.arange(1000000, dtype = np.float64) * 0.1 + r * 10 + z, z)
+            rasters.append(rc)
+
+        usage = ilwis.Engine.memoryUsage()
+        self.isTrue(usage["spilledblocks"] > 0, "Packed blocks spilled to make place for the second raster")
+        self.isTrue(usage["packedbytes"] <= usage["packedbudget"], "Packed blocks within the pool")
+        self.isTrue(usage["spillwrites"] > 0, "Spilled blocks written to the cache files")
+        for r in range(2):
+            for z in range(2):
+                for i in range(0, 1000000, 99991):
+                    self.isEqual(rasters[r].pix2value(ilwis.Pixel(i % 1000, i // 1000, z)), i * 0.1 + r * 10 + z, "Value at " + str(i) + " of band " + str(z) + " of raster " + str(r))
+
+    def test_08_constantBlocks(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # blocks with one value everywhere, or only undefined values, are kept as a single value instead of being spilled
+        before = ilwis.Engine.memoryUsage()["constantblocks"]
+        grf = ilwis.GeoReference("epsg:4326", ilwis.Envelope("0 25 30 60") , ilwis.Size(100,100))
+        rc = ilwis.RasterCoverage()
+        rc.setGeoReference(grf)
+        rc.setDataDef(ilwis.DataDefinition(ilwis.NumericDomain("code=value"), ilwis.NumericRange(-1000, 1000, 0)))
+        rc.setSize(ilwis.Size(100, 100, 3))
+        rc.array2raster(np.full(10000, ilwis.Const.rUNDEF, dtype = np.float64), 0)
+        rc.array2raster(np.full(10000, 7.0, dtype = np.float64), 1)
+        mixed = np.full(10000, 7.0, dtype = np.float64)
+        mixed[5000] = ilwis.Const.rUNDEF
+        rc.array2raster(mixed, 2)
+
+        self.isTrue(ilwis.Engine.memoryUsage()["constantblocks"] >= before + 2, "Constant blocks")
+        for i in range(0, 10000, 997):
+            self.isEqual(rc.pix2value(ilwis.Pixel(i % 100, i // 100, 0)), ilwis.Const.rUNDEF, "Undefined block at " + str(i))
+            self.isEqual(rc.pix2value(ilwis.Pixel(i % 100, i // 100, 1)), 7.0, "Constant block at " + str(i))
+        self.isEqual(rc.pix2value(ilwis.Pixel(0, 50, 2)), ilwis.Const.rUNDEF, "Undefined value in mixed block")
+        self.isEqual(rc.pix2value(ilwis.Pixel(1, 50, 2)), 7.0, "Defined value in mixed block")
+
+    def test_09_tiledGrid(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # a grid of 16x16 tiles (with partial tiles at the right and bottom edge) must give the same results as the default full width strips
+        values = np.arange(7000, dtype = np.float64) % 997
+        strips = self.createNumericRaster(70, 50, 2, values)
+        tiles = self.createNumericRaster(70, 50, 2, values, ilwis.Size(16, 16))
+        self.isEqual(tiles.tileSize().xsize, 16, "Tile width")
+        self.isEqual(tiles.tileSize().ysize, 16, "Tile height")
+        self.isEqual(strips.tileSize().xsize, 70, "Strip width")
+        for z in range(2):
+            for y in range(0, 50, 3):
+                for x in range(70):
+                    self.isEqual(tiles.pix2value(ilwis.Pixel(x, y, z)), strips.pix2value(ilwis.Pixel(x, y, z)), "Tiled value at " + str(x) + " " + str(y) + " " + str(z))
+
+        fstrips = ilwis.do("linearrasterfilter", strips, "code=1 2 1 2 4 2 1 2 1")
+        ftiles = ilwis.do("linearrasterfilter", tiles, "code=1 2 1 2 4 2 1 2 1")
+        mstrips = ilwis.do("mapcalc", "@1 * 2 + 1", strips)
+        mtiles = ilwis.do("mapcalc", "@1 * 2 + 1", tiles)
+        for y in range(0, 50, 7):
+            for x in range(70):
+                self.isEqual(ftiles.pix2value(ilwis.Pixel(x, y, 0)), fstrips.pix2value(ilwis.Pixel(x, y, 0)), "Filtered tiles at " + str(x) + " " + str(y))
+                self.isEqual(mtiles.pix2value(ilwis.Pixel(x, y, 1)), mstrips.pix2value(ilwis.Pixel(x, y, 1)), "Mapcalc on tiles at " + str(x) + " " + str(y))
+
+    def test_10_cloneSharesBlocks(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # a clone refers to the blocks of its original; changing one of them must not change the other
+        rc = self.createNumericRaster(60, 40, 2, np.arange(4800, dtype = np.float64) % 251)
+        copy = rc.clone()
+        copy.array2raster(np.full(2400, 7, dtype = np.float64), 1)
+        for y in range(0, 40, 5):
+            for x in range(0, 60, 3):
+                self.isEqual(copy.pix2value(ilwis.Pixel(x, y, 0)), rc.pix2value(ilwis.Pixel(x, y, 0)), "Shared band at " + str(x) + " " + str(y))
+                self.isEqual(copy.pix2value(ilwis.Pixel(x, y, 1)), 7, "Changed band of the clone at " + str(x) + " " + str(y))
+                self.isEqual(rc.pix2value(ilwis.Pixel(x, y, 1)), (2400 + y * 60 + x) % 251, "Original band at " + str(x) + " " + str(y))
+
+    def test_11_interleavedGrid(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # a grid that keeps the bands of a pixel together must give the same results as one with blocks per band, also after a conversion between the two
+        values = np.arange(7200, dtype = np.float64) % 613
+        bands = self.createNumericRaster(40, 30, 6, values)
+        interleaved = self.createNumericRaster(40, 30, 6, values, interleaved = True)
+        converted = self.createNumericRaster(40, 30, 6, values)
+        converted.setInterleaved(True)
+        self.isTrue(interleaved.isInterleaved(), "Interleaved grid")
+        sums = [ilwis.do("aggregaterasterstatistics", rc, "sum") for rc in [bands, interleaved, converted]]
+        for y in range(0, 30, 4):
+            for x in range(40):
+                for z in range(6):
+                    pix = ilwis.Pixel(x, y, z)
+                    self.isEqual(interleaved.pix2value(pix), bands.pix2value(pix), "Interleaved value at " + str(x) + " " + str(y) + " " + str(z))
+                    self.isEqual(converted.pix2value(pix), bands.pix2value(pix), "Converted value at " + str(x) + " " + str(y) + " " + str(z))
+                self.isEqual(sums[1].pix2value(ilwis.Pixel(x, y)), sums[0].pix2value(ilwis.Pixel(x, y)), "Sum of interleaved bands at " + str(x) + " " + str(y))
+                self.isEqual(sums[2].pix2value(ilwis.Pixel(x, y)), sums[0].pix2value(ilwis.Pixel(x, y)), "Sum of converted bands at " + str(x) + " " + str(y))
+
+    def test_12_overviews(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # every level halves the size; a numeric overview pixel is the mean of the defined pixels it covers
+        grf = ilwis.GeoReference("epsg:4326", ilwis.Envelope("0 25 30 60") , ilwis.Size(41,30))
+        rc = ilwis.RasterCoverage()
+        rc.setGeoReference(grf)
+        rc.setDataDef(ilwis.DataDefinition(ilwis.NumericDomain("code=value"), ilwis.NumericRange(-100000, 100000, 0)))
+        rc.setSize(ilwis.Size(41, 30, 2))
+        values = (np.arange(41 * 30 * 2, dtype = np.float64) * 7) % 311
+        values[5] = ilwis.Const.rUNDEF
+        rc.array2raster(values)
+        grid = values.reshape(2, 30, 41)
+
+        self.isEqual(rc.overviewLevels(), 6, "Number of overview levels")
+        ov = rc.overview(1)
+        self.isEqual(ov.size().xsize, 21, "X size of the first overview")
+        self.isEqual(ov.size().ysize, 15, "Y size of the first overview")
+        self.isEqual(ov.size().zsize, 2, "Z size of the first overview")
+        for z in range(2):
+            for y in range(15):
+                for x in range(21):
+                    part = grid[z, 2 * y : 2 * y + 2, 2 * x : 2 * x + 2].flatten()
+                    part = part[part != ilwis.Const.rUNDEF]
+                    self.isAlmostEqualNum(ov.pix2value(ilwis.Pixel(x, y, z)), np.mean(part), 1e-9, "Mean of the pixels under " + str(x) + " " + str(y) + " " + str(z))
+        self.isEqual(rc.overview(6).size().xsize, 1, "Last overview")
+        self.isTrue(not rc.overview(7), "No overview beyond the last level")
+
+        # writing pixels drops the overviews; the next request builds them from the new values
+        rc.array2raster(np.full(41 * 30, 50.0, dtype = np.float64), 1)
+        ov = rc.overview(1)
+        self.isEqual(ov.pix2value(ilwis.Pixel(3, 4, 1)), 50.0, "Overview pixel of a band that was written")
+        self.isAlmostEqualNum(ov.pix2value(ilwis.Pixel(3, 4, 0)), np.mean(grid[0, 8:10, 6:8]), 1e-9, "Overview pixel of a band that was not written")
+        it = ilwis.PixelIterator(rc)
+        it[0] = 1000.0
+        self.isAlmostEqualNum(rc.overview(1).pix2value(ilwis.Pixel(0, 0, 0)), np.mean([1000.0, grid[0, 0, 1], grid[0, 1, 0], grid[0, 1, 1]]), 1e-9, "Overview pixel after writing through an iterator")
+        self.isAlmostEqualNum(rc.overview(6).pix2value(ilwis.Pixel(0, 0, 1)), 50.0, 1e-9, "Last overview of a band that was written")
+
+    def test_13_storeBlockwise(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # the GeoTIFF writer converts strips of whole GDAL blocks in parallel while the previous strip is written; 300 x 270 pixels of two bands
+        values = (np.arange(300 * 270 * 2, dtype = np.float64) * 7) % 311
+        values[17] = ilwis.Const.rUNDEF
+        rc = self.createNumericRaster(300, 270, 2, values)
+
+        # stripped: undefined pixels get the nodata value of the float type
+        rc.store("storetest_plain.tif", "GTiff", "gdal")
+        stored = ilwis.RasterCoverage("storetest_plain.tif")
+        self.isEqual(stored.size().zsize, 2, "Bands of the stripped output")
+        self.isTrue(np.array_equal(np.fromiter(ilwis.PixelIterator(stored), dtype=np.float64), values), "Values of the stripped output")
+
+        # tiled and compressed: the tiles of the file become the blocks of the grid when it is read
+        rc.store("storetest_tiled.tif", "GTiff", "gdal", ilwis.IOOptions("tiled", True).addOption("tilesize", 64).addOption("compress", "deflate"))
+        stored = ilwis.RasterCoverage("storetest_tiled.tif")
+        self.isEqual(stored.tileSize().xsize, 64, "Tile width of the tiled output")
+        self.isEqual(stored.tileSize().ysize, 64, "Tile height of the tiled output")
+        self.isTrue(np.array_equal(np.fromiter(ilwis.PixelIterator(stored), dtype=np.float64), values), "Values of the tiled output")
+
+        # cloud optimized: tiled, with averaged overviews in the file; the first one serves level 1 of the pyramid
+        rc.store("storetest_cog.tif", "GTiff", "gdal", ilwis.IOOptions("cog", True).addOption("tilesize", 64))
+        stored = ilwis.RasterCoverage("storetest_cog.tif")
+        self.isEqual(stored.tileSize().xsize, 64, "Tile width of the cloud optimized output")
+        self.isTrue(np.array_equal(np.fromiter(ilwis.PixelIterator(stored), dtype=np.float64), values), "Values of the cloud optimized output")
+        ov = stored.overview(1)
+        self.isEqual(ov.size().xsize, 150, "Width of the first overview of the cloud optimized output")
+        band = values[300 * 270:].reshape(270, 300)
+        self.isAlmostEqualNum(ov.pix2value(ilwis.Pixel(20, 30, 1)), np.mean(band[60:62, 40:42]), 1e-9, "Averaged overview of the cloud optimized output")
+
+        # integers: an integer type holds the values, its undefined value is the nodata of the file
+        integers = np.arange(300 * 270, dtype = np.float64) % 1000 - 500
+        integers[5] = ilwis.Const.rUNDEF
+        irc = ilwis.RasterCoverage()
+        irc.setGeoReference(ilwis.GeoReference("epsg:4326", ilwis.Envelope("0 25 30 60") , ilwis.Size(300, 270)))
+        irc.setDataDef(ilwis.DataDefinition(ilwis.NumericDomain("code=value"), ilwis.NumericRange(-500, 499, 1)))
+        irc.setSize(ilwis.Size(300, 270, 1))
+        irc.array2raster(integers)
+        irc.store("storetest_integer.tif", "GTiff", "gdal")
+        stored = ilwis.RasterCoverage("storetest_integer.tif")
+        self.isEqual(stored.datadef().range().toNumericRange().resolution(), 1.0, "Integer values of the integer output")
+        self.isTrue(np.array_equal(np.fromiter(ilwis.PixelIterator(stored), dtype=np.float64), integers), "Values of the integer output")
+
+        stored = None
+        ov = None
+        self.removeFiles("storetest_*")
+
+    def test_14_ilwis4Chunks(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # the ilwis4 data file holds chunks in the smallest type that fits them; an undefined and a constant chunk are stored as one value.
+        # 100 x 70 pixels in chunks of 32 x 32 give 4 x 3 chunks per band, and the grid gets blocks of that size when the file is read
+        values = np.arange(100 * 70 * 2, dtype = np.float64).reshape(2, 70, 100) % 251
+        values[0, 0:32, 0:32] = ilwis.Const.rUNDEF
+        values[1, 32:64, 32:64] = 7
+        values[1, 5, 90] = 0.25
+        values[0, 40, 10] = ilwis.Const.rUNDEF
+        rc = self.createNumericRaster(100, 70, 2, values.flatten())
+        region = ilwis.IOOptions("boundingbox", "40 40 0 50 50 0") # within block 5 of band 0
+
+        # uncompressed: the first load of band 0 maps all its blocks into the file, except the one of the undefined chunk, which has no data in the file
+        rc.store("chunktest_mapped.ilwis4", "i4raster", "ilwis4", ilwis.IOOptions("tilesize", 32))
+        stored = ilwis.RasterCoverage("chunktest_mapped.ilwis4")
+        self.isEqual(stored.tileSize().xsize, 32, "Blocks of the grid have the size of the chunks")
+        self.isTrue(stored.loadData(region), "Loading a region of the uncompressed chunk file")
+        self.isEqual([b for b in range(24) if stored.hasBlockData(b)], list(range(1, 12)), "Blocks of band 0 mapped on its first load")
+        self.isTrue(np.array_equal(np.fromiter(ilwis.PixelIterator(stored), dtype=np.float64), values.flatten()), "Values of the uncompressed chunk file")
+
+        # compressed: nothing can be mapped; a load gets only the blocks of the region, the others are read when they are used
+        rc.store("chunktest_compressed.ilwis4", "i4raster", "ilwis4", ilwis.IOOptions("tilesize", 32).addOption("compression", 6).addOption("overviews", True))
+        stored = ilwis.RasterCoverage("chunktest_compressed.ilwis4")
+        self.isTrue(stored.loadData(region), "Loading a region of the compressed chunk file")
+        self.isEqual([b for b in range(24) if stored.hasBlockData(b)], [5], "Blocks of the compressed chunk file loaded for the region")
+        self.isTrue(np.array_equal(np.fromiter(ilwis.PixelIterator(stored), dtype=np.float64), values.flatten()), "Values of the compressed chunk file")
+        ov = stored.overview(1)
+        self.isAlmostEqualNum(ov.pix2value(ilwis.Pixel(20, 20, 1)), 7, 1e-9, "Overview from the chunk file")
+
+        stored = None
+        ov = None
+        self.removeFiles("chunktest_*")
+
+    def test_15_tiledReaders(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # a source that is organized in full width lines must fill a tiled grid as well; its blocks are then read line by line instead of being mapped
+        values = (np.arange(70 * 50, dtype = np.float64) * 3) % 499
+        values[71] = ilwis.Const.rUNDEF
+        rc = self.createNumericRaster(70, 50, 1, values)
+        rc.store("tiledread.mpr", "map", "ilwis3")
+        stored = ilwis.RasterCoverage("tiledread.mpr")
+        stored.setTileSize(ilwis.Size(16, 16))
+        self.isEqual(stored.tileSize().xsize, 16, "Tile width of the ilwis3 raster")
+        same = all(stored.pix2value(ilwis.Pixel(x, y, 0)) == rc.pix2value(ilwis.Pixel(x, y, 0)) for y in range(50) for x in range(70))
+        self.isTrue(same, "Values of the tiled ilwis3 raster")
+        self.isEqual(stored.pix2value(ilwis.Pixel(1, 1, 0)), ilwis.Const.rUNDEF, "Undefined value of the tiled ilwis3 raster")
+        stored = None
+        self.removeFiles("tiledread*")
+
+    def test_16_bandsAfterLastBlock(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # when the lines of a band end exactly at the end of a row of blocks, iterating must go on with the next band. A band interleaved grid has no
+        # blocks beyond those of the first band, so the next band must be chosen before the next block is. 2500 columns of 5 bands make strips of 100 lines
+        cases = [(2500, 200, 5, None), (70, 48, 3, ilwis.Size(16, 16))]
+        for xsize, ysize, zsize, tileSize in cases:
+            values = np.arange(xsize * ysize * zsize, dtype = np.float64) % 797
+            for interleaved in [False, True]:
+                rc = self.createNumericRaster(xsize, ysize, zsize, values, tileSize, interleaved)
+                name = ("tiles" if tileSize is not None else "strips") + (" interleaved" if interleaved else "")
+                iterated = np.fromiter(ilwis.PixelIterator(rc), dtype = np.float64)
+                self.isEqual(len(iterated), len(values), "Pixels iterated in all bands of " + name)
+                self.isTrue(np.array_equal(iterated, values), "Values iterated in all bands of " + name)
+
+    def test_17_loadRegion(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # loading a region reads only the blocks that intersect it; with tiles of 32x32 a band of 200x120 has 7 x 4 blocks
+        values = np.arange(200 * 120 * 2, dtype = np.float64) % 397
+        rc = self.createNumericRaster(200, 120, 2, values)
+        rc.store("regionload.tif", "GTiff", "gdal")
+        inRegion = [8, 9, 15, 16]
+        # pixels 40..70 x 50..70 of the second band, and about the same pixels as coordinates of all bands
+        cases = [("boundingbox", "40 50 1 70 70 1", [28 + b for b in inRegion]),
+                 ("envelope", "6.1 39.6 10.4 45.3", inRegion + [28 + b for b in inRegion])]
+        for option, region, expected in cases:
+            stored = ilwis.RasterCoverage("regionload.tif")
+            stored.setTileSize(ilwis.Size(32, 32))
+            self.isTrue(stored.loadData(ilwis.IOOptions(option, region)), "Loading a region given by a " + option)
+            loaded = [b for b in range(2 * 28) if stored.hasBlockData(b)]
+            self.isEqual(loaded, expected, "Blocks loaded for a region given by a " + option)
+            self.isEqual(stored.pix2value(ilwis.Pixel(45, 55, 1)), values[200 * 120 + 55 * 200 + 45], "Pixel value in the region given by a " + option)
+            self.isEqual(stored.pix2value(ilwis.Pixel(5, 5, 0)), values[5 * 200 + 5], "Pixel value outside the region given by a " + option)
+            stored = None
+        self.removeFiles("regionload*")
+
+    def writeScaledTiff(self, path, xsize, ysize, raw, scale, offset, nodata):
+        # a geotiff of signed 16 bit values with the scale, offset and nodata of its band in the gdal tags; 0.1 degree pixels from 5E 50N in epsg:4326
+        metadata = ('<GDALMetadata><Item name="OFFSET" sample="0" role="offset">%g</Item><Item name="SCALE" sample="0" role="scale">%g</Item></GDALMetadata>' % (offset, scale)).encode() + b'\0'
+        nodataText = ('%d' % nodata).encode() + b'\0'
+        geokeys = struct.pack('<16H', 1, 1, 0, 3, 1024, 0, 1, 2, 1025, 0, 1, 1, 2048, 0, 1, 4326)
+        extras = [(33550, 12, 3, struct.pack('<3d', 0.1, 0.1, 0.0)), (33922, 12, 6, struct.pack('<6d', 0, 0, 0, 5.0, 50.0, 0)),
+                  (34735, 3, 16, geokeys), (42112, 2, len(metadata), metadata), (42113, 2, len(nodataText), nodataText)]
+        pixels = np.asarray(raw, dtype = '<i2').tobytes()
+        tags = [(256, 3, 1, xsize), (257, 3, 1, ysize), (258, 3, 1, 16), (259, 3, 1, 1), (262, 3, 1, 1), (273, 4, 1, None), (277, 3, 1, 1),
+                (278, 3, 1, ysize), (279, 4, 1, len(pixels)), (339, 3, 1, 2)] + extras
+        tags.sort(key = lambda tag: tag[0])
+        directorySize = 2 + 12 * len(tags) + 4
+        dataOffset = 8 + directorySize
+        entries = b''
+        data = b''
+        for tag, type, count, value in tags:
+            if isinstance(value, bytes) and len(value) > 4:
+                entries += struct.pack('<HHII', tag, type, count, dataOffset + len(data))
+                data += value + (b'\0' if len(value) % 2 else b'')
+            elif isinstance(value, bytes):
+                entries += struct.pack('<HHI', tag, type, count) + value.ljust(4, b'\0')
+            elif tag == 273:
+                entries += struct.pack('<HHII', tag, type, count, 0) # patched below, the pixels follow the other data
+            else:
+                entries += struct.pack('<HHI', tag, type, count) + (struct.pack('<HH', value, 0) if type == 3 else struct.pack('<I', value))
+        pixelOffset = dataOffset + len(data)
+        index = [t[0] for t in tags].index(273)
+        entries = entries[:12 * index + 8] + struct.pack('<I', pixelOffset) + entries[12 * index + 12:]
+        with open(path, 'wb') as f:
+            f.write(b'II' + struct.pack('<HI', 42, 8) + struct.pack('<H', len(tags)) + entries + struct.pack('<I', 0) + data + pixels)
+
+    def test_18_scaledNodata(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # nodata is a raw value of the band; it must be compared before the scale and offset are applied. The raw value -20018 scales to -9999, the
+        # nodata value, but is a valid value; the raw value -9999 is the undefined one
+        xsize, ysize, scale, offset, nodata = 12, 10, 0.5, 10.0, -9999
+        raw = (np.arange(xsize * ysize) * 7 % 300 - 150).astype(np.int16)
+        raw[3] = nodata
+        raw[17] = -20018
+        raw[xsize * ysize - 1] = nodata
+        self.writeScaledTiff(self.workingdir + '/scalednodata.tif', xsize, ysize, raw, scale, offset, nodata)
+
+        rc = ilwis.RasterCoverage("scalednodata.tif")
+        self.isTrue(bool(rc), "Opening the scaled raster with nodata")
+        values = np.fromiter(ilwis.PixelIterator(rc), dtype=np.float64)
+        expected = raw.astype(np.float64) * scale + offset
+        expected[raw == nodata] = ilwis.Const.rUNDEF
+        self.isEqual(values.tolist(), expected.tolist(), "Scaled values with the raw nodata value undefined")
+        self.isEqual(rc.pix2value(ilwis.Pixel(3, 0)), ilwis.Const.rUNDEF, "Raw nodata value is undefined")
+        self.isEqual(rc.pix2value(ilwis.Pixel(5, 1)), -9999.0, "Scaled value equal to nodata is defined")
+        rc = None
+        self.removeFiles("scalednodata*")
@@ -68,6 +68,26 @@ class TestBasicPixelIterator(bt.BaseTest):
                 
         self.isTrue(eq, "All Pixel values match, 3D")
 
+    def test_02_spans(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # the same computation through classic iteration and through span loops must give identical rasters, also when the blocks hold several bands
+        rc1 = self.createSmallNumericRaster3Layers()
+        rc2 = self.createSmallNumericRaster3Layers(1)
+        for interleaved in [False, True]:
+            rc1.setInterleaved(interleaved)
+            rc2.setInterleaved(interleaved)
+            name = ", band interleaved" if interleaved else ""
+            result = ilwis.do("iterationbenchmark", rc1, rc2)
+            classic = np.fromiter(ilwis.PixelIterator(result[0]), dtype = np.float64)
+            span = np.fromiter(ilwis.PixelIterator(result[1]), dtype = np.float64)
+            self.isEqual(len(span), rc1.size().linearSize(), "All pixels visited" + name)
+            self.isTrue(np.array_equal(classic, span), "Span loops give the same result as classic iteration" + name)
+            in1 = np.fromiter(ilwis.PixelIterator(rc1), dtype = np.float64)
+            in2 = np.fromiter(ilwis.PixelIterator(rc2), dtype = np.float64)
+            undef = (in1 == ilwis.Const.rUNDEF) | (in2 == ilwis.Const.rUNDEF)
+            self.isTrue(np.array_equal(span, np.where(undef, ilwis.Const.rUNDEF, 2 * in1 + in2)), "Span loops compute 2 * raster1 + raster2" + name)
+
 
 
    
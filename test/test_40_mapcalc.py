@@ -254,6 +254,81 @@ class TestBasicPixelIterator(bt.BaseTest):
         self.isAlmostEqualNum(rc3.pix2value(ilwis.Pixel(4,9,2)),70.63993204979744, 0.01, "pixel value at 4,9,2, basic mapcalc sqrt")
         self.isEqual(rc3.pix2value(ilwis.Pixel(0,2,0)),ilwis.Const.rUNDEF, "pixel value at 0,2,0, basic mapcalc sqrt undef")
 
+    def test_03_blockEvaluation(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # mapcalc evaluates whole runs of pixels at a time; every pixel must still follow the undefined rules of the per pixel evaluation
+        rc1 = self.createSmallNumericRaster3Layers()
+        rc2 = self.createSmallNumericRaster1Layer(5)
+        rc3 = ilwis.do("mapcalc", "iff(@1 > @2, (@1 - @2) / (@2 - 105), min(@1, @2) * 0.5)", rc1, rc2)
+
+        undef = ilwis.Const.rUNDEF
+        def expected(v1, v2):
+            if v1 == undef or v2 == undef:
+                return undef
+            if v1 > v2:
+                return undef if v2 - 105 == 0 else (v1 - v2) / (v2 - 105)
+            return min(v1, v2) * 0.5
+
+        ok = True
+        sz = rc1.size()
+        for z in range(sz.zsize):
+            for y in range(sz.ysize):
+                for x in range(sz.xsize):
+                    v1 = rc1.pix2value(ilwis.Pixel(x,y,z))
+                    v2 = rc2.pix2value(ilwis.Pixel(x,y,0)) # the single band input is used for every band
+                    if abs(rc3.pix2value(ilwis.Pixel(x,y,z)) - expected(v1, v2)) > 1e-9:
+                        ok = False
+        self.isTrue(ok, "All pixels of a multi band mapcalc with a single band input")
+        self.isEqual(rc3.pix2value(ilwis.Pixel(10,0,1)), undef, "pixel value at 10,0,1, division by zero is undefined")
+        # atan is defined for every number, also beyond pi/2
+        rc4 = ilwis.do("mapcalc", "atan(@1)", rc1)
+        self.isAlmostEqualNum(rc4.pix2value(ilwis.Pixel(4,9,0)), np.arctan(rc1.pix2value(ilwis.Pixel(4,9,0))), 1e-9, "pixel value at 4,9,0, atan of a value beyond pi/2")
+        self.isEqual(rc4.pix2value(ilwis.Pixel(0,2,0)), undef, "pixel value at 0,2,0, atan undef")
+
+    def test_04_chainedExpressions(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # pixel wise results are computed when they are read, fused with the operations that use them; a chain must give the same pixels as one expression
+        rc1 = self.createSmallNumericRaster3Layers()
+        rc2 = self.createSmallNumericRaster1Layer(5)
+        step1 = ilwis.do("mapcalc", "iff(@1 > @2, @1 - @2, @2 * 0.5)", rc1, rc2)
+        step2 = step1 * 2 + rc1
+        chained = ilwis.do("mapcalc", "max(@1, 20) / @2", step2, rc2)
+        direct = ilwis.do("mapcalc", "max(iff(@1 > @2, @1 - @2, @2 * 0.5) * 2 + @1, 20) / @2", rc1, rc2)
+
+        # an intermediate result that was read keeps its values when it is used again
+        readFirst = step1.pix2value(ilwis.Pixel(3,4,2))
+        again = step1 + 0
+
+        ok = True
+        sz = rc1.size()
+        for z in range(sz.zsize):
+            for y in range(sz.ysize):
+                for x in range(sz.xsize):
+                    pix = ilwis.Pixel(x,y,z)
+                    if abs(chained.pix2value(pix) - direct.pix2value(pix)) > 1e-9 or again.pix2value(pix) != step1.pix2value(pix):
+                        ok = False
+        self.isTrue(ok, "All pixels of a chain of operations")
+        self.isEqual(again.pix2value(ilwis.Pixel(3,4,2)), readFirst, "pixel value at 3,4,2 of a result that was read")
+
+    def test_05_deferredInputs(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # a deferred result has the values of its inputs at the moment it was made, also when an input is written before the result is read
+        rc1 = self.createSmallNumericRaster1Layer(3)
+        before = np.fromiter(ilwis.PixelIterator(rc1), dtype=np.float64)
+        result = ilwis.do("mapcalc", "@1 * 2 - 7", rc1)
+        rc1.array2raster(np.full(15 * 12, 1000.0, dtype = np.float64))
+
+        values = np.fromiter(ilwis.PixelIterator(result), dtype=np.float64)
+        defined = before != ilwis.Const.rUNDEF
+        self.isTrue(np.allclose(values[defined], before[defined] * 2 - 7), "Pixels of a result of which the input was written afterwards")
+        self.isEqual(values[9], ilwis.Const.rUNDEF, "pixel value at 9,0,0, undef")
+        # the range of a result that has been read entirely is the range of its values
+        self.isAlmostEqualNum(result.min(), values[defined].min(), 1e-9, "Minimum of a deferred result")
+        self.isAlmostEqualNum(result.max(), values[defined].max(), 1e-9, "Maximum of a deferred result")
+
         
 
        
@@ -34,8 +34,42 @@ class TestTable(bt.BaseTest):
            self.isTrue(False, "trying to access aa recordnumber") # shouldnt' come here
         except IndexError as ex:
            self.isTrue(True, "trying to access illegal recordnumber")
-   
 
+    def test_02_columnStorage(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # the ilwis4 data file of a table holds its values per column. Numbers and the raw values of items are packed as numbers, text as a dictionary
+        # of its distinct values; undefined values must survive both
+        tbl = self.createTestTable()
+        tbl.setCell("ints", 2, ilwis.Const.iUNDEF)
+        tbl.setCell("floats", 3, ilwis.Const.rUNDEF)
+        tbl.setCell("items", 1, ilwis.Const.sUNDEF)
+        tbl.setCell("strings1", 4, ilwis.Const.sUNDEF)
+        names = ["ints", "floats", "items", "strings1", "strings2", "strings3"]
+        tbl.store("columntest_plain.ilwis4", "i4table", "ilwis4")
+        tbl.store("columntest_compressed.ilwis4", "i4table", "ilwis4", ilwis.IOOptions("compression", 6).addOption("chunkrows", 1024))
+
+        for name in ["plain", "compressed"]:
+            stored = ilwis.Table("columntest_" + name + ".ilwis4")
+            self.isEqual(stored.recordCount(), tbl.recordCount(), "Records of the " + name + " column file")
+            same = all(stored.cell(c, r) == tbl.cell(c, r) for c in names for r in range(tbl.recordCount()))
+            self.isTrue(same, "Values of the " + name + " column file")
+            self.isEqual(stored.cell("ints", 2), ilwis.Const.iUNDEF, "Undefined number of the " + name + " column file")
+            self.isEqual(stored.cell("items", 1), ilwis.Const.sUNDEF, "Undefined item of the " + name + " column file")
+
+        # a selection of columns: an item column and a text column; the others are not loaded
+        part = ilwis.Table("columntest_compressed.ilwis4", ilwis.IOOptions("columns", "items|strings1"))
+        self.isEqual(part.columnCount(), 2, "Only the selected columns are loaded")
+        self.isEqual(part.cell("items", 0), "stone", "Item of a selected column")
+        self.isEqual(part.cell("items", 1), ilwis.Const.sUNDEF, "Undefined item of a selected column")
+        self.isEqual(part.cell("strings1", 3), "wim", "Text of a selected column")
+        self.isEqual(part.cell("strings1", 4), ilwis.Const.sUNDEF, "Undefined text of a selected column")
+
+        stored = None
+        part = None
+        self.removeFiles("columntest_*")
+   
+ 
 
      
 
@@ -85,4 +85,123 @@ class TestRasterOperations(bt.BaseTest):
 
         bt.testExceptionCondition2(self,lambda p1, p2 : ilwis.do('mirrorrotateraster',p1, p2), rc, 'mirrhor', 'aborted, illegal input map') 
         bt.testExceptionCondition2(self,lambda p1, p2 : ilwis.do('mirrorrotateraster',p1, p2), rc1, 'blabla', 'aborted, illegal mirrottype') 
-        
\ No newline at end of file
+        
+    def test_02_linearFilter(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # the filter engine works on rows of pixels; every pixel must equal the filter applied to its neighbourhood, with repeated edge pixels
+        grf = ilwis.GeoReference("epsg:4326", ilwis.Envelope("0 25 30 60") , ilwis.Size(20,14))
+        rc = ilwis.RasterCoverage()
+        rc.setGeoReference(grf)
+        rc.setDataDef(ilwis.DataDefinition(ilwis.NumericDomain("code=value"), ilwis.NumericRange(-1000000.0, 1000000.0, 0)))
+        rc.setSize(ilwis.Size(20,14))
+        array1 = np.empty(20 * 14, dtype = np.float64)
+        for i in range(len(array1)):
+            array1[i] = (i * 37) % 101 + 0.25
+        array1[5 * 20 + 7] = ilwis.Const.rUNDEF
+        rc.array2raster(array1)
+
+        undef = ilwis.Const.rUNDEF
+        def reference(kernel, columns, rows, gain, x, y):
+            v = 0
+            for dy in range(rows):
+                for dx in range(columns):
+                    px = min(max(x + dx - columns // 2, 0), 19)
+                    py = min(max(y + dy - rows // 2, 0), 13)
+                    val = rc.pix2value(ilwis.Pixel(px, py))
+                    if val == undef:
+                        return undef
+                    v += val * kernel[dy * columns + dx]
+            return v * gain
+
+        filters = [("code=1 2 1 2 4 2 1 2 1", [1,2,1,2,4,2,1,2,1], 3, 3, 1.0 / 16), # separable
+                   ("code=0 -1 0 -1 5 -1 0 -1 0", [0,-1,0,-1,5,-1,0,-1,0], 3, 3, 1.0),
+                   ("code=5,3,1 1 1 1 1 1 2 2 2 1 1 1 1 1 1", [1,1,1,1,1,1,2,2,2,1,1,1,1,1,1], 5, 3, 1.0 / 18)]
+        for definition, kernel, columns, rows, gain in filters:
+            result = ilwis.do("linearrasterfilter", rc, definition)
+            ok = True
+            for y in range(14):
+                for x in range(20):
+                    if abs(result.pix2value(ilwis.Pixel(x, y)) - reference(kernel, columns, rows, gain, x, y)) > 1e-9:
+                        ok = False
+            self.isTrue(ok, "All pixels of linear filter " + definition)
+        self.isEqual(ilwis.do("linearrasterfilter", rc, "code=1 2 1 2 4 2 1 2 1").pix2value(ilwis.Pixel(8,6)), undef, "pixel value at 8,6 next to an undefined pixel")
+
+    def test_03_rankOrderFilter(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # the rank order engine keeps a sliding histogram of the neighbourhood; every pixel must equal the sorted neighbourhood at the rank, undefined values ranking lowest
+        grf = ilwis.GeoReference("epsg:4326", ilwis.Envelope("0 25 30 60") , ilwis.Size(20,14))
+        undef = ilwis.Const.rUNDEF
+        for integers in [True, False]:
+            rc = ilwis.RasterCoverage()
+            rc.setGeoReference(grf)
+            rc.setDataDef(ilwis.DataDefinition(ilwis.NumericDomain("code=value"), ilwis.NumericRange(-1000000.0, 1000000.0, 0)))
+            rc.setSize(ilwis.Size(20,14))
+            array1 = np.empty(20 * 14, dtype = np.float64)
+            for i in range(len(array1)):
+                array1[i] = (i * 37) % 23 if integers else ((i * 37) % 101) * 1013.5
+            array1[5 * 20 + 7] = undef
+            rc.array2raster(array1)
+
+            for name, size, rank in [("median3x3", 3, 4), ("median5x5", 5, 12), ("maximum3x3", 3, 8)]:
+                result = ilwis.do("rankorderrasterfilter", rc, name)
+                ok = True
+                for y in range(14):
+                    for x in range(20):
+                        window = []
+                        for dy in range(size):
+                            for dx in range(size):
+                                px = min(max(x + dx - size // 2, 0), 19)
+                                py = min(max(y + dy - size // 2, 0), 13)
+                                window.append(rc.pix2value(ilwis.Pixel(px, py)))
+                        window.sort()
+                        if result.pix2value(ilwis.Pixel(x, y)) != window[rank]:
+                            ok = False
+                self.isTrue(ok, "All pixels of rank order filter " + name + (" on integers" if integers else " on real values"))
+
+    def test_04_aggregateGrouped(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # grouped aggregation reads its groups as windows on a ring of rows
+        rc = self.createSmallNumericRaster3Layers()
+        for method, func in [("Avg", lambda v : sum(v) / len(v)), ("Max", max), ("Min", min)]:
+            result = ilwis.do("aggregateraster", rc, method, 3, True)
+            sz = result.size()
+            self.isEqual(sz.xsize, 5, "aggregated xsize")
+            ok = True
+            for z in range(sz.zsize):
+                for y in range(sz.ysize):
+                    for x in range(sz.xsize):
+                        values = [rc.pix2value(ilwis.Pixel(x * 3 + dx, y * 3 + dy, z)) for dy in range(3) for dx in range(3)]
+                        if abs(result.pix2value(ilwis.Pixel(x, y, z)) - func(values)) > 1e-6:
+                            ok = False
+            self.isTrue(ok, "All pixels of grouped aggregation " + method)
+
+    def test_05_rankOrderFilterChunks(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # the rows of a box are binned in chunks; the pixels around the border of two chunks must be ranked like all others
+        xsize, ysize = 9, 600
+        grf = ilwis.GeoReference("epsg:4326", ilwis.Envelope("0 0 9 60") , ilwis.Size(xsize, ysize))
+        for integers in [True, False]:
+            rc = ilwis.RasterCoverage()
+            rc.setGeoReference(grf)
+            rc.setDataDef(ilwis.DataDefinition(ilwis.NumericDomain("code=value"), ilwis.NumericRange(-1000000.0, 1000000.0, 0)))
+            rc.setSize(ilwis.Size(xsize, ysize))
+            values = np.array([(i * 37) % 29 if integers else ((i * 53) % 997) * 0.25 for i in range(xsize * ysize)], dtype = np.float64)
+            rc.array2raster(values)
+
+            threads = ilwis.Engine.threadCount()
+            ilwis.Engine.setThreadCount(1) # one box, so there is more than one chunk
+            result = np.fromiter(ilwis.PixelIterator(ilwis.do("rankorderrasterfilter", rc, "median5x5")), dtype=np.float64).reshape(ysize, xsize)
+            ilwis.Engine.setThreadCount(threads)
+            grid = values.reshape(ysize, xsize)
+            ok = True
+            for y in range(ysize):
+                rows = np.clip(np.arange(y - 2, y + 3), 0, ysize - 1)
+                for x in range(xsize):
+                    columns = np.clip(np.arange(x - 2, x + 3), 0, xsize - 1)
+                    if result[y, x] != np.sort(grid[np.ix_(rows, columns)], axis = None)[12]:
+                        ok = False
+            self.isTrue(ok, "All pixels of a median filter over more than one chunk of rows" + (" on integers" if integers else " on real values"))
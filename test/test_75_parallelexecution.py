@@ -0,0 +1,208 @@
+import unittest as ut
+import basetest as bt
+import ilwis
+import inspect
+import math
+import numpy as np
+
+class TestParallelExecution(bt.BaseTest):
+    def setUp(self):
+        self.prepare('base')
+        self.threads = ilwis.Engine.threadCount()
+
+    def tearDown(self):
+        ilwis.Engine.setThreadCount(self.threads)
+
+    def createRaster(self, xsize, ysize, zsize, offset):
+        grf = ilwis.GeoReference("epsg:4326", ilwis.Envelope("0 25 30 60") , ilwis.Size(xsize,ysize))
+        dfNum = ilwis.DataDefinition(ilwis.NumericDomain("code=value"), ilwis.NumericRange(-1000000.0, 1000000.0, 0))
+        rc = ilwis.RasterCoverage()
+        rc.setGeoReference(grf)
+        rc.setDataDef(dfNum)
+        rc.setSize(ilwis.Size(xsize, ysize, zsize))
+        baseSize = xsize * ysize
+        for z in range(zsize):
+            array1 = np.empty(baseSize, dtype = np.float64)
+            for i in range(baseSize):
+                array1[i] = (i + z * baseSize) * 0.5 + offset + 100 * math.sin(math.radians(i * 7))
+            array1[(z * 13) % baseSize] = ilwis.Const.rUNDEF
+            rc.array2raster(array1, z)
+
+        return rc
+
+    def pixels(self, rc):
+        sz = rc.size()
+        values = []
+        for z in range(sz.zsize):
+            for y in range(sz.ysize):
+                for x in range(sz.xsize):
+                    values.append(rc.pix2value(ilwis.Pixel(x,y,z)))
+        return values
+
+    def compareThreadCounts(self, func, msg):
+        ilwis.Engine.setThreadCount(1)
+        reference = self.pixels(func())
+        for n in range(2, 5):
+            ilwis.Engine.setThreadCount(n)
+            self.isTrue(self.pixels(func()) == reference, msg + " identical with " + str(n) + " threads")
+
+    def test_01_pointoperations(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        rc1 = self.createRaster(60, 45, 2, 0)
+        rc2 = self.createRaster(60, 45, 2, 25)
+
+        self.compareThreadCounts(lambda : ilwis.do("mapcalc", "(@1 + 1) * @2 - 3", rc1, rc2), "mapcalc")
+        self.compareThreadCounts(lambda : rc1 + rc2, "binarymathraster coverage coverage")
+        self.compareThreadCounts(lambda : rc1 * 2.5, "binarymathraster coverage number")
+        self.compareThreadCounts(lambda : rc1 > rc2, "binarylogicalraster coverage coverage")
+        self.compareThreadCounts(lambda : rc1 > 300, "binarylogicalraster coverage number")
+        self.compareThreadCounts(lambda : ilwis.do("abs", rc1 - 500), "unary math")
+
+    def test_02_neighbourhoodoperations(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        rc1 = self.createRaster(60, 45, 1, 0)
+
+        self.compareThreadCounts(lambda : ilwis.do("linearrasterfilter", rc1, "code=1 2 1 2 4 2 1 2 1"), "linear filter")
+        self.compareThreadCounts(lambda : ilwis.do("aggregateraster", rc1, "Avg", 3, True), "aggregate raster grouped")
+
+    def test_03_readAhead(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # results must not depend on how far blocks are read ahead; with three bands the prefetcher reads the next bands of the inputs
+        depth = ilwis.Engine.prefetchDepth()
+        rc1 = self.createRaster(60, 45, 3, 0)
+        rc2 = self.createRaster(60, 45, 3, 25)
+        for d in [0, 1, 4]:
+            ilwis.Engine.setPrefetchDepth(d)
+            self.compareThreadCounts(lambda : ilwis.do("mapcalc", "@1 * @2 + 1", rc1, rc2), "mapcalc with read ahead depth " + str(d))
+        ilwis.Engine.setPrefetchDepth(depth)
+        stats = ilwis.Engine.prefetchStatistics()
+        self.isTrue(stats["requests"] >= stats["loads"], "Prefetch statistics")
+
+    def test_04_statistics(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # the statistics are collected per box of rows and merged in the order of the boxes; the result must not depend on the number of threads
+        ps = ilwis.PropertySets
+        mode = ps.pMIN | ps.pMAX | ps.pMEAN | ps.pMEDIAN | ps.pVARIANCE | ps.pSTDEV | ps.pHISTOGRAM
+        props = [ps.pCOUNT, ps.pNETTOCOUNT, ps.pMIN, ps.pMAX, ps.pSUM, ps.pMEAN, ps.pMEDIAN, ps.pVARIANCE, ps.pSTDEV]
+        values = np.array([v for v in self.pixels(self.createRaster(80, 60, 2, 0)) if v != ilwis.Const.rUNDEF])
+        reference = None
+        for n in range(1, 5):
+            ilwis.Engine.setThreadCount(n)
+            stats = self.createRaster(80, 60, 2, 0).statistics(mode)
+            result = [stats[p] for p in props] + [stats.histogram()]
+            if reference is None:
+                reference = result
+            self.isTrue(result == reference, "Statistics identical with " + str(n) + " threads")
+
+        self.isEqual(stats[ps.pNETTOCOUNT], len(values), "Net count")
+        self.isAlmostEqualNum(stats[ps.pMEAN], np.mean(values), 1e-9, "Mean")
+        self.isAlmostEqualNum(stats[ps.pVARIANCE], np.var(values), 1e-6, "Variance")
+        self.isAlmostEqualNum(stats[ps.pSTDEV], np.std(values, ddof = 1), 1e-9, "Standard deviation")
+        # the median comes from a sketch; its rank must be close to the middle
+        self.isAlmostEqualNum(np.mean(values < stats[ps.pMEDIAN]), 0.5, 0.02, "Rank of the median")
+        self.isEqual(sum([b[1] for b in stats.histogram()]), 80 * 60 * 2, "Pixels in the histogram")
+
+    def test_05_outputRanges(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # the range of an output is counted by the tasks while they write their boxes, or read back from the box by a task that does not count;
+        # a deferred result gets its range when its last block is computed. It must be the range of the values whatever the number of threads
+        rc1 = self.createRaster(60, 45, 3, 0)
+        cases = [("linear filter", lambda: ilwis.do("linearrasterfilter", rc1, "code=1 2 1 2 4 2 1 2 1"), None),
+                 ("rank order filter", lambda: ilwis.do("rankorderrasterfilter", rc1, "median3x3"), None),
+                 ("mirror", lambda: ilwis.do("mirrorrotateraster", rc1, "mirrvert"), None),
+                 ("deferred mapcalc", lambda: ilwis.do("mapcalc", "iff(@1 > 100, @1 * 2, @1 - 500)", rc1), 0),
+                 ("deferred integer mapcalc", lambda: ilwis.do("mapcalc", "iff(@1 > 100, 3, -2)", rc1), 1)]
+        for name, operation, resolution in cases:
+            for n in range(1, 5):
+                ilwis.Engine.setThreadCount(n)
+                out = operation()
+                values = [v for v in self.pixels(out) if v != ilwis.Const.rUNDEF]
+                nr = out.datadef().range().toNumericRange()
+                msg = " of the " + name + " output with " + str(n) + " threads"
+                self.isAlmostEqualNum(nr.min(), min(values), 1e-9, "Minimum" + msg)
+                self.isAlmostEqualNum(nr.max(), max(values), 1e-9, "Maximum" + msg)
+                if resolution is not None: # a mapcalc result gets resolution 1 if all its values are integers
+                    self.isEqual(nr.resolution(), resolution, "Resolution" + msg)
+                self.isAlmostEqualNum(out.min(), min(values), 1e-9, "Minimum through the statistics" + msg)
+
+    def test_06_boxedOperations(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # every operation that runs its boxes through OperationHelperRaster must give the same output whatever the number of threads
+        rc1 = self.createRaster(60, 45, 3, 0)
+        rc2 = self.createRaster(60, 45, 3, 25)
+        band = self.createRaster(60, 45, 1, 0)
+        target = ilwis.GeoReference("epsg:4326", ilwis.Envelope("0 25 30 60"), ilwis.Size(47, 38))
+        slices = ilwis.NumericItemRange()
+        slices.add(("low", -1000000.0, 300.0))
+        slices.add(("high", 300.0, 1000000.0))
+        sources = np.full(60 * 45, ilwis.Const.rUNDEF)
+        sources[[0, 1000, 2699]] = 1
+        source = self.createRaster(60, 45, 1, 0)
+        source.array2raster(sources)
+        weight = self.createRaster(60, 45, 1, 0) * 0 + 1
+
+        self.compareThreadCounts(lambda : ilwis.do("iffraster", rc1 > 300, rc1, rc2), "iffraster")
+        for method in ["nearestneighbour", "bilinear", "bicubic"]:
+            self.compareThreadCounts(lambda : ilwis.do("resample", band, target, method), "resample " + method)
+        self.compareThreadCounts(lambda : ilwis.do("densifyraster", band, 2, "bilinear"), "densifyraster")
+        self.compareThreadCounts(lambda : ilwis.do("areanumbering", band > 300, 8), "areanumbering")
+        self.compareThreadCounts(lambda : ilwis.do("sliceraster", rc1, ilwis.ItemDomain(slices)), "sliceraster")
+        self.compareThreadCounts(lambda : ilwis.do("distanceraster", source, weight), "distanceraster")
+        self.compareThreadCounts(lambda : ilwis.do("rankorderrasterfilter", band, "median3x3"), "rank order filter")
+        self.compareThreadCounts(lambda : ilwis.do("stackminmaxpick", rc1, "maximum"), "stackminmaxpick")
+        self.compareThreadCounts(lambda : ilwis.do("mirrorrotateraster", band, "rotate90"), "mirrorrotateraster")
+        self.compareThreadCounts(lambda : ilwis.do("aggregateraster", band, "Avg", 3, False), "aggregate raster not grouped")
+        for op in ["sqrt", "sin", "floor", "ln"]:
+            self.compareThreadCounts(lambda : ilwis.do(op, rc1), "unary math " + op)
+
+    def test_07_prefetchHits(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # a block that is read ahead from the source must be served from the cache when the operation gets to it
+        depth = ilwis.Engine.prefetchDepth()
+        ilwis.Engine.setThreadCount(1)
+        self.createRaster(400, 600, 1, 0).store("prefetchtest.tif", "GTiff", "gdal")
+        results = []
+        hits = []
+        for d in [0, 4]:
+            ilwis.Engine.setPrefetchDepth(d)
+            before = ilwis.Engine.prefetchStatistics()["hits"]
+            results.append(self.pixels(ilwis.do("mapcalc", "@1 * 2 + 1", ilwis.RasterCoverage("prefetchtest.tif"))))
+            hits.append(ilwis.Engine.prefetchStatistics()["hits"] - before)
+        ilwis.Engine.setPrefetchDepth(depth)
+        self.removeFiles("prefetchtest.*")
+        self.isEqual(hits[0], 0, "No prefetch hits without read ahead")
+        self.isTrue(hits[1] > 0, "Prefetched blocks served from the cache")
+        self.isTrue(results[0] == results[1], "Values identical with and without read ahead")
+
+    def test_08_pooledLoads(self):
+        self.decorateFunction(__name__, inspect.stack()[0][3])
+
+        # the tasks of an operation load the blocks of a gdal source in parallel, each through a dataset handle of the pool; the values must not depend on
+        # the number of threads and the handles must be reused between blocks
+        self.createRaster(300, 400, 2, 0).store("pooledload.tif", "GTiff", "gdal")
+        source = ilwis.RasterCoverage("pooledload.tif")
+        before = source.connectorStatistics()
+        results = []
+        for n in range(1, 5):
+            ilwis.Engine.setThreadCount(n)
+            source.unload()
+            results.append(np.fromiter(ilwis.PixelIterator(ilwis.do("mapcalc", "@1 * 2 + 1", source)), dtype=np.float64))
+        after = source.connectorStatistics()
+        source = None
+        self.removeFiles("pooledload.*")
+        for n in range(2, 5):
+            self.isTrue(np.array_equal(results[n - 1], results[0]), "Pooled loads identical with " + str(n) + " threads")
+        self.isTrue(after["pooled"], "Blocks loaded through the pool")
+        self.isTrue(after["opened"] > before["opened"], "Dataset handles opened by the pool")
+        self.isTrue(after["reused"] > before["reused"], "Dataset handles of the pool reused")
+        self.isTrue(after["open"] <= after["opened"], "Open dataset handles counted")
+
+if __name__ == "__main__":
+    ut.main()